@@ -0,0 +1,268 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "btree.h"
+#include "page.h"
+#include "node_search.h"
+#include "exceptions/insufficient_space_exception.h"
+#include "exceptions/file_not_found_exception.h"
+
+using namespace badgerdb;
+
+// -----------------------------------------------------------------------------
+// Throughput benchmarks, run as badgerdb_bench [benchmark]. Each one builds its
+// own relation and index in the working directory and removes them afterwards.
+// -----------------------------------------------------------------------------
+
+namespace
+{
+
+const std::string relationName = "benchRel";
+const int relationSize = 200000;
+
+/**
+ * Seconds each thread count and operation mix runs for.
+ */
+const double runSeconds = 1.0;
+
+typedef struct tuple {
+	int i;
+	double d;
+	char s[64];
+} RECORD;
+
+/**
+ * Write a relation whose int keys are 0 to relationSize-1.
+ */
+void createRelation()
+{
+	try
+	{
+		File::remove(relationName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+	PageFile file = PageFile::create(relationName);
+	RECORD record;
+	memset(&record, ' ', sizeof(record));
+	PageId pageNo;
+	Page page = file.allocatePage(pageNo);
+	for (int i = 0; i < relationSize; i++)
+	{
+		sprintf(record.s, "%08d string record", i);
+		record.i = i;
+		record.d = (double)i;
+		std::string data(reinterpret_cast<char*>(&record), sizeof(record));
+		while (1)
+		{
+			try
+			{
+				page.insertRecord(data);
+				break;
+			}
+			catch(const InsufficientSpaceException &e)
+			{
+				file.writePage(pageNo, page);
+				page = file.allocatePage(pageNo);
+			}
+		}
+	}
+	file.writePage(pageNo, page);
+}
+
+/**
+ * Lookups of random keys of the relation in several threads, and inserts of new keys
+ * above them in the given percentage of operations.
+ * @return operations per second summed over all threads
+ */
+double runMix(BTreeIndex &index, int threads, int insertPercent, std::atomic<int> &nextKey)
+{
+	std::atomic<bool> stop(false);
+	std::vector<std::uint64_t> ops(threads, 0);
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; t++)
+	{
+		workers.push_back(std::thread([&, t]() {
+			std::mt19937 rng(t + 1);
+			std::uniform_int_distribution<int> keys(0, relationSize - 1);
+			std::uniform_int_distribution<int> percent(0, 99);
+			RecordId rid;
+			std::uint64_t done = 0;
+			while (!stop.load(std::memory_order_relaxed))
+			{
+				if (percent(rng) < insertPercent)
+				{
+					// a key no other insert uses, the record id is made up, it is never fetched
+					int key = nextKey++;
+					rid.page_number = key / 100 + 1;
+					rid.slot_number = key % 100;
+					rid.padding = 0;
+					index.insertEntry(&key, rid);
+				}
+				else
+				{
+					int key = keys(rng);
+					index.lookup(&key, rid);
+				}
+				done++;
+			}
+			ops[t] = done;
+		}));
+	}
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::this_thread::sleep_for(std::chrono::duration<double>(runSeconds));
+	stop = true;
+	for (int t = 0; t < threads; t++)
+	{
+		workers[t].join();
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::uint64_t total = 0;
+	for (int t = 0; t < threads; t++)
+	{
+		total += ops[t];
+	}
+	return total / seconds;
+}
+
+/**
+ * Lookup and insert throughput of one index shared by 1, 2, 4 and 8 threads.
+ */
+void concurrencyBenchmark()
+{
+	createRelation();
+	BufMgr bufMgr(4096);
+	std::string indexName;
+	{
+		BTreeIndex index(relationName, indexName, &bufMgr, offsetof(tuple,i), INTEGER);
+		std::cout << "concurrency: " << relationSize << " int keys, " << std::thread::hardware_concurrency()
+				<< " hardware threads" << std::endl;
+		const int insertPercents[3] = { 0, 5, 50 };
+		std::atomic<int> nextKey(relationSize);
+		for (int mix = 0; mix < 3; mix++)
+		{
+			for (int threads = 1; threads <= 8; threads *= 2)
+			{
+				double rate = runMix(index, threads, insertPercents[mix], nextKey);
+				std::cout << "lookup " << 100 - insertPercents[mix] << "% insert " << insertPercents[mix] << "%, "
+						<< threads << " threads: " << (std::uint64_t)rate << " ops/sec" << std::endl;
+			}
+		}
+	}
+	File::remove(indexName);
+	File::remove(relationName);
+}
+
+/**
+ * Nanoseconds per lowerBound over random keys of nodes picked at random from the given ones, which are
+ * too many together to stay in the processor caches.
+ */
+template <class Node>
+double searchNodes(const std::vector<Node*> &nodes, int searches)
+{
+	std::mt19937 rng(1);
+	std::uniform_int_distribution<int> pick(0, (int)nodes.size() - 1);
+	std::uniform_int_distribution<int> keys(0, 2 * Node::SIZE);
+	long sum = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < searches; i++)
+	{
+		sum += nodes[pick(rng)]->lowerBound(keys(rng));
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	// keeps the searches from being optimized away
+	if (sum < 0)
+	{
+		std::cout << sum << std::endl;
+	}
+	return seconds * 1e9 / searches;
+}
+
+/**
+ * Full nodes of the given layout, holding the even keys from 0, on cache line aligned pages of memory.
+ */
+template <class Node>
+std::vector<Node*> fillNodes(std::vector<char> &memory, int count)
+{
+	memory.assign(count * Page::SIZE + BufMgr::FRAME_ALIGNMENT, 0);
+	std::uintptr_t start = reinterpret_cast<std::uintptr_t>(memory.data());
+	char *aligned = reinterpret_cast<char*>((start + BufMgr::FRAME_ALIGNMENT - 1) & ~(std::uintptr_t)(BufMgr::FRAME_ALIGNMENT - 1));
+	std::vector<Node*> nodes;
+	for (int n = 0; n < count; n++)
+	{
+		Node *node = reinterpret_cast<Node*>(aligned + n * Page::SIZE);
+		node->init(1);
+		for (int i = 0; i < Node::SIZE; i++)
+		{
+			node->insert(i, 2 * i, i + 1);
+		}
+		nodes.push_back(node);
+	}
+	return nodes;
+}
+
+/**
+ * Search time of the sorted and the blocked non-leaf layout of INTEGER keys, in nodes in memory and in
+ * lookups of whole indexes, whose non-leaf levels are made deep by a low fill factor.
+ */
+void innerLayoutBenchmark()
+{
+	const int nodeCount = 8192;
+	const int searches = 4000000;
+	std::vector<char> memory;
+	std::cout << "inner layout: " << nodeCount << " full nodes, search kernel " << NodeSearch::kernelName() << std::endl;
+	double sorted = searchNodes(fillNodes<NonLeafNode<int> >(memory, nodeCount), searches);
+	std::cout << "sorted, " << NonLeafNode<int>::SIZE << " keys: " << sorted << " ns/search" << std::endl;
+	double blocked = searchNodes(fillNodes<BlockedNonLeafNode<> >(memory, nodeCount), searches);
+	std::cout << "blocked, " << BlockedNonLeafNode<>::SIZE << " keys: " << blocked << " ns/search" << std::endl;
+
+	createRelation();
+	for (int layout = 0; layout < 2; layout++)
+	{
+		BufMgr bufMgr(4096);
+		std::string indexName;
+		IndexOptions options;
+		options.blockedInnerNodes = layout == 1;
+		options.fillFactor = 0.1;
+		{
+			BTreeIndex index(relationName, indexName, &bufMgr, offsetof(tuple,i), INTEGER, options);
+			std::atomic<int> nextKey(relationSize);
+			double rate = runMix(index, 1, 0, nextKey);
+			std::cout << (layout == 1 ? "blocked" : "sorted") << " index lookups: " << (std::uint64_t)rate << " ops/sec" << std::endl;
+		}
+		File::remove(indexName);
+	}
+	File::remove(relationName);
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	std::string name = argc > 1 ? argv[1] : "concurrency";
+	if (name == "concurrency")
+	{
+		concurrencyBenchmark();
+		return 0;
+	}
+	if (name == "innerlayout")
+	{
+		innerLayoutBenchmark();
+		return 0;
+	}
+	std::cerr << "Unknown benchmark " << name << ", one of: concurrency, innerlayout" << std::endl;
+	return 1;
+}
@@ -5,7 +5,12 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
 #include "btree.h"
+#include "node_search.h"
+#include "external_sort.h"
 #include "filescan.h"
 #include "exceptions/bad_index_info_exception.h"
 #include "exceptions/bad_opcodes_exception.h"
@@ -28,58 +33,118 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
 		std::string & outIndexName,
 		BufMgr *bufMgrIn,
 		const int attrByteOffset,
-		const Datatype attrType)
+		const Datatype attrType,
+		const IndexOptions &optionsIn)
+	: scan(this)
 {
 	this->bufMgr = bufMgrIn;
+	this->options = optionsIn;
+	this->upperLevels = NULL;
+	this->readAhead = NULL;
+	this->upperLevelsStale = true;
+	this->statsRefreshing = false;
+	if (options.fillFactor <= 0 || options.fillFactor > 1)
+	{
+		throw BadIndexInfoException("Fill factor must be in (0,1]");
+	}
+	if (options.readAhead < 0)
+	{
+		throw BadIndexInfoException("Read-ahead cannot be negative");
+	}
+	if (options.pinnedUpperPages < 0)
+	{
+		throw BadIndexInfoException("Pinned upper pages cannot be negative");
+	}
+	if (options.include.size() > (std::size_t)MAX_INCLUDED_COLUMNS)
+	{
+		throw BadIndexInfoException("Too many included attributes");
+	}
+	this->payloadBytes = 0;
+	for (std::size_t i = 0; i < options.include.size(); i++)
+	{
+		if (options.include[i].offset < 0 || options.include[i].length <= 0)
+		{
+			throw BadIndexInfoException("Included attribute has no bytes");
+		}
+		payloadBytes += options.include[i].length;
+	}
+	if (payloadBytes > MAX_PAYLOAD_SIZE)
+	{
+		throw BadIndexInfoException("Included attributes are too long");
+	}
+	if (payloadBytes > 0 && options.postingLists)
+	{
+		// a posting list keeps record ids only, there is no entry to store the attributes with
+		throw BadIndexInfoException("Posting lists cannot include attributes");
+	}
+	if (options.blockedInnerNodes && attrType != INTEGER)
+	{
+		throw BadIndexInfoException("Blocked non-leaf nodes need INTEGER keys");
+	}
 	this->attrByteOffset = attrByteOffset;
 	this->attributeType = attrType;
-	this->scanExecuting = false;
+	// the only place the attribute type is looked at, everything after goes through the bound typed code
+	switch (attrType)
+	{
+		case INTEGER:
+			bindKeyType<int>();
+			break;
+		case DOUBLE:
+			bindKeyType<double>();
+			break;
+		case STRING:
+			bindKeyType<StringKey>();
+			break;
+		default:
+			throw BadIndexInfoException("Unknown attribute type");
+	}
 	
 	// construct index name
 	std::ostringstream idxStr;
 	idxStr << relationName << '.' << attrByteOffset;
 	std::string indexName = idxStr.str(); // name of index file
 	outIndexName = indexName;
-/*
+
 	// open index file if it exists
- 	if (File::exists(indexName))
+	if (File::exists(indexName))
 	{
-		relationName.copy(metaInfo.relationName, 20, 0);
-		std::cout<< "index file exists\n";
-		BlobFile* indexFile = new BlobFile(outIndexName, false);
-		// read existing metapage
-		File* indexFileCastToFile = (File*) indexFile; // cast indexFile to File object
+		this->file = new BlobFile(indexName, false);
+		// first page of index file is meta page
+		this->headerPageNum = file->getFirstPageNo();
 		Page* metaPage;
-		PageId metaPageNo = indexFile->getFirstPageNo(); 
-		this->bufMgr->readPage(indexFileCastToFile, metaPageNo, metaPage);
-		std::cout<<"reached metapage check\n";
-		std::cout<<"metaInfo relationName: " << metaInfo.relationName[0] <<std::endl;
-		IndexMetaInfo* metaInfo = (IndexMetaInfo*) metaPage;
-		std::cout<<metaInfo->relationName<<std::endl;
+		this->bufMgr->readPage(this->file, this->headerPageNum, metaPage);
+		memcpy(&metaInfo, metaPage, sizeof(IndexMetaInfo));
+		this->bufMgr->unPinPage(this->file, this->headerPageNum, false);
 		// check whether existing metapage data matches construction parameters
-		std::cout<< "Check started\n";
-		if (metaInfo->relationName != relationName || metaInfo->attrByteOffset != attrByteOffset
-				|| metaInfo->attrType != attrType)
+		bool sameIncluded = metaInfo.includedColumns == (int)options.include.size();
+		for (int i = 0; sameIncluded && i < metaInfo.includedColumns; i++)
+		{
+			sameIncluded = metaInfo.included[i].offset == options.include[i].offset
+					&& metaInfo.included[i].length == options.include[i].length;
+		}
+		if (strncmp(metaInfo.relationName, relationName.c_str(), sizeof(metaInfo.relationName) - 1) != 0
+				|| metaInfo.attrByteOffset != attrByteOffset || metaInfo.attrType != attrType
+				|| metaInfo.formatVersion != NODE_FORMAT_VERSION || metaInfo.rootPageNo == Page::INVALID_NUMBER
+				|| (metaInfo.postingLists != 0) != options.postingLists || (metaInfo.counted != 0) != options.counted
+				|| (metaInfo.blockedInnerNodes != 0) != options.blockedInnerNodes || !sameIncluded)
 		{
-			std::cout<< "Enter if statement\n";
-			this->bufMgr->unPinPage(indexFileCastToFile, metaPageNo, false);
+			bufMgr->flushFile(this->file);
+			delete this->file;
 			throw BadIndexInfoException("Index file exists but metapage data don't match construction parameters");
 		}
-		std::cout<< "Check ended\n";
-		this->headerPageNum = metaPageNo;
-		this->rootPageNum = metaInfo->rootPageNo;
-std::cout<<"if: metaInfo pageNo: " << metaPageNo <<std::endl;
-std::cout<<"if: root pageNo: " <<  metaInfo->rootPageNo<<std::endl;
-		this->file = indexFileCastToFile;
-		this->bufMgr->unPinPage(this->file, metaPageNo, false);
-	} else
+		this->rootPageNum = metaInfo.rootPageNo;
+		this->upperLevels = new UpperLevelCache(bufMgr, file, options.pinnedUpperPages);
+		this->readAhead = new ReadAhead(bufMgr, file);
+	}
+	else
 	{
-	*/
 		// create new index file
 		std::cout<< "Create new index file\n";
 		BlobFile* indexFile = new BlobFile(indexName, true);
 		File* indexFileCastToFile = (File*) indexFile;
 		this->file = indexFileCastToFile;
+		this->upperLevels = new UpperLevelCache(bufMgr, file, options.pinnedUpperPages);
+		this->readAhead = new ReadAhead(bufMgr, file);
 		// create meta page
 		Page* metaPage;
 		PageId metaPageNo;
@@ -88,577 +153,3958 @@ std::cout<<"if: root pageNo: " <<  metaInfo->rootPageNo<<std::endl;
 		// first page of index file is meta page
 		// set page number of meta page
 		this->headerPageNum = metaPageNo;
-		// cast metaPage to IndexMetaInfo struct and set its variables 
+		// the meta page is only valid once the build below completes
+		memset((void*)metaPage, 0, Page::SIZE);
+		this->bufMgr->unPinPage(this->file, metaPageNo, true);
+		// fill in metaInfo, writeMetaPage copies it to the meta page
 		metaInfo.attrByteOffset = attrByteOffset;
 		metaInfo.attrType = attrType;
-		strcpy(metaInfo.relationName, relationName.c_str());
-		// allocate page for root
-		Page* rootPage;
-		PageId rootPageNo;
-		this->bufMgr->allocPage(this->file, rootPageNo, rootPage);
-		bufMgr->unPinPage(file,rootPageNo,false);
-		this->rootPageNum = rootPageNo;
-		metaInfo.rootPageNo = rootPageNo;
-		this->rootPageNum = rootPageNo;
-		// after alloc, rootPage need not be a page object
-		// so cast to leaf node
-		LeafNodeInt* rootPageCastToLeaf = (LeafNodeInt *) rootPage;
-		rootPageCastToLeaf->rightSibPageNo = Page::INVALID_NUMBER;
-		rootPageCastToLeaf->level = -1;
-		FileScan* fScan = new FileScan(relationName, bufMgrIn);
-		
-		try
-		{
-			RecordId scanRid;
-			while(1)
-			{
-				fScan->scanNext(scanRid);
-				std::string recordStr = fScan->getRecord();
-				const char *record = recordStr.c_str();
-				int key = *((int*)(record + attrByteOffset));
-				std::cout << "Extracted : " << key << std::endl;
-				this->insertEntry(&key, scanRid);
-			}
-		}
-		catch(const EndOfFileException &e)
+		metaInfo.freePageNo = Page::INVALID_NUMBER;
+		metaInfo.postingLists = options.postingLists;
+		metaInfo.counted = options.counted;
+		metaInfo.blockedInnerNodes = options.blockedInnerNodes;
+		metaInfo.includedColumns = (int)options.include.size();
+		std::copy(options.include.begin(), options.include.end(), metaInfo.included);
+		strncpy(metaInfo.relationName, relationName.c_str(), sizeof(metaInfo.relationName) - 1);
+		(this->*buildFn)(relationName);
+		if (!options.bulkLoad)
 		{
-			std::cout << "Read all records" << std::endl;
+			// nothing else runs yet, the walk cannot be disturbed
+			(this->*collectStatsFn)();
 		}
-		delete fScan;
-//	}
+		// index is complete, from now on it can be reopened
+		metaInfo.formatVersion = NODE_FORMAT_VERSION;
+		writeMetaPage();
+	}
+	// the first descent pins the top levels, opening an index reads nothing but its meta page
+	upperLevelsStale = true;
 }
 
 
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::~BTreeIndex -- destructor
+// BTreeIndex::bindKeyType
 // -----------------------------------------------------------------------------
 
-BTreeIndex::~BTreeIndex()
+template <class T>
+void BTreeIndex::bindKeyType()
 {
-	this->bufMgr->unPinPage(file,headerPageNum,true);
-	//bufMgr->unPinPage(file,rootPageNum,true);
-	if(scanExecuting == true) {
-		endScan();
+	if (options.postingLists)
+	{
+		bindLeafLayout<T, PostingLeafNode<T> >();
+	}
+	else if (payloadBytes > 0)
+	{
+		bindLeafLayout<T, CoveringLeafNode<T> >();
+	}
+	else
+	{
+		bindLeafLayout<T, LeafNode<T> >();
 	}
-	bufMgr->flushFile(this->file);	// flushing the index file
-	delete this->file;
 }
 
-// -----------------------------------------------------------------------------
-// BTreeIndex::insertEntry
-// -----------------------------------------------------------------------------
-
-void BTreeIndex::insertEntry(const void *key, const RecordId rid) 
+template <class T, class Leaf>
+void BTreeIndex::bindLeafLayout()
 {
-	//calling helper method on root page no.
-	insertHelper(metaInfo.rootPageNo,*(int *)key,rid,0);
-
-}
-PageId BTreeIndex::insertHelper(PageId pageNo,int key,RecordId rid, PageId newChildPageNo){
-	Page *page;
-	bufMgr->readPage(file, pageNo, page);
-	//leaf Node
-	if(isLeaf(pageNo)){
-		newChildPageNo = insertIntoLeaf((LeafNodeInt*)page,key,rid,pageNo);
-		if(newChildPageNo!=0 && metaInfo.rootPageNo == pageNo){
-			Page *newChildPage;
-			bufMgr->readPage(file,newChildPageNo,newChildPage);
-			LeafNodeInt* newChildNode = (LeafNodeInt*) newChildPage;
-			newChildNode->level=-1;
-			Page *newRootPage;
-			PageId newRootPageNo;
-			bufMgr->allocPage(file,newRootPageNo,newRootPage);
-			NonLeafNodeInt* newRootNode = (NonLeafNodeInt*) newRootPage;
-			metaInfo.rootPageNo = newRootPageNo;
-			this->rootPageNum=newRootPageNo;
-			newRootNode->level = 1;
-			newRootNode->keyArray[0] = newChildNode->keyArray[0];
-			newRootNode->pageNoArray[0]=pageNo;
-			newRootNode->pageNoArray[1]=newChildPageNo;
-			bufMgr->unPinPage(file,newChildPageNo,false);
-			newChildPageNo=0;//already resolve split
-			this->bufMgr->unPinPage(file,newRootPageNo,true);
-		}
-			bufMgr->unPinPage(file,pageNo,true);
-		return newChildPageNo;
-	}else{
-		//not leaf,find child
-		NonLeafNodeInt* currentNode=(NonLeafNodeInt*)page;
-		int childIndex=0;
-		for (childIndex=0;childIndex<nonLeafNodeRecNo(currentNode);childIndex++){
-			if(key<currentNode->keyArray[childIndex]){
-				break;
-			}
-		}
-		if(key>currentNode->keyArray[nonLeafNodeRecNo(currentNode)-1]){
-			childIndex = nonLeafNodeRecNo(currentNode);
-		}
-		//get pageNo of child
-		PageId childPageNo = currentNode->pageNoArray[childIndex];
-		if(isLeaf(childPageNo)){
-			currentNode->level=1;
-		}else{
-			currentNode->level=0;
-		}
-		//leaf return nonzero newChildPageNo, the key to parent node
-		if(newChildPageNo!=0){
-			Page* newChildPage;
-			bufMgr->readPage(file,newChildPageNo,newChildPage);
-			LeafNodeInt* newChildNode = (LeafNodeInt*) newChildPage;
-			this->bufMgr->unPinPage(file,newChildPageNo,false);
-			newChildNode->level=-1;
-			newChildPageNo=insertIntoNonLeaf(currentNode,newChildNode->keyArray[0],newChildPageNo);
-		}
-		//recursiively insert to child
-		newChildPageNo = insertHelper(childPageNo,key,rid,newChildPageNo);
-		//no spliting
-		if(newChildPageNo==0){
-			bufMgr->unPinPage(file,pageNo,true);
-			return newChildPageNo; 
-		}else{
-		//split
-				//insert the first key of newNode into parent
-				Page* newChildPage;
-				bufMgr->readPage(file,newChildPageNo,newChildPage);
-				NonLeafNodeInt* newChildNode = (NonLeafNodeInt*) newChildPage;
-				bufMgr->unPinPage(file,newChildPageNo,false);
-				newChildPageNo = insertIntoNonLeaf(currentNode,newChildNode->keyArray[0],newChildPageNo);
-				//current Node is root, build a new node
-				if(newChildPageNo!=0 && metaInfo.rootPageNo==pageNo){
-					NonLeafNodeInt* newRootNode;
-					PageId newRootPageNo;
-					bufMgr->allocPage(file,newRootPageNo,(Page *&)newRootNode);	
-					newRootNode->keyArray[0] = newChildNode->keyArray[0];
-					newRootNode->pageNoArray[0]=pageNo;
-					newRootNode->pageNoArray[1]=newChildPageNo;
-					metaInfo.rootPageNo = newRootPageNo;
-					this->rootPageNum = newRootPageNo;
-					bufMgr->unPinPage(file,newRootPageNo,true);
-					if(isLeaf(pageNo)){
-						newRootNode->level=1;
-					}else{
-						newRootNode->level=0;
-					}
-				}
-				//copy up, no need to delete first entry
-				if(isLeaf(childPageNo)){
-					bufMgr->unPinPage(file,pageNo,true);
-					return newChildPageNo;
-				//push up, delete first entry of newChildNode
-				}else{
-					for(int i=0;i<nonLeafNodeRecNo(newChildNode)-1;i++){
-						newChildNode->keyArray[i] = newChildNode->keyArray[i+1];
-					}
-					bufMgr->unPinPage(file,pageNo,true);
-					return newChildPageNo;
-				}
-		}
-	
+	if (options.counted)
+	{
+		bindInnerLayout<Leaf, CountedChild>((const T*)NULL);
+	}
+	else
+	{
+		bindInnerLayout<Leaf, UncountedChild>((const T*)NULL);
 	}
-	
 }
 
-void BTreeIndex::startScan(const void* lowValParm,
-				   const Operator lowOpParm,
-				   const void* highValParm,
-				   const Operator highOpParm)
+template <class Leaf, class Child, class T>
+void BTreeIndex::bindInnerLayout(const T*)
 {
-	if (this->scanExecuting == true)
-	{
-		this->endScan();
-	}else{
-		this->scanExecuting=true;
-	}
-	if ((lowOpParm!=GT && lowOpParm!=GTE) || (highOpParm!=LT && highOpParm!=LTE))
+	bindLayout<T, Leaf, NonLeafNode<T, Child> >();
+}
+
+template <class Leaf, class Child>
+void BTreeIndex::bindInnerLayout(const int*)
+{
+	if (options.blockedInnerNodes)
 	{
-		throw BadOpcodesException();
+		bindLayout<int, Leaf, BlockedNonLeafNode<Child> >();
 	}
-	if (*((int*) lowValParm) > *((int*) highValParm))
+	else
 	{
-		throw BadScanrangeException();
+		bindLayout<int, Leaf, NonLeafNode<int, Child> >();
 	}
-	this->lowValInt = *((int*) lowValParm);
-	this->highValInt = *((int*) highValParm);
-	this->lowOp = lowOpParm;
-	this->highOp = highOpParm;
-	NonLeafNodeInt* currentNode;
-	
-	// find the leaf ndoe to begin search
-	// if root is leaf, root is the node we will search
-	if (this->isLeaf(metaInfo.rootPageNo) == true)
+}
+
+template <class T, class Leaf, class Inner>
+void BTreeIndex::bindLayout()
+{
+	this->leafOccupancy = Leaf::SIZE;
+	this->nodeOccupancy = Inner::SIZE;
+	this->buildFn = &BTreeIndex::build<T, Leaf, Inner>;
+	this->insertEntryFn = &BTreeIndex::insertEntryTyped<T, Leaf, Inner>;
+	this->insertBatchFn = &BTreeIndex::insertBatchTyped<T, Leaf, Inner>;
+	this->deleteEntryFn = &BTreeIndex::deleteEntryTyped<T, Leaf, Inner>;
+	this->startScanFn = &BTreeIndex::startScanTyped<T, Leaf, Inner>;
+	this->lookupFn = &BTreeIndex::lookupTyped<T, Leaf, Inner>;
+	this->countRangeFn = &BTreeIndex::countRangeTyped<T, Leaf, Inner>;
+	this->refreshUpperLevelsFn = &BTreeIndex::refreshUpperLevels<Inner>;
+	this->collectStatsFn = &BTreeIndex::collectStats<T, Leaf, Inner>;
+	this->noteChangeFn = &BTreeIndex::noteChange<T>;
+	this->estimateRangeFn = &BTreeIndex::estimateRangeTyped<T>;
+	bindScan<T, Inner>((const Leaf*)NULL);
+}
+
+template <class T, class Inner>
+void BTreeIndex::bindScan(const LeafNode<T>*)
+{
+	// the two leaf layouts share the engine, only returning record ids differs
+	this->scanNextFn = &BTreeIndex::scanNextTyped<T, LeafNode<T>, Inner>;
+	this->scanNextBatchFn = &BTreeIndex::scanNextBatchTyped<T, LeafNode<T>, Inner>;
+	this->openBackwardFn = &BTreeIndex::openBackwardTyped<T, LeafNode<T>, Inner>;
+	this->scanPrevFn = &BTreeIndex::scanPrevTyped<T, LeafNode<T>, Inner>;
+	this->scanPrevBatchFn = &BTreeIndex::scanPrevBatchTyped<T, LeafNode<T>, Inner>;
+}
+
+template <class T, class Inner>
+void BTreeIndex::bindScan(const PostingLeafNode<T>*)
+{
+	this->scanNextFn = &BTreeIndex::scanNextPosting<T, Inner>;
+	this->scanNextBatchFn = &BTreeIndex::scanNextBatchPosting<T, Inner>;
+	this->openBackwardFn = NULL;
+	this->scanPrevFn = NULL;
+	this->scanPrevBatchFn = NULL;
+}
+
+template <class T, class Inner>
+void BTreeIndex::bindScan(const CoveringLeafNode<T>*)
+{
+	this->scanNextFn = &BTreeIndex::scanNextTyped<T, CoveringLeafNode<T>, Inner>;
+	this->scanNextBatchFn = &BTreeIndex::scanNextBatchTyped<T, CoveringLeafNode<T>, Inner>;
+	this->openBackwardFn = &BTreeIndex::openBackwardTyped<T, CoveringLeafNode<T>, Inner>;
+	this->scanPrevFn = &BTreeIndex::scanPrevTyped<T, CoveringLeafNode<T>, Inner>;
+	this->scanPrevBatchFn = &BTreeIndex::scanPrevBatchTyped<T, CoveringLeafNode<T>, Inner>;
+}
+
+template <>
+int &BTreeCursor::lowVal<int>()
+{
+	return lowValInt;
+}
+
+template <>
+int &BTreeCursor::highVal<int>()
+{
+	return highValInt;
+}
+
+template <>
+double &BTreeCursor::lowVal<double>()
+{
+	return lowValDouble;
+}
+
+template <>
+double &BTreeCursor::highVal<double>()
+{
+	return highValDouble;
+}
+
+template <>
+StringKey &BTreeCursor::lowVal<StringKey>()
+{
+	return lowValString;
+}
+
+template <>
+StringKey &BTreeCursor::highVal<StringKey>()
+{
+	return highValString;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::build
+// -----------------------------------------------------------------------------
+
+template <class T, class Leaf, class Inner>
+void BTreeIndex::build(const std::string &relationName)
+{
+	if (options.bulkLoad)
 	{
-		this->currentPageNum = metaInfo.rootPageNo;
-		this->bufMgr->readPage(this->file, this->currentPageNum, this->currentPageData);
-		this->bufMgr->unPinPage(this->file, this->currentPageNum, false);
-		currentNode = (struct NonLeafNodeInt*) this->currentPageData;
+		bulkLoad<T, Leaf, Inner>(relationName);
+		return;
 	}
-	else
+	// allocate page for root
+	Page* rootPage;
+	PageId rootPageNo;
+	allocNode(rootPageNo, rootPage);
+	metaInfo.rootPageNo = rootPageNo;
+	this->rootPageNum = rootPageNo;
+	// after alloc, rootPage need not be a page object
+	// so cast to leaf node
+	initLeaf((Leaf *) rootPage);
+	bufMgr->unPinPage(file,rootPageNo,true);
+	FileScan* fScan = new FileScan(relationName, bufMgr);
+
+	try
 	{
-		this->currentPageNum = metaInfo.rootPageNo; // start searching from root
-		// traverse tree until leaf is found
-		
-		while (this->isLeaf(this->currentPageNum) == false)
+		RecordId scanRid;
+		while(1)
 		{
-			this->bufMgr->readPage(this->file, this->currentPageNum, this->currentPageData);
-			currentNode = (struct NonLeafNodeInt*) this->currentPageData;
-			this->bufMgr->unPinPage(this->file, this->currentPageNum, false);
-
-			for (int i = 0; i < nonLeafNodeRecNo(currentNode)-1; i++)
-			{
-				// got to right pointer
-				if (currentNode->keyArray[i] <= this->lowValInt && currentNode->keyArray[i+1] >= this->lowValInt)
-				{
-					this->currentPageNum = currentNode->pageNoArray[i+1];
-					break;
-				}
-				// go to left pointer
-				else if (currentNode->keyArray[i] > this->lowValInt)
-				{
-					this->currentPageNum = currentNode->pageNoArray[i];
-					break;
-				}
-				else
-				{
-					continue;
-				}
-			}
-		
+			fScan->scanNext(scanRid);
+			std::string recordStr = fScan->getRecord();
+			const char *record = recordStr.c_str();
+			char payload[MAX_PAYLOAD_SIZE];
+			insertEntryTyped<T, Leaf, Inner>(record + attrByteOffset, scanRid, gatherPayload(record, payload));
+			// the histogram of the walk after the build is cut by this count
+			metaInfo.stats.entries++;
 		}
-		
 	}
-	if (this->currentPageNum == metaInfo.rootPageNo)
+	catch(const EndOfFileException &e)
 	{
-		throw NoSuchKeyFoundException();
+		std::cout << "Read all records" << std::endl;
 	}
-	// save leaf node in this->currentPageData
-	this->bufMgr->readPage(this->file, this->currentPageNum, this->currentPageData);
-	this->bufMgr->unPinPage(this->file, this->currentPageNum, false);
-	this->nextEntry = 0; // just initialized scan, so next entry to insert is at slot 0 of page
+	delete fScan;
 }
 
-
 // -----------------------------------------------------------------------------
-// BTreeIndex::scanNext
+// BTreeIndex::bulkLoad
 // -----------------------------------------------------------------------------
 
-void BTreeIndex::scanNext(RecordId& outRid) 
+template <class T, class Leaf, class Inner>
+void BTreeIndex::bulkLoad(const std::string &relationName)
 {
-	if (this->scanExecuting == false)
+	// sort the (key, rid) pairs of the relation, spilling runs next to the index file. Included
+	// attributes are sorted along with their pair
+	typedef typename Leaf::Entry Entry;
+	ExternalSorter<Entry> sorter(file->filename() + ".sort", options.sortBufferEntries);
+	FileScan* fScan = new FileScan(relationName, bufMgr);
+	// the statistics are gathered from the sorted entries and the leaves as they are packed
+	IndexStats stats = IndexStats();
+	std::int64_t total = 0;
+	try
 	{
-		throw ScanNotInitializedException();
+		RecordId scanRid;
+		while(1)
+		{
+			fScan->scanNext(scanRid);
+			std::string recordStr = fScan->getRecord();
+			Entry pair;
+			pair.rid = scanRid;
+			KeyTraits<T>::set(pair.key, recordStr.c_str() + attrByteOffset);
+			includeColumns(pair, recordStr.c_str());
+			sorter.add(pair);
+			total++;
+		}
 	}
-	
-	//read from currentNode
-	LeafNodeInt* currentNode = (LeafNodeInt*) this->currentPageData;
-	while(1)
+	catch(const EndOfFileException &e)
 	{
+		std::cout << "Read all records" << std::endl;
+	}
+	delete fScan;
+	sorter.finish();
 
-		if (this->lowOp == GT)
+	// pack the leaves left to right, every new leaf becomes a child of the level above
+	std::vector<BulkLevel<Inner> > levels;
+	PageId firstLeafPageNo;
+	PageId leafPageNo;
+	Leaf* leafNode;
+	allocNode(leafPageNo, (Page *&)leafNode);
+	initLeaf(leafNode);
+	firstLeafPageNo = leafPageNo;
+	// entries a leaf gave back once the separator after it was known, they go first into the next leaf
+	std::deque<Entry> pending;
+	std::int64_t depth = std::max<std::int64_t>(total / HISTOGRAM_BUCKETS, 1);
+	std::int64_t inBucket = 0;
+	double leafSlots = 0;
+	while(1)
+	{
+		Entry pair;
+		bool more = true;
+		if (!pending.empty())
+		{
+			pair = pending.front();
+			pending.pop_front();
+		}
+		else
 		{
-			// next entry >= lower bound
-			if (currentNode->keyArray[nextEntry] > this->lowValInt)
+			more = sorter.next(pair);
+			if (more)
 			{
-				// next entry also <= upper bound
-				if (this->highOp == LT)
-				{
-					
-					if (currentNode->keyArray[nextEntry] < this->highValInt)
-					{
-						outRid = currentNode->ridArray[nextEntry];
-						break;
-					}
-					// next entry not <= upper bound, so done
-					else
-					{
-						// end of scan
-					
-						throw IndexScanCompletedException();
-					}
-				}
-				else if (this->highOp == LTE)
-				{
-					if (currentNode->keyArray[nextEntry] <= this->highValInt)
-                                        {
-											outRid = currentNode->ridArray[nextEntry];
-                                                break;
-                                        }
-                                        // next entry not <= upper bound, so done
-                                        else
-                                        {
-                                                // end of scan
-                                                throw IndexScanCompletedException();
-                                        }
-				}
+				countStatsKey(stats, pair.key, 1, depth, inBucket);
 			}
-			else
+		}
+		if (more && leafNode->hasRoom(pair.key, options.fillFactor))
+		{
+			insertIntoLeaf(leafNode, pair.key, pair.rid, pair.payload());
+			continue;
+		}
+		if (!more)
+		{
+			// nothing bounds the last leaf on the right
+			if (leafNode->widen(NULL))
 			{
-				if (this->nextEntry+1 >= leafNodeRecNo(currentNode))
-				{
-					if (currentNode->rightSibPageNo == Page::INVALID_NUMBER)
-					{
-						throw IndexScanCompletedException();
-					}
-               				this->currentPageNum = currentNode->rightSibPageNo;
-               		 		this->bufMgr->readPage(this->file, this->currentPageNum, this->currentPageData);
-							this->bufMgr->unPinPage(this->file, this->currentPageNum, false);
-               		 		currentNode = (LeafNodeInt*)this->currentPageData;
-                			this->nextEntry = 0; // start searching from beginning of new node
-        			}
-       		 		else
-        			{	
-                			this->nextEntry++;
-        			}	
-			}	
-		}
-		else if (this->lowOp == GTE)
-		{
-			// next entry >= lower bound
-               		if (currentNode->keyArray[nextEntry] >= this->lowValInt)
-                	{
-				if (this->highOp == LT)
-				{
-                        		// next entry also <= upper bound
-                        		if (currentNode->keyArray[nextEntry] < this->highValInt)
-                       	 		{
-										outRid = currentNode->ridArray[nextEntry];
-                                		break;
-                        		}
-                        		// next entry not <= upper bound, so done
-                        		else
-                        		{
-                                		// end of scan
-								
-                                		throw IndexScanCompletedException();
-                        		}
-                		}
-				else if (this->highOp == LTE)
-				{
-					                                        // next entry also <= upper bound
-                                        if (currentNode->keyArray[nextEntry] <= this->highValInt)
-                                        {
-											outRid = currentNode->ridArray[nextEntry];
-                                                break;
-                                        }
-                                        // next entry not <= upper bound, so done
-                                        else
-                                        {
-                                                // end of scan
-                                                throw IndexScanCompletedException();
-					}
-				}
+				break;
 			}
-                	// next entry not >= lower bound
-                	else
-                	{
-          			if (this->nextEntry+1 >= leafNodeRecNo(currentNode))
-                       		{
-                               		if (currentNode->rightSibPageNo == Page::INVALID_NUMBER)
-                               		{
-                               	        	throw IndexScanCompletedException();
-                                	}
-                                	this->currentPageNum = currentNode->rightSibPageNo;
-                                	this->bufMgr->readPage(this->file, this->currentPageNum, this->currentPageData);
-									this->bufMgr->unPinPage(this->file, this->currentPageNum, false);
-                                	currentNode = (LeafNodeInt*)this->currentPageData;
-                                	this->nextEntry = 0; // start searching from beginning of new node
-                        	}
-                        	else
-                        	{
-                                	this->nextEntry++;
-                        	}
-			}	
-		}
-	}
-	if (this->nextEntry+1 >= leafNodeRecNo(currentNode))
-	{
-		this->currentPageNum = currentNode->rightSibPageNo;
-		this->bufMgr->readPage(this->file, this->currentPageNum, this->currentPageData);
-		this->bufMgr->unPinPage(this->file, this->currentPageNum, false);
-		currentNode = (LeafNodeInt*)this->currentPageData;
-		this->nextEntry = 0; // start searching from beginning of new node
+			giveBackLast(leafNode, pending);
+		}
+		else
+		{
+			pending.push_front(pair);
+		}
+		// the leaf is bounded by the separator to the next one, which may shorten the prefix
+		// of STRING leaves, or fall on the last key of a posting list leaf. Entries that then
+		// no longer fit move on to the next leaf
+		T separator = KeyTraits<T>::separator(leafNode->key(leafNode->count() - 1), pending.front().key);
+		while (!leafNode->widen(&separator))
+		{
+			giveBackLast(leafNode, pending);
+			separator = KeyTraits<T>::separator(leafNode->key(leafNode->count() - 1), pending.front().key);
+		}
+		PageId newLeafPageNo;
+		Leaf* newLeafNode;
+		allocNode(newLeafPageNo, (Page *&)newLeafNode);
+		initLeaf(newLeafNode);
+		newLeafNode->narrow(&separator, &pending.front().key);
+		newLeafNode->leftSibPageNo = leafPageNo;
+		leafNode->rightSibPageNo = newLeafPageNo;
+		leafNode->setHighKey(&separator);
+		std::uint32_t leafCount = Inner::COUNTED ? leafNode->entries(leafNode->count()) : 0;
+		stats.leafPages++;
+		leafSlots += leafNode->count();
+		bufMgr->unPinPage(file, leafPageNo, true);
+		leafPageNo = newLeafPageNo;
+		leafNode = newLeafNode;
+		PageKeyPair<T> child;
+		child.set(newLeafPageNo, separator);
+		bulkAddChild(levels, 0, child, firstLeafPageNo, leafCount);
 	}
-	else
+	std::uint32_t closedCount = Inner::COUNTED ? leafNode->entries(leafNode->count()) : 0;
+	stats.leafPages++;
+	leafSlots += leafNode->count();
+	bufMgr->unPinPage(file, leafPageNo, true);
+
+	// the top level always holds a single node, the root. The last node of each level is complete now
+	for (std::size_t i = 0; i < levels.size(); i++)
+	{
+		Inner* node = levels[i].node;
+		node->setChildCount(node->count(), closedCount);
+		closedCount = node->totalCount();
+		bufMgr->unPinPage(file, levels[i].pageNo, true);
+	}
+	metaInfo.rootPageNo = levels.empty() ? firstLeafPageNo : levels.back().pageNo;
+	this->rootPageNum = metaInfo.rootPageNo;
+
+	// the non-leaf levels are a small fraction of the pages, they are read again for their figures
+	stats.leafFill = leafSlots / ((double)stats.leafPages * Leaf::SIZE);
+	PageId leftmostPageNo;
+	if (collectLevels<Inner>(stats, leftmostPageNo))
+	{
+		publishStats(stats, 0);
+	}
+}
+
+template <class T, class Inner>
+void BTreeIndex::bulkAddChild(std::vector<BulkLevel<Inner> > &levels,std::size_t level,PageKeyPair<T> child,PageId leftmostPageNo,std::uint32_t closedCount)
+{
+	if (level == levels.size())
 	{
-		this->nextEntry++;
+		// first node of a new level, starts with the first node of the level below
+		BulkLevel<Inner> newLevel;
+		allocNode(newLevel.pageNo, (Page *&)newLevel.node);
+		newLevel.node->init(level == 0 ? 1 : 0);
+		newLevel.node->setChild(0, leftmostPageNo);
+		newLevel.firstPageNo = newLevel.pageNo;
+		levels.push_back(newLevel);
 	}
+	Inner* node = levels[level].node;
+	// the last child so far is complete, its count is known
+	node->setChildCount(node->count(), closedCount);
+	if (node->hasRoom(child.key, options.fillFactor))
+	{
+		node->insert(node->count(), child.key, child.pageNo);
+		return;
+	}
+	// node is filled up, child starts the next node and its key is pushed up
+	PageId newPageNo;
+	Inner* newNode;
+	allocNode(newPageNo, (Page *&)newNode);
+	newNode->init(node->header.level);
+	newNode->setChild(0, child.pageNo);
+	node->rightSibPageNo = newPageNo;
+	node->setHighKey(&child.key);
+	std::uint32_t nodeCount = node->totalCount();
+	bufMgr->unPinPage(file, levels[level].pageNo, true);
+	levels[level].pageNo = newPageNo;
+	levels[level].node = newNode;
+	PageKeyPair<T> pushUp;
+	pushUp.set(newPageNo, child.key);
+	bulkAddChild(levels, level + 1, pushUp, levels[level].firstPageNo, nodeCount);
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::endScan
+// BTreeIndex::~BTreeIndex -- destructor
 // -----------------------------------------------------------------------------
-//
-void BTreeIndex::endScan() 
+
+BTreeIndex::~BTreeIndex()
 {
-	if(scanExecuting == false) {
-		throw ScanNotInitializedException();
-	} else {
-		scanExecuting = true;
+	// the scan's leaf has to be unpinned before the file goes away, its read-ahead goes with the index's
+	scan.close();
+	scan.readAheadOwner = 0;
+	if (statsWorker.joinable())
+	{
+		statsWorker.join();
+	}
+	// entries counted since the statistics were last written
+	if (metaInfo.stats.changes > 0)
+	{
+		std::lock_guard<std::mutex> meta(metaLatch);
+		writeMetaPage();
 	}
+	// and the cached upper levels and the leaves being read ahead, flushFile wants every page of the file unpinned
+	delete readAhead;
+	delete upperLevels;
+	bufMgr->flushFile(this->file);	// flushing the index file
+	delete this->file;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertEntry
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::insertEntry(const void *key, const RecordId rid, const char *record) 
+{
+	char payload[MAX_PAYLOAD_SIZE];
+	(this->*insertEntryFn)(key, rid, gatherPayload(record, payload));
+	(this->*noteChangeFn)(key, 1);
+	refreshStatsIfStale();
 }
 
-PageId BTreeIndex::insertIntoLeaf(LeafNodeInt *leafNode, int key, const RecordId rid, const PageId pageNo)
+template <class T, class Leaf, class Inner>
+void BTreeIndex::insertEntryTyped(const void *key, const RecordId rid, const char *payload)
 {
-	//find index to insert
-	int insertIndex=0;
-	for(insertIndex=0;insertIndex<leafNodeRecNo(leafNode);insertIndex++){
-		if(key<leafNode->keyArray[insertIndex]){
-			break;
+	T keyValue;
+	KeyTraits<T>::set(keyValue, key);
+	PageId pageNo;
+	Page *page;
+	// a leaf with room is all an insert changes, unless there are subtree counts above it
+	if(!Inner::COUNTED && latchLeaf<T, Leaf, Inner>(keyValue,pageNo,page,NULL)){
+		Leaf* leafNode = (Leaf*)page;
+		if(leafNode->hasRoom(keyValue)){
+			insertIntoLeaf(leafNode,keyValue,rid,payload);
+			releaseNode(pageNo,page,true);
+			return;
 		}
-	}
-	if(key>leafNode->keyArray[leafNodeRecNo(leafNode)-1]){
-		insertIndex=leafNodeRecNo(leafNode);
+		releaseNode(pageNo,page,false);
 	}
 
-	PageId newPageNo=0;
-	//split if full
-	if(isLeafFull(leafNode)){
-		newPageNo = splitLeaf(leafNode,INTARRAYLEAFSIZE/2);
-		Page* newPage;
-		bufMgr->readPage(file,newPageNo,newPage);
-		LeafNodeInt* newLeafNode = (LeafNodeInt*) newPage;
-		newLeafNode->level=-1;
-		//insert into original leaf node
-		if(insertIndex<INTARRAYLEAFSIZE/2){
-			insertIntoLeaf(leafNode,key,rid,pageNo);
-		}else{
-			//insert to new leaf node
-			insertIntoLeaf(newLeafNode,key,rid,pageNo);
-		}
-		this->bufMgr->unPinPage(file,newPageNo,true);
+	std::lock_guard<std::mutex> structure(structureLatch);
+	PathEntry path[MAX_TREE_HEIGHT];
+	int depth;
+	KeyFences<T> fences;
+	latchForInsert<T, Inner>(keyValue,path,depth,pageNo,page,fences);
+
+	Leaf* leafNode = (Leaf*)page;
+	if(leafNode->hasRoom(keyValue)){
+		insertIntoLeaf(leafNode,keyValue,rid,payload);
+		countPath<Inner>(path,depth,1);
+		releaseNode(pageNo,page,true);
+		releasePath<Inner>(path,depth,Inner::COUNTED);
 	}else{
-		//if leaf node is not full, shift the rest and directly insert
-		for(int i=leafNodeRecNo(leafNode)-1;i>=insertIndex;i--){
-			leafNode->keyArray[i+1]=leafNode->keyArray[i];
-			leafNode->ridArray[i+1]=leafNode->ridArray[i];
-		}
-		leafNode->keyArray[insertIndex] = key;
-		leafNode->ridArray[insertIndex] = rid;
-		
+		splitAndInsert<T, Leaf, Inner>(leafNode,pageNo,keyValue,rid,payload,path,depth,fences);
 	}
-	
-	return newPageNo;
 }
 
-PageId BTreeIndex::insertIntoNonLeaf(NonLeafNodeInt *nonLeafNode,int key,PageId pid)
-{
-	//find index to insert
-	int insertIndex = 0;
-	for(insertIndex=0;insertIndex<INTARRAYNONLEAFSIZE+1;insertIndex++){
-		if(key<nonLeafNode->keyArray[insertIndex]){
-			break;
+template <class T, class Inner>
+void BTreeIndex::latchForInsert(const T &key,PathEntry *path,int &depth,PageId &pageNo,Page *&page,KeyFences<T> &fences){
+	// only the holder of structureLatch changes non-leaf nodes, so they can be read without latching
+	// them, unless their subtree counts change too. A node with room for another separator stops any
+	// split coming up from below, the nodes above it are let go
+	depth = 0;
+	pageNo = metaInfo.rootPageNo;
+	bufMgr->readPage(file, pageNo, page);
+	while(((NodeHeader*)page)->level != -1){
+		Inner* node = (Inner*)page;
+		if(Inner::COUNTED){
+			bufMgr->latch(page).lock();
+		}else if(node->hasRoom(KeyTraits<T>::longest())){
+			releasePath<Inner>(path,depth);
+			depth = 0;
 		}
+		int childIndex = node->upperBound(key);
+		fences.narrow(node,childIndex);
+		path[depth].pageNo = pageNo;
+		path[depth].page = page;
+		path[depth].childIndex = childIndex;
+		depth++;
+		pageNo = node->child(childIndex);
+		bufMgr->readPage(file, pageNo, page);
 	}
-	if(key>nonLeafNode->keyArray[nonLeafNodeRecNo(nonLeafNode)-1]){
-		insertIndex=nonLeafNodeRecNo(nonLeafNode);
-	}
-	PageId newPageNo=0;
-	//split if full
-	if(isNonLeafFull(nonLeafNode)){
-		newPageNo = splitNonLeaf(nonLeafNode,INTARRAYNONLEAFSIZE/2);
-		Page* newPage;
-		bufMgr->readPage(file,newPageNo,newPage);
-		NonLeafNodeInt *newNonLeafNode = (NonLeafNodeInt*) newPage;
-		newNonLeafNode->level = nonLeafNode->level;
-		if(insertIndex<INTARRAYNONLEAFSIZE/2){
-			//insert into old non leaf node
-			insertIntoNonLeaf(nonLeafNode,key,pid);
-		}else{
-			//insert to new non leaf Node
-			insertIntoNonLeaf(newNonLeafNode,key,pid);
+	bufMgr->latch(page).lock();
+}
+
+template <class T, class Leaf, class Inner>
+bool BTreeIndex::descendOptimistic(const T &key,bool upper,PageId &pageNo,Page *&page,std::uint32_t &version,KeyFences<T> *fences,std::uint64_t *countLeft){
+	if(fences != NULL){
+		*fences = KeyFences<T>();
+	}
+	if(countLeft != NULL){
+		*countLeft = 0;
+	}
+	// the non-leaf nodes of the top levels come from the upper level cache, without the buffer manager
+	if(__atomic_load_n(&upperLevelsStale, __ATOMIC_RELAXED)){
+		loadUpperLevels();
+	}
+	std::uint32_t cacheVersion = upperLevels->readVersion();
+	std::uint32_t rootVersion = rootLatch.readVersion();
+	pageNo = __atomic_load_n(&metaInfo.rootPageNo, __ATOMIC_RELAXED);
+	bool pinned = enterNode(pageNo, page);
+	version = bufMgr->latch(page).readVersion();
+	if(!rootLatch.validate(rootVersion)){
+		leaveNode(pageNo, pinned);
+		return false;
+	}
+	std::uint64_t copy[Page::SIZE / sizeof(std::uint64_t)];
+	while(true){
+		// a node split whose parent does not have the new separator yet holds only the keys below its
+		// high key, the others are found by following right links. The high key is at the same place
+		// in every layout and read in place
+		bool leaf = ((NodeHeader*)page)->level == -1;
+		if(leaf ? ((const Leaf*)page)->isPastHighKey(key, upper) : ((const Inner*)page)->isPastHighKey(key, upper)){
+			PageId rightPageNo;
+			if(leaf){
+				const Leaf* leafNode = readNode<Leaf>(page, version, copy);
+				if(leafNode == NULL || (!pinned && !upperLevels->validate(cacheVersion))){
+					leaveNode(pageNo, pinned);
+					return false;
+				}
+				if(fences != NULL){
+					fences->low = leafNode->highKey;
+					fences->hasLow = true;
+				}
+				if(countLeft != NULL){
+					*countLeft += leafNode->entries(leafNode->count());
+				}
+				rightPageNo = leafNode->rightSibPageNo;
+			}else{
+				const Inner* node = readNode<Inner>(page, version, copy);
+				if(node == NULL || (!pinned && !upperLevels->validate(cacheVersion))){
+					leaveNode(pageNo, pinned);
+					return false;
+				}
+				if(fences != NULL){
+					fences->low = node->highKey;
+					fences->hasLow = true;
+				}
+				if(countLeft != NULL){
+					*countLeft += node->totalCount();
+				}
+				rightPageNo = node->rightSibPageNo;
+			}
+			if(!couple(pageNo, page, version, rightPageNo, pinned, cacheVersion)){
+				return false;
+			}
+			continue;
 		}
-		this->bufMgr->unPinPage(file,newPageNo,true);
-	}else{
-		//if leaf node is not full, shift the rest and directly insert
-		for(int i=nonLeafNodeRecNo(nonLeafNode)-1;i>=insertIndex;i--){
-			nonLeafNode->keyArray[i+1]=nonLeafNode->keyArray[i];
-			nonLeafNode->pageNoArray[i+2]=nonLeafNode->pageNoArray[i+1];
+		if(leaf){
+			if(pinned){
+				return true;
+			}
+			// a cached page that is a leaf by now, freed and taken again, is pinned for the caller like any
+			// other leaf. The cache keeps it in its frame as long as the cache is unchanged
+			Page *leafPage;
+			bufMgr->readPage(file, pageNo, leafPage);
+			if(leafPage != page || !upperLevels->validate(cacheVersion)){
+				bufMgr->unPinPage(file, pageNo, false);
+				return false;
+			}
+			return true;
+		}
+		const Inner* node = readNode<Inner>(page, version, copy);
+		if(node == NULL || (!pinned && !upperLevels->validate(cacheVersion))){
+			leaveNode(pageNo, pinned);
+			return false;
+		}
+		// whatever is read here is only used once couple() finds the node unchanged
+		int childIndex = upper ? node->upperBound(key) : node->lowerBound(key);
+		if(fences != NULL){
+			fences->narrow(node,childIndex);
+		}
+		if(countLeft != NULL){
+			for(int i=0;i<childIndex;i++){
+				*countLeft += node->childCount(i);
+			}
+		}
+		if(!couple(pageNo, page, version, node->child(childIndex), pinned, cacheVersion)){
+			return false;
 		}
-		nonLeafNode->keyArray[insertIndex] = key;
-		nonLeafNode->pageNoArray[insertIndex+1]=pid;
 	}
-	return newPageNo;
-
 }
 
-bool BTreeIndex::isLeaf(PageId pageNo){
-	Page *page;
-	bufMgr->readPage(file, pageNo, page);
-	LeafNodeInt* currNode = (LeafNodeInt*) page;
-	int level = currNode->level;
-	bufMgr->unPinPage(file,pageNo,false);
-	return level==-1;
-}
-bool BTreeIndex::isLeafFull(LeafNodeInt *leafNode){
-	
-	return leafNodeRecNo(leafNode)==INTARRAYLEAFSIZE-1;
+template <class Node>
+const Node* BTreeIndex::readNode(Page *page,std::uint32_t version,std::uint64_t *copy){
+	if(Node::READ_IN_PLACE){
+		return (const Node*)page;
+	}
+	memcpy(copy, (void*)page, Page::SIZE);
+	if(!bufMgr->latch(page).validate(version)){
+		return NULL;
+	}
+	return (const Node*)copy;
 }
-bool BTreeIndex::isNonLeafFull(NonLeafNodeInt *nonLeafNode){
-	
-	return nonLeafNodeRecNo(nonLeafNode)==INTARRAYNONLEAFSIZE;
+
+bool BTreeIndex::couple(PageId &pageNo,Page *&page,std::uint32_t &version,PageId nextPageNo){
+	bool pinned = true;
+	return couple(pageNo, page, version, nextPageNo, pinned, 0);
 }
 
-int BTreeIndex::leafNodeRecNo(LeafNodeInt *leafNode){
-	int	count = 0;
-	for(int i=0;i<INTARRAYLEAFSIZE;i++){
-		if(leafNode->ridArray[i].page_number!=0&&leafNode->ridArray[i].slot_number!=0){
-			count++;
-		}else{
-			break;
-		}
+bool BTreeIndex::couple(PageId &pageNo,Page *&page,std::uint32_t &version,PageId nextPageNo,bool &pinned,std::uint32_t cacheVersion){
+	// the page number is only trusted, and pinned, once the node it came from is known to be unchanged.
+	// A page from the upper level cache is only known to be the node while the cache is unchanged
+	if(!bufMgr->latch(page).validate(version) || (!pinned && !upperLevels->validate(cacheVersion))){
+		leaveNode(pageNo, pinned);
+		return false;
+	}
+	Page *next;
+	bool nextPinned = enterNode(nextPageNo, next);
+	std::uint32_t nextVersion = bufMgr->latch(next).readVersion();
+	bool valid = bufMgr->latch(page).validate(version) && (pinned || upperLevels->validate(cacheVersion));
+	leaveNode(pageNo, pinned);
+	if(!valid){
+		leaveNode(nextPageNo, nextPinned);
+		return false;
 	}
-return count;
+	pageNo = nextPageNo;
+	page = next;
+	version = nextVersion;
+	pinned = nextPinned;
+	return true;
 }
-int BTreeIndex::nonLeafNodeRecNo(NonLeafNodeInt *nonLeafNode){
-	int count=0;
-	for(int i=0;i<INTARRAYNONLEAFSIZE+1;i++){
-		if(nonLeafNode->keyArray[i]!=0){
-			count++;
-		}else{
-			break;
-		}
+
+void BTreeIndex::loadUpperLevels(){
+	// descents never hold structureLatch. A writer holding it reads the levels again itself before it lets go
+	if(structureLatch.try_lock()){
+		(this->*refreshUpperLevelsFn)();
+		structureLatch.unlock();
 	}
-return count;
 }
-PageId BTreeIndex::splitLeaf(LeafNodeInt *leafNode,int splitIndex){
-	PageId newPageId;
-	LeafNodeInt *newLeafNode;
-	bufMgr->allocPage(file, newPageId, (Page *&)newLeafNode);
-  	memset(newLeafNode, 0, sizeof(LeafNodeInt));
-	for(int i=splitIndex;i<INTARRAYLEAFSIZE;i++){
-		//copy data to newLeafNode
-		newLeafNode->keyArray[i-splitIndex]=leafNode->keyArray[i];
-		newLeafNode->ridArray[i-splitIndex]=leafNode->ridArray[i];
-		//remove from old leafNode
-		leafNode->keyArray[i]=0;
-		leafNode->ridArray[i].page_number=0;
-		leafNode->ridArray[i].slot_number=0;
-	}
-
-	//set the sibling
-	newLeafNode->rightSibPageNo=leafNode->rightSibPageNo;
-	leafNode->rightSibPageNo=newPageId;
-	newLeafNode->level = -1;
-	bufMgr->unPinPage(file,newPageId,true);
-	return newPageId;
 
+bool BTreeIndex::enterNode(PageId pageNo,Page *&page){
+	page = upperLevels->find(pageNo);
+	if(page != NULL){
+		return false;
+	}
+	bufMgr->readPage(file, pageNo, page);
+	return true;
 }
-PageId BTreeIndex::splitNonLeaf(NonLeafNodeInt *nonLeafNode,int splitIndex){
-	PageId newPageId;
-	NonLeafNodeInt *newNonLeafNode;
-	bufMgr->allocPage(file, newPageId, (Page *&)newNonLeafNode);
-  	memset(newNonLeafNode, 0, Page::SIZE);
-	for(int i=splitIndex;i<INTARRAYNONLEAFSIZE;i++){
-		//copy to new node
-		newNonLeafNode->keyArray[i-splitIndex]= nonLeafNode->keyArray[i];
-		newNonLeafNode->pageNoArray[i-splitIndex+1] = nonLeafNode->pageNoArray[i+1];
-		//remove from old nonLeafNode
-		nonLeafNode->keyArray[i]=0;
-		nonLeafNode->pageNoArray[i+1]=0;
+
+void BTreeIndex::leaveNode(PageId pageNo,bool pinned){
+	if(pinned){
+		bufMgr->unPinPage(file, pageNo, false);
 	}
-	//two nonleafode will be in the same level after split
-	newNonLeafNode->level=nonLeafNode->level;
-	bufMgr->unPinPage(file,newPageId,true);
-	return newPageId;
 }
+
+template <class Inner>
+void BTreeIndex::refreshUpperLevels(){
+	if(!upperLevelsStale){
+		return;
+	}
+	__atomic_store_n(&upperLevelsStale, false, __ATOMIC_RELAXED);
+	// whole levels from the root down, along the right links. The first level that does not fit ends the walk
+	std::vector<UpperLevelCache::Entry> pages;
+	PageId firstPageNo = metaInfo.rootPageNo;
+	while(true){
+		Page *page;
+		bufMgr->readPage(file, firstPageNo, page);
+		if(((NodeHeader*)page)->level == -1){
+			bufMgr->unPinPage(file, firstPageNo, false);
+			break;
+		}
+		std::size_t levelStart = pages.size();
+		PageId childPageNo = ((Inner*)page)->child(0);
+		PageId pageNo = firstPageNo;
+		bool fits = true;
+		while(true){
+			if(pages.size() == upperLevels->capacity()){
+				bufMgr->unPinPage(file, pageNo, false);
+				fits = false;
+				break;
+			}
+			pages.push_back(UpperLevelCache::Entry(pageNo, page));
+			if(!((Inner*)page)->hasHighKey()){
+				break;
+			}
+			pageNo = ((Inner*)page)->rightSibPageNo;
+			bufMgr->readPage(file, pageNo, page);
+		}
+		if(!fits){
+			for(std::size_t i=levelStart;i<pages.size();i++){
+				bufMgr->unPinPage(file, pages[i].first, false);
+			}
+			pages.resize(levelStart);
+			break;
+		}
+		firstPageNo = childPageNo;
+	}
+	// the pins taken here pass to the cache
+	upperLevels->replace(pages);
+}
+
+template <class T, class Leaf, class Inner>
+bool BTreeIndex::latchLeaf(const T &key,PageId &pageNo,Page *&page,KeyFences<T> *fences){
+	for(int attempt=0;attempt<OPTIMISTIC_ATTEMPTS;attempt++){
+		std::uint32_t version;
+		if(!descendOptimistic<T, Leaf, Inner>(key,true,pageNo,page,version,fences,NULL)){
+			continue;
+		}
+		// fails if the leaf changed since the descent checked it against its parent
+		if(bufMgr->latch(page).tryUpgrade(version)){
+			return true;
+		}
+		bufMgr->unPinPage(file,pageNo,false);
+	}
+	return false;
+}
+
+template <class T, class Leaf, class Inner>
+void BTreeIndex::splitAndInsert(Leaf *leafNode,PageId pageNo,const T &keyValue,const RecordId rid,const char *payload,PathEntry *path,int depth,const KeyFences<T> &fences){
+	int height = depth;
+	countPath<Inner>(path,depth,1);
+
+	// leaf split, a separator between the two leaves is copied up
+	Leaf* newLeafNode;
+	int leafSplit = chooseSplit(leafNode,leafNode->key(leafNode->count()-1)<keyValue);
+	PageKeyPair<T> pushUp = splitLeaf<T>(leafNode,pageNo,leafSplit,newLeafNode,fences);
+	if(keyValue<pushUp.key){
+		insertIntoLeaf(leafNode,keyValue,rid,payload);
+	}else{
+		insertIntoLeaf(newLeafNode,keyValue,rid,payload);
+	}
+	// counts of the two halves, they replace the count of the old leaf in its parent
+	std::uint32_t leftCount = leafNode->entries(leafNode->count());
+	std::uint32_t rightCount = newLeafNode->entries(newLeafNode->count());
+	// the new node is not latched, until its parent links it it is reached through the right link of the split node
+	bufMgr->unPinPage(file,pushUp.pageNo,true);
+	PageId splitPageNo = pageNo;
+	Page *splitPage = (Page*)leafNode;
+
+	// walk back up the path until a parent has room for the new child. The split is complete in the
+	// split node, which is let go before its parent is latched. In a counted index it stays latched
+	// until the parent has the new counts, readers could count the entries of the new node twice
+	while(depth>0){
+		depth--;
+		if(!Inner::COUNTED){
+			releaseNode(splitPageNo,splitPage,true);
+			bufMgr->latch(path[depth].page).lock();
+		}
+		Inner* node = (Inner*)path[depth].page;
+		int childIndex = path[depth].childIndex;
+		if(node->hasRoom(pushUp.key)){
+			node->insert(childIndex,pushUp.key,pushUp.pageNo,rightCount);
+			node->setChildCount(childIndex,leftCount);
+			if(Inner::COUNTED){
+				releaseNode(splitPageNo,splitPage,true);
+			}
+			releaseNode(path[depth].pageNo,path[depth].page,true);
+			releasePath<Inner>(path,depth,Inner::COUNTED);
+			refreshUpperLevels<Inner>();
+			return;
+		}
+		// non leaf split, middle key is pushed up
+		int splitIndex = chooseSplit(node,childIndex==node->count());
+		Inner* newNode;
+		PageKeyPair<T> nextPushUp = splitNonLeaf<T>(node,splitIndex,newNode);
+		if(childIndex<=splitIndex){
+			node->insert(childIndex,pushUp.key,pushUp.pageNo,rightCount);
+			node->setChildCount(childIndex,leftCount);
+		}else{
+			newNode->insert(childIndex-splitIndex-1,pushUp.key,pushUp.pageNo,rightCount);
+			newNode->setChildCount(childIndex-splitIndex-1,leftCount);
+		}
+		leftCount = node->totalCount();
+		rightCount = newNode->totalCount();
+		bufMgr->unPinPage(file,nextPushUp.pageNo,true);
+		if(Inner::COUNTED){
+			releaseNode(splitPageNo,splitPage,true);
+		}
+		splitPageNo = path[depth].pageNo;
+		splitPage = path[depth].page;
+		pushUp = nextPushUp;
+	}
+
+	// root split, tree grows by one level. Readers that still start at the old root go right from there
+	if(!Inner::COUNTED){
+		releaseNode(splitPageNo,splitPage,true);
+	}
+	growRoot<T, Inner>(pushUp,height==0 ? 1 : 0,leftCount,rightCount);
+	if(Inner::COUNTED){
+		releaseNode(splitPageNo,splitPage,true);
+	}
+	refreshUpperLevels<Inner>();
+}
+
+template <class Node>
+int BTreeIndex::chooseSplit(const Node *node,bool atEnd) const{
+	int even = node->splitIndex();
+	if(!options.appendSplits || !atEnd || node->hasHighKey() || node->count()<2){
+		return even;
+	}
+	// both sides keep at least one entry, the separator is taken from them
+	int keep = (int)(node->count()*options.fillFactor);
+	if(keep<even){
+		keep = even;
+	}
+	return keep<node->count()-1 ? keep : node->count()-1;
+}
+
+template <class Inner>
+void BTreeIndex::countPath(PathEntry *path,int depth,int delta){
+	if(!Inner::COUNTED){
+		return;
+	}
+	for(int i=0;i<depth;i++){
+		Inner* node = (Inner*)path[i].page;
+		node->setChildCount(path[i].childIndex,node->childCount(path[i].childIndex)+delta);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertBatch
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::insertBatch(const std::pair<const void*, RecordId> *entries, std::size_t n, const char* const *records)
+{
+	if (payloadBytes > 0 && records == NULL)
+	{
+		throw BadIndexInfoException("Index includes attributes, the records of the entries are needed");
+	}
+	(this->*insertBatchFn)(entries, n, records);
+	for (std::size_t i = 0; i < n; i++)
+	{
+		(this->*noteChangeFn)(entries[i].first, 1);
+	}
+	refreshStatsIfStale();
+}
+
+template <class T, class Leaf, class Inner>
+void BTreeIndex::insertBatchTyped(const std::pair<const void*, RecordId> *entries, std::size_t n, const char* const *records)
+{
+	std::vector<typename Leaf::Entry> batch(n);
+	for(std::size_t i=0;i<n;i++){
+		T key;
+		KeyTraits<T>::set(key, entries[i].first);
+		batch[i].set(entries[i].second,key);
+		includeColumns(batch[i], records == NULL ? NULL : records[i]);
+	}
+	std::sort(batch.begin(),batch.end());
+
+	PathEntry path[MAX_TREE_HEIGHT];
+	std::size_t i = 0;
+	bool latchPath = false;
+	while(i<n){
+		int depth = 0;
+		PageId pageNo;
+		Page *page;
+		// the leaf takes every key below the nearest separator right of the descent
+		KeyFences<T> fences;
+		std::unique_lock<std::mutex> structure(structureLatch, std::defer_lock);
+		if(latchPath || Inner::COUNTED || !latchLeaf<T, Leaf, Inner>(batch[i].key,pageNo,page,&fences)){
+			structure.lock();
+			latchForInsert<T, Inner>(batch[i].key,path,depth,pageNo,page,fences);
+		}
+		latchPath = false;
+
+		// keys of the batch that belong in this leaf go in under the one latch
+		Leaf* leafNode = (Leaf*)page;
+		int inserted = 0;
+		while(i<n && (!fences.hasHigh || batch[i].key<fences.high) && leafNode->hasRoom(batch[i].key)){
+			insertIntoLeaf(leafNode,batch[i].key,batch[i].rid,batch[i].payload());
+			inserted++;
+			i++;
+		}
+		countPath<Inner>(path,depth,inserted);
+		if(i==n || (fences.hasHigh && !(batch[i].key<fences.high))){
+			releaseNode(pageNo,page,inserted>0);
+			releasePath<Inner>(path,depth,Inner::COUNTED && inserted>0);
+		}else if(!structure.owns_lock()){
+			// leaf is full, it has to be split with its path latched
+			releaseNode(pageNo,page,inserted>0);
+			latchPath = true;
+		}else{
+			// split once and go down again for the rest of the batch
+			splitAndInsert<T, Leaf, Inner>(leafNode,pageNo,batch[i].key,batch[i].rid,batch[i].payload(),path,depth,fences);
+			i++;
+		}
+	}
+}
+
+template <class Inner>
+void BTreeIndex::releasePath(PathEntry *path,int depth,bool dirty){
+	for(int i=0;i<depth;i++){
+		if(Inner::COUNTED){
+			releaseNode(path[i].pageNo,path[i].page,dirty);
+		}else{
+			bufMgr->unPinPage(file,path[i].pageNo,dirty);
+		}
+	}
+}
+
+void BTreeIndex::releaseNode(PageId pageNo, Page *page, bool dirty){
+	bufMgr->latch(page).unlock();
+	bufMgr->unPinPage(file,pageNo,dirty);
+}
+
+template <class T, class Inner>
+void BTreeIndex::growRoot(PageKeyPair<T> pushUp,int level,std::uint32_t leftCount,std::uint32_t rightCount){
+	PageId oldRootPageNo = metaInfo.rootPageNo;
+	Inner* newRootNode;
+	PageId newRootPageNo;
+	allocNode(newRootPageNo,(Page *&)newRootNode);
+	__atomic_store_n(&upperLevelsStale, true, __ATOMIC_RELAXED);
+	newRootNode->init(level);
+	newRootNode->setChild(0,oldRootPageNo);
+	newRootNode->setChildCount(0,leftCount);
+	newRootNode->insert(0,pushUp.key,pushUp.pageNo,rightCount);
+	{
+		std::lock_guard<std::mutex> meta(metaLatch);
+		// descents that read the old root page number start again
+		rootLatch.lock();
+		__atomic_store_n(&metaInfo.rootPageNo, newRootPageNo, __ATOMIC_RELAXED);
+		rootLatch.unlock();
+		this->rootPageNum = newRootPageNo;
+		writeMetaPage();
+	}
+	bufMgr->unPinPage(file,newRootPageNo,true);
+}
+
+void BTreeIndex::writeMetaPage(){
+	Page* metaPage;
+	bufMgr->readPage(file,headerPageNum,metaPage);
+	memcpy((void*)metaPage,&metaInfo,sizeof(IndexMetaInfo));
+	bufMgr->unPinPage(file,headerPageNum,true);
+}
+
+void BTreeIndex::allocNode(PageId &pageNo, Page *&page){
+	std::lock_guard<std::mutex> meta(metaLatch);
+	if(metaInfo.freePageNo==Page::INVALID_NUMBER){
+		bufMgr->allocPage(file,pageNo,page);
+		return;
+	}
+	// reuse the page at the head of the free list
+	pageNo = metaInfo.freePageNo;
+	bufMgr->readPage(file,pageNo,page);
+	metaInfo.freePageNo = ((FreeNode*)page)->nextFreePageNo;
+	writeMetaPage();
+}
+
+void BTreeIndex::freeNode(PageId pageNo, Page *page, bool latched){
+	std::lock_guard<std::mutex> meta(metaLatch);
+	if(((NodeHeader*)page)->level != -1 && !(((NodeHeader*)page)->flags & NODE_OVERFLOW)){
+		// a non-leaf node, the cached levels may hold it
+		__atomic_store_n(&upperLevelsStale, true, __ATOMIC_RELAXED);
+	}
+	FreeNode* freeNode = (FreeNode*)page;
+	memset((void*)page, 0, Page::SIZE);
+	freeNode->header.level = 0;
+	freeNode->header.version = NODE_FORMAT_VERSION;
+	freeNode->header.flags = NODE_FREE;
+	freeNode->nextFreePageNo = metaInfo.freePageNo;
+	metaInfo.freePageNo = pageNo;
+	if(latched){
+		// readers still holding the page fail to validate it
+		bufMgr->latch(page).unlock();
+	}
+	bufMgr->unPinPage(file,pageNo,true);
+	writeMetaPage();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::deleteEntry
+// -----------------------------------------------------------------------------
+
+bool BTreeIndex::deleteEntry(const void *key, const RecordId rid)
+{
+	bool removed = (this->*deleteEntryFn)(key, rid);
+	if (removed)
+	{
+		(this->*noteChangeFn)(key, -1);
+		refreshStatsIfStale();
+	}
+	return removed;
+}
+
+template <class T, class Leaf, class Inner>
+bool BTreeIndex::deleteEntryTyped(const void *key, const RecordId rid)
+{
+	T keyValue;
+	KeyTraits<T>::set(keyValue, key);
+	// a leaf with entries to spare is all a delete changes, unless there are subtree counts above it
+	PageId pageNo;
+	Page *page;
+	bool found;
+	if(!Inner::COUNTED && latchEntry<T, Leaf, Inner>(keyValue, rid, pageNo, page, found)){
+		if(!found){
+			return false;
+		}
+		Leaf* leafNode = (Leaf*)page;
+		if(leafNode->canLend()){
+			bool removed = removeFromLeaf(leafNode, keyValue, rid);
+			releaseNode(pageNo, page, removed);
+			return removed;
+		}
+		releaseNode(pageNo, page, false);
+	}
+
+	// like an insert that splits, only the holder of structureLatch changes non-leaf nodes, so they are read
+	// without latching them. Only the nodes a delete changes are latched: the leaf, and once it is underfull its
+	// sibling and their parent, or every node of the path when subtree counts change
+	std::lock_guard<std::mutex> structure(structureLatch);
+	PageId rootPageNo = metaInfo.rootPageNo;
+	Page *root;
+	bufMgr->readPage(file, rootPageNo, root);
+	Inner* rootNode = (Inner*)root;
+	bool rootLatched = Inner::COUNTED || rootNode->header.level == -1;
+	if(rootLatched){
+		bufMgr->latch(root).lock();
+	}
+	bool removed = removeEntry<T, Leaf, Inner>(root, keyValue, rid, rootLatched);
+	if(!removed || rootNode->header.level == -1 || rootNode->count() > 0){
+		if(rootLatched){
+			releaseNode(rootPageNo, root, removed);
+		}else{
+			bufMgr->unPinPage(file, rootPageNo, false);
+		}
+		refreshUpperLevels<Inner>();
+		return removed;
+	}
+	// root lost its last separator in a merge, which latched it. Its only child becomes the root and the tree
+	// shrinks by one level
+	{
+		std::lock_guard<std::mutex> meta(metaLatch);
+		rootLatch.lock();
+		__atomic_store_n(&metaInfo.rootPageNo, rootNode->child(0), __ATOMIC_RELAXED);
+		this->rootPageNum = metaInfo.rootPageNo;
+	}
+	freeNode(rootPageNo, root, true);
+	rootLatch.unlock();
+	refreshUpperLevels<Inner>();
+	return true;
+}
+
+template <class T, class Leaf, class Inner>
+bool BTreeIndex::latchEntry(const T &key,const RecordId rid,PageId &pageNo,Page *&page,bool &found){
+	std::uint64_t copy[Page::SIZE / sizeof(std::uint64_t)];
+	for(int attempt=0;attempt<OPTIMISTIC_ATTEMPTS;attempt++){
+		std::uint32_t version;
+		if(!descendOptimistic<T, Leaf, Inner>(key,false,pageNo,page,version,NULL,NULL)){
+			continue;
+		}
+		// equal keys can go on over several leaves, like removeEntry tries every child that may hold key
+		while(true){
+			const Leaf* leafNode = readNode<Leaf>(page, version, copy);
+			if(leafNode == NULL){
+				bufMgr->unPinPage(file, pageNo, false);
+				break;
+			}
+			EntryLocation location = locateEntry(leafNode, key, rid);
+			if(location == ENTRY_FURTHER_RIGHT){
+				if(!couple(pageNo, page, version, leafNode->rightSibPageNo)){
+					break;
+				}
+				continue;
+			}
+			if(location == ENTRY_ABSENT){
+				bool valid = bufMgr->latch(page).validate(version);
+				bufMgr->unPinPage(file, pageNo, false);
+				if(!valid){
+					break;
+				}
+				found = false;
+				return true;
+			}
+			if(bufMgr->latch(page).tryUpgrade(version)){
+				found = true;
+				return true;
+			}
+			bufMgr->unPinPage(file, pageNo, false);
+			break;
+		}
+	}
+	return false;
+}
+
+template <class T, class Leaf>
+BTreeIndex::EntryLocation BTreeIndex::locateEntry(const Leaf *leafNode, const T &key, const RecordId rid)
+{
+	int numKeys = leafNode->count();
+	int i = leafNode->lowerBound(key);
+	for(;i<numKeys && !(key<leafNode->key(i));i++){
+		if(leafNode->rid(i) == rid){
+			return ENTRY_HERE;
+		}
+	}
+	if(i<numKeys || leafNode->rightSibPageNo == Page::INVALID_NUMBER){
+		return ENTRY_ABSENT;
+	}
+	return ENTRY_FURTHER_RIGHT;
+}
+
+template <class T>
+BTreeIndex::EntryLocation BTreeIndex::locateEntry(const PostingLeafNode<T> *leafNode, const T &key, const RecordId rid)
+{
+	// a key has one list, removeFromLeaf looks for rid in it
+	int i = leafNode->lowerBound(key);
+	if(i<leafNode->count()){
+		return key<leafNode->key(i) ? ENTRY_ABSENT : ENTRY_HERE;
+	}
+	return leafNode->rightSibPageNo == Page::INVALID_NUMBER ? ENTRY_ABSENT : ENTRY_FURTHER_RIGHT;
+}
+
+template <class T, class Leaf, class Inner>
+bool BTreeIndex::removeEntry(Page *page, const T &key, const RecordId rid, bool &latched)
+{
+	if(((NodeHeader*)page)->level == -1){
+		return removeFromLeaf((Leaf*)page, key, rid);
+	}
+
+	// equal keys can be spread over several children, try each one that may hold key
+	Inner* node = (Inner*)page;
+	int lastChild = node->upperBound(key);
+	for(int childIndex=node->lowerBound(key);childIndex<=lastChild;childIndex++){
+		PageId childPageNo = node->child(childIndex);
+		Page *child;
+		bufMgr->readPage(file, childPageNo, child);
+		bool leaf = ((NodeHeader*)child)->level == -1;
+		bool childLatched = Inner::COUNTED || leaf;
+		if(childLatched){
+			bufMgr->latch(child).lock();
+		}
+		if(!removeEntry<T, Leaf, Inner>(child, key, rid, childLatched)){
+			if(childLatched){
+				releaseNode(childPageNo, child, false);
+			}else{
+				bufMgr->unPinPage(file, childPageNo, false);
+			}
+			continue;
+		}
+		node->setChildCount(childIndex, node->childCount(childIndex) - 1);
+		if(leaf ? ((Leaf*)child)->isUnderfull() : ((Inner*)child)->isUnderfull()){
+			// the separator between the child and its sibling changes, or goes
+			if(!latched){
+				bufMgr->latch(page).lock();
+				latched = true;
+			}
+			if(!childLatched){
+				bufMgr->latch(child).lock();
+			}
+			if(leaf){
+				rebalanceLeaf<T>(node, childIndex, (Leaf*)child);
+			}else{
+				rebalanceNonLeaf<T>(node, childIndex, (Inner*)child);
+			}
+			return true;
+		}
+		if(childLatched){
+			releaseNode(childPageNo, child, true);
+		}else{
+			bufMgr->unPinPage(file, childPageNo, false);
+		}
+		return true;
+	}
+	return false;
+}
+
+template <class T, class Leaf, class Inner>
+void BTreeIndex::rebalanceLeaf(Inner *parent, int childIndex, Leaf *child)
+{
+	// pair the leaf with its left sibling, the leftmost child with its right one
+	int keyIndex = childIndex > 0 ? childIndex-1 : 0;
+	PageId leftPageNo = parent->child(keyIndex);
+	PageId rightPageNo = parent->child(keyIndex+1);
+	Leaf* left;
+	Leaf* right;
+	if(childIndex == keyIndex){
+		left = child;
+		bufMgr->readPage(file, rightPageNo, (Page *&)right);
+		bufMgr->latch((Page*)right).lock();
+	}else{
+		bufMgr->readPage(file, leftPageNo, (Page *&)left);
+		bufMgr->latch((Page*)left).lock();
+		right = child;
+	}
+	Leaf* sibling = left == child ? right : left;
+	std::uint32_t total = parent->childCount(keyIndex) + parent->childCount(keyIndex+1);
+
+	if(sibling->canLend()){
+		//an entry changes sides, the separator moves to just before the first entry of the right leaf
+		T separator = sibling == right ? KeyTraits<T>::separator(right->key(0), right->key(1))
+				: KeyTraits<T>::separator(left->key(left->count()-2), left->key(left->count()-1));
+		if(parent->canReplaceKey(keyIndex, separator)
+				&& (sibling == right ? left->borrowFirst(right, separator) : right->borrowLast(left, separator))){
+			parent->replaceKey(keyIndex, separator);
+			left->setHighKey(&separator);
+			std::uint32_t leftCount = Inner::COUNTED ? left->entries(left->count()) : 0;
+			parent->setChildCount(keyIndex, leftCount);
+			parent->setChildCount(keyIndex+1, total - leftCount);
+			releaseNode(leftPageNo, (Page*)left, true);
+			releaseNode(rightPageNo, (Page*)right, true);
+			return;
+		}
+	}
+
+	//merge the right leaf into the left one
+	if(left->absorb(right)){
+		left->rightSibPageNo = right->rightSibPageNo;
+		left->setHighKey(right->hasHighKey() ? &right->highKey : NULL);
+		linkLeft<Leaf>(left->rightSibPageNo, leftPageNo);
+		parent->remove(keyIndex);
+		parent->setChildCount(keyIndex, total);
+		releaseNode(leftPageNo, (Page*)left, true);
+		freeNode(rightPageNo, (Page*)right, true);
+		return;
+	}
+	//STRING leaves whose keys would not fit without their prefixes, or posting lists too long
+	//to fit together, stay as they are
+	releaseNode(leftPageNo, (Page*)left, true);
+	releaseNode(rightPageNo, (Page*)right, true);
+}
+
+template <class T, class Inner>
+void BTreeIndex::rebalanceNonLeaf(Inner *parent, int childIndex, Inner *child)
+{
+	int keyIndex = childIndex > 0 ? childIndex-1 : 0;
+	PageId leftPageNo = parent->child(keyIndex);
+	PageId rightPageNo = parent->child(keyIndex+1);
+	Inner* left;
+	Inner* right;
+	if(childIndex == keyIndex){
+		left = child;
+		bufMgr->readPage(file, rightPageNo, (Page *&)right);
+		bufMgr->latch((Page*)right).lock();
+	}else{
+		bufMgr->readPage(file, leftPageNo, (Page *&)left);
+		bufMgr->latch((Page*)left).lock();
+		right = child;
+	}
+	Inner* sibling = left == child ? right : left;
+	T separator = parent->key(keyIndex);
+
+	if(sibling->canLend()){
+		if(sibling == right){
+			//separator comes down to the left node, first key of the right node goes up
+			T up = right->key(0);
+			if(left->hasRoom(separator) && parent->canReplaceKey(keyIndex, up)){
+				left->insert(left->count(), separator, right->child(0), right->childCount(0));
+				parent->replaceKey(keyIndex, up);
+				left->setHighKey(&up);
+				right->removeFront();
+				parent->setChildCount(keyIndex, left->totalCount());
+				parent->setChildCount(keyIndex+1, right->totalCount());
+				releaseNode(leftPageNo, (Page*)left, true);
+				releaseNode(rightPageNo, (Page*)right, true);
+				return;
+			}
+		}else{
+			//separator comes down to the right node, last key of the left node goes up
+			int last = left->count()-1;
+			T up = left->key(last);
+			if(right->hasRoom(separator) && parent->canReplaceKey(keyIndex, up)){
+				right->insertFront(separator, left->child(last+1), left->childCount(last+1));
+				parent->replaceKey(keyIndex, up);
+				left->setHighKey(&up);
+				left->remove(last);
+				parent->setChildCount(keyIndex, left->totalCount());
+				parent->setChildCount(keyIndex+1, right->totalCount());
+				releaseNode(leftPageNo, (Page*)left, true);
+				releaseNode(rightPageNo, (Page*)right, true);
+				return;
+			}
+		}
+	}
+
+	//merge the right node into the left one, the separator comes down between them
+	if(left->absorb(separator, right)){
+		left->rightSibPageNo = right->rightSibPageNo;
+		left->setHighKey(right->hasHighKey() ? &right->highKey : NULL);
+		parent->remove(keyIndex);
+		parent->setChildCount(keyIndex, left->totalCount());
+		releaseNode(leftPageNo, (Page*)left, true);
+		freeNode(rightPageNo, (Page*)right, true);
+		return;
+	}
+	//STRING separators too long to fit together, the node stays as it is
+	releaseNode(leftPageNo, (Page*)left, true);
+	releaseNode(rightPageNo, (Page*)right, true);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::lookup
+// -----------------------------------------------------------------------------
+
+bool BTreeIndex::lookup(const void* key, RecordId& outRid)
+{
+	return (this->*lookupFn)(key, &outRid);
+}
+
+bool BTreeIndex::contains(const void* key)
+{
+	return (this->*lookupFn)(key, NULL);
+}
+
+template <class T, class Leaf, class Inner>
+bool BTreeIndex::lookupTyped(const void *keyParm, RecordId *outRid)
+{
+	T key;
+	KeyTraits<T>::set(key, keyParm);
+	std::uint64_t copy[Page::SIZE / sizeof(std::uint64_t)];
+	// no latches are taken, a descent that finds a node changed under it starts again from the root
+	while (1)
+	{
+		PageId pageNo;
+		Page *page;
+		std::uint32_t version;
+		// leftmost child that can hold key, like startScan with a GTE bound
+		if (!descendOptimistic<T, Leaf, Inner>(key, false, pageNo, page, version, NULL, NULL))
+		{
+			continue;
+		}
+		// the first entry >= key is in this leaf, or the first one of a leaf on its right
+		// when the key equals the separator the descent went left of
+		while (1)
+		{
+			const Leaf* leafNode = readNode<Leaf>(page, version, copy);
+			if (leafNode == NULL)
+			{
+				this->bufMgr->unPinPage(this->file, pageNo, false);
+				break;
+			}
+			int i = leafNode->lowerBound(key);
+			if (i < leafNode->count() || leafNode->rightSibPageNo == Page::INVALID_NUMBER)
+			{
+				bool found = i < leafNode->count() && !(key < leafNode->key(i));
+				RecordId rid;
+				if (found && outRid != NULL)
+				{
+					rid = firstRid(leafNode, i);
+				}
+				bool valid = this->bufMgr->latch(page).validate(version);
+				this->bufMgr->unPinPage(this->file, pageNo, false);
+				if (!valid)
+				{
+					break;
+				}
+				if (found && outRid != NULL)
+				{
+					*outRid = rid;
+				}
+				return found;
+			}
+			if (!couple(pageNo, page, version, leafNode->rightSibPageNo))
+			{
+				break;
+			}
+		}
+	}
+}
+
+template <class Leaf>
+RecordId BTreeIndex::firstRid(const Leaf *leafNode, int i)
+{
+	return leafNode->rid(i);
+}
+
+template <class T>
+RecordId BTreeIndex::firstRid(const PostingLeafNode<T> *leafNode, int i)
+{
+	// the first value of a list, and of every overflow page, is stored whole
+	std::uint64_t value;
+	if (!leafNode->isOverflow(i))
+	{
+		PostingCodec::get(leafNode->list(i), value);
+		return PostingCodec::recordId(value);
+	}
+	PageId pageNo = leafNode->overflowPageNo(i);
+	OverflowNode* page;
+	this->bufMgr->readPage(this->file, pageNo, (Page *&)page);
+	PostingCodec::get(page->data, value);
+	this->bufMgr->unPinPage(this->file, pageNo, false);
+	return PostingCodec::recordId(value);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::countRange
+// -----------------------------------------------------------------------------
+
+std::uint64_t BTreeIndex::countRange(const void* lowValParm,
+				   const Operator lowOpParm,
+				   const void* highValParm,
+				   const Operator highOpParm)
+{
+	return (this->*countRangeFn)(lowValParm, lowOpParm, highValParm, highOpParm);
+}
+
+template <class T, class Leaf, class Inner>
+std::uint64_t BTreeIndex::countRangeTyped(const void* lowValParm,
+				   const Operator lowOpParm,
+				   const void* highValParm,
+				   const Operator highOpParm)
+{
+	if (!Inner::COUNTED)
+	{
+		// no counts to go by, the range is scanned
+		BTreeCursor cursor(this);
+		std::uint64_t count = 0;
+		if (cursor.open(lowValParm, lowOpParm, highValParm, highOpParm))
+		{
+			RecordId rids[256];
+			std::size_t n;
+			while ((n = cursor.nextBatch(rids, 256)) > 0)
+			{
+				count += n;
+			}
+		}
+		return count;
+	}
+	if ((lowOpParm!=GT && lowOpParm!=GTE) || (highOpParm!=LT && highOpParm!=LTE))
+	{
+		throw BadOpcodesException();
+	}
+	T lowVal;
+	T highVal;
+	KeyTraits<T>::set(lowVal, lowValParm);
+	KeyTraits<T>::set(highVal, highValParm);
+	if (highVal < lowVal)
+	{
+		throw BadScanrangeException();
+	}
+	// entries up to the high bound, less those before the low bound
+	std::uint64_t high = countBelow<T, Leaf, Inner>(highVal, highOpParm == LTE);
+	std::uint64_t low = countBelow<T, Leaf, Inner>(lowVal, lowOpParm == GT);
+	return high > low ? high - low : 0;
+}
+
+template <class T, class Leaf, class Inner>
+std::uint64_t BTreeIndex::countBelow(const T &key, bool inclusive)
+{
+	std::uint64_t copy[Page::SIZE / sizeof(std::uint64_t)];
+	while (1)
+	{
+		// children left of the one that holds the bound are counted whole, those right of it not at all
+		std::uint64_t count;
+		PageId pageNo;
+		Page *page;
+		std::uint32_t version;
+		if (!descendOptimistic<T, Leaf, Inner>(key, inclusive, pageNo, page, version, NULL, &count))
+		{
+			continue;
+		}
+		const Leaf* leafNode = readNode<Leaf>(page, version, copy);
+		if (leafNode != NULL)
+		{
+			count += leafNode->entries(inclusive ? leafNode->upperBound(key) : leafNode->lowerBound(key));
+		}
+		bool valid = leafNode != NULL && this->bufMgr->latch(page).validate(version);
+		this->bufMgr->unPinPage(this->file, pageNo, false);
+		if (valid)
+		{
+			return count;
+		}
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::estimateRange
+// -----------------------------------------------------------------------------
+
+RangeEstimate BTreeIndex::estimateRange(const void* lowValParm,
+				   const Operator lowOpParm,
+				   const void* highValParm,
+				   const Operator highOpParm)
+{
+	return (this->*estimateRangeFn)(lowValParm, lowOpParm, highValParm, highOpParm);
+}
+
+template <class T>
+RangeEstimate BTreeIndex::estimateRangeTyped(const void* lowValParm,
+				   const Operator lowOpParm,
+				   const void* highValParm,
+				   const Operator highOpParm)
+{
+	if ((lowOpParm!=GT && lowOpParm!=GTE) || (highOpParm!=LT && highOpParm!=LTE))
+	{
+		throw BadOpcodesException();
+	}
+	T lowVal;
+	T highVal;
+	KeyTraits<T>::set(lowVal, lowValParm);
+	KeyTraits<T>::set(highVal, highValParm);
+	if (highVal < lowVal)
+	{
+		throw BadScanrangeException();
+	}
+	if (__atomic_load_n(&metaInfo.stats.height, __ATOMIC_RELAXED) == 0)
+	{
+		refreshStats();
+	}
+	IndexStats stats = statistics();
+	RangeEstimate estimate;
+	double total = 0;
+	for (int b = 0; b < stats.buckets; b++)
+	{
+		total += std::max<std::int64_t>(stats.bucketEntries[b], 0);
+	}
+	double entries = 0;
+	if (lowOpParm == GTE && highOpParm == LTE && lowVal == highVal)
+	{
+		// an equality range, as many entries as the average key of its bucket
+		if (stats.buckets > 0 && !(lowVal < statsBound<T>(stats, 0)) && !(statsBound<T>(stats, stats.buckets) < lowVal))
+		{
+			int b = findBucket(stats, lowVal);
+			entries = (double)std::max<std::int64_t>(stats.bucketEntries[b], 0) / std::max<std::int64_t>(stats.bucketKeys[b], 1);
+		}
+	}
+	else
+	{
+		for (int b = 0; b < stats.buckets; b++)
+		{
+			double bucketEntries = std::max<std::int64_t>(stats.bucketEntries[b], 0);
+			double part = bucketBelow(stats, b, highVal, highOpParm == LTE) - bucketBelow(stats, b, lowVal, lowOpParm == GT);
+			if (part > 0)
+			{
+				// a range that reaches into a bucket holds at least one of its keys
+				entries += std::max(part * bucketEntries, bucketEntries / std::max<std::int64_t>(stats.bucketKeys[b], 1));
+			}
+		}
+	}
+	estimate.entries = std::min(entries, total);
+	estimate.selectivity = total > 0 ? estimate.entries / total : 0;
+	estimate.leafPages = std::max(estimate.selectivity * stats.leafPages, 1.0);
+	return estimate;
+}
+
+template <class T>
+double BTreeIndex::bucketBelow(const IndexStats &stats, int b, const T &key, bool inclusive)
+{
+	T first = statsBound<T>(stats, b);
+	T end = statsBound<T>(stats, b + 1);
+	if (key < first)
+	{
+		return 0;
+	}
+	if (first == end)
+	{
+		// a bucket of one key, only the last one can be
+		return first < key || inclusive ? 1 : 0;
+	}
+	if (!(key < end))
+	{
+		return 1;
+	}
+	return std::min(std::max(KeyTraits<T>::fraction(key, inclusive, first, end), 0.0), 1.0);
+}
+
+IndexStats BTreeIndex::statistics()
+{
+	IndexStats stats;
+	while (1)
+	{
+		std::uint32_t version = statsLatch.readVersion();
+		memcpy(&stats, &metaInfo.stats, sizeof(IndexStats));
+		if (statsLatch.validate(version))
+		{
+			return stats;
+		}
+	}
+}
+
+void BTreeIndex::refreshStats()
+{
+	std::lock_guard<std::mutex> collection(statsCollection);
+	for (int attempt = 0; attempt < OPTIMISTIC_ATTEMPTS && !(this->*collectStatsFn)(); attempt++)
+	{
+	}
+}
+
+void BTreeIndex::refreshStatsIfStale()
+{
+	std::int64_t changes = __atomic_load_n(&metaInfo.stats.changes, __ATOMIC_RELAXED);
+	if (changes <= __atomic_load_n(&metaInfo.stats.collectedEntries, __ATOMIC_RELAXED) / 4 + STATS_MIN_CHANGES)
+	{
+		return;
+	}
+	// one writer starts the worker, the others go on. A worker that cleared the flag is about to end
+	std::unique_lock<std::mutex> launch(statsLaunch, std::try_to_lock);
+	if (!launch.owns_lock() || __atomic_load_n(&statsRefreshing, __ATOMIC_ACQUIRE))
+	{
+		return;
+	}
+	if (statsWorker.joinable())
+	{
+		statsWorker.join();
+	}
+	__atomic_store_n(&statsRefreshing, true, __ATOMIC_RELAXED);
+	statsWorker = std::thread(&BTreeIndex::refreshStatsInBackground, this);
+}
+
+void BTreeIndex::refreshStatsInBackground()
+{
+	refreshStats();
+	__atomic_store_n(&statsRefreshing, false, __ATOMIC_RELEASE);
+}
+
+template <class T>
+void BTreeIndex::noteChange(const void *key, int delta)
+{
+	T keyValue;
+	KeyTraits<T>::set(keyValue, key);
+	IndexStats &stats = metaInfo.stats;
+	__atomic_fetch_add(&stats.entries, delta, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&stats.changes, 1, __ATOMIC_RELAXED);
+	while (1)
+	{
+		std::uint32_t version = statsLatch.readVersion();
+		int buckets = stats.buckets;
+		if (buckets == 0)
+		{
+			// nothing to add to until the first walk
+			return;
+		}
+		bool below = keyValue < statsBound<T>(stats, 0);
+		bool above = statsBound<T>(stats, buckets) < keyValue;
+		int b = findBucket(stats, keyValue);
+		// the bucket is updated under the latch, a walk publishing its figures would otherwise copy over it
+		if (!statsLatch.tryUpgrade(version))
+		{
+			continue;
+		}
+		if (delta < 0 || (!below && !above))
+		{
+			stats.bucketEntries[b] += delta;
+		}
+		else
+		{
+			// a new smallest or largest key, the outer bucket grows to take it
+			setStatsBound(stats, below ? 0 : buckets, keyValue);
+			stats.bucketEntries[below ? 0 : buckets - 1] += delta;
+			stats.bucketKeys[below ? 0 : buckets - 1]++;
+		}
+		statsLatch.unlock();
+		return;
+	}
+}
+
+template <class T>
+int BTreeIndex::findBucket(const IndexStats &stats, const T &key)
+{
+	// the last bucket whose first key is not above key
+	int low = 0;
+	int high = stats.buckets - 1;
+	while (low < high)
+	{
+		int middle = (low + high + 1) / 2;
+		if (key < statsBound<T>(stats, middle))
+		{
+			high = middle - 1;
+		}
+		else
+		{
+			low = middle;
+		}
+	}
+	return low;
+}
+
+template <class T>
+T BTreeIndex::statsBound(const IndexStats &stats, int i)
+{
+	T key;
+	memcpy(&key, stats.bounds[i], sizeof(T));
+	return key;
+}
+
+template <class T>
+void BTreeIndex::setStatsBound(IndexStats &stats, int i, const T &key)
+{
+	memcpy(stats.bounds[i], &key, sizeof(T));
+}
+
+template <class T, class Leaf, class Inner>
+bool BTreeIndex::collectStats()
+{
+	IndexStats stats = IndexStats();
+	std::int64_t changes = __atomic_load_n(&metaInfo.stats.changes, __ATOMIC_RELAXED);
+	PageId firstPageNo;
+	if (!collectLevels<Inner>(stats, firstPageNo))
+	{
+		return false;
+	}
+	// the buckets are cut by the entries counted since the last walk. Should they be far off, in a file without
+	// statistics, the leaves are walked again with the number just counted
+	std::int64_t expected = __atomic_load_n(&metaInfo.stats.entries, __ATOMIC_RELAXED);
+	if (!collectLeaves<T, Leaf>(firstPageNo, expected, stats))
+	{
+		return false;
+	}
+	if (std::abs(stats.entries - expected) > stats.entries / 8 && !collectLeaves<T, Leaf>(firstPageNo, stats.entries, stats))
+	{
+		return false;
+	}
+	publishStats(stats, changes);
+	return true;
+}
+
+template <class Inner>
+bool BTreeIndex::collectLevels(IndexStats &stats, PageId &firstPageNo)
+{
+	// a level at a time along the right links, down the leftmost children
+	std::uint64_t copy[Page::SIZE / sizeof(std::uint64_t)];
+	while (1)
+	{
+		std::uint32_t rootVersion = rootLatch.readVersion();
+		firstPageNo = __atomic_load_n(&metaInfo.rootPageNo, __ATOMIC_RELAXED);
+		if (rootLatch.validate(rootVersion))
+		{
+			break;
+		}
+	}
+	double innerSlots = 0;
+	// non-leaf levels are 0 down to the one just above the leaves, which is 1
+	int level = 0;
+	while (1)
+	{
+		copyPage(firstPageNo, copy);
+		const NodeHeader *header = (const NodeHeader*)copy;
+		if (header->flags & (NODE_FREE | NODE_OVERFLOW))
+		{
+			return false;
+		}
+		if (header->level == -1)
+		{
+			if (stats.height > 0 && level != 1)
+			{
+				return false;
+			}
+			break;
+		}
+		if (level == 1)
+		{
+			return false;
+		}
+		level = header->level;
+		stats.height++;
+		PageId childPageNo = ((const Inner*)copy)->child(0);
+		while (1)
+		{
+			const Inner *node = (const Inner*)copy;
+			stats.innerPages++;
+			innerSlots += node->count();
+			if (!node->hasHighKey())
+			{
+				break;
+			}
+			copyPage(node->rightSibPageNo, copy);
+			if ((header->flags & (NODE_FREE | NODE_OVERFLOW)) || header->level != level)
+			{
+				return false;
+			}
+		}
+		firstPageNo = childPageNo;
+	}
+	stats.height++;
+	stats.innerFill = stats.innerPages > 0 ? innerSlots / ((double)stats.innerPages * Inner::SIZE) : 0;
+	return true;
+}
+
+template <class T, class Leaf>
+bool BTreeIndex::collectLeaves(PageId firstPageNo, std::int64_t expected, IndexStats &stats)
+{
+	stats.leafPages = 0;
+	stats.entries = 0;
+	stats.distinctKeys = 0;
+	stats.buckets = 0;
+	memset(stats.bucketEntries, 0, sizeof(stats.bucketEntries));
+	memset(stats.bucketKeys, 0, sizeof(stats.bucketKeys));
+	memset(stats.bounds, 0, sizeof(stats.bounds));
+	std::int64_t depth = std::max<std::int64_t>(expected / HISTOGRAM_BUCKETS, 1);
+	std::int64_t inBucket = 0;
+	double leafSlots = 0;
+	std::uint64_t copy[Page::SIZE / sizeof(std::uint64_t)];
+	PageId pageNo = firstPageNo;
+	while (pageNo != Page::INVALID_NUMBER)
+	{
+		copyPage(pageNo, copy);
+		const NodeHeader *header = (const NodeHeader*)copy;
+		if ((header->flags & (NODE_FREE | NODE_OVERFLOW)) || header->level != -1)
+		{
+			return false;
+		}
+		const Leaf *leafNode = (const Leaf*)copy;
+		stats.leafPages++;
+		leafSlots += leafNode->count();
+		for (int i = 0; i < leafNode->count(); i++)
+		{
+			T key = leafNode->key(i);
+			if (stats.buckets > 0 && key < statsBound<T>(stats, stats.buckets))
+			{
+				// a leaf freed by a merge and taken again for other keys
+				return false;
+			}
+			countStatsKey(stats, key, slotEntries(leafNode, i), depth, inBucket);
+		}
+		pageNo = leafNode->hasHighKey() ? leafNode->rightSibPageNo : Page::INVALID_NUMBER;
+	}
+	stats.leafFill = stats.leafPages > 0 ? leafSlots / ((double)stats.leafPages * Leaf::SIZE) : 0;
+	return true;
+}
+
+template <class T>
+void BTreeIndex::countStatsKey(IndexStats &stats, const T &key, std::int64_t entries, std::int64_t depth, std::int64_t &inBucket)
+{
+	// the bound after the last bucket is the last key added
+	if (stats.buckets == 0 || key != statsBound<T>(stats, stats.buckets))
+	{
+		if (stats.buckets == 0 || (inBucket >= depth && stats.buckets < HISTOGRAM_BUCKETS))
+		{
+			setStatsBound(stats, stats.buckets, key);
+			stats.buckets++;
+			inBucket = 0;
+		}
+		stats.distinctKeys++;
+		stats.bucketKeys[stats.buckets - 1]++;
+		setStatsBound(stats, stats.buckets, key);
+	}
+	stats.bucketEntries[stats.buckets - 1] += entries;
+	stats.entries += entries;
+	inBucket += entries;
+}
+
+void BTreeIndex::copyPage(PageId pageNo, std::uint64_t *copy)
+{
+	Page *page;
+	this->bufMgr->readPage(this->file, pageNo, page);
+	OptimisticLatch &latch = this->bufMgr->latch(page);
+	while (1)
+	{
+		std::uint32_t version = latch.readVersion();
+		memcpy(copy, (void*)page, Page::SIZE);
+		if (latch.validate(version))
+		{
+			break;
+		}
+	}
+	this->bufMgr->unPinPage(this->file, pageNo, false);
+}
+
+void BTreeIndex::publishStats(IndexStats &stats, std::int64_t changes)
+{
+	std::lock_guard<std::mutex> meta(metaLatch);
+	statsLatch.lock();
+	// entries and changes are added to by writers without the latch, they are never copied over. Once there are
+	// statistics entries is counted exactly as it changes, better than from leaves copied one by one
+	IndexStats &kept = metaInfo.stats;
+	if (kept.height == 0)
+	{
+		__atomic_store_n(&kept.entries, stats.entries, __ATOMIC_RELAXED);
+	}
+	else if (stats.entries > 0)
+	{
+		// changes to leaves the walk had passed are in the count but not in the buckets, they are spread over
+		// the buckets in proportion
+		double scale = (double)__atomic_load_n(&kept.entries, __ATOMIC_RELAXED) / stats.entries;
+		for (int b = 0; b < stats.buckets; b++)
+		{
+			stats.bucketEntries[b] = (std::int64_t)(stats.bucketEntries[b] * scale + 0.5);
+		}
+	}
+	memcpy(&kept, &stats, offsetof(IndexStats, entries));
+	memcpy(&kept.distinctKeys, &stats.distinctKeys, offsetof(IndexStats, changes) - offsetof(IndexStats, distinctKeys));
+	kept.collectedEntries = __atomic_load_n(&kept.entries, __ATOMIC_RELAXED);
+	__atomic_fetch_sub(&kept.changes, changes, __ATOMIC_RELAXED);
+	statsLatch.unlock();
+	writeMetaPage();
+}
+
+template <class Leaf>
+std::int64_t BTreeIndex::slotEntries(const Leaf *leafNode, int i)
+{
+	return 1;
+}
+
+template <class T>
+std::int64_t BTreeIndex::slotEntries(const PostingLeafNode<T> *leafNode, int i)
+{
+	return leafNode->isOverflow(i) ? leafNode->overflowCount(i) : PostingCodec::count(leafNode->list(i), leafNode->listBytes(i));
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::startScan
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::startScan(const void* lowValParm,
+				   const Operator lowOpParm,
+				   const void* highValParm,
+				   const Operator highOpParm)
+{
+	if (!scan.open(lowValParm, lowOpParm, highValParm, highOpParm))
+	{
+		scan.close();
+		throw NoSuchKeyFoundException();
+	}
+}
+
+bool BTreeIndex::tryStartScan(const void* lowValParm,
+				   const Operator lowOpParm,
+				   const void* highValParm,
+				   const Operator highOpParm)
+{
+	return scan.open(lowValParm, lowOpParm, highValParm, highOpParm);
+}
+
+template <class T>
+void BTreeIndex::setScanBounds(BTreeCursor &cursor,
+				   const void* lowValParm,
+				   const Operator lowOpParm,
+				   const void* highValParm,
+				   const Operator highOpParm)
+{
+	cursor.close();
+	if ((lowOpParm!=GT && lowOpParm!=GTE) || (highOpParm!=LT && highOpParm!=LTE))
+	{
+		throw BadOpcodesException();
+	}
+	T lowVal;
+	T highVal;
+	KeyTraits<T>::set(lowVal, lowValParm);
+	KeyTraits<T>::set(highVal, highValParm);
+	if (highVal < lowVal)
+	{
+		throw BadScanrangeException();
+	}
+	cursor.lowVal<T>() = lowVal;
+	cursor.highVal<T>() = highVal;
+	cursor.lowOp = lowOpParm;
+	cursor.highOp = highOpParm;
+	cursor.backward = false;
+	cursor.postingPos = 0;
+	cursor.postingEnd = 0;
+	cursor.postingSkip = 0;
+	cursor.overflowPageNum = Page::INVALID_NUMBER;
+	cursor.leavesScanned = 0;
+}
+
+template <class T, class Leaf, class Inner>
+bool BTreeIndex::startScanTyped(BTreeCursor &cursor,
+				   const void* lowValParm,
+				   const Operator lowOpParm,
+				   const void* highValParm,
+				   const Operator highOpParm)
+{
+	setScanBounds<T>(cursor, lowValParm, lowOpParm, highValParm, highOpParm);
+	const T &lowVal = cursor.lowVal<T>();
+	// leftmost leaf that can hold lowVal, equal keys may sit left of their separator.
+	// The leaf stays pinned until the scan moves off it, its entries are read from the copy
+	seekLeaf<T, Leaf, Inner>(cursor, lowVal, false);
+	cursor.scanExecuting = true;
+	// first entry past the low bound, keys equal to it may continue into the leaves on the right.
+	// From here on every entry is past the low bound and only the high bound is checked
+	cursor.nextEntry = 0;
+	while (1)
+	{
+		const Leaf* currentNode = cursor.leaf<Leaf>();
+		int first = lowOpParm == GT ? currentNode->upperBound(lowVal) : currentNode->lowerBound(lowVal);
+		cursor.nextEntry = std::max(cursor.nextEntry, first);
+		if (cursor.nextEntry < currentNode->count() || !nextLeaf<T, Leaf, Inner>(cursor))
+		{
+			break;
+		}
+	}
+	return positionScan<T, Leaf, Inner>(cursor);
+}
+
+template <class T, class Leaf, class Inner>
+void BTreeIndex::seekLeaf(BTreeCursor &cursor, const T &key, bool upper)
+{
+	while (1)
+	{
+		std::uint32_t version;
+		if (!descendOptimistic<T, Leaf, Inner>(key, upper, cursor.currentPageNum, cursor.currentPageData, version, NULL, NULL))
+		{
+			continue;
+		}
+		if (copyLeaf(cursor, version))
+		{
+			return;
+		}
+		this->bufMgr->unPinPage(this->file, cursor.currentPageNum, false);
+	}
+}
+
+bool BTreeIndex::copyLeaf(BTreeCursor &cursor, std::uint32_t version)
+{
+	memcpy(cursor.leafCopy, (void*)cursor.currentPageData, Page::SIZE);
+	cursor.leafVersion = version;
+	return this->bufMgr->latch(cursor.currentPageData).validate(version);
+}
+
+template <class T, class Leaf, class Inner>
+bool BTreeIndex::nextLeaf(BTreeCursor &cursor)
+{
+	const Leaf* currentNode = cursor.leaf<Leaf>();
+	if (currentNode->rightSibPageNo == Page::INVALID_NUMBER || !currentNode->hasHighKey())
+	{
+		return false;
+	}
+	// the copy is overwritten below, keep what is needed to find the place again: the last key of the copy and
+	// the record ids of the entries with that key, the last of them passed by the cursor
+	T highKey = currentNode->highKey;
+	PageId rightPageNo = currentNode->rightSibPageNo;
+	int count = currentNode->count();
+	T lastKey = count > 0 ? currentNode->key(count - 1) : highKey;
+	bool runFromLeft = count > 0 && currentNode->lowerBound(lastKey) == 0;
+	// STRING leaves hold more than Leaf::SIZE entries when their keys share a prefix, none more than a page of rids
+	RecordId run[Page::SIZE / sizeof(RecordId)];
+	int runLength = count > 0 ? lastRun(currentNode, run) : 0;
+	std::uint32_t version = cursor.leafVersion;
+	bool linked = true;
+	if (!this->bufMgr->latch(cursor.currentPageData).validate(version))
+	{
+		// entries were added to the leaf or removed since it was copied. As long as it was not split
+		// or merged, which moves its high key or right link, the leaf on its right is still the next one
+		std::uint64_t copy[Page::SIZE / sizeof(std::uint64_t)];
+		version = this->bufMgr->latch(cursor.currentPageData).readVersion();
+		const Leaf* leafNode = readNode<Leaf>(cursor.currentPageData, version, copy);
+		linked = leafNode != NULL && leafNode->header.level == -1 && !(leafNode->header.flags & NODE_FREE)
+				&& leafNode->hasHighKey() && !(leafNode->highKey < highKey) && !(highKey < leafNode->highKey)
+				&& leafNode->rightSibPageNo == rightPageNo;
+		// inserts of the high key go right of the leaf, an entry of it at the end that the copy did not end with
+		// was taken from the right sibling with its separator unchanged
+		int last = linked ? leafNode->count() - 1 : -1;
+		if (last >= 0 && !(leafNode->key(last) < highKey)
+				&& (lastKey < highKey || runLength == 0 || runIndex(leafNode, last, run, runLength) != runLength - 1))
+		{
+			linked = false;
+		}
+		if (!linked)
+		{
+			this->bufMgr->unPinPage(this->file, cursor.currentPageNum, false);
+		}
+	}
+	if (linked && couple(cursor.currentPageNum, cursor.currentPageData, version, rightPageNo))
+	{
+		if (copyLeaf(cursor, version))
+		{
+			cursor.nextEntry = 0;
+			readAheadFrom<Leaf>(cursor);
+			return true;
+		}
+		this->bufMgr->unPinPage(this->file, cursor.currentPageNum, false);
+	}
+	// the leaf was split or merged since it was copied. Every entry of the copy was passed, the scan goes on
+	// strictly after the last of them
+	if (count == 0)
+	{
+		seekLeaf<T, Leaf, Inner>(cursor, highKey, true);
+		cursor.nextEntry = cursor.leaf<Leaf>()->lowerBound(highKey);
+	}
+	else
+	{
+		resumeAfter<T, Leaf, Inner>(cursor, lastKey, run, runLength, runFromLeft);
+	}
+	readAheadFrom<Leaf>(cursor);
+	return true;
+}
+
+template <class T, class Leaf, class Inner>
+void BTreeIndex::resumeAfter(BTreeCursor &cursor, const T &key, const RecordId *run, int runLength, bool runFromLeft)
+{
+	if (runLength == 0)
+	{
+		// keys are unique and below the high key of their leaf, an upper descent finds the leaf of key even
+		// when a borrow made it the separator. A lower one would stop left of it and return key again
+		seekLeaf<T, Leaf, Inner>(cursor, key, true);
+		cursor.nextEntry = cursor.leaf<Leaf>()->upperBound(key);
+		return;
+	}
+	// leftmost leaf that can hold key, equal keys may sit left of their separator
+	seekLeaf<T, Leaf, Inner>(cursor, key, false);
+	cursor.nextEntry = cursor.leaf<Leaf>()->lowerBound(key);
+	// entries of one key keep their order, inserts add to the end of the run. Those the cursor passed, the
+	// ones in the copy last, are followed by those it did not, so it goes on after the last passed entry
+	// still there. Only if the run began in an earlier leaf and every entry of it in the copy was deleted can
+	// the passed entries not be told apart, then the run is returned again from its start
+	bool passedOne = false;
+	while (1)
+	{
+		const Leaf* currentNode = cursor.leaf<Leaf>();
+		if (cursor.nextEntry >= currentNode->count())
+		{
+			if (!nextLeaf<T, Leaf, Inner>(cursor))
+			{
+				break;
+			}
+			continue;
+		}
+		if (key < currentNode->key(cursor.nextEntry))
+		{
+			break;
+		}
+		int passed = runIndex(currentNode, cursor.nextEntry, run, runLength);
+		if (passed >= 0)
+		{
+			passedOne = true;
+			cursor.nextEntry++;
+			if (passed == runLength - 1)
+			{
+				return;
+			}
+			continue;
+		}
+		if (passedOne || !runFromLeft)
+		{
+			return;
+		}
+		cursor.nextEntry++;
+	}
+	if (!passedOne && runFromLeft)
+	{
+		this->bufMgr->unPinPage(this->file, cursor.currentPageNum, false);
+		seekLeaf<T, Leaf, Inner>(cursor, key, false);
+		cursor.nextEntry = cursor.leaf<Leaf>()->lowerBound(key);
+	}
+}
+
+template <class Leaf>
+int BTreeIndex::lastRun(const Leaf *leafNode, RecordId *run)
+{
+	int runLength = 0;
+	for (int i = leafNode->lowerBound(leafNode->key(leafNode->count() - 1)); i < leafNode->count(); i++)
+	{
+		run[runLength++] = leafNode->rid(i);
+	}
+	return runLength;
+}
+
+template <class T>
+int BTreeIndex::lastRun(const PostingLeafNode<T> *leafNode, RecordId *run)
+{
+	return 0;
+}
+
+template <class Leaf>
+int BTreeIndex::runIndex(const Leaf *leafNode, int i, const RecordId *run, int runLength)
+{
+	const RecordId *found = std::find(run, run + runLength, leafNode->rid(i));
+	return found == run + runLength ? -1 : (int)(found - run);
+}
+
+template <class T>
+int BTreeIndex::runIndex(const PostingLeafNode<T> *leafNode, int i, const RecordId *run, int runLength)
+{
+	return -1;
+}
+
+template <class Leaf>
+void BTreeIndex::readAheadFrom(BTreeCursor &cursor)
+{
+	cursor.leavesScanned++;
+	const Leaf* currentNode = cursor.leaf<Leaf>();
+	PageId nextPageNo = cursor.backward ? currentNode->leftSibPageNo : currentNode->rightSibPageNo;
+	if (options.readAhead == 0 || nextPageNo == Page::INVALID_NUMBER)
+	{
+		return;
+	}
+	if (cursor.leavesScanned < 2)
+	{
+		return;
+	}
+	// one leaf ahead after the second move, twice as many after every move since. While the last
+	// request is still being read the scan is behind it and nothing more is asked for
+	int leaves = cursor.leavesScanned > 30 ? options.readAhead : std::min(options.readAhead, 1 << (cursor.leavesScanned - 2));
+	if (cursor.readAheadOwner == 0)
+	{
+		cursor.readAheadOwner = this->readAhead->newOwner();
+	}
+	this->readAhead->request(cursor.readAheadOwner, nextPageNo, leaves, cursor.backward ? &BTreeIndex::leftLink<Leaf> : &BTreeIndex::rightLink<Leaf>);
+}
+
+template <class Leaf>
+PageId BTreeIndex::rightLink(BufMgr *bufMgr, Page *page)
+{
+	std::uint32_t version = bufMgr->latch(page).readVersion();
+	const Leaf *leafNode = (const Leaf*) page;
+	bool live = leafNode->header.level == -1 && !(leafNode->header.flags & NODE_FREE);
+	PageId rightPageNo = leafNode->rightSibPageNo;
+	return live && bufMgr->latch(page).validate(version) ? rightPageNo : Page::INVALID_NUMBER;
+}
+
+template <class Leaf>
+PageId BTreeIndex::leftLink(BufMgr *bufMgr, Page *page)
+{
+	std::uint32_t version = bufMgr->latch(page).readVersion();
+	const Leaf *leafNode = (const Leaf*) page;
+	bool live = leafNode->header.level == -1 && !(leafNode->header.flags & NODE_FREE);
+	PageId leftPageNo = leafNode->leftSibPageNo;
+	return live && bufMgr->latch(page).validate(version) ? leftPageNo : Page::INVALID_NUMBER;
+}
+
+// -----------------------------------------------------------------------------
+// Backward scans
+// -----------------------------------------------------------------------------
+
+template <class T, class Leaf, class Inner>
+bool BTreeIndex::openBackwardTyped(BTreeCursor &cursor,
+				   const void* lowValParm,
+				   const Operator lowOpParm,
+				   const void* highValParm,
+				   const Operator highOpParm)
+{
+	setScanBounds<T>(cursor, lowValParm, lowOpParm, highValParm, highOpParm);
+	const T &highVal = cursor.highVal<T>();
+	// leaf an insert of highVal would go to. Keys up to the high bound may go on into the leaves on its
+	// right, as long as their high keys are within the bound, the scan starts from the last of them
+	seekLeaf<T, Leaf, Inner>(cursor, highVal, true);
+	cursor.scanExecuting = true;
+	while (1)
+	{
+		const Leaf* currentNode = cursor.leaf<Leaf>();
+		bool further = currentNode->hasHighKey()
+				&& (highOpParm == LT ? currentNode->highKey < highVal : !(highVal < currentNode->highKey));
+		if (!further || !nextLeaf<T, Leaf, Inner>(cursor))
+		{
+			break;
+		}
+	}
+	const Leaf* currentNode = cursor.leaf<Leaf>();
+	cursor.backward = true;
+	cursor.nextEntry = (highOpParm == LT ? currentNode->lowerBound(highVal) : currentNode->upperBound(highVal)) - 1;
+	return positionBackward<T, Leaf, Inner>(cursor);
+}
+
+template <class T, class Leaf, class Inner>
+bool BTreeIndex::positionBackward(BTreeCursor &cursor)
+{
+	// current leaf used up (or empty), continue on the left sibling
+	while (cursor.nextEntry < 0)
+	{
+		if (!prevLeaf<T, Leaf, Inner>(cursor))
+		{
+			return false;
+		}
+	}
+	const T &key = cursor.leaf<Leaf>()->key(cursor.nextEntry);
+	const T &lowVal = cursor.lowVal<T>();
+	return cursor.lowOp == GT ? lowVal < key : !(key < lowVal);
+}
+
+template <class T, class Leaf, class Inner>
+bool BTreeIndex::prevLeaf(BTreeCursor &cursor)
+{
+	const Leaf* currentNode = cursor.leaf<Leaf>();
+	PageId leftPageNo = currentNode->leftSibPageNo;
+	if (leftPageNo == Page::INVALID_NUMBER)
+	{
+		return false;
+	}
+	// the copy is overwritten below, keep what is needed to find the place again: the first key of the copy
+	// and the record ids of the entries with that key, the first of them passed last. Only the root leaf is
+	// ever empty, and it has no left sibling
+	const T &highVal = cursor.highVal<T>();
+	T firstKey = currentNode->count() > 0 ? currentNode->key(0) : highVal;
+	RecordId run[Page::SIZE / sizeof(RecordId)];
+	int runLength = currentNode->count() > 0 ? currentNode->upperBound(firstKey) : 0;
+	for (int i = 0; i < runLength; i++)
+	{
+		run[i] = currentNode->rid(i);
+	}
+	PageId pageNo = cursor.currentPageNum;
+	Page *leftPage;
+	this->bufMgr->readPage(this->file, leftPageNo, leftPage);
+	std::uint32_t version = this->bufMgr->latch(leftPage).readVersion();
+	memcpy(cursor.leafCopy, (void*)leftPage, Page::SIZE);
+	currentNode = cursor.leaf<Leaf>();
+	// the left link is only a hint. The leaf found there is the one before as long as it links back to the
+	// leaf of the copy and that leaf did not change, so no entry moved between the two in the meantime
+	bool linked = this->bufMgr->latch(leftPage).validate(version) && currentNode->header.level == -1
+			&& !(currentNode->header.flags & NODE_FREE) && currentNode->rightSibPageNo == pageNo
+			&& this->bufMgr->latch(cursor.currentPageData).validate(cursor.leafVersion);
+	this->bufMgr->unPinPage(this->file, pageNo, false);
+	int end;
+	if (linked)
+	{
+		cursor.currentPageNum = leftPageNo;
+		cursor.currentPageData = leftPage;
+		cursor.leafVersion = version;
+		end = currentNode->count();
+	}
+	else
+	{
+		// go on strictly before the first passed entry still there. Entries of one key keep their order, those
+		// the cursor did not pass come before the run of the copy. If none of the run is left, the whole run of
+		// the key is returned, again for entries of it the cursor passed in leaves on the right
+		this->bufMgr->unPinPage(this->file, leftPageNo, false);
+		seekLeaf<T, Leaf, Inner>(cursor, firstKey, false);
+		end = cursor.leaf<Leaf>()->lowerBound(firstKey);
+		while (1)
+		{
+			currentNode = cursor.leaf<Leaf>();
+			if (end >= currentNode->count())
+			{
+				if (!nextLeaf<T, Leaf, Inner>(cursor))
+				{
+					break;
+				}
+				end = cursor.nextEntry;
+				continue;
+			}
+			if (firstKey < currentNode->key(end) || std::find(run, run + runLength, currentNode->rid(end)) != run + runLength)
+			{
+				break;
+			}
+			end++;
+		}
+		currentNode = cursor.leaf<Leaf>();
+	}
+	// leaves at the start of a scan can still hold keys above the high bound
+	int bound = cursor.highOp == LT ? currentNode->lowerBound(highVal) : currentNode->upperBound(highVal);
+	cursor.nextEntry = std::min(end, bound) - 1;
+	readAheadFrom<Leaf>(cursor);
+	return true;
+}
+
+template <class T, class Leaf, class Inner>
+bool BTreeIndex::scanPrevTyped(BTreeCursor &cursor, RecordId& outRid)
+{
+	if (!positionBackward<T, Leaf, Inner>(cursor))
+	{
+		return false;
+	}
+	const Leaf* currentNode = cursor.leaf<Leaf>();
+	const char *payload = currentNode->payload(cursor.nextEntry);
+	cursor.payloadPos = payload == NULL ? -1 : (int)(payload - (const char*)cursor.leafCopy);
+	outRid = currentNode->rid(cursor.nextEntry--);
+	return true;
+}
+
+template <class T, class Leaf, class Inner>
+std::size_t BTreeIndex::scanPrevBatchTyped(BTreeCursor &cursor, RecordId* outRids, std::size_t maxRids, char* outPayloads)
+{
+	std::size_t count = 0;
+	while (count < maxRids && positionBackward<T, Leaf, Inner>(cursor))
+	{
+		const Leaf* currentNode = cursor.leaf<Leaf>();
+		if (outPayloads != NULL)
+		{
+			currentNode->copyPayloads(cursor.nextEntry, 1, outPayloads + count * payloadBytes);
+		}
+		outRids[count++] = currentNode->rid(cursor.nextEntry--);
+	}
+	return count;
+}
+
+template <class T, class Leaf, class Inner>
+bool BTreeIndex::positionScan(BTreeCursor &cursor)
+{
+	const Leaf* currentNode = cursor.leaf<Leaf>();
+	// current leaf used up (or empty), continue on the right sibling
+	while (cursor.nextEntry >= currentNode->count())
+	{
+		if (!nextLeaf<T, Leaf, Inner>(cursor))
+		{
+			return false;
+		}
+		currentNode = cursor.leaf<Leaf>();
+	}
+	const T &key = currentNode->key(cursor.nextEntry);
+	const T &highVal = cursor.highVal<T>();
+	return cursor.highOp == LT ? key < highVal : !(highVal < key);
+}
+
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::scanNext
+// -----------------------------------------------------------------------------
+
+void BTreeIndex::scanNext(RecordId& outRid) 
+{
+	if (!tryScanNext(outRid))
+	{
+		throw IndexScanCompletedException();
+	}
+}
+
+bool BTreeIndex::tryScanNext(RecordId& outRid)
+{
+	return scan.next(outRid);
+}
+
+template <class T, class Leaf, class Inner>
+bool BTreeIndex::scanNextTyped(BTreeCursor &cursor, RecordId& outRid)
+{
+	if (!positionScan<T, Leaf, Inner>(cursor))
+	{
+		return false;
+	}
+	// moving on to the right sibling is left to the next call, the payload stays in the copy until then
+	const Leaf* currentNode = cursor.leaf<Leaf>();
+	const char *payload = currentNode->payload(cursor.nextEntry);
+	cursor.payloadPos = payload == NULL ? -1 : (int)(payload - (const char*)cursor.leafCopy);
+	outRid = currentNode->rid(cursor.nextEntry++);
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::range
+// -----------------------------------------------------------------------------
+
+BTreeRange BTreeIndex::range(const void* lowValParm,
+				   const Operator lowOpParm,
+				   const void* highValParm,
+				   const Operator highOpParm)
+{
+	BTreeRange range(this);
+	range.cursor.open(lowValParm, lowOpParm, highValParm, highOpParm);
+	return range;
+}
+
+BTreeRange::BTreeRange(BTreeIndex *index)
+	: cursor(index)
+{
+}
+
+BTreeRange::BTreeRange(BTreeRange &&other)
+	: cursor(std::move(other.cursor))
+{
+}
+
+BTreeRange::iterator BTreeRange::begin()
+{
+	iterator first;
+	first.range = this;
+	++first;
+	return first;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::scanNextBatch
+// -----------------------------------------------------------------------------
+
+std::size_t BTreeIndex::scanNextBatch(RecordId* outRids, std::size_t maxRids, char* outPayloads)
+{
+	return scan.nextBatch(outRids, maxRids, outPayloads);
+}
+
+template <class T, class Leaf, class Inner>
+std::size_t BTreeIndex::scanNextBatchTyped(BTreeCursor &cursor, RecordId* outRids, std::size_t maxRids, char* outPayloads)
+{
+	const T &highVal = cursor.highVal<T>();
+	const Leaf* currentNode = cursor.leaf<Leaf>();
+	std::size_t count = 0;
+	while (count < maxRids)
+	{
+		int numKeys = currentNode->count();
+		if (cursor.nextEntry >= numKeys)
+		{
+			if (!nextLeaf<T, Leaf, Inner>(cursor))
+			{
+				break;
+			}
+			currentNode = cursor.leaf<Leaf>();
+			continue;
+		}
+
+		// slice [begin, end) of the leaf within the bounds. The scan starts past the low bound
+		// and only the last leaf of a scan has keys above the high bound
+		int begin = cursor.nextEntry;
+		int end = numKeys;
+		const T &lastKey = currentNode->key(numKeys-1);
+		bool lastLeaf = cursor.highOp == LT ? !(lastKey < highVal) : highVal < lastKey;
+		if (lastLeaf)
+		{
+			end = cursor.highOp == LT ? currentNode->lowerBound(highVal) : currentNode->upperBound(highVal);
+		}
+
+		std::size_t take = begin < end ? std::min<std::size_t>(end - begin, maxRids - count) : 0;
+		currentNode->copyRids(begin, (int)take, outRids + count);
+		if (outPayloads != NULL)
+		{
+			currentNode->copyPayloads(begin, (int)take, outPayloads + count * payloadBytes);
+		}
+		count += take;
+		cursor.nextEntry = begin + (int)take;
+		if (lastLeaf)
+		{
+			// nothing right of the slice matches, the scan stays on this leaf
+			break;
+		}
+	}
+	return count;
+}
+
+template <class T, class Inner>
+bool BTreeIndex::scanNextPosting(BTreeCursor &cursor, RecordId& outRid)
+{
+	if (cursor.postingPos == cursor.postingEnd && !nextPosting<T, Inner>(cursor))
+	{
+		return false;
+	}
+	std::uint64_t delta;
+	const char *pos = cursor.postingBuffer + cursor.postingPos;
+	cursor.postingPos = (int)(PostingCodec::get(pos, delta) - cursor.postingBuffer);
+	cursor.postingValue += delta;
+	outRid = PostingCodec::recordId(cursor.postingValue);
+	return true;
+}
+
+template <class T, class Inner>
+std::size_t BTreeIndex::scanNextBatchPosting(BTreeCursor &cursor, RecordId* outRids, std::size_t maxRids, char* outPayloads)
+{
+	std::size_t count = 0;
+	while (count < maxRids)
+	{
+		if (cursor.postingPos == cursor.postingEnd && !nextPosting<T, Inner>(cursor))
+		{
+			break;
+		}
+		// every record id of the list matches, they are decoded one after another
+		const char *pos = cursor.postingBuffer + cursor.postingPos;
+		const char *end = cursor.postingBuffer + cursor.postingEnd;
+		std::uint64_t value = cursor.postingValue;
+		while (pos < end && count < maxRids)
+		{
+			std::uint64_t delta;
+			pos = PostingCodec::get(pos, delta);
+			value += delta;
+			outRids[count++] = PostingCodec::recordId(value);
+		}
+		cursor.postingPos = (int)(pos - cursor.postingBuffer);
+		cursor.postingValue = value;
+	}
+	return count;
+}
+
+template <class T, class Inner>
+bool BTreeIndex::nextPosting(BTreeCursor &cursor)
+{
+	while (1)
+	{
+		if (cursor.overflowPageNum != Page::INVALID_NUMBER)
+		{
+			// the record ids in the buffer were all returned
+			if (cursor.postingEnd > 0)
+			{
+				cursor.postingSkip = std::max(cursor.postingSkip, cursor.postingValue + 1);
+			}
+			OverflowNode* page;
+			this->bufMgr->readPage(this->file, cursor.overflowPageNum, (Page *&)page);
+			int bytes = page->bytes < OverflowNode::DATA_SIZE ? page->bytes : OverflowNode::DATA_SIZE;
+			memcpy(cursor.postingBuffer, page->data, bytes);
+			PageId nextPageNo = page->nextPageNo;
+			this->bufMgr->unPinPage(this->file, cursor.overflowPageNum, false);
+			// the chain is only changed with its leaf latched, what was read is good while the leaf is unchanged
+			if (!this->bufMgr->latch(cursor.currentPageData).validate(cursor.leafVersion))
+			{
+				resumePosting<T, Inner>(cursor);
+			}
+			else
+			{
+				cursor.postingPos = 0;
+				cursor.postingEnd = bytes;
+				cursor.postingValue = 0;
+				cursor.overflowPageNum = nextPageNo;
+			}
+		}
+		else
+		{
+			if (!positionScan<T, PostingLeafNode<T>, Inner>(cursor))
+			{
+				return false;
+			}
+			// the key is within the bounds, all of its list is returned
+			cursor.postingSkip = 0;
+			takePosting<T>(cursor, cursor.nextEntry++);
+		}
+		// record ids returned before the list had to be found again are passed over
+		while (cursor.postingPos < cursor.postingEnd)
+		{
+			std::uint64_t delta;
+			const char *next = PostingCodec::get(cursor.postingBuffer + cursor.postingPos, delta);
+			if (cursor.postingValue + delta >= cursor.postingSkip)
+			{
+				return true;
+			}
+			cursor.postingValue += delta;
+			cursor.postingPos = (int)(next - cursor.postingBuffer);
+		}
+	}
+}
+
+template <class T>
+void BTreeIndex::takePosting(BTreeCursor &cursor, int i)
+{
+	const PostingLeafNode<T>* currentNode = cursor.leaf<PostingLeafNode<T> >();
+	cursor.postingPos = 0;
+	cursor.postingEnd = 0;
+	cursor.postingValue = 0;
+	if (currentNode->isOverflow(i))
+	{
+		cursor.overflowPageNum = currentNode->overflowPageNo(i);
+		return;
+	}
+	memcpy(cursor.postingBuffer, currentNode->list(i), currentNode->listBytes(i));
+	cursor.postingEnd = currentNode->listBytes(i);
+}
+
+template <class T, class Inner>
+void BTreeIndex::resumePosting(BTreeCursor &cursor)
+{
+	// keys are unique in posting leaves and below the high key, an upper descent finds the leaf of key
+	T key = cursor.leaf<PostingLeafNode<T> >()->key(cursor.nextEntry - 1);
+	this->bufMgr->unPinPage(this->file, cursor.currentPageNum, false);
+	seekLeaf<T, PostingLeafNode<T>, Inner>(cursor, key, true);
+	const PostingLeafNode<T>* currentNode = cursor.leaf<PostingLeafNode<T> >();
+	cursor.nextEntry = currentNode->lowerBound(key);
+	cursor.overflowPageNum = Page::INVALID_NUMBER;
+	cursor.postingPos = 0;
+	cursor.postingEnd = 0;
+	if (cursor.nextEntry < currentNode->count() && !(key < currentNode->key(cursor.nextEntry)))
+	{
+		takePosting<T>(cursor, cursor.nextEntry++);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::endScan
+// -----------------------------------------------------------------------------
+//
+void BTreeIndex::endScan() 
+{
+	if(!scan.isOpen()) {
+		throw ScanNotInitializedException();
+	}
+	scan.close();
+}
+
+// -----------------------------------------------------------------------------
+// BTreeCursor
+// -----------------------------------------------------------------------------
+
+BTreeCursor::BTreeCursor(BTreeIndex *index)
+	: index(index), scanExecuting(false), backward(false), postingPos(0), postingEnd(0), postingSkip(0), overflowPageNum(Page::INVALID_NUMBER),
+		payloadPos(-1), leavesScanned(0), readAheadOwner(0)
+{
+}
+
+BTreeCursor::BTreeCursor(BTreeCursor &&other)
+	: index(other.index), scanExecuting(other.scanExecuting), backward(other.backward), nextEntry(other.nextEntry),
+		currentPageNum(other.currentPageNum), currentPageData(other.currentPageData),
+		lowValInt(other.lowValInt), lowValDouble(other.lowValDouble), lowValString(other.lowValString),
+		highValInt(other.highValInt), highValDouble(other.highValDouble), highValString(other.highValString),
+		lowOp(other.lowOp), highOp(other.highOp), postingPos(other.postingPos), postingEnd(other.postingEnd),
+		postingValue(other.postingValue), postingSkip(other.postingSkip), overflowPageNum(other.overflowPageNum),
+		leafVersion(other.leafVersion), payloadPos(other.payloadPos), leavesScanned(other.leavesScanned),
+		readAheadOwner(other.readAheadOwner)
+{
+	memcpy(postingBuffer + postingPos, other.postingBuffer + postingPos, postingEnd - postingPos);
+	if (scanExecuting)
+	{
+		memcpy(leafCopy, other.leafCopy, Page::SIZE);
+	}
+	// the pinned leaf and the read-ahead now belong to this cursor
+	other.scanExecuting = false;
+	other.readAheadOwner = 0;
+}
+
+BTreeCursor::~BTreeCursor()
+{
+	close();
+	if (readAheadOwner != 0)
+	{
+		index->readAhead->forget(readAheadOwner);
+	}
+}
+
+bool BTreeCursor::open(const void* lowValParm, const Operator lowOpParm, const void* highValParm, const Operator highOpParm)
+{
+	return (index->*index->startScanFn)(*this, lowValParm, lowOpParm, highValParm, highOpParm);
+}
+
+bool BTreeCursor::openBackward(const void* lowValParm, const Operator lowOpParm, const void* highValParm, const Operator highOpParm)
+{
+	if (index->openBackwardFn == NULL)
+	{
+		throw BadIndexInfoException("Posting lists cannot be scanned backward");
+	}
+	return (index->*index->openBackwardFn)(*this, lowValParm, lowOpParm, highValParm, highOpParm);
+}
+
+bool BTreeCursor::next(RecordId& outRid)
+{
+	if (!scanExecuting)
+	{
+		throw ScanNotInitializedException();
+	}
+	return (index->*(backward ? index->scanPrevFn : index->scanNextFn))(*this, outRid);
+}
+
+std::size_t BTreeCursor::nextBatch(RecordId* outRids, std::size_t maxRids, char* outPayloads)
+{
+	if (!scanExecuting)
+	{
+		throw ScanNotInitializedException();
+	}
+	payloadPos = -1;
+	return (index->*(backward ? index->scanPrevBatchFn : index->scanNextBatchFn))(*this, outRids, maxRids, outPayloads);
+}
+
+std::uint64_t BTreeCursor::leavesReadAhead()
+{
+	return readAheadOwner == 0 ? 0 : index->readAhead->pagesRead(readAheadOwner);
+}
+
+void BTreeCursor::close()
+{
+	payloadPos = -1;
+	if (!scanExecuting)
+	{
+		return;
+	}
+	// the leaves read ahead stay in the pool, the one being read is unpinned before the index can go away
+	if (readAheadOwner != 0)
+	{
+		index->readAhead->cancel(readAheadOwner);
+	}
+	// release the leaf the scan was positioned on
+	index->bufMgr->unPinPage(index->file, currentPageNum, false);
+	scanExecuting = false;
+}
+
+template <class T>
+void BTreeIndex::insertIntoLeaf(LeafNode<T> *leafNode, const T &key, const RecordId rid, const char *payload)
+{
+	leafNode->insert(leafNode->upperBound(key), key, rid);
+}
+
+template <class T, class Leaf>
+bool BTreeIndex::removeFromLeaf(Leaf *leafNode, const T &key, const RecordId rid)
+{
+	int numKeys = leafNode->count();
+	for(int i=leafNode->lowerBound(key);i<numKeys && !(key<leafNode->key(i));i++){
+		if(leafNode->rid(i) == rid){
+			leafNode->remove(i);
+			return true;
+		}
+	}
+	return false;
+}
+
+template <class T>
+void BTreeIndex::giveBackLast(LeafNode<T> *leafNode, std::deque<RIDKeyPair<T> > &pending)
+{
+	int last = leafNode->count() - 1;
+	RIDKeyPair<T> moved;
+	moved.set(leafNode->rid(last), leafNode->key(last));
+	pending.push_front(moved);
+	leafNode->remove(last);
+}
+
+// -----------------------------------------------------------------------------
+// Included attributes
+// -----------------------------------------------------------------------------
+
+template <class Leaf>
+void BTreeIndex::initLeaf(Leaf *leafNode)
+{
+	leafNode->init();
+}
+
+template <class T>
+void BTreeIndex::initLeaf(CoveringLeafNode<T> *leafNode)
+{
+	leafNode->init(payloadBytes);
+}
+
+const char* BTreeIndex::gatherPayload(const char *record, char *out)
+{
+	if (payloadBytes == 0)
+	{
+		return NULL;
+	}
+	if (record == NULL)
+	{
+		throw BadIndexInfoException("Index includes attributes, the record of the entry is needed");
+	}
+	int pos = 0;
+	for (int i = 0; i < metaInfo.includedColumns; i++)
+	{
+		memcpy(out + pos, record + metaInfo.included[i].offset, metaInfo.included[i].length);
+		pos += metaInfo.included[i].length;
+	}
+	return out;
+}
+
+template <class T>
+void BTreeIndex::includeColumns(RIDKeyPair<T> &entry, const char *record)
+{
+}
+
+template <class T>
+void BTreeIndex::includeColumns(CoveredEntry<T> &entry, const char *record)
+{
+	gatherPayload(record, entry.columns);
+}
+
+template <class T>
+void BTreeIndex::insertIntoLeaf(CoveringLeafNode<T> *leafNode, const T &key, const RecordId rid, const char *payload)
+{
+	leafNode->insert(leafNode->upperBound(key), key, rid, payload);
+}
+
+template <class T>
+void BTreeIndex::giveBackLast(CoveringLeafNode<T> *leafNode, std::deque<CoveredEntry<T> > &pending)
+{
+	int last = leafNode->count() - 1;
+	CoveredEntry<T> moved;
+	moved.set(leafNode->rid(last), leafNode->key(last));
+	memcpy(moved.columns, leafNode->payload(last), payloadBytes);
+	pending.push_front(moved);
+	leafNode->remove(last);
+}
+
+// -----------------------------------------------------------------------------
+// Posting lists
+// -----------------------------------------------------------------------------
+
+template <class T>
+void BTreeIndex::insertIntoLeaf(PostingLeafNode<T> *leafNode, const T &key, const RecordId rid, const char *payload)
+{
+	int i = leafNode->find(key);
+	if (i < 0)
+	{
+		leafNode->insert(leafNode->upperBound(key), key, rid);
+		return;
+	}
+	if (leafNode->isOverflow(i))
+	{
+		insertIntoOverflow(leafNode->overflowPageNo(i), PostingCodec::value(rid));
+		leafNode->setOverflow(i, leafNode->overflowPageNo(i), leafNode->overflowCount(i) + 1);
+		return;
+	}
+	if (leafNode->insertRid(i, rid))
+	{
+		return;
+	}
+	// the list got too long for the leaf, it moves to overflow pages
+	std::uint64_t values[PostingLeafNode<T>::MAX_LIST_BYTES + 1];
+	int n = leafNode->values(i, values);
+	std::uint64_t value = PostingCodec::value(rid);
+	std::uint64_t *pos = std::upper_bound(values, values + n, value);
+	memmove(pos + 1, pos, (values + n - pos) * sizeof(std::uint64_t));
+	*pos = value;
+	leafNode->setOverflow(i, writeOverflow(values, n + 1), n + 1);
+}
+
+template <class T>
+bool BTreeIndex::removeFromLeaf(PostingLeafNode<T> *leafNode, const T &key, const RecordId rid)
+{
+	int i = leafNode->find(key);
+	if (i < 0)
+	{
+		return false;
+	}
+	if (!leafNode->isOverflow(i))
+	{
+		return leafNode->removeRid(i, rid);
+	}
+	PageId firstPageNo = leafNode->overflowPageNo(i);
+	if (!removeFromOverflow(firstPageNo, PostingCodec::value(rid)))
+	{
+		return false;
+	}
+	if (firstPageNo == Page::INVALID_NUMBER)
+	{
+		leafNode->remove(i);
+	}
+	else
+	{
+		leafNode->setOverflow(i, firstPageNo, leafNode->overflowCount(i) - 1);
+	}
+	return true;
+}
+
+template <class T>
+void BTreeIndex::giveBackLast(PostingLeafNode<T> *leafNode, std::deque<RIDKeyPair<T> > &pending)
+{
+	// only lists kept in the leaf take up room in it, so bulk loading never gives back an overflow list
+	int last = leafNode->count() - 1;
+	std::uint64_t values[PostingLeafNode<T>::MAX_LIST_BYTES];
+	int n = leafNode->values(last, values);
+	for (int j = n - 1; j >= 0; j--)
+	{
+		RIDKeyPair<T> moved;
+		moved.set(PostingCodec::recordId(values[j]), leafNode->key(last));
+		pending.push_front(moved);
+	}
+	leafNode->remove(last);
+}
+
+/**
+ * Number of values from the start of values, at most n, that fit in an overflow page.
+ */
+static int overflowFit(const std::uint64_t *values, int n)
+{
+	int bytes = 0;
+	std::uint64_t last = 0;
+	for (int i = 0; i < n; i++)
+	{
+		bytes += PostingCodec::length(values[i] - last);
+		if (bytes > OverflowNode::DATA_SIZE)
+		{
+			return i;
+		}
+		last = values[i];
+	}
+	return n;
+}
+
+PageId BTreeIndex::writeOverflow(const std::uint64_t *values, int n)
+{
+	PageId firstPageNo;
+	OverflowNode* first;
+	int take = overflowFit(values, n);
+	allocNode(firstPageNo, (Page *&)first);
+	first->init(values, take);
+	PageId pageNo = firstPageNo;
+	OverflowNode* page = first;
+	for (int i = take; i < n; i += take)
+	{
+		take = overflowFit(values + i, n - i);
+		PageId nextPageNo;
+		OverflowNode* next;
+		allocNode(nextPageNo, (Page *&)next);
+		next->init(values + i, take);
+		page->nextPageNo = nextPageNo;
+		if (page != first)
+		{
+			bufMgr->unPinPage(file, pageNo, true);
+		}
+		pageNo = nextPageNo;
+		page = next;
+	}
+	first->tailPageNo = pageNo;
+	if (page != first)
+	{
+		bufMgr->unPinPage(file, pageNo, true);
+	}
+	bufMgr->unPinPage(file, firstPageNo, true);
+	return firstPageNo;
+}
+
+void BTreeIndex::insertIntoOverflow(PageId firstPageNo, std::uint64_t value)
+{
+	OverflowNode* first;
+	bufMgr->readPage(file, firstPageNo, (Page *&)first);
+	// record ids mostly come in order and go after the last page
+	PageId pageNo = first->tailPageNo;
+	OverflowNode* page = first;
+	if (pageNo != firstPageNo)
+	{
+		bufMgr->readPage(file, pageNo, (Page *&)page);
+	}
+	if (value < page->lastValue)
+	{
+		// the first page whose last record id is not below value, the last page at the latest
+		if (page != first)
+		{
+			bufMgr->unPinPage(file, pageNo, false);
+		}
+		pageNo = firstPageNo;
+		page = first;
+		while (page->lastValue < value)
+		{
+			PageId nextPageNo = page->nextPageNo;
+			if (page != first)
+			{
+				bufMgr->unPinPage(file, pageNo, false);
+			}
+			pageNo = nextPageNo;
+			bufMgr->readPage(file, pageNo, (Page *&)page);
+		}
+	}
+	else if (page->bytes + PostingCodec::length(value - page->lastValue) <= OverflowNode::DATA_SIZE)
+	{
+		// appended without decoding the page
+		page->bytes += PostingCodec::put(page->data + page->bytes, value - page->lastValue);
+		page->lastValue = value;
+		page->header.numKeys++;
+		if (page != first)
+		{
+			bufMgr->unPinPage(file, pageNo, true);
+		}
+		bufMgr->unPinPage(file, firstPageNo, page == first);
+		return;
+	}
+
+	std::vector<std::uint64_t> values(page->header.numKeys + 1);
+	int n = PostingCodec::decode(page->data, page->bytes, &values[0]);
+	int pos = (int)(std::upper_bound(values.begin(), values.begin() + n, value) - values.begin());
+	values.insert(values.begin() + pos, value);
+	n++;
+	if (overflowFit(&values[0], n) < n)
+	{
+		// split the page, its upper half moves to a new page after it. A record id past the end
+		// of the list starts a new last page on its own, so appends leave full pages behind
+		int half = pos == n - 1 ? n - 1 : n / 2;
+		PageId newPageNo;
+		OverflowNode* newPage;
+		allocNode(newPageNo, (Page *&)newPage);
+		newPage->init(&values[half], n - half);
+		newPage->nextPageNo = page->nextPageNo;
+		page->nextPageNo = newPageNo;
+		if (first->tailPageNo == pageNo)
+		{
+			first->tailPageNo = newPageNo;
+		}
+		bufMgr->unPinPage(file, newPageNo, true);
+		n = half;
+	}
+	page->set(&values[0], n);
+	if (page != first)
+	{
+		bufMgr->unPinPage(file, pageNo, true);
+	}
+	bufMgr->unPinPage(file, firstPageNo, true);
+}
+
+bool BTreeIndex::removeFromOverflow(PageId &firstPageNo, std::uint64_t value)
+{
+	OverflowNode* first;
+	bufMgr->readPage(file, firstPageNo, (Page *&)first);
+	// the first page whose last record id is not below value, and the page before it
+	PageId pageNo = firstPageNo;
+	OverflowNode* page = first;
+	PageId prevPageNo = Page::INVALID_NUMBER;
+	OverflowNode* prev = NULL;
+	while (page->lastValue < value && page->nextPageNo != Page::INVALID_NUMBER)
+	{
+		if (prev != NULL && prev != first)
+		{
+			bufMgr->unPinPage(file, prevPageNo, false);
+		}
+		prevPageNo = pageNo;
+		prev = page;
+		pageNo = page->nextPageNo;
+		bufMgr->readPage(file, pageNo, (Page *&)page);
+	}
+
+	std::vector<std::uint64_t> values(page->header.numKeys);
+	int n = PostingCodec::decode(page->data, page->bytes, &values[0]);
+	int pos = (int)(std::lower_bound(values.begin(), values.begin() + n, value) - values.begin());
+	bool found = pos < n && values[pos] == value;
+	if (found && n > 1)
+	{
+		values.erase(values.begin() + pos);
+		page->set(&values[0], n - 1);
+	}
+	else if (found)
+	{
+		// the page is emptied and leaves the chain
+		if (page == first)
+		{
+			firstPageNo = first->nextPageNo;
+			if (firstPageNo != Page::INVALID_NUMBER)
+			{
+				OverflowNode* newFirst;
+				bufMgr->readPage(file, firstPageNo, (Page *&)newFirst);
+				newFirst->tailPageNo = first->tailPageNo;
+				bufMgr->unPinPage(file, firstPageNo, true);
+			}
+			freeNode(pageNo, (Page*)page);
+			return true;
+		}
+		prev->nextPageNo = page->nextPageNo;
+		if (first->tailPageNo == pageNo)
+		{
+			first->tailPageNo = prevPageNo;
+		}
+		freeNode(pageNo, (Page*)page);
+		page = first;
+	}
+	if (page != first)
+	{
+		bufMgr->unPinPage(file, pageNo, found);
+	}
+	if (prev != NULL && prev != first)
+	{
+		bufMgr->unPinPage(file, prevPageNo, found);
+	}
+	bufMgr->unPinPage(file, firstPageNo, found);
+	return found;
+}
+
+template <class T, class Leaf>
+PageKeyPair<T> BTreeIndex::splitLeaf(Leaf *leafNode,PageId pageNo,int splitIndex,Leaf *&newLeafNode,const KeyFences<T> &fences){
+	PageId newPageId;
+	allocNode(newPageId, (Page *&)newLeafNode);
+	initLeaf(newLeafNode);
+	leafNode->moveTail(splitIndex,newLeafNode);
+
+	//set the sibling, the leaf on the right links back to the new one
+	newLeafNode->rightSibPageNo=leafNode->rightSibPageNo;
+	newLeafNode->leftSibPageNo=pageNo;
+	leafNode->rightSibPageNo=newPageId;
+	linkLeft<Leaf>(newLeafNode->rightSibPageNo,newPageId);
+
+	//copy up, the keys themselves stay in the leaves
+	PageKeyPair<T> pushUp;
+	pushUp.set(newPageId,KeyTraits<T>::separator(leafNode->key(leafNode->count()-1),newLeafNode->key(0)));
+
+	//the new leaf takes over the high key, readers that reach the old leaf with a key past the separator
+	//go right until the parent has it
+	newLeafNode->setHighKey(leafNode->hasHighKey() ? &leafNode->highKey : NULL);
+	leafNode->setHighKey(&pushUp.key);
+
+	//the old leaf was bounded by the fences of the descent, the separator copied up now lies between them
+	leafNode->narrow(fences.lowFence(),&pushUp.key);
+	newLeafNode->narrow(&pushUp.key,fences.highFence());
+	return pushUp;
+}
+
+template <class Leaf>
+void BTreeIndex::linkLeft(PageId pageNo,PageId leftPageNo){
+	if(pageNo==Page::INVALID_NUMBER){
+		return;
+	}
+	Page *page;
+	bufMgr->readPage(file,pageNo,page);
+	bufMgr->latch(page).lock();
+	((Leaf*)page)->leftSibPageNo=leftPageNo;
+	releaseNode(pageNo,page,true);
+}
+
+template <class T, class Inner>
+PageKeyPair<T> BTreeIndex::splitNonLeaf(Inner *nonLeafNode,int splitIndex,Inner *&newNonLeafNode){
+	PageId newPageId;
+	allocNode(newPageId, (Page *&)newNonLeafNode);
+	__atomic_store_n(&upperLevelsStale, true, __ATOMIC_RELAXED);
+	//two nonleafode will be in the same level after split
+	newNonLeafNode->init(nonLeafNode->header.level);
+	//push up, key at splitIndex moves to the parent and its right child
+	//becomes the leftmost child of the new node
+	PageKeyPair<T> pushUp;
+	pushUp.set(newPageId,nonLeafNode->key(splitIndex));
+	nonLeafNode->moveTail(splitIndex,newNonLeafNode);
+	//the new node goes in between the node and its right sibling, like a leaf
+	newNonLeafNode->rightSibPageNo=nonLeafNode->rightSibPageNo;
+	nonLeafNode->rightSibPageNo=newPageId;
+	newNonLeafNode->setHighKey(nonLeafNode->hasHighKey() ? &nonLeafNode->highKey : NULL);
+	nonLeafNode->setHighKey(&pushUp.key);
+	return pushUp;
+}
+
+// -----------------------------------------------------------------------------
+// LeafNode<StringKey>
+// -----------------------------------------------------------------------------
+
+/**
+ * strcmp order of two byte strings that are not NUL terminated.
+ */
+static int compareBytes(const char *a, int aLength, const char *b, int bLength)
+{
+	int c = memcmp(a, b, aLength < bLength ? aLength : bLength);
+	return c != 0 ? c : aLength - bLength;
+}
+
+void LeafNode<StringKey>::init()
+{
+	memset((void*)this, 0, Page::SIZE);
+	header.level = -1;
+	header.version = NODE_FORMAT_VERSION;
+	header.flags = NODE_LEAF;
+	rightSibPageNo = Page::INVALID_NUMBER;
+	leftSibPageNo = Page::INVALID_NUMBER;
+	heapOffset = DATA_SIZE;
+}
+
+void LeafNode<StringKey>::setHighKey(const StringKey *key)
+{
+	if (key == NULL)
+	{
+		header.flags &= ~NODE_HIGH_KEY;
+		return;
+	}
+	highKey = *key;
+	header.flags |= NODE_HIGH_KEY;
+}
+
+bool LeafNode<StringKey>::isPastHighKey(const StringKey &key, bool upper) const
+{
+	return hasHighKey() && (upper ? !(key < highKey) : highKey < key);
+}
+
+StringKey LeafNode<StringKey>::key(int i) const
+{
+	const Slot &slot = slots()[i];
+	StringKey key;
+	memcpy(key.data, prefix, prefixLength);
+	memcpy(key.data + prefixLength, data + slot.offset, slot.length);
+	memset(key.data + prefixLength + slot.length, 0, STRINGSIZE - prefixLength - slot.length);
+	return key;
+}
+
+int LeafNode<StringKey>::search(const StringKey &key, bool upper) const
+{
+	// a key that does not start with the prefix sorts before or after every entry.
+	// A key shorter than the prefix compares its zero padding against prefix bytes, so it sorts before
+	int c = memcmp(key.data, prefix, prefixLength);
+	if (c != 0)
+	{
+		return c < 0 ? 0 : header.numKeys;
+	}
+	const char *suffix = key.data + prefixLength;
+	int suffixLength = KeyTraits<StringKey>::length(key) - prefixLength;
+	const Slot *slot = slots();
+	int low = 0;
+	int high = header.numKeys;
+	while (low < high)
+	{
+		int mid = (low + high) / 2;
+		int cmp = compareBytes(data + slot[mid].offset, slot[mid].length, suffix, suffixLength);
+		if (cmp < 0 || (upper && cmp == 0))
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+int LeafNode<StringKey>::lowerBound(const StringKey &key) const
+{
+	return search(key, false);
+}
+
+int LeafNode<StringKey>::upperBound(const StringKey &key) const
+{
+	return search(key, true);
+}
+
+bool LeafNode<StringKey>::hasRoom(const StringKey &key, double fillFactor) const
+{
+	if (header.numKeys == 0)
+	{
+		return true;
+	}
+	int keyLength = KeyTraits<StringKey>::length(key);
+	int shared = KeyTraits<StringKey>::commonPrefix(prefix, prefixLength, key.data, keyLength);
+	int needed = usedBytesWithPrefix(shared) + SLOT_SIZE + keyLength - shared;
+	return needed <= (int)(DATA_SIZE * fillFactor);
+}
+
+void LeafNode<StringKey>::insert(int i, const StringKey &key, const RecordId &rid)
+{
+	int keyLength = KeyTraits<StringKey>::length(key);
+	int shared = KeyTraits<StringKey>::commonPrefix(prefix, prefixLength, key.data, keyLength);
+	if (shared < prefixLength)
+	{
+		// only while bulk loading fills a leaf, or in an empty leaf, see the prefix invariant
+		rebuild(prefix, shared);
+	}
+	int length = keyLength - prefixLength;
+	if (heapOffset - length < (header.numKeys + 1) * SLOT_SIZE)
+	{
+		rebuild(prefix, prefixLength);
+	}
+	put(i, key.data + prefixLength, length, rid);
+}
+
+void LeafNode<StringKey>::put(int i, const char *suffix, int length, const RecordId &rid)
+{
+	heapOffset -= length;
+	memcpy(data + heapOffset, suffix, length);
+	heapBytes += length;
+	Slot *slot = slots();
+	memmove(slot + i + 1, slot + i, (header.numKeys - i) * SLOT_SIZE);
+	slot[i].rid = rid;
+	slot[i].offset = heapOffset;
+	slot[i].length = length;
+	header.numKeys++;
+}
+
+void LeafNode<StringKey>::remove(int i)
+{
+	Slot *slot = slots();
+	heapBytes -= slot[i].length;
+	memmove(slot + i, slot + i + 1, (header.numKeys - i - 1) * SLOT_SIZE);
+	header.numKeys--;
+	if (header.numKeys == 0)
+	{
+		heapOffset = DATA_SIZE;
+	}
+}
+
+void LeafNode<StringKey>::rebuild(const char *newPrefix, int newPrefixLength)
+{
+	LeafNode<StringKey> old;
+	memcpy((void*)&old, this, Page::SIZE);
+	memmove(prefix, newPrefix, newPrefixLength);
+	prefixLength = newPrefixLength;
+	heapOffset = DATA_SIZE;
+	heapBytes = 0;
+	header.numKeys = 0;
+	for (int i = 0; i < old.header.numKeys; i++)
+	{
+		StringKey key = old.key(i);
+		put(i, key.data + prefixLength, KeyTraits<StringKey>::length(key) - prefixLength, old.rid(i));
+	}
+}
+
+int LeafNode<StringKey>::splitIndex() const
+{
+	// first entry past half of the bytes used, both halves keep at least one entry
+	int half = usedBytes() / 2;
+	int used = 0;
+	int i = 0;
+	while (i < header.numKeys - 1 && used < half)
+	{
+		used += SLOT_SIZE + slots()[i].length;
+		i++;
+	}
+	return i < 1 ? 1 : i;
+}
+
+void LeafNode<StringKey>::moveTail(int from, LeafNode *dest)
+{
+	if (dest->header.numKeys == 0)
+	{
+		// dest covers part of the range of this leaf, so the prefix holds for it too
+		memcpy(dest->prefix, prefix, prefixLength);
+		dest->prefixLength = prefixLength;
+	}
+	for (int i = from; i < header.numKeys; i++)
+	{
+		dest->insert(dest->header.numKeys, key(i), rid(i));
+		heapBytes -= slots()[i].length;
+	}
+	header.numKeys = from;
+}
+
+bool LeafNode<StringKey>::isUnderfull() const
+{
+	return usedBytes() < DATA_SIZE / 2;
+}
+
+bool LeafNode<StringKey>::canLend() const
+{
+	return header.numKeys > 1 && usedBytes() > DATA_SIZE / 2;
+}
+
+bool LeafNode<StringKey>::absorb(LeafNode *right)
+{
+	// the merged leaf spans both ranges, it keeps what the two prefixes have in common
+	int shared = KeyTraits<StringKey>::commonPrefix(prefix, prefixLength, right->prefix, right->prefixLength);
+	if (usedBytesWithPrefix(shared) + right->usedBytesWithPrefix(shared) > DATA_SIZE)
+	{
+		return false;
+	}
+	if (shared < prefixLength)
+	{
+		rebuild(prefix, shared);
+	}
+	right->moveTail(0, this);
+	return true;
+}
+
+bool LeafNode<StringKey>::borrowFirst(LeafNode *right, const StringKey &separator)
+{
+	// the high bound of this leaf moves out to separator
+	int shared = KeyTraits<StringKey>::commonPrefix(prefix, prefixLength, separator.data, KeyTraits<StringKey>::length(separator));
+	StringKey moved = right->key(0);
+	if (usedBytesWithPrefix(shared) + SLOT_SIZE + KeyTraits<StringKey>::length(moved) - shared > DATA_SIZE)
+	{
+		return false;
+	}
+	if (shared < prefixLength)
+	{
+		rebuild(prefix, shared);
+	}
+	insert(header.numKeys, moved, right->rid(0));
+	right->remove(0);
+	return true;
+}
+
+bool LeafNode<StringKey>::borrowLast(LeafNode *left, const StringKey &separator)
+{
+	// the low bound of this leaf moves out to separator
+	int shared = KeyTraits<StringKey>::commonPrefix(prefix, prefixLength, separator.data, KeyTraits<StringKey>::length(separator));
+	int last = left->header.numKeys - 1;
+	StringKey moved = left->key(last);
+	if (usedBytesWithPrefix(shared) + SLOT_SIZE + KeyTraits<StringKey>::length(moved) - shared > DATA_SIZE)
+	{
+		return false;
+	}
+	if (shared < prefixLength)
+	{
+		rebuild(prefix, shared);
+	}
+	insert(0, moved, left->rid(last));
+	left->remove(last);
+	return true;
+}
+
+void LeafNode<StringKey>::narrow(const StringKey *low, const StringKey *high)
+{
+	if (low == NULL || high == NULL)
+	{
+		return;
+	}
+	int shared = KeyTraits<StringKey>::commonPrefix(low->data, KeyTraits<StringKey>::length(*low),
+			high->data, KeyTraits<StringKey>::length(*high));
+	if (shared > prefixLength)
+	{
+		rebuild(low->data, shared);
+	}
+}
+
+bool LeafNode<StringKey>::widen(const StringKey *fence)
+{
+	int shared = fence == NULL ? 0
+			: KeyTraits<StringKey>::commonPrefix(prefix, prefixLength, fence->data, KeyTraits<StringKey>::length(*fence));
+	if (shared == prefixLength)
+	{
+		return true;
+	}
+	if (usedBytesWithPrefix(shared) > DATA_SIZE)
+	{
+		return false;
+	}
+	rebuild(prefix, shared);
+	return true;
+}
+
+void LeafNode<StringKey>::copyRids(int begin, int n, RecordId *out) const
+{
+	const Slot *slot = slots() + begin;
+	for (int i = 0; i < n; i++)
+	{
+		out[i] = slot[i].rid;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// NonLeafNode<StringKey>
+// -----------------------------------------------------------------------------
+
+template <class Child>
+void NonLeafNode<StringKey, Child>::init(int level)
+{
+	memset((void*)this, 0, Page::SIZE);
+	header.level = level;
+	header.version = NODE_FORMAT_VERSION;
+	heapOffset = DATA_SIZE;
+}
+
+template <class Child>
+void NonLeafNode<StringKey, Child>::setHighKey(const StringKey *key)
+{
+	if (key == NULL)
+	{
+		header.flags &= ~NODE_HIGH_KEY;
+		return;
+	}
+	highKey = *key;
+	header.flags |= NODE_HIGH_KEY;
+}
+
+template <class Child>
+bool NonLeafNode<StringKey, Child>::isPastHighKey(const StringKey &key, bool upper) const
+{
+	return hasHighKey() && (upper ? !(key < highKey) : highKey < key);
+}
+
+template <class Child>
+StringKey NonLeafNode<StringKey, Child>::key(int i) const
+{
+	const Slot &slot = slots()[i];
+	StringKey key;
+	memcpy(key.data, data + slot.offset, slot.length);
+	memset(key.data + slot.length, 0, STRINGSIZE - slot.length);
+	return key;
+}
+
+template <class Child>
+int NonLeafNode<StringKey, Child>::search(const StringKey &key, bool upper) const
+{
+	int keyLength = KeyTraits<StringKey>::length(key);
+	const Slot *slot = slots();
+	int low = 0;
+	int high = header.numKeys;
+	while (low < high)
+	{
+		int mid = (low + high) / 2;
+		int cmp = compareBytes(data + slot[mid].offset, slot[mid].length, key.data, keyLength);
+		if (cmp < 0 || (upper && cmp == 0))
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+template <class Child>
+int NonLeafNode<StringKey, Child>::lowerBound(const StringKey &key) const
+{
+	return search(key, false);
+}
+
+template <class Child>
+int NonLeafNode<StringKey, Child>::upperBound(const StringKey &key) const
+{
+	return search(key, true);
+}
+
+template <class Child>
+bool NonLeafNode<StringKey, Child>::hasRoom(const StringKey &key, double fillFactor) const
+{
+	if (header.numKeys == 0)
+	{
+		return true;
+	}
+	return usedBytes() + SLOT_SIZE + KeyTraits<StringKey>::length(key) <= (int)(DATA_SIZE * fillFactor);
+}
+
+template <class Child>
+void NonLeafNode<StringKey, Child>::insert(int keyIndex, const StringKey &key, PageId rightChild, std::uint32_t count)
+{
+	int length = KeyTraits<StringKey>::length(key);
+	if (heapOffset - length < (header.numKeys + 1) * SLOT_SIZE)
+	{
+		compact();
+	}
+	heapOffset -= length;
+	memcpy(data + heapOffset, key.data, length);
+	heapBytes += length;
+	Slot *slot = slots();
+	memmove(slot + keyIndex + 1, slot + keyIndex, (header.numKeys - keyIndex) * SLOT_SIZE);
+	slot[keyIndex].offset = heapOffset;
+	slot[keyIndex].length = length;
+	slot[keyIndex].child.pageNo = rightChild;
+	slot[keyIndex].child.setCount(count);
+	header.numKeys++;
+}
+
+template <class Child>
+void NonLeafNode<StringKey, Child>::insertFront(const StringKey &key, PageId leftChild, std::uint32_t count)
+{
+	insert(0, key, firstChild.pageNo, firstChild.count());
+	firstChild.pageNo = leftChild;
+	firstChild.setCount(count);
+}
+
+template <class Child>
+void NonLeafNode<StringKey, Child>::remove(int keyIndex)
+{
+	Slot *slot = slots();
+	heapBytes -= slot[keyIndex].length;
+	memmove(slot + keyIndex, slot + keyIndex + 1, (header.numKeys - keyIndex - 1) * SLOT_SIZE);
+	header.numKeys--;
+}
+
+template <class Child>
+void NonLeafNode<StringKey, Child>::removeFront()
+{
+	firstChild = slots()[0].child;
+	remove(0);
+}
+
+template <class Child>
+void NonLeafNode<StringKey, Child>::compact()
+{
+	NonLeafNode old;
+	memcpy((void*)&old, this, Page::SIZE);
+	heapOffset = DATA_SIZE;
+	Slot *slot = slots();
+	for (int i = 0; i < header.numKeys; i++)
+	{
+		heapOffset -= slot[i].length;
+		memcpy(data + heapOffset, old.data + slot[i].offset, slot[i].length);
+		slot[i].offset = heapOffset;
+	}
+}
+
+template <class Child>
+int NonLeafNode<StringKey, Child>::splitIndex() const
+{
+	// key past half of the bytes used, both sides keep at least one key
+	int half = usedBytes() / 2;
+	int used = 0;
+	int i = 0;
+	while (i < header.numKeys - 2 && used < half)
+	{
+		used += SLOT_SIZE + slots()[i].length;
+		i++;
+	}
+	return i < 1 ? 1 : i;
+}
+
+template <class Child>
+void NonLeafNode<StringKey, Child>::moveTail(int splitIndex, NonLeafNode *dest)
+{
+	dest->firstChild = slots()[splitIndex].child;
+	for (int i = splitIndex + 1; i < header.numKeys; i++)
+	{
+		dest->insert(dest->header.numKeys, key(i), child(i + 1), childCount(i + 1));
+	}
+	for (int i = splitIndex; i < header.numKeys; i++)
+	{
+		heapBytes -= slots()[i].length;
+	}
+	header.numKeys = splitIndex;
+}
+
+template <class Child>
+bool NonLeafNode<StringKey, Child>::isUnderfull() const
+{
+	return usedBytes() < DATA_SIZE / 2;
+}
+
+template <class Child>
+bool NonLeafNode<StringKey, Child>::canLend() const
+{
+	return header.numKeys > 1 && usedBytes() > DATA_SIZE / 2;
+}
+
+template <class Child>
+bool NonLeafNode<StringKey, Child>::absorb(const StringKey &separator, const NonLeafNode *right)
+{
+	if (usedBytes() + SLOT_SIZE + KeyTraits<StringKey>::length(separator) + right->usedBytes() > DATA_SIZE)
+	{
+		return false;
+	}
+	insert(header.numKeys, separator, right->child(0), right->childCount(0));
+	for (int i = 0; i < right->header.numKeys; i++)
+	{
+		insert(header.numKeys, right->key(i), right->child(i + 1), right->childCount(i + 1));
+	}
+	return true;
+}
+
+template <class Child>
+bool NonLeafNode<StringKey, Child>::canReplaceKey(int i, const StringKey &key) const
+{
+	return usedBytes() - slots()[i].length + KeyTraits<StringKey>::length(key) <= DATA_SIZE;
+}
+
+template <class Child>
+void NonLeafNode<StringKey, Child>::replaceKey(int i, const StringKey &key)
+{
+	Child old = slots()[i].child;
+	remove(i);
+	insert(i, key, old.pageNo, old.count());
+}
+
+// -----------------------------------------------------------------------------
+// PostingLeafNode
+// -----------------------------------------------------------------------------
+
+template <class T>
+void PostingLeafNode<T>::init()
+{
+	memset((void*)this, 0, Page::SIZE);
+	header.level = -1;
+	header.version = NODE_FORMAT_VERSION;
+	header.flags = NODE_LEAF | NODE_POSTING;
+	rightSibPageNo = Page::INVALID_NUMBER;
+	leftSibPageNo = Page::INVALID_NUMBER;
+	heapOffset = DATA_SIZE;
+}
+
+template <class T>
+void PostingLeafNode<T>::setHighKey(const T *key)
+{
+	if (key == NULL)
+	{
+		header.flags &= ~NODE_HIGH_KEY;
+		return;
+	}
+	highKey = *key;
+	header.flags |= NODE_HIGH_KEY;
+}
+
+template <class T>
+bool PostingLeafNode<T>::isPastHighKey(const T &key, bool upper) const
+{
+	return hasHighKey() && (upper ? !(key < highKey) : highKey < key);
+}
+
+template <class T>
+int PostingLeafNode<T>::search(const T &key, bool upper) const
+{
+	const Slot *slot = slots();
+	int low = 0;
+	int high = header.numKeys;
+	while (low < high)
+	{
+		int mid = (low + high) / 2;
+		if (slot[mid].key < key || (upper && !(key < slot[mid].key)))
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+template <class T>
+int PostingLeafNode<T>::lowerBound(const T &key) const
+{
+	return search(key, false);
+}
+
+template <class T>
+int PostingLeafNode<T>::upperBound(const T &key) const
+{
+	return search(key, true);
+}
+
+template <class T>
+int PostingLeafNode<T>::find(const T &key) const
+{
+	int i = search(key, false);
+	return i < header.numKeys && !(key < slots()[i].key) ? i : -1;
+}
+
+template <class T>
+bool PostingLeafNode<T>::hasRoom(const T &key, double fillFactor) const
+{
+	int i = find(key);
+	if (i >= 0)
+	{
+		// a record id adds at most MAX_BYTES to a list, a list that gets too long leaves the page
+		return isOverflow(i) || usedBytes() + PostingCodec::MAX_BYTES <= DATA_SIZE;
+	}
+	if (header.numKeys == 0)
+	{
+		return true;
+	}
+	return usedBytes() + SLOT_SIZE + PostingCodec::MAX_BYTES <= (int)(DATA_SIZE * fillFactor);
+}
+
+template <class T>
+void PostingLeafNode<T>::insert(int i, const T &key, const RecordId &rid)
+{
+	char list[PostingCodec::MAX_BYTES];
+	put(i, key, list, PostingCodec::put(list, PostingCodec::value(rid)));
+}
+
+template <class T>
+int PostingLeafNode<T>::values(int i, std::uint64_t *values) const
+{
+	return PostingCodec::decode(list(i), listBytes(i), values);
+}
+
+template <class T>
+bool PostingLeafNode<T>::insertRid(int i, const RecordId &rid)
+{
+	std::uint64_t values[MAX_LIST_BYTES + 1];
+	int n = this->values(i, values);
+	std::uint64_t value = PostingCodec::value(rid);
+	std::uint64_t *pos = std::upper_bound(values, values + n, value);
+	memmove(pos + 1, pos, (values + n - pos) * sizeof(std::uint64_t));
+	*pos = value;
+	char list[MAX_LIST_BYTES + PostingCodec::MAX_BYTES];
+	int length = PostingCodec::encode(values, n + 1, list);
+	if (length > MAX_LIST_BYTES)
+	{
+		return false;
+	}
+	setList(i, list, length);
+	return true;
+}
+
+template <class T>
+bool PostingLeafNode<T>::removeRid(int i, const RecordId &rid)
+{
+	std::uint64_t values[MAX_LIST_BYTES];
+	int n = this->values(i, values);
+	std::uint64_t value = PostingCodec::value(rid);
+	std::uint64_t *pos = std::lower_bound(values, values + n, value);
+	if (pos == values + n || *pos != value)
+	{
+		return false;
+	}
+	if (n == 1)
+	{
+		remove(i);
+		return true;
+	}
+	// the list gets no longer, the difference that replaces two is never longer than the two were
+	memmove(pos, pos + 1, (values + n - pos - 1) * sizeof(std::uint64_t));
+	char list[MAX_LIST_BYTES];
+	setList(i, list, PostingCodec::encode(values, n - 1, list));
+	return true;
+}
+
+template <class T>
+void PostingLeafNode<T>::setOverflow(int i, PageId pageNo, std::uint32_t entries)
+{
+	OverflowList overflow;
+	overflow.pageNo = pageNo;
+	overflow.entries = entries;
+	setList(i, (const char*)&overflow, OVERFLOW_LIST);
+}
+
+template <class T>
+std::uint32_t PostingLeafNode<T>::entries(int end) const
+{
+	std::uint32_t n = 0;
+	for (int i = 0; i < end; i++)
+	{
+		n += isOverflow(i) ? overflowCount(i) : PostingCodec::count(list(i), listBytes(i));
+	}
+	return n;
+}
+
+template <class T>
+void PostingLeafNode<T>::put(int i, const T &key, const char *list, int length)
+{
+	Slot slot;
+	slot.key = key;
+	slot.length = (std::uint16_t)length;
+	int bytes = storedBytes(length);
+	if (heapOffset - bytes < (header.numKeys + 1) * SLOT_SIZE)
+	{
+		compact();
+	}
+	heapOffset -= bytes;
+	memcpy(data + heapOffset, list, bytes);
+	heapBytes += bytes;
+	slot.offset = heapOffset;
+	Slot *slots = this->slots();
+	memmove(slots + i + 1, slots + i, (header.numKeys - i) * SLOT_SIZE);
+	slots[i] = slot;
+	header.numKeys++;
+}
+
+template <class T>
+void PostingLeafNode<T>::setList(int i, const char *list, int length)
+{
+	// the old list is left in the heap until the next compaction
+	Slot &slot = slots()[i];
+	heapBytes -= storedBytes(slot.length);
+	slot.length = 0;
+	int bytes = storedBytes(length);
+	if (heapOffset - bytes < header.numKeys * SLOT_SIZE)
+	{
+		compact();
+	}
+	heapOffset -= bytes;
+	memcpy(data + heapOffset, list, bytes);
+	heapBytes += bytes;
+	slot.offset = heapOffset;
+	slot.length = (std::uint16_t)length;
+}
+
+template <class T>
+void PostingLeafNode<T>::remove(int i)
+{
+	Slot *slot = slots();
+	heapBytes -= storedBytes(slot[i].length);
+	memmove(slot + i, slot + i + 1, (header.numKeys - i - 1) * SLOT_SIZE);
+	header.numKeys--;
+	if (header.numKeys == 0)
+	{
+		heapOffset = DATA_SIZE;
+	}
+}
+
+template <class T>
+void PostingLeafNode<T>::compact()
+{
+	PostingLeafNode<T> old;
+	memcpy((void*)&old, this, Page::SIZE);
+	heapOffset = DATA_SIZE;
+	Slot *slot = slots();
+	for (int i = 0; i < header.numKeys; i++)
+	{
+		int bytes = storedBytes(slot[i].length);
+		heapOffset -= bytes;
+		memcpy(data + heapOffset, old.data + slot[i].offset, bytes);
+		slot[i].offset = heapOffset;
+	}
+}
+
+template <class T>
+int PostingLeafNode<T>::splitIndex() const
+{
+	// first key past half of the bytes used, both halves keep at least one key
+	int half = usedBytes() / 2;
+	int used = 0;
+	int i = 0;
+	while (i < header.numKeys - 1 && used < half)
+	{
+		used += SLOT_SIZE + storedBytes(slots()[i].length);
+		i++;
+	}
+	return i < 1 ? 1 : i;
+}
+
+template <class T>
+void PostingLeafNode<T>::moveTail(int from, PostingLeafNode *dest)
+{
+	for (int i = from; i < header.numKeys; i++)
+	{
+		const Slot &slot = slots()[i];
+		dest->put(dest->header.numKeys, slot.key, data + slot.offset, slot.length);
+		heapBytes -= storedBytes(slot.length);
+	}
+	header.numKeys = from;
+}
+
+template <class T>
+bool PostingLeafNode<T>::isUnderfull() const
+{
+	return usedBytes() < DATA_SIZE / 2;
+}
+
+template <class T>
+bool PostingLeafNode<T>::canLend() const
+{
+	return header.numKeys > 1 && usedBytes() > DATA_SIZE / 2;
+}
+
+template <class T>
+bool PostingLeafNode<T>::absorb(PostingLeafNode *right)
+{
+	if (usedBytes() + right->usedBytes() > DATA_SIZE)
+	{
+		return false;
+	}
+	right->moveTail(0, this);
+	return true;
+}
+
+template <class T>
+bool PostingLeafNode<T>::borrowFirst(PostingLeafNode *right, const T &separator)
+{
+	const Slot &slot = right->slots()[0];
+	if (usedBytes() + SLOT_SIZE + storedBytes(slot.length) > DATA_SIZE)
+	{
+		return false;
+	}
+	put(header.numKeys, slot.key, right->data + slot.offset, slot.length);
+	right->remove(0);
+	return true;
+}
+
+template <class T>
+bool PostingLeafNode<T>::borrowLast(PostingLeafNode *left, const T &separator)
+{
+	int last = left->header.numKeys - 1;
+	const Slot &slot = left->slots()[last];
+	if (usedBytes() + SLOT_SIZE + storedBytes(slot.length) > DATA_SIZE)
+	{
+		return false;
+	}
+	put(0, slot.key, left->data + slot.offset, slot.length);
+	left->remove(last);
+	return true;
+}
+
 }
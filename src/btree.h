@@ -11,11 +11,20 @@
 #include <string>
 #include "string.h"
 #include <sstream>
+#include <utility>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <thread>
 
 #include "types.h"
 #include "page.h"
 #include "file.h"
 #include "buffer.h"
+#include "latch.h"
+#include "node_search.h"
+#include "read_ahead.h"
+#include "upper_level_cache.h"
 
 namespace badgerdb
 {
@@ -43,16 +52,257 @@ enum Operator
 
 
 /**
- * @brief Number of key slots in B+Tree leaf for INTEGER key.
+ * @brief Version of the node layout, stamped into the header of every node page.
  */
-//                                                  sibling ptr             key               rid
-const  int INTARRAYLEAFSIZE = ( Page::SIZE - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( RecordId ) );
+const std::uint16_t NODE_FORMAT_VERSION = 6;
 
 /**
- * @brief Number of key slots in B+Tree non-leaf for INTEGER key.
+ * @brief Bits of NodeHeader::flags.
+ */
+enum NodeFlags
+{
+	NODE_LEAF = 0x1,	/* Node is a leaf */
+	NODE_FREE = 0x2,	/* Page was freed and is on the free list of the meta page */
+	NODE_POSTING = 0x4,	/* Leaf keeps the record ids of each key in a posting list, see PostingLeafNode */
+	NODE_OVERFLOW = 0x8,	/* Page holds part of a posting list too long for its leaf, see OverflowNode */
+	NODE_HIGH_KEY = 0x10	/* Node has a high key, it is not the rightmost node of its level */
+};
+
+/**
+ * @brief Header at the start of every node page. The number of entries is kept here
+ * so that node occupancy is known without scanning for empty slots, which also lets
+ * key 0 and RecordId {0,x} be stored like any other value.
+*/
+struct NodeHeader{
+  /**
+   * Level of the node in the tree. -1 for leaves, 1 for non-leaves just above the leaves, 0 otherwise.
+   * Kept first so the kind of a node can be told from any node pointer.
+   */
+	int level;
+
+  /**
+   * Layout version, NODE_FORMAT_VERSION when the node was written.
+   */
+	std::uint16_t version;
+
+  /**
+   * NodeFlags bits.
+   */
+	std::uint16_t flags;
+
+  /**
+   * Number of keys stored in the node.
+   */
+	int numKeys;
+};
+
+/**
+ * @brief Width of STRING keys, the size of the string attribute in the record.
+ */
+const int STRINGSIZE = 64;
+
+/**
+ * @brief Key of a STRING index. Holds the attribute up to its terminating NUL with the rest
+ * of the bytes zeroed, so keys compare with a single memcmp in strcmp order.
+ */
+struct StringKey{
+	char data[ STRINGSIZE ];
+};
+
+inline bool operator<( const StringKey& k1, const StringKey& k2 )
+{
+	return memcmp( k1.data, k2.data, STRINGSIZE ) < 0;
+}
+
+inline bool operator==( const StringKey& k1, const StringKey& k2 )
+{
+	return memcmp( k1.data, k2.data, STRINGSIZE ) == 0;
+}
+
+inline bool operator!=( const StringKey& k1, const StringKey& k2 )
+{
+	return !( k1 == k2 );
+}
+
+/**
+ * @brief Per key type properties used by the templated node layouts and the insert/scan code.
+ * Specialized for the C++ type of each Datatype: int, double and StringKey.
+ */
+template <class T>
+struct KeyTraits;
+
+template <>
+struct KeyTraits<int>{
+	static const Datatype TYPE = INTEGER;
+
+  /**
+   * Read a key from a value passed to the index or from the attribute inside a record.
+   */
+	static void set( int& key, const void* value )
+	{
+		memcpy( &key, value, sizeof( int ) );
+	}
+
+  /**
+   * Separator copied up into the parent when a leaf splits between left and right, any key in (left, right].
+   */
+	static int separator( int left, int right )
+	{
+		return right;
+	}
+
+  /**
+   * A key taking as much room in a node as any other, to check that a node has room for whatever separator comes up.
+   */
+	static int longest()
+	{
+		return 0;
+	}
+
+  /**
+   * Where key lies from low to high, 0 at low and 1 at high, taking the keys between them as evenly spread. Each whole
+   * number is a step of its own, which inclusive counts as below key. Estimates the part of a histogram bucket
+   * a range takes, see IndexStats. The caller has low <= key < high.
+   */
+	static double fraction( int key, bool inclusive, int low, int high )
+	{
+		return ( (double) key - low + ( inclusive ? 1 : 0 ) ) / ( (double) high - low );
+	}
+};
+
+template <>
+struct KeyTraits<double>{
+	static const Datatype TYPE = DOUBLE;
+
+	static void set( double& key, const void* value )
+	{
+		memcpy( &key, value, sizeof( double ) );
+	}
+
+	static double separator( double left, double right )
+	{
+		return right;
+	}
+
+	static double longest()
+	{
+		return 0;
+	}
+
+	static double fraction( double key, bool inclusive, double low, double high )
+	{
+		return ( key - low ) / ( high - low );
+	}
+};
+
+template <>
+struct KeyTraits<StringKey>{
+	static const Datatype TYPE = STRING;
+
+	static void set( StringKey& key, const void* value )
+	{
+		const char* str = (const char*) value;
+		size_t len = strnlen( str, STRINGSIZE );
+		memcpy( key.data, str, len );
+		memset( key.data + len, 0, STRINGSIZE - len );
+	}
+
+  /**
+   * Number of bytes of the key before its terminating NUL.
+   */
+	static int length( const StringKey& key )
+	{
+		return (int) strnlen( key.data, STRINGSIZE );
+	}
+
+  /**
+   * Length of the longest common prefix of two byte strings.
+   */
+	static int commonPrefix( const char* a, int aLength, const char* b, int bLength )
+	{
+		int n = aLength < bLength ? aLength : bLength;
+		int i = 0;
+		while( i < n && a[i] == b[i] )
+			i++;
+		return i;
+	}
+
+  /**
+   * The shortest prefix of right that is still greater than left, so inner nodes hold only the bytes
+   * needed to tell the two sides of a split apart. right itself if the two are equal.
+   */
+	static StringKey separator( const StringKey& left, const StringKey& right )
+	{
+		int rightLength = length( right );
+		int n = commonPrefix( left.data, length( left ), right.data, rightLength ) + 1;
+		if( n >= rightLength )
+			return right;
+		StringKey key;
+		memcpy( key.data, right.data, n );
+		memset( key.data + n, 0, STRINGSIZE - n );
+		return key;
+	}
+
+  /**
+   * A key of STRINGSIZE bytes without a terminating NUL.
+   */
+	static StringKey longest()
+	{
+		StringKey key;
+		memset( key.data, 'z', STRINGSIZE );
+		return key;
+	}
+
+  /**
+   * The bytes after the prefix low and high share, as a number from low to high.
+   */
+	static double fraction( const StringKey& key, bool inclusive, const StringKey& low, const StringKey& high )
+	{
+		int from = commonPrefix( low.data, STRINGSIZE, high.data, STRINGSIZE );
+		double lowValue = digits( low, from );
+		return ( digits( key, from ) - lowValue ) / ( digits( high, from ) - lowValue );
+	}
+
+  /**
+   * Eight bytes of key from the given one on, as a fraction in [0,1).
+   */
+	static double digits( const StringKey& key, int from )
+	{
+		double value = 0;
+		double scale = 1;
+		for( int i = from; i < from + 8 && i < STRINGSIZE; i++ )
+		{
+			scale /= 256;
+			value += (unsigned char) key.data[i] * scale;
+		}
+		return value;
+	}
+};
+
+/**
+ * @brief Most attributes an index can include, see IndexOptions::include.
+ */
+const int MAX_INCLUDED_COLUMNS = 8;
+
+/**
+ * @brief Most bytes of included attributes stored with each key.
+ */
+const int MAX_PAYLOAD_SIZE = 128;
+
+/**
+ * @brief Attribute of the relation stored in the leaves next to each key, see IndexOptions::include.
  */
-//                                                     level     extra pageNo                  key       pageNo
-const  int INTARRAYNONLEAFSIZE = ( Page::SIZE - sizeof( int ) - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( PageId ) );
+struct IncludedColumn{
+  /**
+   * Offset of the attribute inside the record.
+   */
+	int offset;
+
+  /**
+   * Bytes of the attribute.
+   */
+	int length;
+};
 
 /**
  * @brief Structure to store a key-rid pair. It is used to pass the pair to functions that 
@@ -68,6 +318,29 @@ public:
 		rid = r;
 		key = k;
 	}
+
+  /**
+   * Included attributes of the entry, none unless the index has them.
+   */
+	const char* payload() const
+	{
+		return NULL;
+	}
+};
+
+/**
+ * @brief Key-rid pair with the included attributes of its record, sorted and loaded into the leaves
+ * of an index with IndexOptions::include like a plain pair.
+ */
+template <class T>
+class CoveredEntry : public RIDKeyPair<T>{
+public:
+	char columns[ MAX_PAYLOAD_SIZE ];
+
+	const char* payload() const
+	{
+		return columns;
+	}
 };
 
 /**
@@ -86,20 +359,185 @@ public:
 	}
 };
 
+/**
+ * @brief Maximum height of the tree, bounds the path recorded during a root-to-leaf descent.
+ */
+const int MAX_TREE_HEIGHT = 16;
+
+/**
+ * @brief One step of a root-to-leaf descent: a pinned non-leaf node and the child slot taken in it.
+ * Insert keeps these on a stack so that splits can be propagated upwards without reading
+ * the nodes again.
+*/
+struct PathEntry{
+  /**
+   * Page number of the node.
+   */
+	PageId pageNo;
+
+  /**
+   * The node, pinned in the buffer pool.
+   */
+	Page *page;
+
+  /**
+   * Index into pageNoArray of the child the descent went to.
+   */
+	int childIndex;
+};
+
+/**
+ * @brief Separators bounding the leaf a descent ends in, the nearest ones left and right of the path.
+ * There is none on the left or right edge of the tree.
+*/
+template <class T>
+struct KeyFences{
+	T low;
+	T high;
+	bool hasLow;
+	bool hasHigh;
+
+	KeyFences()
+		: hasLow( false ), hasHigh( false )
+	{
+	}
+
+  /**
+   * The descent goes on to child childIndex of node, the separators around it are closer than any above.
+   */
+	template <class Inner>
+	void narrow( const Inner* node, int childIndex )
+	{
+		if( childIndex > 0 )
+		{
+			low = node->key( childIndex - 1 );
+			hasLow = true;
+		}
+		if( childIndex < node->count() )
+		{
+			high = node->key( childIndex );
+			hasHigh = true;
+		}
+	}
+
+	const T* lowFence() const
+	{
+		return hasLow ? &low : NULL;
+	}
+
+	const T* highFence() const
+	{
+		return hasHigh ? &high : NULL;
+	}
+};
+
+/**
+ * @brief Number of optimistic descents an insert or delete makes, when other threads keep changing the nodes
+ * it passes, before it latches its way down instead.
+ */
+const int OPTIMISTIC_ATTEMPTS = 4;
+
 /**
  * @brief Overloaded operator to compare the key values of two rid-key pairs
  * and if they are the same compares to see if the first pair has
- * a smaller rid.pageNo value.
+ * a smaller rid, by page number and then slot number.
 */
 template <class T>
 bool operator<( const RIDKeyPair<T>& r1, const RIDKeyPair<T>& r2 )
 {
 	if( r1.key != r2.key )
 		return r1.key < r2.key;
-	else
+	else if( r1.rid.page_number != r2.rid.page_number )
 		return r1.rid.page_number < r2.rid.page_number;
+	else
+		return r1.rid.slot_number < r2.rid.slot_number;
 }
 
+/**
+ * @brief Buckets of the histogram of IndexStats.
+ */
+const int HISTOGRAM_BUCKETS = 32;
+
+/**
+ * @brief Inserts and deletes after which the statistics of an index are collected again, on top of a quarter of
+ * the entries it had when they were last collected.
+ */
+const int STATS_MIN_CHANGES = 1024;
+
+/**
+ * @brief Statistics of an index, kept in its meta page, see BTreeIndex::statistics and BTreeIndex::estimateRange.
+ * A bulk load gathers them while it packs the leaves, a walk of the whole tree collects them again. Until the next walk every insert and delete adds to entries and to the
+ * count of the bucket of its key, the other figures stay as the walk left them.
+ * The histogram is equi-depth: buckets start at a change of key once the one before holds its share of the
+ * entries, so a key never spans two buckets. Bucket b holds the keys from bounds[b] up to bounds[b+1], the last one
+ * bounds[buckets] too. Bounds are keys of the index type, copied into the bytes of a StringKey.
+*/
+struct IndexStats{
+  /**
+   * Levels of the tree, 1 while the root is a leaf. 0 if the statistics were never collected.
+   */
+	int height;
+
+	std::uint32_t leafPages;
+
+	std::uint32_t innerPages;
+
+  /**
+   * Used key slots of the leaves, and of the non-leaf nodes, over the slots they have.
+   */
+	double leafFill;
+
+	double innerFill;
+
+	std::int64_t entries;
+
+  /**
+   * Distinct keys at the last walk.
+   */
+	std::int64_t distinctKeys;
+
+  /**
+   * Buckets in use, fewer than HISTOGRAM_BUCKETS if the index has fewer distinct keys. 0 for an empty index.
+   */
+	int buckets;
+
+	std::int64_t bucketEntries[ HISTOGRAM_BUCKETS ];
+
+  /**
+   * Distinct keys of each bucket at the last walk.
+   */
+	std::int64_t bucketKeys[ HISTOGRAM_BUCKETS ];
+
+	char bounds[ HISTOGRAM_BUCKETS + 1 ][ sizeof( StringKey ) ];
+
+  /**
+   * Entries at the last walk, and inserts and deletes since.
+   */
+	std::int64_t collectedEntries;
+
+	std::int64_t changes;
+};
+
+/**
+ * @brief Estimate of a range of an index, see BTreeIndex::estimateRange.
+*/
+struct RangeEstimate{
+  /**
+   * Entries in the range, as many as a scan would return.
+   */
+	double entries;
+
+  /**
+   * Fraction of the entries of the index in the range.
+   */
+	double selectivity;
+
+  /**
+   * Leaves a scan of the range reads.
+   */
+	double leafPages;
+};
+
 /**
  * @brief The meta page, which holds metadata for Index file, is always first page of the btree index file and is cast
  * to the following structure to store or retrieve information from it.
@@ -128,318 +566,3793 @@ struct IndexMetaInfo{
    * Page number of root page of the B+ Tree inside the file index file.
    */
 	PageId rootPageNo;
-};
 
-/*
-Each node is a page, so once we read the page in we just cast the pointer to the 
-page to this struct and use it to access the parts. These structures basically are the 
-format in which the information is stored in the pages for the index file depending on what kind of 
-node they are. The level memeber of each non leaf structure seen below is set to 1 if the nodes 
-at this level are just above the leaf nodes. Otherwise set to 0.
-*/
+  /**
+   * NODE_FORMAT_VERSION of the nodes in the file. Zero until the index has been completely built,
+   * so a partially built file is never reopened.
+   */
+	int formatVersion;
 
-/**
- * @brief Structure for all non-leaf nodes when the key is of INTEGER type.
-*/
-struct NonLeafNodeInt{
   /**
-   * Level of the node in the tree.
+   * First page of the list of pages freed by deletes, Page::INVALID_NUMBER if there are none.
+   * New nodes are taken from this list before the file is extended.
    */
-	int level;
+	PageId freePageNo;
 
   /**
-   * Stores keys.
+   * Non-zero if the leaves are PostingLeafNodes, see IndexOptions::postingLists.
    */
-	int keyArray[ INTARRAYNONLEAFSIZE ];
+	int postingLists;
 
   /**
-   * Stores page numbers of child pages which themselves are other non-leaf/leaf nodes in the tree.
+   * Non-zero if non-leaf nodes keep subtree counts, see IndexOptions::counted.
    */
-	PageId pageNoArray[ INTARRAYNONLEAFSIZE + 1 ];
-};
+	int counted;
 
+  /**
+   * Number of attributes stored with each key, see IndexOptions::include.
+   */
+	int includedColumns;
 
-/**
- * @brief Structure for all leaf nodes when the key is of INTEGER type.
-*/
-struct LeafNodeInt{
-	int level = -1;
   /**
-   * Stores keys.
+   * The included attributes, in the order they are stored in.
    */
-	int keyArray[ INTARRAYLEAFSIZE ];
+	IncludedColumn included[ MAX_INCLUDED_COLUMNS ];
 
   /**
-   * Stores RecordIds.
+   * Non-zero if non-leaf nodes are BlockedNonLeafNodes, see IndexOptions::blockedInnerNodes.
    */
-	RecordId ridArray[ INTARRAYLEAFSIZE ];
+	int blockedInnerNodes;
 
   /**
-   * Page number of the leaf on the right side.
-	 * This linking of leaves allows to easily move from one leaf to the next leaf during index scan.
+   * Statistics of the index, all zero in files written before they were kept.
    */
-	PageId rightSibPageNo;
+	IndexStats stats;
 };
 
+static_assert( sizeof( IndexMetaInfo ) <= Page::SIZE, "meta info does not fit a page" );
 
 /**
- * @brief BTreeIndex class. It implements a B+ Tree index on a single attribute of a
- * relation. This index supports only one scan at a time.
+ * @brief A page on the free list. Freed pages are chained through this next pointer.
 */
-class BTreeIndex {
-
- private:
-
+struct FreeNode{
   /**
-   * File object for the index file.
+   * Node header, flags is NODE_FREE.
    */
-	File		*file;
+	NodeHeader header;
 
   /**
-   * Buffer Manager Instance.
+   * Next page of the free list, Page::INVALID_NUMBER at the end.
    */
-	BufMgr	*bufMgr;
+	PageId nextFreePageNo;
+};
+
+/*
+Each node is a page, so once we read the page in we just cast the pointer to the 
+page to this struct and use it to access the parts. These structures basically are the 
+format in which the information is stored in the pages for the index file depending on what kind of 
+node they are. Both start with a NodeHeader. The level member of each non leaf header is set to 1 if the nodes 
+at this level are just above the leaf nodes. Otherwise set to 0.
+The layouts are templated on the key type, the number of key slots is worked out per type at compile time.
+The insert, delete and scan code only goes through the member functions of the nodes, so a key type can
+have a layout of its own, as STRING keys do below.
+Readers do not latch the nodes they pass and may see a node while a writer changes it, see BTreeIndex. Layouts
+with READ_IN_PLACE set stay within their page whatever they read: counts are clamped to the key arrays. The other
+layouts follow offsets stored in the page and are searched in a copy, checked against the node version first.
+*/
+
+/**
+ * @brief Child pointer of a non-leaf node.
+*/
+struct UncountedChild{
+	static const bool COUNTED = false;
+
+	PageId pageNo;
+
+	std::uint32_t count() const
+	{
+		return 0;
+	}
+
+	void setCount( std::uint32_t )
+	{
+	}
+};
+
+/**
+ * @brief Child pointer of a non-leaf node in an index with IndexOptions::counted set, which also holds the
+ * number of entries in the subtree below the child. Counting the entries of a range then takes one
+ * descent for each of its bounds.
+*/
+struct CountedChild{
+	static const bool COUNTED = true;
+
+	PageId pageNo;
 
   /**
-   * Page number of meta page.
+   * Entries in the subtree, record ids for posting list leaves.
    */
-	PageId	headerPageNum;
+	std::uint32_t entries;
+
+	std::uint32_t count() const
+	{
+		return entries;
+	}
+
+	void setCount( std::uint32_t n )
+	{
+		entries = n;
+	}
+};
 
+/**
+ * @brief Structure for all non-leaf nodes, for keys of type T. Child is UncountedChild, or CountedChild for
+ * indexes that keep subtree counts.
+*/
+template <class T, class Child = UncountedChild>
+struct NonLeafNode{
   /**
-   * page number of root page of B+ tree inside index file.
+   * Number of key slots. Header and sibling pointer take 16 bytes, so the high key and the key array are aligned for every key type.
    */
-	PageId	rootPageNum;
+	//                                     header                  sibling ptr             high key       extra child               key          child
+	static const int SIZE = ( Page::SIZE - sizeof( NodeHeader ) - sizeof( PageId ) - sizeof( T ) - sizeof( Child ) ) / ( sizeof( T ) + sizeof( Child ) );
 
   /**
-   * Datatype of attribute over which index is built.
+   * True if the children carry subtree counts.
    */
-	Datatype	attributeType;
+	static const bool COUNTED = Child::COUNTED;
+
+	static const bool READ_IN_PLACE = true;
 
   /**
-   * Offset of attribute, over which index is built, inside records. 
+   * Node header, holds level and number of keys.
    */
-	int 		attrByteOffset;
+	NodeHeader header;
 
   /**
-   * Number of keys in leaf node, depending upon the type of key.
+   * Page number of the node on the right side, on the same level.
    */
-	int			leafOccupancy;
+	PageId rightSibPageNo;
 
   /**
-   * Number of keys in non-leaf node, depending upon the type of key.
+   * Separator between the node and its right sibling, no key of the node is above it. Set when header.flags has NODE_HIGH_KEY.
    */
-	int			nodeOccupancy;
+	T highKey;
 
-	// MEMBERS SPECIFIC TO SCANNING
+  /**
+   * Stores keys.
+   */
+	T keyArray[ SIZE ];
 
   /**
-   * True if an index scan has been started.
+   * Stores page numbers of child pages which themselves are other non-leaf/leaf nodes in the tree.
    */
-	bool		scanExecuting;
+	Child childArray[ SIZE + 1 ];
 
   /**
-   * Index of next entry to be scanned in current leaf being scanned.
+   * Turn a freshly allocated page into an empty node.
+   * @param level level of the node, 1 if its children are leaves, 0 otherwise
    */
-	int			nextEntry;
+	void init( int level )
+	{
+		memset( (void*) this, 0, Page::SIZE );
+		header.level = level;
+		header.version = NODE_FORMAT_VERSION;
+	}
 
   /**
-   * Page number of current page being scanned.
+   * Number of keys, the node has one child more. Never more than SIZE, even when read halfway through a change.
    */
-	PageId	currentPageNum;
+	int count() const
+	{
+		return header.numKeys < SIZE ? header.numKeys : SIZE;
+	}
+
+	bool hasHighKey() const
+	{
+		return header.flags & NODE_HIGH_KEY;
+	}
 
   /**
-   * Current Page being scanned.
+   * Set the high key, NULL for the rightmost node of a level.
    */
-	Page		*currentPageData;
+	void setHighKey( const T* key )
+	{
+		if( key == NULL )
+		{
+			header.flags &= ~NODE_HIGH_KEY;
+			return;
+		}
+		highKey = *key;
+		header.flags |= NODE_HIGH_KEY;
+	}
 
   /**
-   * Low INTEGER value for scan.
+   * True if key belongs to a node further right, which a split moved it to before the parent heard of it.
+   * @param upper true to go right on a key equal to the high key, as an insert does
    */
-	int			lowValInt;
+	bool isPastHighKey( const T& key, bool upper ) const
+	{
+		return hasHighKey() && ( upper ? !( key < highKey ) : highKey < key );
+	}
+
+	const T& key( int i ) const
+	{
+		return keyArray[ i ];
+	}
+
+	PageId child( int i ) const
+	{
+		return childArray[ i ].pageNo;
+	}
+
+	void setChild( int i, PageId pageNo )
+	{
+		childArray[ i ].pageNo = pageNo;
+	}
 
   /**
-   * Low DOUBLE value for scan.
+   * Entries below child i, always 0 for an UncountedChild.
    */
-	double	lowValDouble;
+	std::uint32_t childCount( int i ) const
+	{
+		return childArray[ i ].count();
+	}
+
+	void setChildCount( int i, std::uint32_t n )
+	{
+		childArray[ i ].setCount( n );
+	}
 
   /**
-   * Low STRING value for scan.
+   * Entries below the node.
    */
-	std::string	lowValString;
+	std::uint32_t totalCount() const
+	{
+		std::uint32_t n = 0;
+		for( int i = 0; i <= count(); i++ )
+			n += childArray[ i ].count();
+		return n;
+	}
 
   /**
-   * High INTEGER value for scan.
+   * Index of the first key >= key, which is also the leftmost child that can hold key.
    */
-	int			highValInt;
+	int lowerBound( const T& key ) const
+	{
+		return NodeSearch::lowerBound( keyArray, count(), key );
+	}
 
   /**
-   * High DOUBLE value for scan.
+   * Index of the first key > key, the child an insert of key goes to.
    */
-	double	highValDouble;
+	int upperBound( const T& key ) const
+	{
+		return NodeSearch::upperBound( keyArray, count(), key );
+	}
 
   /**
-   * High STRING value for scan.
+   * True if key can be added without going over fillFactor of the node.
    */
-	std::string highValString;
-	
+	bool hasRoom( const T& key, double fillFactor = 1.0 ) const
+	{
+		int slots = (int)( SIZE * fillFactor );
+		return header.numKeys < ( slots < 1 ? 1 : slots );
+	}
+
   /**
-   * Low Operator. Can only be GT(>) or GTE(>=).
+   * Insert a key, and the child holding the keys >= key right after it. The node must have room.
+   * @param keyIndex key slot to insert at, the child goes into child slot keyIndex+1
+   * @param count entries below the new child
    */
-	Operator	lowOp;
+	void insert( int keyIndex, const T& key, PageId rightChild, std::uint32_t count = 0 )
+	{
+		for( int i = header.numKeys - 1; i >= keyIndex; i-- )
+		{
+			keyArray[ i + 1 ] = keyArray[ i ];
+			childArray[ i + 2 ] = childArray[ i + 1 ];
+		}
+		keyArray[ keyIndex ] = key;
+		childArray[ keyIndex + 1 ].pageNo = rightChild;
+		childArray[ keyIndex + 1 ].setCount( count );
+		header.numKeys++;
+	}
 
   /**
-   * High Operator. Can only be LT(<) or LTE(<=).
+   * Insert a key in front of all others, with a new leftmost child. The node must have room.
    */
-	Operator	highOp;
-	struct IndexMetaInfo metaInfo {};
+	void insertFront( const T& key, PageId leftChild, std::uint32_t count = 0 )
+	{
+		insert( 0, key, childArray[ 0 ].pageNo, childArray[ 0 ].count() );
+		childArray[ 0 ].pageNo = leftChild;
+		childArray[ 0 ].setCount( count );
+	}
 
-	
- public:
+  /**
+   * Remove a key and the child slot right after it.
+   */
+	void remove( int keyIndex )
+	{
+		for( int i = keyIndex + 1; i < header.numKeys; i++ )
+		{
+			keyArray[ i - 1 ] = keyArray[ i ];
+			childArray[ i ] = childArray[ i + 1 ];
+		}
+		header.numKeys--;
+	}
 
   /**
-   * BTreeIndex Constructor. 
-	 * Check to see if the corresponding index file exists. If so, open the file.
-	 * If not, create it and insert entries for every tuple in the base relation using FileScan class.
-   *
-   * @param relationName        Name of file.
-   * @param outIndexName        Return the name of index file.
-   * @param bufMgrIn						Buffer Manager Instance
-   * @param attrByteOffset			Offset of attribute, over which index is to be built, in the record
-   * @param attrType						Datatype of attribute over which index is built
-   * @throws  BadIndexInfoException     If the index file already exists for the corresponding attribute,
-   *  but values in metapage(relationName, attribute byte offset, attribute type etc.) do not match with values received through constructor parameters.
+   * Remove the first key and the leftmost child.
    */
-	BTreeIndex(const std::string & relationName, std::string & outIndexName,
-						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType);
-	
+	void removeFront()
+	{
+		childArray[ 0 ] = childArray[ 1 ];
+		remove( 0 );
+	}
 
   /**
-   * BTreeIndex Destructor. 
-	 * End any initialized scan, flush index file, after unpinning any pinned pages, from the buffer manager
-	 * and delete file instance thereby closing the index file.
-	 * Destructor should not throw any exceptions. All exceptions should be caught in here itself. 
-	 * */
-	~BTreeIndex();
+   * Key slot to split a full node at, see moveTail.
+   */
+	int splitIndex() const
+	{
+		return header.numKeys / 2;
+	}
 
+  /**
+   * Move the keys after splitIndex and the children after them to an empty node. Key splitIndex is dropped,
+   * it is pushed up by the caller, and its right child becomes the leftmost child of dest.
+   */
+	void moveTail( int splitIndex, NonLeafNode* dest )
+	{
+		for( int i = splitIndex + 1; i < header.numKeys; i++ )
+			dest->keyArray[ i - splitIndex - 1 ] = keyArray[ i ];
+		for( int i = splitIndex + 1; i <= header.numKeys; i++ )
+			dest->childArray[ i - splitIndex - 1 ] = childArray[ i ];
+		dest->header.numKeys = header.numKeys - splitIndex - 1;
+		header.numKeys = splitIndex;
+	}
 
   /**
-	 * Insert a new entry using the pair <value,rid>. 
-	 * Start from root to recursively find out the leaf to insert the entry in. The insertion may cause splitting of leaf node.
-	 * This splitting will require addition of new leaf page number entry into the parent non-leaf, which may in-turn get split.
-	 * This may continue all the way upto the root causing the root to get split. If root gets split, metapage needs to be changed accordingly.
-	 * Make sure to unpin pages as soon as you can.
-   * @param key			Key to insert, pointer to integer/double/char string
-   * @param rid			Record ID of a record whose entry is getting inserted into the index.
-	**/
-	void insertEntry(const void* key, const RecordId rid);
+   * True if less than half of the node is used.
+   */
+	bool isUnderfull() const
+	{
+		return header.numKeys < SIZE / 2;
+	}
 
+  /**
+   * True if a key can be taken from the node without leaving it underfull.
+   */
+	bool canLend() const
+	{
+		return header.numKeys > SIZE / 2;
+	}
 
   /**
-	 * Begin a filtered scan of the index.  For instance, if the method is called 
-	 * using ("a",GT,"d",LTE) then we should seek all entries with a value 
-	 * greater than "a" and less than or equal to "d".
-	 * If another scan is already executing, that needs to be ended here.
-	 * Set up all the variables for scan. Start from root to find out the leaf page that contains the first RecordID
-	 * that satisfies the scan parameters. Keep that page pinned in the buffer pool.
-   * @param lowVal	Low value of range, pointer to integer / double / char string
-   * @param lowOp		Low operator (GT/GTE)
-   * @param highVal	High value of range, pointer to integer / double / char string
-   * @param highOp	High operator (LT/LTE)
-   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values 
-   * @throws  BadScanrangeException If lowVal > highval
-	 * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
-	**/
-	void startScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
+   * Append the separator and all keys and children of the right sibling.
+   * @return false, and nothing is changed, if they do not fit
+   */
+	bool absorb( const T& separator, const NonLeafNode* right )
+	{
+		if( header.numKeys + 1 + right->header.numKeys > SIZE )
+			return false;
+		insert( header.numKeys, separator, right->child( 0 ), right->childCount( 0 ) );
+		for( int i = 0; i < right->header.numKeys; i++ )
+			insert( header.numKeys, right->keyArray[ i ], right->child( i + 1 ), right->childCount( i + 1 ) );
+		return true;
+	}
+
+  /**
+   * True if key i can be replaced by key.
+   */
+	bool canReplaceKey( int i, const T& key ) const
+	{
+		return true;
+	}
+
+	void replaceKey( int i, const T& key )
+	{
+		keyArray[ i ] = key;
+	}
+};
 
 
+/**
+ * @brief Keys of one cache line of a BlockedNonLeafNode.
+ */
+const int BLOCK_KEYS = 16;
+
+/**
+ * @brief Most blocks of BLOCK_KEYS keys a BlockedNonLeafNode has room for.
+ */
+const int MAX_KEY_BLOCKS = 64;
+
+/**
+ * @brief Non-leaf node for INTEGER keys of an index with IndexOptions::blockedInnerNodes set. The keys are kept
+ * in sorted order like in NonLeafNode, in blocks of BLOCK_KEYS that each fill one cache line, and two summary levels
+ * above them hold the largest key of every block and of every BLOCK_KEYS blocks. A search reads one line of each
+ * level, three lines in all, where a binary search over the whole key array touches about ten spread over 4 KB.
+ * The summaries are rebuilt from the first block a change touches, so inserts, deletes and splits keep them up to
+ * date and they are written to disk with the node.
+*/
+template <class Child = UncountedChild>
+struct BlockedNonLeafNode{
   /**
-	 * Fetch the record id of the next index entry that matches the scan.
-	 * Return the next record from current page being scanned. If current page has been scanned to its entirety, move on to the right sibling of current page, if any exists, to start scanning that page. Make sure to unpin any pages that are no longer required.
-   * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
-	 * @throws ScanNotInitializedException If no scan has been initialized.
-	 * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
-	**/
-	void scanNext(RecordId& outRid);  // returned record id
+   * Number of key slots. The summaries and the key array start on cache line boundaries, see BufMgr::FRAME_ALIGNMENT.
+   */
+	//                                     header, high key, summaries                         extra child               key          child
+	static const int SIZE = ( Page::SIZE - ( BLOCK_KEYS + BLOCK_KEYS + MAX_KEY_BLOCKS ) * sizeof( int ) - sizeof( Child ) ) / ( sizeof( int ) + sizeof( Child ) );
 
+	static const bool COUNTED = Child::COUNTED;
+
+	static const bool READ_IN_PLACE = true;
 
   /**
-	 * Terminate the current scan. Unpin any pinned pages. Reset scan specific variables.
-	 * @throws ScanNotInitializedException If no scan has been initialized.
-	**/
-	void endScan();
+   * Node header, holds level and number of keys.
+   */
+	NodeHeader header;
 
-	// ADDITIONAL METHODS
-	/**
-	 * Insert a key, rid pair into a leaf node
-	 * @param leafNode leaf node to insert into
-	 * @param key key of entry to insert
-	 * @param rid rid of entry to insert
-	 * @param pageNo page number of the leaf node to insert into
-	 */
-	PageId insertIntoLeaf(LeafNodeInt *leafNode, int key, const RecordId rid, const PageId pageNo);
-	
-	/**
-	 * Insert a key, rid pair into a non-leaf node
-	 * @param key key to insert
-	 * @param pageNo page number of the leaf node to insert into
-	 * @param pid of corresponding page
-	 */
-	PageId insertIntoNonLeaf(NonLeafNodeInt *nonLeafNode,int key,PageId pid);
-	
-	/**
-	 * Split a leaf node into two when node is full and an insert is attempted
-	 * @param leafNode leaf node to split
-	 * @param splitIndex index to split at
-	 */
-	PageId splitLeaf(LeafNodeInt *leafNode,int splitIndex);
-	
-	/**
-	 * Split a non leaf (internal) node when pushup operation resulting from a
-	 * split from a lower level results in overflow in the non leaf node
-	 * @param key key to insert
-	 * @param rid record id to insert
-	 * @param pageNo page number of leaf node to split
-	 */
-	PageId splitNonLeaf(NonLeafNodeInt *nonLeafNode,int splitIndex);
+  /**
+   * Page number of the node on the right side, on the same level.
+   */
+	PageId rightSibPageNo;
 
-	/**
-	 * Returns the number of records currently in a leaf node
-	 * @param leafNode pointer to the leaf node desired
-	 */
-	int leafNodeRecNo(LeafNodeInt *leafNode);
+  /**
+   * Separator between the node and its right sibling, no key of the node is above it. Set when header.flags has NODE_HIGH_KEY.
+   */
+	int highKey;
 
-   	/**
-         * Returns the number of records currently in a non leaf node
-         * @param leafNode pointer to the non leaf node desired
-         */
-	int nonLeafNodeRecNo(NonLeafNodeInt *nonLeafNode);
+  /**
+   * Pads the header to a cache line.
+   */
+	int unused[ BLOCK_KEYS - ( sizeof( NodeHeader ) + sizeof( PageId ) + sizeof( int ) ) / sizeof( int ) ];
 
-	/**
-	 * Returns true if leafNode is at full capacity, false otherwise
-	 * @param leafNode leaf node desired
-	 */
-	bool isLeafFull(LeafNodeInt *leafNode);
-	
-   	/**
-         * Returns true if none leaf node is at full capacity, false otherwise
-         * @param nonLeafNode non leaf node desired
-         */
-	bool isNonLeafFull(NonLeafNodeInt *nonLeafNode);
+  /**
+   * Largest key of every BLOCK_KEYS blocks, the last group may be shorter.
+   */
+	int groupKeys[ BLOCK_KEYS ];
 
-	/**
-	 * Returns true if node is a leaf
-	 * @param pageNo page number of node desired
-	 * @return if page is leaf node
-	 */
-	bool isLeaf(PageId pageNo);
+  /**
+   * Largest key of every block, the last block may be shorter.
+   */
+	int blockKeys[ MAX_KEY_BLOCKS ];
+
+  /**
+   * Stores keys.
+   */
+	int keyArray[ SIZE ];
+
+  /**
+   * Stores page numbers of child pages which themselves are other non-leaf/leaf nodes in the tree.
+   */
+	Child childArray[ SIZE + 1 ];
+
+	void init( int level )
+	{
+		memset( (void*) this, 0, Page::SIZE );
+		header.level = level;
+		header.version = NODE_FORMAT_VERSION;
+	}
+
+	int count() const
+	{
+		return header.numKeys < SIZE ? header.numKeys : SIZE;
+	}
+
+	bool hasHighKey() const
+	{
+		return header.flags & NODE_HIGH_KEY;
+	}
+
+	void setHighKey( const int* key )
+	{
+		if( key == NULL )
+		{
+			header.flags &= ~NODE_HIGH_KEY;
+			return;
+		}
+		highKey = *key;
+		header.flags |= NODE_HIGH_KEY;
+	}
+
+	bool isPastHighKey( const int& key, bool upper ) const
+	{
+		return hasHighKey() && ( upper ? !( key < highKey ) : highKey < key );
+	}
+
+	const int& key( int i ) const
+	{
+		return keyArray[ i ];
+	}
+
+	PageId child( int i ) const
+	{
+		return childArray[ i ].pageNo;
+	}
+
+	void setChild( int i, PageId pageNo )
+	{
+		childArray[ i ].pageNo = pageNo;
+	}
+
+	std::uint32_t childCount( int i ) const
+	{
+		return childArray[ i ].count();
+	}
+
+	void setChildCount( int i, std::uint32_t n )
+	{
+		childArray[ i ].setCount( n );
+	}
+
+	std::uint32_t totalCount() const
+	{
+		std::uint32_t n = 0;
+		for( int i = 0; i <= count(); i++ )
+			n += childArray[ i ].count();
+		return n;
+	}
+
+  /**
+   * Index of the first key >= key, which is also the leftmost child that can hold key.
+   */
+	int lowerBound( const int& key ) const
+	{
+		return search<false>( key );
+	}
+
+  /**
+   * Index of the first key > key, the child an insert of key goes to.
+   */
+	int upperBound( const int& key ) const
+	{
+		return search<true>( key );
+	}
+
+	bool hasRoom( const int& key, double fillFactor = 1.0 ) const
+	{
+		int slots = (int)( SIZE * fillFactor );
+		return header.numKeys < ( slots < 1 ? 1 : slots );
+	}
+
+	void insert( int keyIndex, const int& key, PageId rightChild, std::uint32_t count = 0 )
+	{
+		for( int i = header.numKeys - 1; i >= keyIndex; i-- )
+		{
+			keyArray[ i + 1 ] = keyArray[ i ];
+			childArray[ i + 2 ] = childArray[ i + 1 ];
+		}
+		keyArray[ keyIndex ] = key;
+		childArray[ keyIndex + 1 ].pageNo = rightChild;
+		childArray[ keyIndex + 1 ].setCount( count );
+		header.numKeys++;
+		rebuildSummaries( keyIndex );
+	}
+
+	void insertFront( const int& key, PageId leftChild, std::uint32_t count = 0 )
+	{
+		insert( 0, key, childArray[ 0 ].pageNo, childArray[ 0 ].count() );
+		childArray[ 0 ].pageNo = leftChild;
+		childArray[ 0 ].setCount( count );
+	}
+
+	void remove( int keyIndex )
+	{
+		for( int i = keyIndex + 1; i < header.numKeys; i++ )
+		{
+			keyArray[ i - 1 ] = keyArray[ i ];
+			childArray[ i ] = childArray[ i + 1 ];
+		}
+		header.numKeys--;
+		rebuildSummaries( keyIndex );
+	}
+
+	void removeFront()
+	{
+		childArray[ 0 ] = childArray[ 1 ];
+		remove( 0 );
+	}
+
+	int splitIndex() const
+	{
+		return header.numKeys / 2;
+	}
+
+  /**
+   * Move the keys after splitIndex and the children after them to an empty node, see NonLeafNode::moveTail.
+   * The summaries of both nodes are rebuilt.
+   */
+	void moveTail( int splitIndex, BlockedNonLeafNode* dest )
+	{
+		for( int i = splitIndex + 1; i < header.numKeys; i++ )
+			dest->keyArray[ i - splitIndex - 1 ] = keyArray[ i ];
+		for( int i = splitIndex + 1; i <= header.numKeys; i++ )
+			dest->childArray[ i - splitIndex - 1 ] = childArray[ i ];
+		dest->header.numKeys = header.numKeys - splitIndex - 1;
+		header.numKeys = splitIndex;
+		dest->rebuildSummaries( 0 );
+		rebuildSummaries( splitIndex );
+	}
+
+	bool isUnderfull() const
+	{
+		return header.numKeys < SIZE / 2;
+	}
+
+	bool canLend() const
+	{
+		return header.numKeys > SIZE / 2;
+	}
+
+	bool absorb( const int& separator, const BlockedNonLeafNode* right )
+	{
+		if( header.numKeys + 1 + right->header.numKeys > SIZE )
+			return false;
+		insert( header.numKeys, separator, right->child( 0 ), right->childCount( 0 ) );
+		for( int i = 0; i < right->header.numKeys; i++ )
+			insert( header.numKeys, right->keyArray[ i ], right->child( i + 1 ), right->childCount( i + 1 ) );
+		return true;
+	}
+
+	bool canReplaceKey( int i, const int& key ) const
+	{
+		return true;
+	}
+
+	void replaceKey( int i, const int& key )
+	{
+		keyArray[ i ] = key;
+		rebuildSummaries( i );
+	}
+
+  /**
+   * Recompute the largest key of every block from the one holding key i on, and of every group.
+   */
+	void rebuildSummaries( int i )
+	{
+		int n = header.numKeys;
+		int blocks = ( n + BLOCK_KEYS - 1 ) / BLOCK_KEYS;
+		for( int b = i / BLOCK_KEYS; b < blocks; b++ )
+			blockKeys[ b ] = keyArray[ ( b + 1 ) * BLOCK_KEYS < n ? ( b + 1 ) * BLOCK_KEYS - 1 : n - 1 ];
+		int groups = ( blocks + BLOCK_KEYS - 1 ) / BLOCK_KEYS;
+		for( int g = 0; g < groups; g++ )
+			groupKeys[ g ] = blockKeys[ ( g + 1 ) * BLOCK_KEYS < blocks ? ( g + 1 ) * BLOCK_KEYS - 1 : blocks - 1 ];
+	}
+
+ private:
+  /**
+   * Position in keys[0..n) of the first key >= key, or > key if UPPER.
+   */
+	template <bool UPPER>
+	static int bound( const int* keys, int n, int key )
+	{
+		return UPPER ? NodeSearch::upperBound( keys, n, key ) : NodeSearch::lowerBound( keys, n, key );
+	}
+
+  /**
+   * Search the group summary, then the blocks of the group, then the block. Each step searches a single cache line
+   * and finds a position whose largest key is past key, so the next step cannot run off its line. A reader that
+   * sees the node halfway through a change still gets a position in [0, count()].
+   */
+	template <bool UPPER>
+	int search( int key ) const
+	{
+		int n = count();
+		int blocks = ( n + BLOCK_KEYS - 1 ) / BLOCK_KEYS;
+		int groups = ( blocks + BLOCK_KEYS - 1 ) / BLOCK_KEYS;
+		int group = bound<UPPER>( groupKeys, groups, key );
+		if( group == groups )
+			return n;
+		int firstBlock = group * BLOCK_KEYS;
+		int block = firstBlock + bound<UPPER>( blockKeys + firstBlock,
+				blocks - firstBlock < BLOCK_KEYS ? blocks - firstBlock : BLOCK_KEYS, key );
+		if( block == blocks )
+			return n;
+		int first = block * BLOCK_KEYS;
+		return first + bound<UPPER>( keyArray + first, n - first < BLOCK_KEYS ? n - first : BLOCK_KEYS, key );
+	}
+};
+
+/**
+ * @brief Structure for all leaf nodes, for keys of type T.
+*/
+template <class T>
+struct LeafNode{
+  /**
+   * Number of key slots. Header and sibling pointers take 20 bytes, a DOUBLE leaf pads them to 24 to align its
+   * high key, which fits in what rounding down leaves over.
+   */
+	//                                     header                  sibling ptrs                high key         key            rid
+	static const int SIZE = ( Page::SIZE - sizeof( NodeHeader ) - 2 * sizeof( PageId ) - sizeof( T ) ) / ( sizeof( T ) + sizeof( RecordId ) );
+
+	static const bool READ_IN_PLACE = true;
+
+  /**
+   * Pair sorted by bulk loading and batch inserts.
+   */
+	typedef RIDKeyPair<T> Entry;
+
+  /**
+   * Node header, holds level and number of keys.
+   */
+	NodeHeader header;
+
+  /**
+   * Page number of the leaf on the right side.
+	 * This linking of leaves allows to easily move from one leaf to the next leaf during index scan.
+   */
+	PageId rightSibPageNo;
+
+  /**
+   * Page number of the leaf on the left side, Page::INVALID_NUMBER for the leftmost leaf. Backward scans take
+   * it as a hint only, the leaf found there has to link back to this one.
+   */
+	PageId leftSibPageNo;
+
+  /**
+   * Separator between the leaf and its right sibling, no key of the leaf is above it. Set when header.flags has NODE_HIGH_KEY.
+   */
+	T highKey;
+
+  /**
+   * Stores keys.
+   */
+	T keyArray[ SIZE ];
+
+  /**
+   * Stores RecordIds.
+   */
+	RecordId ridArray[ SIZE ];
+
+  /**
+   * Turn a freshly allocated page into an empty leaf.
+   */
+	void init()
+	{
+		memset( (void*) this, 0, Page::SIZE );
+		header.level = -1;
+		header.version = NODE_FORMAT_VERSION;
+		header.flags = NODE_LEAF;
+		rightSibPageNo = Page::INVALID_NUMBER;
+		leftSibPageNo = Page::INVALID_NUMBER;
+	}
+
+  /**
+   * Number of entries, never more than SIZE.
+   */
+	int count() const
+	{
+		return header.numKeys < SIZE ? header.numKeys : SIZE;
+	}
+
+	bool hasHighKey() const
+	{
+		return header.flags & NODE_HIGH_KEY;
+	}
+
+  /**
+   * Set the high key, NULL for the rightmost node of a level.
+   */
+	void setHighKey( const T* key )
+	{
+		if( key == NULL )
+		{
+			header.flags &= ~NODE_HIGH_KEY;
+			return;
+		}
+		highKey = *key;
+		header.flags |= NODE_HIGH_KEY;
+	}
+
+  /**
+   * True if key belongs to a node further right, which a split moved it to before the parent heard of it.
+   * @param upper true to go right on a key equal to the high key, as an insert does
+   */
+	bool isPastHighKey( const T& key, bool upper ) const
+	{
+		return hasHighKey() && ( upper ? !( key < highKey ) : highKey < key );
+	}
+
+  /**
+   * Number of record ids in the first end entries, end itself as every entry holds one.
+   */
+	std::uint32_t entries( int end ) const
+	{
+		return end;
+	}
+
+	const T& key( int i ) const
+	{
+		return keyArray[ i ];
+	}
+
+	const RecordId& rid( int i ) const
+	{
+		return ridArray[ i ];
+	}
+
+  /**
+   * Included attributes of entry i, the leaf keeps none.
+   */
+	const char* payload( int i ) const
+	{
+		return NULL;
+	}
+
+  /**
+   * Index of the first entry with a key >= key.
+   */
+	int lowerBound( const T& key ) const
+	{
+		return NodeSearch::lowerBound( keyArray, count(), key );
+	}
+
+  /**
+   * Index of the first entry with a key > key.
+   */
+	int upperBound( const T& key ) const
+	{
+		return NodeSearch::upperBound( keyArray, count(), key );
+	}
+
+  /**
+   * True if an entry for key can be added without going over fillFactor of the leaf.
+   */
+	bool hasRoom( const T& key, double fillFactor = 1.0 ) const
+	{
+		int slots = (int)( SIZE * fillFactor );
+		return header.numKeys < ( slots < 1 ? 1 : slots );
+	}
+
+  /**
+   * Insert an entry at index i, keys must stay sorted. The leaf must have room.
+   */
+	void insert( int i, const T& key, const RecordId& rid )
+	{
+		for( int j = header.numKeys - 1; j >= i; j-- )
+		{
+			keyArray[ j + 1 ] = keyArray[ j ];
+			ridArray[ j + 1 ] = ridArray[ j ];
+		}
+		keyArray[ i ] = key;
+		ridArray[ i ] = rid;
+		header.numKeys++;
+	}
+
+	void remove( int i )
+	{
+		for( int j = i + 1; j < header.numKeys; j++ )
+		{
+			keyArray[ j - 1 ] = keyArray[ j ];
+			ridArray[ j - 1 ] = ridArray[ j ];
+		}
+		header.numKeys--;
+	}
+
+  /**
+   * Index of the first entry moved to the new leaf when a full leaf splits.
+   */
+	int splitIndex() const
+	{
+		return header.numKeys / 2;
+	}
+
+  /**
+   * Append the entries from index from on to dest, which must have room for them, and drop them here.
+   */
+	void moveTail( int from, LeafNode* dest )
+	{
+		int n = header.numKeys - from;
+		memcpy( dest->keyArray + dest->header.numKeys, keyArray + from, n * sizeof( T ) );
+		memcpy( dest->ridArray + dest->header.numKeys, ridArray + from, n * sizeof( RecordId ) );
+		dest->header.numKeys += n;
+		header.numKeys = from;
+	}
+
+  /**
+   * True if less than half of the leaf is used.
+   */
+	bool isUnderfull() const
+	{
+		return header.numKeys < SIZE / 2;
+	}
+
+  /**
+   * True if an entry can be taken from the leaf without leaving it underfull.
+   */
+	bool canLend() const
+	{
+		return header.numKeys > SIZE / 2;
+	}
+
+  /**
+   * Append all entries of the right sibling.
+   * @return false, and nothing is changed, if they do not fit
+   */
+	bool absorb( LeafNode* right )
+	{
+		if( header.numKeys + right->header.numKeys > SIZE )
+			return false;
+		right->moveTail( 0, this );
+		return true;
+	}
+
+  /**
+   * Move the first entry of the right sibling to the end of this leaf.
+   * @param separator the new separator between the two leaves
+   * @return false, and nothing is changed, if the entry does not fit
+   */
+	bool borrowFirst( LeafNode* right, const T& separator )
+	{
+		insert( header.numKeys, right->keyArray[ 0 ], right->ridArray[ 0 ] );
+		right->remove( 0 );
+		return true;
+	}
+
+  /**
+   * Move the last entry of the left sibling to the front of this leaf.
+   * @param separator the new separator between the two leaves
+   * @return false, and nothing is changed, if the entry does not fit
+   */
+	bool borrowLast( LeafNode* left, const T& separator )
+	{
+		int last = left->header.numKeys - 1;
+		insert( 0, left->keyArray[ last ], left->ridArray[ last ] );
+		left->remove( last );
+		return true;
+	}
+
+  /**
+   * Called when the separators bounding the leaf moved closer together, after a split.
+   * low and high are NULL at the edges of the tree.
+   */
+	void narrow( const T* low, const T* high )
+	{
+	}
+
+  /**
+   * Called before a bound of the leaf moves out to fence, NULL for the edge of the tree.
+   * @return false, and nothing is changed, if the entries would no longer fit
+   */
+	bool widen( const T* fence )
+	{
+		return true;
+	}
+
+  /**
+   * Copy the record ids of n entries starting at begin.
+   */
+	void copyRids( int begin, int n, RecordId* out ) const
+	{
+		memcpy( out, ridArray + begin, n * sizeof( RecordId ) );
+	}
+
+	void copyPayloads( int begin, int n, char* out ) const
+	{
+	}
+};
+
+
+/**
+ * @brief Leaf node for STRING keys. The bytes every key of the leaf starts with are stored once, in prefix,
+ * and only the rest of each key is kept, in a heap at the end of the page that slots point into. Slots stay
+ * sorted by key and grow from the front of data, the heap grows down from its end.
+ *
+ * The prefix is shared by every key that can be routed to the leaf, not only the keys it holds: it is a prefix
+ * of both separators bounding the leaf in its ancestors. Splits bring those separators closer and lengthen it
+ * (narrow), merging and moving entries between siblings moves them apart and may shorten it (widen).
+ * So an insert never has to shorten the prefix of a full leaf, and the two halves of a split always fit.
+*/
+template <>
+struct LeafNode<StringKey>{
+  /**
+   * Entry of the leaf, the key bytes after the prefix are at data + offset.
+   */
+	struct Slot{
+		RecordId rid;
+		std::uint16_t offset;
+		std::uint16_t length;
+	};
+
+	static const int SLOT_SIZE = sizeof( Slot );
+
+  /**
+   * Bytes of slots and key heap.
+   */
+	//                                    header                  sibling ptrs                prefixLength ... reserved         high key     prefix
+	static const int DATA_SIZE = Page::SIZE - sizeof( NodeHeader ) - 2 * sizeof( PageId ) - 4 * sizeof( std::uint16_t ) - STRINGSIZE - STRINGSIZE;
+
+  /**
+   * Number of entries that always fit, when keys are STRINGSIZE bytes long and share no prefix.
+   */
+	static const int SIZE = DATA_SIZE / ( SLOT_SIZE + STRINGSIZE );
+
+	static const bool READ_IN_PLACE = false;
+
+	typedef RIDKeyPair<StringKey> Entry;
+
+  /**
+   * Node header, holds level and number of keys.
+   */
+	NodeHeader header;
+
+  /**
+   * Page number of the leaf on the right side.
+   */
+	PageId rightSibPageNo;
+
+  /**
+   * Page number of the leaf on the left side, Page::INVALID_NUMBER for the leftmost leaf. Backward scans take
+   * it as a hint only, the leaf found there has to link back to this one.
+   */
+	PageId leftSibPageNo;
+
+  /**
+   * Number of bytes of prefix in use.
+   */
+	std::uint16_t prefixLength;
+
+  /**
+   * Start of the key heap in data.
+   */
+	std::uint16_t heapOffset;
+
+  /**
+   * Bytes of the heap used by the keys in the leaf, the rest up to DATA_SIZE is left by removed ones.
+   */
+	std::uint16_t heapBytes;
+
+	std::uint16_t reserved;
+
+  /**
+   * Separator between the leaf and its right sibling, no key of the leaf is above it. Set when header.flags
+   * has NODE_HIGH_KEY. Kept whole, readers check it without decoding the leaf.
+   */
+	StringKey highKey;
+
+  /**
+   * Bytes shared by all keys of the leaf.
+   */
+	char prefix[ STRINGSIZE ];
+
+  /**
+   * Slots, free space and key heap.
+   */
+	char data[ DATA_SIZE ];
+
+	void init();
+
+	int count() const
+	{
+		return header.numKeys;
+	}
+
+	bool hasHighKey() const
+	{
+		return header.flags & NODE_HIGH_KEY;
+	}
+
+	void setHighKey( const StringKey* key );
+	bool isPastHighKey( const StringKey& key, bool upper ) const;
+
+	std::uint32_t entries( int end ) const
+	{
+		return end;
+	}
+
+  /**
+   * The key of entry i, put back together from the prefix and the stored bytes.
+   */
+	StringKey key( int i ) const;
+
+	const RecordId& rid( int i ) const
+	{
+		return slots()[ i ].rid;
+	}
+
+	const char* payload( int i ) const
+	{
+		return NULL;
+	}
+
+	int lowerBound( const StringKey& key ) const;
+	int upperBound( const StringKey& key ) const;
+	bool hasRoom( const StringKey& key, double fillFactor = 1.0 ) const;
+	void insert( int i, const StringKey& key, const RecordId& rid );
+	void remove( int i );
+
+  /**
+   * Splits by bytes used, keys can differ in length.
+   */
+	int splitIndex() const;
+
+	void moveTail( int from, LeafNode* dest );
+	bool isUnderfull() const;
+	bool canLend() const;
+	bool absorb( LeafNode* right );
+	bool borrowFirst( LeafNode* right, const StringKey& separator );
+	bool borrowLast( LeafNode* left, const StringKey& separator );
+
+  /**
+   * Lengthen the prefix to the common prefix of low and high.
+   */
+	void narrow( const StringKey* low, const StringKey* high );
+
+  /**
+   * Shorten the prefix to the part fence shares with it.
+   */
+	bool widen( const StringKey* fence );
+
+	void copyRids( int begin, int n, RecordId* out ) const;
+
+	void copyPayloads( int begin, int n, char* out ) const
+	{
+	}
+
+ private:
+	Slot* slots()
+	{
+		return (Slot*) data;
+	}
+
+	const Slot* slots() const
+	{
+		return (const Slot*) data;
+	}
+
+	int usedBytes() const
+	{
+		return header.numKeys * SLOT_SIZE + heapBytes;
+	}
+
+  /**
+   * lowerBound, or upperBound if upper is true.
+   */
+	int search( const StringKey& key, bool upper ) const;
+
+  /**
+   * Bytes used once the prefix is cut to length bytes.
+   */
+	int usedBytesWithPrefix( int length ) const
+	{
+		return usedBytes() + header.numKeys * ( prefixLength - length );
+	}
+
+  /**
+   * Store the entries again with a new prefix, all keys must start with it. Also compacts the heap.
+   */
+	void rebuild( const char* newPrefix, int newPrefixLength );
+
+  /**
+   * Insert an entry whose key is known to start with the prefix and to fit in the free space.
+   */
+	void put( int i, const char* suffix, int length, const RecordId& rid );
+};
+
+
+/**
+ * @brief Non-leaf node for STRING keys. Separators are the shortest prefixes that tell the two sides of a split
+ * apart, see KeyTraits<StringKey>::separator, and take only their own length in a heap at the end of the page.
+ * Slot i holds key i and child i+1, child 0 is kept in firstChild.
+*/
+template <class Child>
+struct NonLeafNode<StringKey, Child>{
+	struct Slot{
+		std::uint16_t offset;
+		std::uint16_t length;
+		Child child;
+	};
+
+	static const int SLOT_SIZE = sizeof( Slot );
+
+	//                                    header                  firstChild             heapOffset, heapBytes            sibling ptr             high key
+	static const int DATA_SIZE = Page::SIZE - sizeof( NodeHeader ) - sizeof( Child ) - 2 * sizeof( std::uint16_t ) - sizeof( PageId ) - STRINGSIZE;
+
+  /**
+   * Number of keys that always fit, when they are STRINGSIZE bytes long.
+   */
+	static const int SIZE = DATA_SIZE / ( SLOT_SIZE + STRINGSIZE );
+
+	static const bool COUNTED = Child::COUNTED;
+
+	static const bool READ_IN_PLACE = false;
+
+	NodeHeader header;
+
+  /**
+   * Leftmost child.
+   */
+	Child firstChild;
+
+  /**
+   * Start of the key heap in data.
+   */
+	std::uint16_t heapOffset;
+
+  /**
+   * Bytes of the heap used by the keys in the node.
+   */
+	std::uint16_t heapBytes;
+
+  /**
+   * Page number of the node on the right side, on the same level.
+   */
+	PageId rightSibPageNo;
+
+  /**
+   * Separator between the node and its right sibling, no key of the node is above it. Set when header.flags has NODE_HIGH_KEY.
+   */
+	StringKey highKey;
+
+  /**
+   * Slots, free space and key heap.
+   */
+	char data[ DATA_SIZE ];
+
+	void init( int level );
+
+	int count() const
+	{
+		return header.numKeys;
+	}
+
+	bool hasHighKey() const
+	{
+		return header.flags & NODE_HIGH_KEY;
+	}
+
+	void setHighKey( const StringKey* key );
+	bool isPastHighKey( const StringKey& key, bool upper ) const;
+
+	StringKey key( int i ) const;
+
+	PageId child( int i ) const
+	{
+		return i == 0 ? firstChild.pageNo : slots()[ i - 1 ].child.pageNo;
+	}
+
+	void setChild( int i, PageId pageNo )
+	{
+		if( i == 0 )
+			firstChild.pageNo = pageNo;
+		else
+			slots()[ i - 1 ].child.pageNo = pageNo;
+	}
+
+	std::uint32_t childCount( int i ) const
+	{
+		return i == 0 ? firstChild.count() : slots()[ i - 1 ].child.count();
+	}
+
+	void setChildCount( int i, std::uint32_t n )
+	{
+		if( i == 0 )
+			firstChild.setCount( n );
+		else
+			slots()[ i - 1 ].child.setCount( n );
+	}
+
+	std::uint32_t totalCount() const
+	{
+		std::uint32_t n = firstChild.count();
+		for( int i = 0; i < header.numKeys; i++ )
+			n += slots()[ i ].child.count();
+		return n;
+	}
+
+	int lowerBound( const StringKey& key ) const;
+	int upperBound( const StringKey& key ) const;
+	bool hasRoom( const StringKey& key, double fillFactor = 1.0 ) const;
+	void insert( int keyIndex, const StringKey& key, PageId rightChild, std::uint32_t count = 0 );
+	void insertFront( const StringKey& key, PageId leftChild, std::uint32_t count = 0 );
+	void remove( int keyIndex );
+	void removeFront();
+	int splitIndex() const;
+	void moveTail( int splitIndex, NonLeafNode* dest );
+	bool isUnderfull() const;
+	bool canLend() const;
+	bool absorb( const StringKey& separator, const NonLeafNode* right );
+	bool canReplaceKey( int i, const StringKey& key ) const;
+	void replaceKey( int i, const StringKey& key );
+
+ private:
+	Slot* slots()
+	{
+		return (Slot*) data;
+	}
+
+	const Slot* slots() const
+	{
+		return (const Slot*) data;
+	}
+
+	int usedBytes() const
+	{
+		return header.numKeys * SLOT_SIZE + heapBytes;
+	}
+
+	int search( const StringKey& key, bool upper ) const;
+
+  /**
+   * Move the keys to the end of the page, dropping the bytes of removed ones.
+   */
+	void compact();
+};
+
+/**
+ * @brief Encoding of the record ids in posting lists. A list is kept sorted and every record id is stored as
+ * its difference to the one before it, in a varint of 7 bits per byte. Record ids of one key on the same or
+ * nearby pages take a byte or two each.
+ */
+struct PostingCodec{
+  /**
+   * Most bytes one record id takes, page and slot number are 48 bits.
+   */
+	static const int MAX_BYTES = 7;
+
+  /**
+   * Record id as a number, ordered by page number and then slot number.
+   */
+	static std::uint64_t value( const RecordId& rid )
+	{
+		return ( (std::uint64_t) rid.page_number << 16 ) | rid.slot_number;
+	}
+
+	static RecordId recordId( std::uint64_t value )
+	{
+		RecordId rid;
+		rid.page_number = (PageId)( value >> 16 );
+		rid.slot_number = (SlotId)( value & 0xFFFF );
+		rid.padding = 0;
+		return rid;
+	}
+
+  /**
+   * Write a difference at out.
+   * @return number of bytes written
+   */
+	static int put( char* out, std::uint64_t delta )
+	{
+		int n = 0;
+		while( delta >= 0x80 )
+		{
+			out[ n++ ] = (char)( delta | 0x80 );
+			delta >>= 7;
+		}
+		out[ n++ ] = (char) delta;
+		return n;
+	}
+
+  /**
+   * Read a difference from in.
+   * @return position after it
+   */
+	static const char* get( const char* in, std::uint64_t& delta )
+	{
+		std::uint64_t byte = (unsigned char) *in++;
+		delta = byte & 0x7F;
+		for( int shift = 7; byte & 0x80; shift += 7 )
+		{
+			byte = (unsigned char) *in++;
+			delta |= ( byte & 0x7F ) << shift;
+		}
+		return in;
+	}
+
+  /**
+   * Number of bytes put() takes for delta.
+   */
+	static int length( std::uint64_t delta )
+	{
+		int n = 1;
+		while( delta >= 0x80 )
+		{
+			delta >>= 7;
+			n++;
+		}
+		return n;
+	}
+
+  /**
+   * Number of values in bytes written by encode, the bytes that end a varint.
+   */
+	static int count( const char* in, int bytes )
+	{
+		int n = 0;
+		for( int i = 0; i < bytes; i++ )
+			n += ( in[ i ] & 0x80 ) == 0;
+		return n;
+	}
+
+  /**
+   * Encode n sorted values, the first one is stored whole.
+   * @return number of bytes written
+   */
+	static int encode( const std::uint64_t* values, int n, char* out )
+	{
+		int bytes = 0;
+		std::uint64_t last = 0;
+		for( int i = 0; i < n; i++ )
+		{
+			bytes += put( out + bytes, values[ i ] - last );
+			last = values[ i ];
+		}
+		return bytes;
+	}
+
+  /**
+   * Decode all values of the bytes written by encode.
+   * @return number of values
+   */
+	static int decode( const char* in, int bytes, std::uint64_t* out )
+	{
+		const char* end = in + bytes;
+		std::uint64_t value = 0;
+		int n = 0;
+		while( in < end )
+		{
+			std::uint64_t delta;
+			in = get( in, delta );
+			value += delta;
+			out[ n++ ] = value;
+		}
+		return n;
+	}
+};
+
+/**
+ * @brief Page of a posting list too long to be kept in its leaf. The pages of a list are chained in record id
+ * order, each one encoded on its own so it can be read and changed without the others.
+*/
+struct OverflowNode{
+	//                                    header                  next, tail              bytes, reserved                  lastValue
+	static const int DATA_SIZE = Page::SIZE - sizeof( NodeHeader ) - 2 * sizeof( PageId ) - 2 * sizeof( std::uint16_t ) - sizeof( std::uint64_t );
+
+  /**
+   * Node header, flags is NODE_OVERFLOW and numKeys the number of record ids in the page.
+   */
+	NodeHeader header;
+
+  /**
+   * Next page of the list, Page::INVALID_NUMBER on the last one.
+   */
+	PageId nextPageNo;
+
+  /**
+   * Last page of the list, kept up to date in the first page only. Record ids mostly arrive in order
+   * and are appended there.
+   */
+	PageId tailPageNo;
+
+  /**
+   * Bytes of data in use.
+   */
+	std::uint16_t bytes;
+
+	std::uint16_t reserved;
+
+  /**
+   * PostingCodec::value of the last record id in the page, so a search can pass over the page without decoding it.
+   */
+	std::uint64_t lastValue;
+
+  /**
+   * Record ids, encoded by PostingCodec.
+   */
+	char data[ DATA_SIZE ];
+
+  /**
+   * Turn a freshly allocated page into a page of a list holding the values given.
+   */
+	void init( const std::uint64_t* values, int n )
+	{
+		memset( (void*) this, 0, Page::SIZE );
+		header.version = NODE_FORMAT_VERSION;
+		header.flags = NODE_OVERFLOW;
+		nextPageNo = Page::INVALID_NUMBER;
+		tailPageNo = Page::INVALID_NUMBER;
+		set( values, n );
+	}
+
+  /**
+   * Replace the record ids of the page by n sorted values, which must fit.
+   */
+	void set( const std::uint64_t* values, int n )
+	{
+		header.numKeys = n;
+		bytes = (std::uint16_t) PostingCodec::encode( values, n, data );
+		lastValue = n > 0 ? values[ n - 1 ] : 0;
+	}
+};
+
+/**
+ * @brief Leaf node that stores every key once, with the record ids of all its entries in a posting list.
+ * Used instead of LeafNode when IndexOptions::postingLists is set, for keys with many duplicates.
+ *
+ * Slots hold the keys, sorted and each one different, and point to their lists in a heap at the end of the
+ * page. A list is encoded by PostingCodec. Once it grows past MAX_LIST_BYTES it moves to a chain of
+ * OverflowNode pages, and only the number of the first page stays in the leaf. A key and its list are never
+ * split over two leaves, the engine sees each key as one entry and the leaf as a node of unique keys.
+*/
+template <class T>
+struct PostingLeafNode{
+  /**
+   * Entry of the leaf, the list of key is at data + offset.
+   */
+	struct Slot{
+		T key;
+		std::uint16_t offset;
+		std::uint16_t length;
+	};
+
+	static const int SLOT_SIZE = sizeof( Slot );
+
+  /**
+   * Slot length of a list kept in overflow pages, the heap then holds an OverflowList.
+   */
+	static const std::uint16_t OVERFLOW_LIST = 0xFFFF;
+
+  /**
+   * What the leaf keeps of a list moved to overflow pages.
+   */
+	struct OverflowList{
+		PageId pageNo;	// first page of the chain
+		std::uint32_t entries;	// record ids in the chain
+	};
+
+  /**
+   * Bytes of slots and list heap.
+   */
+	//                                    header                  sibling ptr             heapOffset, heapBytes            left sibling ptr  high key
+	static const int DATA_SIZE = Page::SIZE - sizeof( NodeHeader ) - sizeof( PageId ) - 2 * sizeof( std::uint16_t ) - sizeof( PageId ) - sizeof( T );
+
+  /**
+   * Longest list kept in the leaf, so that a leaf always holds a few keys and its halves fit after a split.
+   */
+	static const int MAX_LIST_BYTES = DATA_SIZE / 8;
+
+  /**
+   * Number of entries that always fit, when every key has a single record id.
+   */
+	static const int SIZE = DATA_SIZE / ( SLOT_SIZE + PostingCodec::MAX_BYTES );
+
+	static const bool READ_IN_PLACE = false;
+
+	typedef RIDKeyPair<T> Entry;
+
+  /**
+   * Node header, holds level and number of keys.
+   */
+	NodeHeader header;
+
+  /**
+   * Page number of the leaf on the right side.
+   */
+	PageId rightSibPageNo;
+
+  /**
+   * Start of the list heap in data.
+   */
+	std::uint16_t heapOffset;
+
+  /**
+   * Bytes of the heap used by the lists in the leaf.
+   */
+	std::uint16_t heapBytes;
+
+  /**
+   * Page number of the leaf on the left side, Page::INVALID_NUMBER for the leftmost leaf. Backward scans take
+   * it as a hint only, the leaf found there has to link back to this one.
+   */
+	PageId leftSibPageNo;
+
+  /**
+   * Separator between the leaf and its right sibling, no key of the leaf is above it. Set when header.flags has NODE_HIGH_KEY.
+   */
+	T highKey;
+
+  /**
+   * Slots, free space and list heap.
+   */
+	char data[ DATA_SIZE ];
+
+	void init();
+
+  /**
+   * Number of keys.
+   */
+	int count() const
+	{
+		return header.numKeys;
+	}
+
+	bool hasHighKey() const
+	{
+		return header.flags & NODE_HIGH_KEY;
+	}
+
+	void setHighKey( const T* key );
+	bool isPastHighKey( const T& key, bool upper ) const;
+
+	const T& key( int i ) const
+	{
+		return slots()[ i ].key;
+	}
+
+  /**
+   * True if the list of key i is kept in overflow pages.
+   */
+	bool isOverflow( int i ) const
+	{
+		return slots()[ i ].length == OVERFLOW_LIST;
+	}
+
+  /**
+   * First overflow page of the list of key i.
+   */
+	PageId overflowPageNo( int i ) const
+	{
+		OverflowList overflow;
+		memcpy( &overflow, data + slots()[ i ].offset, sizeof( OverflowList ) );
+		return overflow.pageNo;
+	}
+
+  /**
+   * Number of record ids in the overflow pages of key i.
+   */
+	std::uint32_t overflowCount( int i ) const
+	{
+		OverflowList overflow;
+		memcpy( &overflow, data + slots()[ i ].offset, sizeof( OverflowList ) );
+		return overflow.entries;
+	}
+
+  /**
+   * Encoded list of key i, when it is kept in the leaf.
+   */
+	const char* list( int i ) const
+	{
+		return data + slots()[ i ].offset;
+	}
+
+	int listBytes( int i ) const
+	{
+		return slots()[ i ].length;
+	}
+
+  /**
+   * Number of record ids in the lists of the first end keys.
+   */
+	std::uint32_t entries( int end ) const;
+
+	int lowerBound( const T& key ) const;
+	int upperBound( const T& key ) const;
+
+  /**
+   * Index of key, -1 if the leaf does not hold it.
+   */
+	int find( const T& key ) const;
+
+  /**
+   * True if a record id for key can be added. Only a new key counts against fillFactor, the list of a key
+   * already in the leaf may grow up to a full page.
+   */
+	bool hasRoom( const T& key, double fillFactor = 1.0 ) const;
+
+  /**
+   * Insert a new key at index i, with a list of one record id. The leaf must have room.
+   */
+	void insert( int i, const T& key, const RecordId& rid );
+
+  /**
+   * Add a record id to the list of key i, kept in the leaf. The leaf must have room.
+   * @return false, and nothing is changed, if the list would grow past MAX_LIST_BYTES
+   */
+	bool insertRid( int i, const RecordId& rid );
+
+  /**
+   * Remove a record id from the list of key i, kept in the leaf. The key goes too when its list is emptied.
+   * @return false if the list does not hold rid
+   */
+	bool removeRid( int i, const RecordId& rid );
+
+  /**
+   * Decode the list of key i, kept in the leaf, into values, which has room for MAX_LIST_BYTES of them.
+   * @return number of record ids
+   */
+	int values( int i, std::uint64_t* values ) const;
+
+  /**
+   * Keep the list of key i in overflow pages from now on, or point it at a new first page.
+   */
+	void setOverflow( int i, PageId pageNo, std::uint32_t entries );
+
+  /**
+   * Remove key i and its list.
+   */
+	void remove( int i );
+
+  /**
+   * Splits by bytes used, lists differ in length.
+   */
+	int splitIndex() const;
+
+	void moveTail( int from, PostingLeafNode* dest );
+	bool isUnderfull() const;
+	bool canLend() const;
+	bool absorb( PostingLeafNode* right );
+	bool borrowFirst( PostingLeafNode* right, const T& separator );
+	bool borrowLast( PostingLeafNode* left, const T& separator );
+
+	void narrow( const T* low, const T* high )
+	{
+	}
+
+  /**
+   * False if a key of the leaf is not below fence, its list has to go on in the next leaf. Keeps bulk loading
+   * from splitting a key over two leaves.
+   */
+	bool widen( const T* fence ) const
+	{
+		return fence == NULL || header.numKeys == 0 || slots()[ header.numKeys - 1 ].key < *fence;
+	}
+
+ private:
+	Slot* slots()
+	{
+		return (Slot*) data;
+	}
+
+	const Slot* slots() const
+	{
+		return (const Slot*) data;
+	}
+
+  /**
+   * Bytes a list of the given slot length takes in the heap.
+   */
+	static int storedBytes( int length )
+	{
+		return length == OVERFLOW_LIST ? (int) sizeof( OverflowList ) : length;
+	}
+
+	int usedBytes() const
+	{
+		return header.numKeys * SLOT_SIZE + heapBytes;
+	}
+
+	int search( const T& key, bool upper ) const;
+
+  /**
+   * Insert key at index i with the list given, length is OVERFLOW_LIST for a page number. Must fit.
+   */
+	void put( int i, const T& key, const char* list, int length );
+
+  /**
+   * Replace the list of key i. Must fit.
+   */
+	void setList( int i, const char* list, int length );
+
+  /**
+   * Move the lists to the end of the page, dropping the bytes of replaced ones.
+   */
+	void compact();
+};
+
+
+/**
+ * @brief Leaf node of an index with included attributes, see IndexOptions::include. Every entry holds the bytes of
+ * the included attributes of its record next to its key and record id, so scans that only need those attributes
+ * never read the relation. Keys, record ids and payloads are kept in three arrays. All entries of an index have the
+ * same payloadSize, the number of slots follows from it and is worked out by init. STRING keys are kept whole.
+*/
+template <class T>
+struct CoveringLeafNode{
+  /**
+   * Bytes of the key, record id and payload arrays.
+   */
+	//                                    header                  sibling ptr             payloadSize, capacity            left sibling ptr  high key
+	static const int DATA_SIZE = Page::SIZE - sizeof( NodeHeader ) - sizeof( PageId ) - 2 * sizeof( std::uint16_t ) - sizeof( PageId ) - sizeof( T );
+
+  /**
+   * Number of entries that always fit, whatever the payload.
+   */
+	static const int SIZE = DATA_SIZE / ( sizeof( T ) + sizeof( RecordId ) + MAX_PAYLOAD_SIZE );
+
+	static const bool READ_IN_PLACE = false;
+
+	typedef CoveredEntry<T> Entry;
+
+  /**
+   * Node header, holds level and number of keys.
+   */
+	NodeHeader header;
+
+  /**
+   * Page number of the leaf on the right side.
+   */
+	PageId rightSibPageNo;
+
+  /**
+   * Bytes of included attributes in every entry.
+   */
+	std::uint16_t payloadSize;
+
+  /**
+   * Number of entries the leaf has room for.
+   */
+	std::uint16_t capacity;
+
+  /**
+   * Page number of the leaf on the left side, Page::INVALID_NUMBER for the leftmost leaf. Backward scans take
+   * it as a hint only, the leaf found there has to link back to this one.
+   */
+	PageId leftSibPageNo;
+
+  /**
+   * Separator between the leaf and its right sibling, no key of the leaf is above it. Set when header.flags has NODE_HIGH_KEY.
+   */
+	T highKey;
+
+  /**
+   * capacity keys, then as many record ids and payloads.
+   */
+	char data[ DATA_SIZE ];
+
+  /**
+   * Turn a freshly allocated page into an empty leaf whose entries carry payloadBytes of included attributes.
+   */
+	void init( int payloadBytes )
+	{
+		memset( (void*) this, 0, Page::SIZE );
+		header.level = -1;
+		header.version = NODE_FORMAT_VERSION;
+		header.flags = NODE_LEAF;
+		rightSibPageNo = Page::INVALID_NUMBER;
+		leftSibPageNo = Page::INVALID_NUMBER;
+		payloadSize = payloadBytes;
+		capacity = DATA_SIZE / ( sizeof( T ) + sizeof( RecordId ) + payloadBytes );
+	}
+
+	int count() const
+	{
+		return header.numKeys;
+	}
+
+	bool hasHighKey() const
+	{
+		return header.flags & NODE_HIGH_KEY;
+	}
+
+	void setHighKey( const T* key )
+	{
+		if( key == NULL )
+		{
+			header.flags &= ~NODE_HIGH_KEY;
+			return;
+		}
+		highKey = *key;
+		header.flags |= NODE_HIGH_KEY;
+	}
+
+	bool isPastHighKey( const T& key, bool upper ) const
+	{
+		return hasHighKey() && ( upper ? !( key < highKey ) : highKey < key );
+	}
+
+	std::uint32_t entries( int end ) const
+	{
+		return end;
+	}
+
+	const T& key( int i ) const
+	{
+		return keys()[ i ];
+	}
+
+	const RecordId& rid( int i ) const
+	{
+		return rids()[ i ];
+	}
+
+  /**
+   * Included attributes of entry i, payloadSize bytes.
+   */
+	const char* payload( int i ) const
+	{
+		return payloads() + i * payloadSize;
+	}
+
+	int lowerBound( const T& key ) const
+	{
+		return NodeSearch::lowerBound( keys(), count(), key );
+	}
+
+	int upperBound( const T& key ) const
+	{
+		return NodeSearch::upperBound( keys(), count(), key );
+	}
+
+	bool hasRoom( const T& key, double fillFactor = 1.0 ) const
+	{
+		int slots = (int)( capacity * fillFactor );
+		return header.numKeys < ( slots < 1 ? 1 : slots );
+	}
+
+  /**
+   * Insert an entry at index i, keys must stay sorted. The leaf must have room.
+   */
+	void insert( int i, const T& key, const RecordId& rid, const char* payload )
+	{
+		int n = header.numKeys - i;
+		memmove( keys() + i + 1, keys() + i, n * sizeof( T ) );
+		memmove( rids() + i + 1, rids() + i, n * sizeof( RecordId ) );
+		memmove( payloads() + ( i + 1 ) * payloadSize, payloads() + i * payloadSize, n * payloadSize );
+		keys()[ i ] = key;
+		rids()[ i ] = rid;
+		memcpy( payloads() + i * payloadSize, payload, payloadSize );
+		header.numKeys++;
+	}
+
+	void remove( int i )
+	{
+		int n = header.numKeys - i - 1;
+		memmove( keys() + i, keys() + i + 1, n * sizeof( T ) );
+		memmove( rids() + i, rids() + i + 1, n * sizeof( RecordId ) );
+		memmove( payloads() + i * payloadSize, payloads() + ( i + 1 ) * payloadSize, n * payloadSize );
+		header.numKeys--;
+	}
+
+	int splitIndex() const
+	{
+		return header.numKeys / 2;
+	}
+
+	void moveTail( int from, CoveringLeafNode* dest )
+	{
+		int n = header.numKeys - from;
+		int at = dest->header.numKeys;
+		memcpy( dest->keys() + at, keys() + from, n * sizeof( T ) );
+		memcpy( dest->rids() + at, rids() + from, n * sizeof( RecordId ) );
+		memcpy( dest->payloads() + at * payloadSize, payloads() + from * payloadSize, n * payloadSize );
+		dest->header.numKeys += n;
+		header.numKeys = from;
+	}
+
+	bool isUnderfull() const
+	{
+		return header.numKeys < capacity / 2;
+	}
+
+	bool canLend() const
+	{
+		return header.numKeys > capacity / 2;
+	}
+
+	bool absorb( CoveringLeafNode* right )
+	{
+		if( header.numKeys + right->header.numKeys > capacity )
+			return false;
+		right->moveTail( 0, this );
+		return true;
+	}
+
+	bool borrowFirst( CoveringLeafNode* right, const T& separator )
+	{
+		insert( header.numKeys, right->key( 0 ), right->rid( 0 ), right->payload( 0 ) );
+		right->remove( 0 );
+		return true;
+	}
+
+	bool borrowLast( CoveringLeafNode* left, const T& separator )
+	{
+		int last = left->header.numKeys - 1;
+		insert( 0, left->key( last ), left->rid( last ), left->payload( last ) );
+		left->remove( last );
+		return true;
+	}
+
+	void narrow( const T* low, const T* high )
+	{
+	}
+
+	bool widen( const T* fence )
+	{
+		return true;
+	}
+
+	void copyRids( int begin, int n, RecordId* out ) const
+	{
+		memcpy( out, rids() + begin, n * sizeof( RecordId ) );
+	}
+
+  /**
+   * Copy the payloads of n entries starting at begin, one after another.
+   */
+	void copyPayloads( int begin, int n, char* out ) const
+	{
+		memcpy( out, payload( begin ), n * payloadSize );
+	}
+
+ private:
+	T* keys()
+	{
+		return (T*) data;
+	}
+
+	const T* keys() const
+	{
+		return (const T*) data;
+	}
+
+	RecordId* rids()
+	{
+		return (RecordId*)( data + capacity * sizeof( T ) );
+	}
+
+	const RecordId* rids() const
+	{
+		return (const RecordId*)( data + capacity * sizeof( T ) );
+	}
+
+	char* payloads()
+	{
+		return data + capacity * ( sizeof( T ) + sizeof( RecordId ) );
+	}
+
+	const char* payloads() const
+	{
+		return data + capacity * ( sizeof( T ) + sizeof( RecordId ) );
+	}
+};
+
+typedef NonLeafNode<int> NonLeafNodeInt;
+typedef LeafNode<int> LeafNodeInt;
+typedef NonLeafNode<double> NonLeafNodeDouble;
+typedef LeafNode<double> LeafNodeDouble;
+typedef NonLeafNode<StringKey> NonLeafNodeString;
+typedef LeafNode<StringKey> LeafNodeString;
+
+/**
+ * @brief Number of key slots in B+Tree leaf for INTEGER key.
+ */
+const int INTARRAYLEAFSIZE = LeafNodeInt::SIZE;
+
+/**
+ * @brief Number of key slots in B+Tree non-leaf for INTEGER key.
+ */
+const int INTARRAYNONLEAFSIZE = NonLeafNodeInt::SIZE;
+
+/**
+ * @brief Number of key slots in B+Tree leaf for DOUBLE key.
+ */
+const int DOUBLEARRAYLEAFSIZE = LeafNodeDouble::SIZE;
+
+/**
+ * @brief Number of key slots in B+Tree non-leaf for DOUBLE key.
+ */
+const int DOUBLEARRAYNONLEAFSIZE = NonLeafNodeDouble::SIZE;
+
+/**
+ * @brief Number of entries a B+Tree leaf for STRING key always has room for. Shorter keys and a shared
+ * prefix make room for more.
+ */
+const int STRINGARRAYLEAFSIZE = LeafNodeString::SIZE;
+
+/**
+ * @brief Number of keys a B+Tree non-leaf for STRING key always has room for. Separators are usually
+ * much shorter than the keys, which makes room for more.
+ */
+const int STRINGARRAYNONLEAFSIZE = NonLeafNodeString::SIZE;
+
+static_assert( sizeof( LeafNodeInt ) <= Page::SIZE && sizeof( NonLeafNodeInt ) <= Page::SIZE, "INTEGER node does not fit a page" );
+static_assert( sizeof( LeafNodeDouble ) <= Page::SIZE && sizeof( NonLeafNodeDouble ) <= Page::SIZE, "DOUBLE node does not fit a page" );
+static_assert( sizeof( LeafNodeString ) <= Page::SIZE && sizeof( NonLeafNodeString ) <= Page::SIZE, "STRING node does not fit a page" );
+static_assert( sizeof( PostingLeafNode<StringKey> ) <= Page::SIZE && sizeof( OverflowNode ) <= Page::SIZE, "posting list node does not fit a page" );
+static_assert( sizeof( CoveringLeafNode<double> ) <= Page::SIZE && sizeof( CoveringLeafNode<StringKey> ) <= Page::SIZE, "covering leaf does not fit a page" );
+static_assert( sizeof( NonLeafNode<int, CountedChild> ) <= Page::SIZE && sizeof( NonLeafNode<double, CountedChild> ) <= Page::SIZE
+		&& sizeof( NonLeafNode<StringKey, CountedChild> ) <= Page::SIZE, "counted non-leaf node does not fit a page" );
+static_assert( sizeof( BlockedNonLeafNode<> ) <= Page::SIZE && sizeof( BlockedNonLeafNode<CountedChild> ) <= Page::SIZE
+		&& BlockedNonLeafNode<>::SIZE <= MAX_KEY_BLOCKS * BLOCK_KEYS, "blocked non-leaf node does not fit a page" );
+static_assert( offsetof( BlockedNonLeafNode<>, keyArray ) % BufMgr::FRAME_ALIGNMENT == 0
+		&& offsetof( BlockedNonLeafNode<>, groupKeys ) % BufMgr::FRAME_ALIGNMENT == 0, "blocked non-leaf node is not aligned to cache lines" );
+
+
+/**
+ * @brief Rightmost node of one non-leaf level while bulk loading. The tree is built
+ * bottom-up and only the node currently being filled on each level is pinned.
+*/
+template <class Inner>
+struct BulkLevel{
+  /**
+   * Page number of the first node of the level, leftmost child of the level above.
+   */
+	PageId firstPageNo;
+
+  /**
+   * Page number of the node being filled.
+   */
+	PageId pageNo;
+
+  /**
+   * The node being filled, pinned in the buffer pool.
+   */
+	Inner *node;
+};
+
+
+/**
+ * @brief Settings for building a new index, passed to the BTreeIndex constructor.
+*/
+struct IndexOptions{
+  /**
+   * Build the index by sorting the (key, rid) pairs of the relation and packing leaves left to right,
+   * then the non-leaf levels bottom-up. If false every tuple is inserted with insertEntry.
+   */
+	bool bulkLoad;
+
+  /**
+   * Fraction, in (0,1], of the key slots of each node filled by bulk loading, and of a node split by an append,
+   * see appendSplits.
+   */
+	double fillFactor;
+
+  /**
+   * Number of (key, rid) pairs sorted in memory before a sorted run is spilled to a temporary file.
+   */
+	std::size_t sortBufferEntries;
+
+  /**
+   * Store each key once in the leaves, with the record ids of its entries in a compressed posting list,
+   * see PostingLeafNode. Makes indexes on columns with few distinct values several times smaller.
+   */
+	bool postingLists;
+
+  /**
+   * Keep the number of entries below every child pointer of the non-leaf nodes, see CountedChild, so that
+   * countRange takes two descents instead of a scan. Costs non-leaf slots and a write of every node on the
+   * path of each insert and delete.
+   */
+	bool counted;
+
+  /**
+   * Attributes of the relation stored in the leaves next to each key, in this order, so that scans return them
+   * without reading the records, see CoveringLeafNode. At most MAX_INCLUDED_COLUMNS of them and MAX_PAYLOAD_SIZE
+   * bytes together. Cannot be combined with postingLists, which keep no entry per record.
+   */
+	std::vector<IncludedColumn> include;
+
+  /**
+   * Most leaves a scan reads ahead of itself along the right links, in the read-ahead thread of the index, so that
+   * a long scan of a cold index does not wait for every leaf in turn. Read-ahead starts when a scan moves to the
+   * next leaf a second time, short scans never do, and reaches twice as far each time it moves on, up to this many
+   * leaves. 0, the default, turns it off: a scan of a warm pool gains nothing from it.
+   */
+	int readAhead;
+
+  /**
+   * Lay out the non-leaf nodes of an INTEGER index as BlockedNonLeafNodes, which find a key in three cache lines
+   * for a little less fan-out. Other key types keep the sorted layout.
+   */
+	bool blockedInnerNodes;
+
+  /**
+   * Split the rightmost node of a level unevenly when an insert goes past its last key, keeping fillFactor of it
+   * and moving the rest to the new node, which the next appends fill. Ascending keys, such as timestamps, then
+   * leave their nodes full rather than half empty. Other splits stay even, a fill factor under one half too.
+   */
+	bool appendSplits;
+
+  /**
+   * Most non-leaf pages kept pinned in an UpperLevelCache of the index, so that descents find them without the
+   * buffer manager and the clock never evicts them. Whole levels are cached from the root down, as many as fit.
+   * 0 turns the cache off.
+   */
+	int pinnedUpperPages;
+
+	IndexOptions()
+		: bulkLoad(true), fillFactor(0.9), sortBufferEntries(1 << 20), postingLists(false), counted(false), readAhead(0),
+			blockedInnerNodes(false), appendSplits(true), pinnedUpperPages(16)
+	{
+	}
+};
+
+
+class BTreeIndex;
+
+/**
+ * @brief Position of a scan over a BTreeIndex. A cursor keeps the leaf it is positioned on pinned and has
+ * its own bounds, so any number of cursors can be open on one index at the same time, e.g. for the inner
+ * and outer side of a nested loop. Cursors have to be closed, or destroyed, before their index.
+ * Entries inserted while a cursor is open may or may not be returned by it. A cursor reads a copy of its leaf,
+ * taken while the leaf was unchanged, so cursors can run in threads alongside inserts and deletes. Entries that
+ * change while the cursor is on them may or may not be returned. Should the leaf be split or merged before the
+ * cursor moves on, it finds its place again by the key and record id of the last entry of the copy it passed,
+ * the first one for a backward cursor. Entries of one key keep their order in the index, so the cursor goes on
+ * strictly after it, and a run of duplicate keys over several leaves is neither repeated nor passed over. Only
+ * if every entry of that key in the copy was deleted meanwhile are entries of it in other leaves returned again.
+*/
+class BTreeCursor {
+
+	friend class BTreeIndex;
+
+ public:
+
+  /**
+   * Cursor on an index, not open yet.
+   * @param index	index to scan
+   */
+	explicit BTreeCursor(BTreeIndex *index);
+
+  /**
+   * Take over the scan of another cursor, which is left closed.
+   */
+	BTreeCursor(BTreeCursor &&other);
+
+  /**
+   * Closes the cursor if it is open.
+   */
+	~BTreeCursor();
+
+  /**
+	 * Position the cursor on the first entry that satisfies the scan criteria, closing it first if it is open.
+	 * The cursor is open afterwards even if the range is empty.
+   * @param lowVal	Low value of range, pointer to integer / double / char string
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High value of range, pointer to integer / double / char string
+   * @param highOp	High operator (LT/LTE)
+   * @return true if at least one entry satisfies the scan criteria
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values 
+   * @throws  BadScanrangeException If lowVal > highval
+	**/
+	bool open(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
+
+  /**
+	 * Position the cursor on the last entry that satisfies the scan criteria, closing it first if it is open.
+	 * next and nextBatch then return the entries from the high bound down, following the left links of the
+	 * leaves, so the top N entries of a range cost N entries however long the range is.
+   * @param lowVal	Low value of range, pointer to integer / double / char string
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High value of range, pointer to integer / double / char string
+   * @param highOp	High operator (LT/LTE)
+   * @return true if at least one entry satisfies the scan criteria
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values 
+   * @throws  BadScanrangeException If lowVal > highval
+   * @throws  BadIndexInfoException If the index keeps posting lists, which are only decoded front to back
+	**/
+	bool openBackward(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
+
+  /**
+	 * Fetch the record id of the next entry that satisfies the scan criteria, in descending key order if the
+	 * cursor was opened with openBackward.
+   * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+   * @return false if no more records, satisfying the scan criteria, are left to be scanned
+	 * @throws ScanNotInitializedException If the cursor is not open.
+	**/
+	bool next(RecordId& outRid);
+
+  /**
+	 * Included attributes of the entry last returned by next, one after another in the order of IndexOptions::include.
+	 * Points into the cursor and stays valid until it moves on. NULL if the index has no included attributes.
+	**/
+	const char* payload() const
+	{
+		return payloadPos < 0 ? NULL : (const char*) leafCopy + payloadPos;
+	}
+
+  /**
+	 * Fetch the record ids of the next entries that satisfy the scan criteria, see BTreeIndex::scanNextBatch.
+	 * In descending key order if the cursor was opened with openBackward.
+   * @return number of record ids returned, less than maxRids only once the scan is completed
+	 * @throws ScanNotInitializedException If the cursor is not open.
+	**/
+	std::size_t nextBatch(RecordId* outRids, std::size_t maxRids, char* outPayloads = NULL);
+
+  /**
+	 * Unpin the leaf the cursor is positioned on and cancel its read-ahead. Does nothing if the cursor is not open.
+	**/
+	void close();
+
+  /**
+	 * Number of leaves the cursor read ahead in the background so far, see IndexOptions::readAhead.
+	**/
+	std::uint64_t leavesReadAhead();
+
+  /**
+	 * Returns true if the cursor is open.
+	**/
+	bool isOpen() const
+	{
+		return scanExecuting;
+	}
+
+ private:
+
+	BTreeCursor(const BTreeCursor &);
+	BTreeCursor &operator=(const BTreeCursor &);
+
+	/**
+	 * Returns the low bound of the scan, the member matching T
+	 */
+	template <class T>
+	T &lowVal();
+
+	/**
+	 * Returns the high bound of the scan, the member matching T
+	 */
+	template <class T>
+	T &highVal();
+
+  /**
+   * Index scanned.
+   */
+	BTreeIndex	*index;
+
+  /**
+   * True if the cursor is open.
+   */
+	bool		scanExecuting;
+
+  /**
+   * True if the cursor was opened with openBackward, nextEntry then counts down.
+   */
+	bool		backward;
+
+  /**
+   * Index of next entry to be scanned in current leaf being scanned.
+   */
+	int			nextEntry;
+
+  /**
+   * Page number of current page being scanned.
+   */
+	PageId	currentPageNum;
+
+  /**
+   * Current Page being scanned.
+   */
+	Page		*currentPageData;
+
+  /**
+   * Low INTEGER value for scan.
+   */
+	int			lowValInt;
+
+  /**
+   * Low DOUBLE value for scan.
+   */
+	double	lowValDouble;
+
+  /**
+   * Low STRING value for scan.
+   */
+	StringKey	lowValString;
+
+  /**
+   * High INTEGER value for scan.
+   */
+	int			highValInt;
+
+  /**
+   * High DOUBLE value for scan.
+   */
+	double	highValDouble;
+
+  /**
+   * High STRING value for scan.
+   */
+	StringKey	highValString;
+	
+  /**
+   * Low Operator. Can only be GT(>) or GTE(>=).
+   */
+	Operator	lowOp;
+
+  /**
+   * High Operator. Can only be LT(<) or LTE(<=).
+   */
+	Operator	highOp;
+
+  /**
+   * Encoded record ids of the posting list being returned, on an index with posting lists. Copied out of the leaf,
+   * or one overflow page at a time, so changes to the index cannot garble a list half way through.
+   */
+	char		postingBuffer[ OverflowNode::DATA_SIZE ];
+
+  /**
+   * Next byte of postingBuffer to decode.
+   */
+	int			postingPos;
+
+  /**
+   * End of the bytes in postingBuffer.
+   */
+	int			postingEnd;
+
+  /**
+   * Last record id decoded, as a PostingCodec value.
+   */
+	std::uint64_t	postingValue;
+
+  /**
+   * Record ids of the posting list below this PostingCodec value were returned already, before its leaf changed
+   * and the list had to be found again.
+   */
+	std::uint64_t	postingSkip;
+
+  /**
+   * Overflow page the posting list goes on in, Page::INVALID_NUMBER if postingBuffer holds the rest of it.
+   */
+	PageId	overflowPageNum;
+
+  /**
+   * Version of the current page when it was copied to leafCopy.
+   */
+	std::uint32_t	leafVersion;
+
+  /**
+   * Offset in leafCopy of the included attributes of the entry last returned by next, -1 if there are none.
+   */
+	int			payloadPos;
+
+  /**
+   * Leaves the scan moved to since it was opened, sets how far it reads ahead.
+   */
+	int			leavesScanned;
+
+  /**
+   * Owner number of the read-ahead requests of the cursor, 0 until the first scan that reads ahead.
+   */
+	std::uint64_t	readAheadOwner;
+
+  /**
+   * Copy of the current page, the entries returned come from here. Moving on to the right sibling checks that the
+   * page still has leafVersion, otherwise the scan goes down from the root again to the high key of the copy.
+   */
+	std::uint64_t	leafCopy[ Page::SIZE / sizeof( std::uint64_t ) ];
+
+  /**
+   * The copy of the current page, as a leaf of the layout of the index.
+   */
+	template <class Leaf>
+	const Leaf *leaf() const
+	{
+		return (const Leaf*) leafCopy;
+	}
+};
+
+
+class BTreeRange;
+
+/**
+ * @brief BTreeIndex class. It implements a B+ Tree index on a single attribute of a
+ * relation. startScan, scanNext and endScan run one scan at a time, BTreeCursor runs
+ * any number of scans side by side.
+ *
+ * insertEntry, insertBatch, deleteEntry, lookup, contains, countRange and cursors can be used from several
+ * threads at once, using optimistic lock coupling. Every node has a version, the latch of its buffer frame.
+ * Readers do not latch: they note the version of a node, read it, and go on to the child only once the version
+ * is unchanged, starting again from the root if it is not. Writers latch the nodes they change and nothing else
+ * in the common case, a leaf with room for the insert or entries to spare for the delete. Splits, merges and the
+ * subtree counts of a counted index are not: they hold structureLatch, a mutex of the whole index, so two of them
+ * never run at once, even in unrelated parts of the tree. Readers and the common-case writers never take it.
+ *
+ * Every level is also linked left to right, as in a B-link tree: each node has the page number of its right
+ * sibling and a high key, the separator its parent has on its right. A split is made in two steps, first the node
+ * gives its upper half to a new node linked to its right and takes the separator as its high key, then the
+ * separator is added to the parent. Only one node is latched at a time, beside structureLatch. A descent that finds
+ * its key past the high key of a node, because it read the parent in between, goes right instead of starting
+ * again, so readers need not wait for a split to reach the parent. Merges latch
+ * the nodes from the root down, as do the splits of a counted index so that no entry is counted twice.
+ * The scan of startScan belongs to the index and is used by one thread. Building, opening and destroying the
+ * index are not threadsafe.
+*/
+class BTreeIndex {
+
+	friend class BTreeCursor;
+
+ private:
+
+  /**
+   * File object for the index file.
+   */
+	File		*file;
+
+  /**
+   * Buffer Manager Instance.
+   */
+	BufMgr	*bufMgr;
+
+  /**
+   * Page number of meta page.
+   */
+	PageId	headerPageNum;
+
+  /**
+   * page number of root page of B+ tree inside index file.
+   */
+	PageId	rootPageNum;
+
+  /**
+   * Datatype of attribute over which index is built.
+   */
+	Datatype	attributeType;
+
+  /**
+   * Offset of attribute, over which index is built, inside records. 
+   */
+	int 		attrByteOffset;
+
+  /**
+   * Number of keys in leaf node, depending upon the type of key.
+   */
+	int			leafOccupancy;
+
+  /**
+   * Number of keys in non-leaf node, depending upon the type of key.
+   */
+	int			nodeOccupancy;
+
+  /**
+   * Bytes of included attributes stored with each key, 0 if the index has none.
+   */
+	int			payloadBytes;
+
+	// MEMBERS SPECIFIC TO SCANNING
+
+  /**
+   * Scan run by startScan, scanNext and endScan. Other scans use cursors of their own.
+   */
+	BTreeCursor	scan;
+
+	struct IndexMetaInfo metaInfo {};
+
+  /**
+   * Settings the index was built with.
+   */
+	IndexOptions	options;
+
+	// KEY TYPE DISPATCH, bound once by the constructor from attributeType
+
+  /**
+   * Builds a new index file from the relation, build<T>.
+   */
+	void (BTreeIndex::*buildFn)(const std::string &relationName);
+
+  /**
+   * insertEntryTyped<T> for the key type of the index.
+   */
+	void (BTreeIndex::*insertEntryFn)(const void *key, const RecordId rid, const char *payload);
+
+  /**
+   * insertBatchTyped<T> for the key type of the index.
+   */
+	void (BTreeIndex::*insertBatchFn)(const std::pair<const void*, RecordId> *entries, std::size_t n, const char* const *records);
+
+  /**
+   * deleteEntryTyped<T> for the key type of the index.
+   */
+	bool (BTreeIndex::*deleteEntryFn)(const void *key, const RecordId rid);
+
+  /**
+   * startScanTyped<T> for the key type of the index.
+   */
+	bool (BTreeIndex::*startScanFn)(BTreeCursor &cursor, const void *lowVal, const Operator lowOp, const void *highVal, const Operator highOp);
+
+  /**
+   * scanNextTyped<T> for the key type of the index.
+   */
+	bool (BTreeIndex::*scanNextFn)(BTreeCursor &cursor, RecordId &outRid);
+
+  /**
+   * scanNextBatchTyped<T> for the key type of the index.
+   */
+	std::size_t (BTreeIndex::*scanNextBatchFn)(BTreeCursor &cursor, RecordId *outRids, std::size_t maxRids, char *outPayloads);
+
+  /**
+   * openBackwardTyped<T> for the key type of the index, NULL for posting lists.
+   */
+	bool (BTreeIndex::*openBackwardFn)(BTreeCursor &cursor, const void *lowVal, const Operator lowOp, const void *highVal, const Operator highOp);
+
+  /**
+   * scanPrevTyped<T> for the key type of the index.
+   */
+	bool (BTreeIndex::*scanPrevFn)(BTreeCursor &cursor, RecordId &outRid);
+
+  /**
+   * scanPrevBatchTyped<T> for the key type of the index.
+   */
+	std::size_t (BTreeIndex::*scanPrevBatchFn)(BTreeCursor &cursor, RecordId *outRids, std::size_t maxRids, char *outPayloads);
+
+  /**
+   * lookupTyped<T> for the key type of the index.
+   */
+	bool (BTreeIndex::*lookupFn)(const void *key, RecordId *outRid);
+
+  /**
+   * countRangeTyped<T> for the key type of the index.
+   */
+	std::uint64_t (BTreeIndex::*countRangeFn)(const void *lowVal, const Operator lowOp, const void *highVal, const Operator highOp);
+
+  /**
+   * refreshUpperLevels<Inner> for the non-leaf layout of the index.
+   */
+	void (BTreeIndex::*refreshUpperLevelsFn)();
+
+  /**
+   * collectStats<T, Leaf, Inner> for the layout of the index.
+   */
+	bool (BTreeIndex::*collectStatsFn)();
+
+  /**
+   * noteChange<T> for the key type of the index.
+   */
+	void (BTreeIndex::*noteChangeFn)(const void *key, int delta);
+
+  /**
+   * estimateRangeTyped<T> for the key type of the index.
+   */
+	RangeEstimate (BTreeIndex::*estimateRangeFn)(const void *lowVal, const Operator lowOp, const void *highVal, const Operator highOp);
+
+	// CONCURRENCY
+
+  /**
+   * Version of metaInfo.rootPageNo. Descents read the root page number under it, writers latch it to replace the root.
+   */
+	OptimisticLatch	rootLatch;
+
+  /**
+   * Held by the inserts and deletes that change non-leaf nodes, splitting or merging nodes or changing subtree counts.
+   * Splits and merges are serialized on it across the whole index.
+   */
+	std::mutex	structureLatch;
+
+  /**
+   * Guards the free list and writes of the meta page.
+   */
+	std::mutex	metaLatch;
+
+	// UPPER LEVELS
+
+  /**
+   * Top levels of the tree, pinned, which descents read without the buffer manager. Always allocated, with no
+   * room if IndexOptions::pinnedUpperPages is 0.
+   */
+	UpperLevelCache	*upperLevels;
+
+  /**
+   * Set when a non-leaf node is added or freed, the cached levels are read again by the holder of structureLatch
+   * before it lets go. Set too until the first descent of an opened index reads them.
+   */
+	bool	upperLevelsStale;
+
+  /**
+   * Reads leaves ahead of the cursors of the index, see IndexOptions::readAhead. Its thread is started by the
+   * first request.
+   */
+	ReadAhead	*readAhead;
+
+	// STATISTICS
+
+  /**
+   * Version of metaInfo.stats. Taken to replace the statistics or move the outer bounds of the histogram, the entry
+   * counts are added to atomically without it.
+   */
+	OptimisticLatch	statsLatch;
+
+  /**
+   * Held by the one thread collecting the statistics.
+   */
+	std::mutex	statsCollection;
+
+  /**
+   * Set by the writer that starts statsWorker, cleared by the worker when it is done.
+   */
+	bool	statsRefreshing;
+
+  /**
+   * Held by the writer starting statsWorker.
+   */
+	std::mutex	statsLaunch;
+
+  /**
+   * Collects the statistics once they went stale, beside the writers. Joined by the next writer to start it and
+   * by the destructor.
+   */
+	std::thread	statsWorker;
+
+	
+ public:
+
+  /**
+   * BTreeIndex Constructor. 
+	 * Check to see if the corresponding index file exists. If so, open the file, which only reads its meta page.
+	 * If not, create it and insert entries for every tuple in the base relation using FileScan class.
+   *
+   * @param relationName        Name of file.
+   * @param outIndexName        Return the name of index file.
+   * @param bufMgrIn						Buffer Manager Instance
+   * @param attrByteOffset			Offset of attribute, over which index is to be built, in the record
+   * @param attrType						Datatype of attribute over which index is built
+   * @param optionsIn						How to build the index if it does not exist yet. postingLists and counted have to match an existing index
+   * @throws  BadIndexInfoException     If the index file already exists for the corresponding attribute,
+   *  but values in metapage(relationName, attribute byte offset, attribute type etc.) do not match with values received through constructor parameters.
+   */
+	BTreeIndex(const std::string & relationName, std::string & outIndexName,
+						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType,
+						const IndexOptions &optionsIn = IndexOptions());
+	
+
+  /**
+   * BTreeIndex Destructor. 
+	 * End any initialized scan, flush index file, after unpinning any pinned pages, from the buffer manager
+	 * and delete file instance thereby closing the index file.
+	 * Destructor should not throw any exceptions. All exceptions should be caught in here itself. 
+	 * */
+	~BTreeIndex();
+
+
+  /**
+	 * Insert a new entry using the pair <value,rid>. 
+	 * Start from root to recursively find out the leaf to insert the entry in. The insertion may cause splitting of leaf node.
+	 * This splitting will require addition of new leaf page number entry into the parent non-leaf, which may in-turn get split.
+	 * This may continue all the way upto the root causing the root to get split. If root gets split, metapage needs to be changed accordingly.
+	 * Make sure to unpin pages as soon as you can.
+	 * An insert that fits its leaf latches only the leaf, one that splits latches the split node and then its
+	 * parent, see the B-link tree above.
+   * @param key			Key to insert, pointer to integer/double/char string
+   * @param rid			Record ID of a record whose entry is getting inserted into the index.
+   * @param record	The record itself, its included attributes are stored with the key. Only looked at, and then
+   *  needed, if the index has IndexOptions::include
+   * @throws  BadIndexInfoException If the index has included attributes and record is NULL
+	**/
+	void insertEntry(const void* key, const RecordId rid, const char* record = NULL);
+
+
+  /**
+	 * Insert many entries at once, giving the same index as inserting them one by one with insertEntry.
+	 * The batch is sorted and the tree is walked once from left to right: a descent finds the leaf of the
+	 * smallest key left, and all following keys that belong in the same leaf are inserted while it stays pinned
+	 * and latched. A full leaf is split once and the descent is repeated for the keys after it.
+   * @param entries	Pairs of key, pointer to integer/double/char string, and record id of the entries to insert
+   * @param n				Number of entries
+   * @param records	The record of each entry, needed if the index has IndexOptions::include, see insertEntry
+   * @throws  BadIndexInfoException If the index has included attributes and records is NULL
+	**/
+	void insertBatch(const std::pair<const void*, RecordId>* entries, std::size_t n, const char* const* records = NULL);
+
+
+  /**
+	 * Delete the entry <key,rid>.
+	 * Every subtree that can hold key is searched for the entry, so rid is found among any number of equal keys.
+	 * A node left less than half full takes an entry from a sibling under the same parent, or is merged with it
+	 * if the sibling has none to spare. Merges remove a separator from the parent, which may underflow in turn.
+	 * A root without keys is replaced by its only child. Pages freed by merges go on the free list of the meta page
+	 * and are reused by later splits.
+	 * A delete that leaves its leaf at least half full latches only the leaf, others latch the path from the root.
+   * @param key			Key to delete, pointer to integer/double/char string
+   * @param rid			Record ID of the record whose entry is deleted
+   * @return false if the index has no entry <key,rid>
+	**/
+	bool deleteEntry(const void* key, const RecordId rid);
+
+
+  /**
+	 * Find an entry with the given key. One descent from the root to the leaf the key belongs in, the leaf is
+	 * binary searched and unpinned before returning, no scan is set up. Does not touch the scan of startScan.
+	 * Takes no latches, the descent starts again if a node it passed was changed by another thread.
+   * @param key			Key to look up, pointer to integer/double/char string
+   * @param outRid	Record ID of the first entry with the key returned in this, in record id order for an index
+   *  with posting lists and in insertion order otherwise
+   * @return false if the index has no entry with the key
+	**/
+	bool lookup(const void* key, RecordId& outRid);
+
+
+  /**
+	 * Check whether the index has an entry with the given key, like lookup without returning the record id.
+   * @param key			Key to look up, pointer to integer/double/char string
+   * @return true if the index has an entry with the key
+	**/
+	bool contains(const void* key);
+
+
+  /**
+	 * Count the entries whose keys satisfy the bounds, as many as a scan with the same bounds returns.
+	 * An index built with IndexOptions::counted answers from the subtree counts of its non-leaf nodes, with one
+	 * descent for each bound, which take no latches like lookup. Other indexes scan the range with a cursor.
+	 * Does not touch the scan of startScan.
+   * @param lowVal	Low value of range, pointer to integer / double / char string
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High value of range, pointer to integer / double / char string
+   * @param highOp	High operator (LT/LTE)
+   * @return number of entries in the range, 0 if there are none
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values 
+   * @throws  BadScanrangeException If lowVal > highval
+	**/
+	std::uint64_t countRange(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
+
+
+  /**
+	 * Number of non-leaf pages kept pinned for descents, see IndexOptions::pinnedUpperPages.
+	**/
+	std::size_t cachedUpperPages() const
+	{
+		return upperLevels->size();
+	}
+
+
+  /**
+	 * Estimate the size of a range from the statistics of the index, without reading a page, so that a query can
+	 * choose between a scan of the index and a FileScan of the relation in microseconds. The histogram buckets the
+	 * range covers count whole, those it takes part of count in proportion, an equality range counts as the average
+	 * key of its bucket. An index whose statistics were never collected, one opened from an older file, collects
+	 * them first.
+   * @param lowVal	Low value of range, pointer to integer / double / char string
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High value of range, pointer to integer / double / char string
+   * @param highOp	High operator (LT/LTE)
+   * @return estimated entries of the range, the fraction of the index they are and the leaves they take
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values 
+   * @throws  BadScanrangeException If lowVal > highval
+	**/
+	RangeEstimate estimateRange(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
+
+
+  /**
+	 * The statistics of the index, see IndexStats. A bulk load gathers them while it packs the leaves. They are
+	 * collected again in the background once a quarter of the entries changed since the last walk, and written to
+	 * the meta page then and when the index is closed.
+	**/
+	IndexStats statistics();
+
+
+  /**
+	 * Collect the statistics of the index now, walking every node. Inserts and deletes go on beside the walk,
+	 * which starts over should a split or merge move a node under it. After OPTIMISTIC_ATTEMPTS walks the
+	 * statistics there were are kept, the changes still count towards the next walk.
+	**/
+	void refreshStats();
+
+
+  /**
+	 * Begin a filtered scan of the index.  For instance, if the method is called 
+	 * using ("a",GT,"d",LTE) then we should seek all entries with a value 
+	 * greater than "a" and less than or equal to "d".
+	 * If another scan is already executing, that needs to be ended here.
+	 * Set up all the variables for scan. Start from root to find out the leaf page that contains the first RecordID
+	 * that satisfies the scan parameters. Keep that page pinned in the buffer pool.
+	 * Empty ranges are common in some workloads, tryStartScan reports them without an exception.
+   * @param lowVal	Low value of range, pointer to integer / double / char string
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High value of range, pointer to integer / double / char string
+   * @param highOp	High operator (LT/LTE)
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values 
+   * @throws  BadScanrangeException If lowVal > highval
+	 * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
+	**/
+	void startScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
+
+
+  /**
+	 * Fetch the record id of the next index entry that matches the scan.
+	 * Return the next record from current page being scanned. If current page has been scanned to its entirety, move on to the right sibling of current page, if any exists, to start scanning that page. Make sure to unpin any pages that are no longer required.
+   * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	 * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+	**/
+	void scanNext(RecordId& outRid);  // returned record id
+
+
+  /**
+	 * Included attributes of the entry last returned by scanNext or tryScanNext, see BTreeCursor::payload.
+	 * Index-only scans read them instead of fetching the record.
+   * @return payloadSize() bytes, the attributes of IndexOptions::include one after another, NULL if the index has none
+	**/
+	const char* scanPayload() const
+	{
+		return scan.payload();
+	}
+
+
+  /**
+	 * Bytes of included attributes stored with each key, 0 if the index has none.
+	**/
+	int payloadSize() const
+	{
+		return payloadBytes;
+	}
+
+
+  /**
+	 * Begin a filtered scan of the index like startScan, but report an empty range by returning false instead of
+	 * throwing NoSuchKeyFoundException. The scan is started either way and has to be ended with endScan.
+   * @return true if at least one entry satisfies the scan criteria
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values 
+   * @throws  BadScanrangeException If lowVal > highval
+	**/
+	bool tryStartScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
+
+
+  /**
+	 * Fetch the record id of the next index entry that matches the scan like scanNext, but report the end of the
+	 * scan by returning false instead of throwing IndexScanCompletedException.
+   * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+   * @return false if no more records, satisfying the scan criteria, are left to be scanned
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	**/
+	bool tryScanNext(RecordId& outRid);
+
+
+  /**
+	 * Scan the index with a range-based for loop, for (RecordId rid : index.range(&lo, GTE, &hi, LT)).
+	 * The range runs a cursor of its own, it does not touch the scan of startScan.
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values 
+   * @throws  BadScanrangeException If lowVal > highval
+	**/
+	BTreeRange range(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
+
+
+  /**
+	 * Fetch the record ids of the next index entries that match the scan, up to maxRids of them.
+	 * The matching slice of each leaf is found with a binary search on the bounds and its record ids are copied
+	 * out in one go, so the scan operators are not looked at per entry. Can be mixed with scanNext.
+   * @param outRids	array of at least maxRids record ids the matching entries are returned in
+   * @param maxRids	most record ids to return
+   * @param outPayloads	if not NULL, room for maxRids times payloadSize() bytes, the included attributes of the
+   *  entries are copied here in the order of their record ids
+   * @return number of record ids returned, less than maxRids only once the scan is completed, 0 after that
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	**/
+	std::size_t scanNextBatch(RecordId* outRids, std::size_t maxRids, char* outPayloads = NULL);
+
+
+  /**
+	 * Terminate the current scan. Unpin any pinned pages. Reset scan specific variables.
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	**/
+	void endScan();
+
+	// ADDITIONAL METHODS
+	/**
+	 * Point the dispatch members at the implementations for key type T and set the node occupancies
+	 */
+	template <class T>
+	void bindKeyType();
+
+	/**
+	 * Pick the non-leaf layout for Leaf, with or without subtree counts
+	 */
+	template <class T, class Leaf>
+	void bindLeafLayout();
+
+	/**
+	 * Bind the sorted non-leaf layout with children of type Child
+	 */
+	template <class Leaf, class Child, class T>
+	void bindInnerLayout(const T*);
+
+	/**
+	 * Bind the sorted or, if IndexOptions::blockedInnerNodes is set, the blocked non-leaf layout for INTEGER keys
+	 */
+	template <class Leaf, class Child>
+	void bindInnerLayout(const int*);
+
+	/**
+	 * Point the dispatch members shared by all node layouts at the implementations for Leaf and Inner
+	 */
+	template <class T, class Leaf, class Inner>
+	void bindLayout();
+
+	/**
+	 * Point the scan dispatch members at the implementations for array leaves
+	 */
+	template <class T, class Inner>
+	void bindScan(const LeafNode<T>*);
+
+	/**
+	 * Point the scan dispatch members at the implementations for posting list leaves
+	 */
+	template <class T, class Inner>
+	void bindScan(const PostingLeafNode<T>*);
+
+	/**
+	 * Point the scan dispatch members at the implementations for leaves with included attributes
+	 */
+	template <class T, class Inner>
+	void bindScan(const CoveringLeafNode<T>*);
+
+	/**
+	 * Turn a freshly allocated page into an empty leaf
+	 */
+	template <class Leaf>
+	void initLeaf(Leaf *leafNode);
+
+	/**
+	 * Turn a freshly allocated page into an empty leaf with room for the included attributes of the index
+	 */
+	template <class T>
+	void initLeaf(CoveringLeafNode<T> *leafNode);
+
+	/**
+	 * Copy the included attributes of a record one after another
+	 * @param out	room for payloadBytes
+	 * @return out, NULL if the index has no included attributes
+	 * @throws  BadIndexInfoException If the index has included attributes and record is NULL
+	 */
+	const char* gatherPayload(const char *record, char *out);
+
+	/**
+	 * Take the included attributes of entry from its record, pairs of an index without them have none
+	 */
+	template <class T>
+	void includeColumns(RIDKeyPair<T> &entry, const char *record);
+
+	template <class T>
+	void includeColumns(CoveredEntry<T> &entry, const char *record);
+
+	/**
+	 * Build a new index file, bulk loading or inserting tuple by tuple as options say
+	 * @param relationName name of the relation to index
+	 */
+	template <class T, class Leaf, class Inner>
+	void build(const std::string &relationName);
+
+	/**
+	 * insertEntry for an index on keys of type T
+	 */
+	template <class T, class Leaf, class Inner>
+	void insertEntryTyped(const void *key, const RecordId rid, const char *payload);
+
+	/**
+	 * insertBatch for an index on keys of type T
+	 */
+	template <class T, class Leaf, class Inner>
+	void insertBatchTyped(const std::pair<const void*, RecordId> *entries, std::size_t n, const char* const *records);
+
+	/**
+	 * Descend from the root to the leaf key is inserted into and latch it. Called under structureLatch. The non-leaf
+	 * nodes are pinned, and latched too if the index is counted. Those above one with room for any separator are
+	 * released again, unless the index is counted
+	 * @param path		the non-leaf nodes still pinned are returned in this
+	 * @param depth		number of entries of path
+	 * @param pageNo	the leaf, latched and pinned, is returned in pageNo and page
+	 * @param fences	separators bounding the leaf returned in this
+	 */
+	template <class T, class Inner>
+	void latchForInsert(const T &key,PathEntry *path,int &depth,PageId &pageNo,Page *&page,KeyFences<T> &fences);
+
+	/**
+	 * Descend from the root to a leaf without latching, checking the version of every node passed and going right
+	 * past the high keys of nodes split since their parent was read
+	 * @param upper		go to the child of upperBound, that of lowerBound otherwise, and right past a high key equal to key
+	 * @param pageNo	the leaf, pinned, is returned in pageNo and page
+	 * @param version	version of the leaf the descent checked against
+	 * @param fences	if not NULL, separators bounding the leaf returned in this
+	 * @param countLeft	if not NULL, entries below the children left of the path returned in this
+	 * @return false, with nothing pinned, if a node changed and the descent has to start again
+	 */
+	template <class T, class Leaf, class Inner>
+	bool descendOptimistic(const T &key,bool upper,PageId &pageNo,Page *&page,std::uint32_t &version,KeyFences<T> *fences,std::uint64_t *countLeft);
+
+	/**
+	 * A node to read without latching it, the page itself for layouts that are read in place, otherwise a copy
+	 * @param copy		room for a page to copy the node to
+	 * @return NULL if the node changed while it was copied
+	 */
+	template <class Node>
+	const Node* readNode(Page *page,std::uint32_t version,std::uint64_t *copy);
+
+	/**
+	 * Move from a node to a page read from it, a child or right sibling, without latching
+	 * @param pageNo	the node, pinned, replaced by the next page, pinned, when true is returned
+	 * @param version	version of the node the page number was read at, replaced by that of the next page
+	 * @param nextPageNo	page to move to
+	 * @return false, with nothing pinned, if the node changed
+	 */
+	bool couple(PageId &pageNo,Page *&page,std::uint32_t &version,PageId nextPageNo);
+
+	/**
+	 * couple() for a descent, whose non-leaf nodes may come from the upper level cache
+	 * @param pinned	true if the node was pinned by the descent, replaced by that of the next page
+	 * @param cacheVersion	version of the upper level cache at the start of the descent
+	 */
+	bool couple(PageId &pageNo,Page *&page,std::uint32_t &version,PageId nextPageNo,bool &pinned,std::uint32_t cacheVersion);
+
+	/**
+	 * Page of a node for a descent, from the upper level cache or else read through the buffer manager
+	 * @return true if the page was read, and pinned, false if it came from the cache
+	 */
+	bool enterNode(PageId pageNo,Page *&page);
+
+	/**
+	 * Let go of a page returned by enterNode
+	 */
+	void leaveNode(PageId pageNo,bool pinned);
+
+	/**
+	 * Read the levels of the upper level cache again if a non-leaf node was added or freed. Called with
+	 * structureLatch held, or before the index is shared, so the non-leaf levels do not change meanwhile
+	 */
+	template <class Inner>
+	void refreshUpperLevels();
+
+	/**
+	 * Read the levels of the upper level cache for the first descents after the index was opened, unless a writer
+	 * holds structureLatch, which reads them itself
+	 */
+	void loadUpperLevels();
+
+	/**
+	 * Walk the tree and replace the statistics of the index, then write them to the meta page. Every node is read
+	 * in a copy taken while it was unchanged, without structureLatch. Returns false, keeping the statistics there
+	 * were, if a merge freed or moved a node the walk was about to read
+	 */
+	template <class T, class Leaf, class Inner>
+	bool collectStats();
+
+	/**
+	 * Height and the non-leaf figures of stats, from the levels along the right links. Sets firstPageNo to the
+	 * leftmost leaf. False if a node is not on the level the walk is on
+	 */
+	template <class Inner>
+	bool collectLevels(IndexStats &stats,PageId &firstPageNo);
+
+	/**
+	 * The leaf figures and the histogram of stats from the chain of leaves starting at firstPageNo. False if
+	 * the keys of the chain go backwards
+	 * @param expected	entries the histogram is cut into HISTOGRAM_BUCKETS for
+	 */
+	template <class T, class Leaf>
+	bool collectLeaves(PageId firstPageNo,std::int64_t expected,IndexStats &stats);
+
+	/**
+	 * Add entries of key, at least the last key added, to the histogram of stats. A bucket that holds depth
+	 * entries ends at the next new key
+	 */
+	template <class T>
+	static void countStatsKey(IndexStats &stats,const T &key,std::int64_t entries,std::int64_t depth,std::int64_t &inBucket);
+
+	/**
+	 * Copy of page pageNo, taken while it was unchanged
+	 */
+	void copyPage(PageId pageNo,std::uint64_t *copy);
+
+	/**
+	 * Replace the statistics of the index with stats and write them to the meta page. The changes counted since
+	 * the walk began are kept for the next one
+	 * @param changes	metaInfo.stats.changes when the walk began
+	 */
+	void publishStats(IndexStats &stats,std::int64_t changes);
+
+	/**
+	 * Body of statsWorker
+	 */
+	void refreshStatsInBackground();
+
+	/**
+	 * Number of entries in slot i of a leaf with an entry per record
+	 */
+	template <class Leaf>
+	std::int64_t slotEntries(const Leaf *leafNode, int i);
+
+	/**
+	 * Number of record ids in the list of key i of a posting leaf
+	 */
+	template <class T>
+	std::int64_t slotEntries(const PostingLeafNode<T> *leafNode, int i);
+
+	/**
+	 * Add delta to the entries of the statistics and of the bucket of key, moving the outer bounds of the
+	 * histogram to a new key outside them
+	 */
+	template <class T>
+	void noteChange(const void *key, int delta);
+
+	/**
+	 * Start statsWorker if enough entries changed since the last walk and it is not running. Called by inserts and
+	 * deletes once they let go of every latch
+	 */
+	void refreshStatsIfStale();
+
+	/**
+	 * Bucket of the histogram of stats that holds key
+	 */
+	template <class T>
+	static int findBucket(const IndexStats &stats, const T &key);
+
+	/**
+	 * Bound i of the histogram of stats, as a key of type T
+	 */
+	template <class T>
+	static T statsBound(const IndexStats &stats, int i);
+
+	template <class T>
+	static void setStatsBound(IndexStats &stats, int i, const T &key);
+
+	/**
+	 * Fraction of the entries of bucket b of stats that are below key, or not above it if inclusive
+	 */
+	template <class T>
+	static double bucketBelow(const IndexStats &stats, int b, const T &key, bool inclusive);
+
+	/**
+	 * estimateRange for an index on keys of type T
+	 */
+	template <class T>
+	RangeEstimate estimateRangeTyped(const void *lowVal, const Operator lowOp, const void *highVal, const Operator highOp);
+
+	/**
+	 * Latch the leaf key is inserted into after an optimistic descent, without latching anything above it
+	 * @param pageNo	the leaf, latched and pinned, is returned in pageNo and page
+	 * @param fences	if not NULL, separators bounding the leaf returned in this
+	 * @return false, with nothing pinned, if other threads kept changing the path
+	 */
+	template <class T, class Leaf, class Inner>
+	bool latchLeaf(const T &key,PageId &pageNo,Page *&page,KeyFences<T> *fences);
+
+	/**
+	 * Where the entry <key,rid> is, as far as one leaf tells
+	 */
+	enum EntryLocation
+	{
+		ENTRY_HERE,	/* In this leaf, for a posting leaf the list of key is */
+		ENTRY_ABSENT,	/* Not in the index */
+		ENTRY_FURTHER_RIGHT	/* Equal keys go on into the leaf on the right */
+	};
+
+	/**
+	 * locateEntry for leaves with an entry per record, LeafNode and CoveringLeafNode
+	 */
+	template <class T, class Leaf>
+	EntryLocation locateEntry(const Leaf *leafNode, const T &key, const RecordId rid);
+
+	template <class T>
+	EntryLocation locateEntry(const PostingLeafNode<T> *leafNode, const T &key, const RecordId rid);
+
+	/**
+	 * Find the leaf holding the entry <key,rid> after an optimistic descent and latch it
+	 * @param pageNo	the leaf, latched and pinned, is returned in pageNo and page if found
+	 * @param found		returns true if the leaf was found, false if the index has no such entry
+	 * @return false, with nothing pinned, if other threads kept changing the path
+	 */
+	template <class T, class Leaf, class Inner>
+	bool latchEntry(const T &key,const RecordId rid,PageId &pageNo,Page *&page,bool &found);
+
+	/**
+	 * Add entries to the subtree counts along a descent path, in a counted index
+	 * @param delta entries added, negative if removed
+	 */
+	template <class Inner>
+	void countPath(PathEntry *path,int depth,int delta);
+
+	/**
+	 * Split a full leaf, insert the entry into the half it belongs in and add the new leaf to its parent,
+	 * splitting non-leaf nodes up the path as needed. Each node split is released before its parent is latched,
+	 * unless the index is counted. Releases the leaf and every node of path
+	 * @param fences separators bounding the leaf
+	 */
+	template <class T, class Leaf, class Inner>
+	void splitAndInsert(Leaf *leafNode,PageId pageNo,const T &key,const RecordId rid,const char *payload,PathEntry *path,int depth,const KeyFences<T> &fences);
+
+	/**
+	 * deleteEntry for an index on keys of type T
+	 */
+	template <class T, class Leaf, class Inner>
+	bool deleteEntryTyped(const void *key, const RecordId rid);
+
+	/**
+	 * Remove an entry from the subtree of a pinned node, rebalancing any child left underfull. Called with
+	 * structureLatch held, latches only the nodes it changes below page: leaves, the children it rebalances
+	 * and their siblings, and every node when subtree counts change
+	 * @param page root of the subtree, stays pinned
+	 * @param key key of the entry
+	 * @param rid rid of the entry
+	 * @param latched whether page is latched, set when a child is rebalanced and page is latched to change it
+	 * @return true if the entry was found and removed
+	 */
+	template <class T, class Leaf, class Inner>
+	bool removeEntry(Page *page, const T &key, const RecordId rid, bool &latched);
+
+	/**
+	 * Remove the entry <key,rid> from a leaf with an entry per record
+	 * @return true if the entry was found and removed
+	 */
+	template <class T, class Leaf>
+	bool removeFromLeaf(Leaf *leafNode, const T &key, const RecordId rid);
+
+	/**
+	 * Remove rid from the posting list of key, freeing the overflow pages it empties
+	 * @return true if the entry was found and removed
+	 */
+	template <class T>
+	bool removeFromLeaf(PostingLeafNode<T> *leafNode, const T &key, const RecordId rid);
+
+	/**
+	 * Refill a leaf that is less than half full from its sibling under the same parent, by taking
+	 * an entry from the sibling or merging the two. Releases the leaf and its sibling
+	 * @param parent parent of the leaf, latched and pinned by the caller
+	 * @param childIndex child slot of the leaf in parent
+	 * @param child the leaf, latched and pinned
+	 */
+	template <class T, class Leaf, class Inner>
+	void rebalanceLeaf(Inner *parent, int childIndex, Leaf *child);
+
+	/**
+	 * Refill a non-leaf node that is less than half full from its sibling under the same parent,
+	 * rotating a key through the parent or merging the two around their separator. Releases the node and its sibling
+	 * @param parent parent of the node, latched and pinned by the caller
+	 * @param childIndex child slot of the node in parent
+	 * @param child the node, latched and pinned
+	 */
+	template <class T, class Inner>
+	void rebalanceNonLeaf(Inner *parent, int childIndex, Inner *child);
+
+	/**
+	 * Close a cursor and give it the bounds of a new scan, checking them first
+	 * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values 
+	 * @throws  BadScanrangeException If lowVal > highval
+	 */
+	template <class T>
+	void setScanBounds(BTreeCursor &cursor, const void *lowVal, const Operator lowOp, const void *highVal, const Operator highOp);
+
+	/**
+	 * BTreeCursor::open for an index on keys of type T
+	 */
+	template <class T, class Leaf, class Inner>
+	bool startScanTyped(BTreeCursor &cursor, const void *lowVal, const Operator lowOp, const void *highVal, const Operator highOp);
+
+	/**
+	 * BTreeCursor::openBackward for an index on keys of type T
+	 */
+	template <class T, class Leaf, class Inner>
+	bool openBackwardTyped(BTreeCursor &cursor, const void *lowVal, const Operator lowOp, const void *highVal, const Operator highOp);
+
+	/**
+	 * BTreeCursor::next for a cursor opened with openBackward
+	 */
+	template <class T, class Leaf, class Inner>
+	bool scanPrevTyped(BTreeCursor &cursor, RecordId &outRid);
+
+	/**
+	 * BTreeCursor::nextBatch for a cursor opened with openBackward
+	 */
+	template <class T, class Leaf, class Inner>
+	std::size_t scanPrevBatchTyped(BTreeCursor &cursor, RecordId *outRids, std::size_t maxRids, char *outPayloads);
+
+	/**
+	 * Move a backward cursor onto the entry at its nextEntry, going left past leaves that are used up
+	 * @return true if that entry is within the low bound of the scan, false if the scan is completed
+	 */
+	template <class T, class Leaf, class Inner>
+	bool positionBackward(BTreeCursor &cursor);
+
+	/**
+	 * Move a cursor on to the leaf left of its copy, at its last entry within the high bound. Takes the left link if
+	 * the leaf there still links back to the unchanged leaf of the copy, otherwise goes down from the root again to
+	 * the first key of the copy and on to the entry before the first one of the copy
+	 * @return false, and the cursor stays where it is, if the copy is of the first leaf
+	 */
+	template <class T, class Leaf, class Inner>
+	bool prevLeaf(BTreeCursor &cursor);
+
+	/**
+	 * BTreeCursor::next for an index on keys of type T
+	 */
+	template <class T, class Leaf, class Inner>
+	bool scanNextTyped(BTreeCursor &cursor, RecordId &outRid);
+
+	/**
+	 * Move a cursor onto the entry at its nextEntry, going right past leaves that are used up
+	 * @return true if that entry is within the high bound of the scan, false if the scan is completed
+	 */
+	template <class T, class Leaf, class Inner>
+	bool positionScan(BTreeCursor &cursor);
+
+	/**
+	 * Descend to the leaf of key without latching and position a cursor on a copy of it, nothing else of the
+	 * cursor is set. Starts again until the copy is taken while the leaf is unchanged
+	 * @param upper		descend like an insert of key, like a search for the first entry >= key otherwise
+	 */
+	template <class T, class Leaf, class Inner>
+	void seekLeaf(BTreeCursor &cursor, const T &key, bool upper);
+
+	/**
+	 * Copy the current page of a cursor to its leafCopy
+	 * @param version	version of the page the copy is checked against
+	 * @return false if the page changed meanwhile
+	 */
+	bool copyLeaf(BTreeCursor &cursor, std::uint32_t version);
+
+	/**
+	 * Count a move of the cursor to the next leaf and read ahead the leaves after it, further the longer the scan.
+	 * A backward cursor reads ahead along the left links.
+	 */
+	template <class Leaf>
+	void readAheadFrom(BTreeCursor &cursor);
+
+	/**
+	 * ReadAhead::NextPageFn following the right link of a leaf, Page::INVALID_NUMBER if the page is no live leaf
+	 * or changed while it was read.
+	 */
+	template <class Leaf>
+	static PageId rightLink(BufMgr *bufMgr, Page *page);
+
+	/**
+	 * ReadAhead::NextPageFn following the left link of a leaf, like rightLink.
+	 */
+	template <class Leaf>
+	static PageId leftLink(BufMgr *bufMgr, Page *page);
+
+	/**
+	 * Move a cursor on to the leaf right of its copy, at the first entry it has not returned. Goes down from
+	 * the root again, see resumeAfter, if the leaf was split or merged since it was copied
+	 * @return false, and the cursor stays where it is, if the copy is of the last leaf
+	 */
+	template <class T, class Leaf, class Inner>
+	bool nextLeaf(BTreeCursor &cursor);
+
+	/**
+	 * Position a cursor whose leaf is unpinned on the entry after the last one it passed
+	 * @param key	last key of the copy
+	 * @param run	record ids of the entries of key in the copy, in order. Empty for keys that are unique
+	 * @param runFromLeft	whether the copy began with key, the cursor may have passed entries of it in earlier leaves
+	 */
+	template <class T, class Leaf, class Inner>
+	void resumeAfter(BTreeCursor &cursor, const T &key, const RecordId *run, int runLength, bool runFromLeft);
+
+	/**
+	 * Record ids of the entries with the last key of a leaf, in order. Returns their number
+	 */
+	template <class Leaf>
+	static int lastRun(const Leaf *leafNode, RecordId *run);
+
+	/**
+	 * Keys are unique in posting leaves, returns 0
+	 */
+	template <class T>
+	static int lastRun(const PostingLeafNode<T> *leafNode, RecordId *run);
+
+	/**
+	 * Position in run of the record id of entry i of a leaf, -1 if it is not there
+	 */
+	template <class Leaf>
+	static int runIndex(const Leaf *leafNode, int i, const RecordId *run, int runLength);
+
+	/**
+	 * Posting leaves have no runs, see lastRun. Returns -1
+	 */
+	template <class T>
+	static int runIndex(const PostingLeafNode<T> *leafNode, int i, const RecordId *run, int runLength);
+
+	/**
+	 * Find the first entry with key, outRid may be NULL if only its presence is asked for
+	 */
+	template <class T, class Leaf, class Inner>
+	bool lookupTyped(const void *key, RecordId *outRid);
+
+	/**
+	 * countRange for an index on keys of type T
+	 */
+	template <class T, class Leaf, class Inner>
+	std::uint64_t countRangeTyped(const void *lowVal, const Operator lowOp, const void *highVal, const Operator highOp);
+
+	/**
+	 * Number of entries with a key below key, or not above it if inclusive, from the subtree counts
+	 * of a single descent
+	 */
+	template <class T, class Leaf, class Inner>
+	std::uint64_t countBelow(const T &key, bool inclusive);
+
+	/**
+	 * Record id of the entry in slot i of a leaf with an entry per record
+	 */
+	template <class Leaf>
+	RecordId firstRid(const Leaf *leafNode, int i);
+
+	/**
+	 * Lowest record id in the list of key i of a posting leaf, read from the first overflow page if the list
+	 * was moved out of the leaf. The caller checks the version of the leaf afterwards
+	 */
+	template <class T>
+	RecordId firstRid(const PostingLeafNode<T> *leafNode, int i);
+
+	/**
+	 * BTreeCursor::nextBatch for an index on keys of type T
+	 */
+	template <class T, class Leaf, class Inner>
+	std::size_t scanNextBatchTyped(BTreeCursor &cursor, RecordId *outRids, std::size_t maxRids, char *outPayloads);
+
+	/**
+	 * BTreeCursor::next for an index with posting lists. The key is only checked against the high bound
+	 * when the cursor moves on to the next list
+	 */
+	template <class T, class Inner>
+	bool scanNextPosting(BTreeCursor &cursor, RecordId &outRid);
+
+	/**
+	 * BTreeCursor::nextBatch for an index with posting lists, decodes whole lists without looking at their keys
+	 */
+	template <class T, class Inner>
+	std::size_t scanNextBatchPosting(BTreeCursor &cursor, RecordId *outRids, std::size_t maxRids, char *outPayloads);
+
+	/**
+	 * Load the next part of the posting list being returned into the cursor, the next overflow page or
+	 * the list of the next key within the bounds
+	 * @return false if the scan is completed
+	 */
+	template <class T, class Inner>
+	bool nextPosting(BTreeCursor &cursor);
+
+	/**
+	 * Start returning the list of key i of the leaf copy of a cursor
+	 */
+	template <class T>
+	void takePosting(BTreeCursor &cursor, int i);
+
+	/**
+	 * Find the posting list being returned again after its leaf changed while an overflow page was read,
+	 * the record ids below cursor.postingSkip are passed over. Moves on to the next key if it is gone
+	 */
+	template <class T, class Inner>
+	void resumePosting(BTreeCursor &cursor);
+
+	/**
+	 * Insert a key, rid pair into a leaf node that has room for it, after any equal keys
+	 * @param leafNode leaf node to insert into
+	 * @param key key of entry to insert
+	 * @param rid rid of entry to insert
+	 * @param payload included attributes of the entry, the leaf keeps none
+	 */
+	template <class T>
+	void insertIntoLeaf(LeafNode<T> *leafNode, const T &key, const RecordId rid, const char *payload);
+
+	/**
+	 * Add rid to the posting list of key in a leaf that has room for it, moving the list to
+	 * overflow pages once it is too long for the leaf
+	 * @param leafNode leaf node to insert into
+	 * @param key key of entry to insert
+	 * @param rid rid of entry to insert
+	 */
+	template <class T>
+	void insertIntoLeaf(PostingLeafNode<T> *leafNode, const T &key, const RecordId rid, const char *payload);
+
+	/**
+	 * Insert an entry with its included attributes into a leaf that has room for it, after any equal keys
+	 * @param payload included attributes of the entry, payloadBytes of them
+	 */
+	template <class T>
+	void insertIntoLeaf(CoveringLeafNode<T> *leafNode, const T &key, const RecordId rid, const char *payload);
+
+	/**
+	 * Remove the last entry of a leaf while bulk loading and put it in front of the pairs still to be loaded
+	 */
+	template <class T>
+	void giveBackLast(LeafNode<T> *leafNode, std::deque<RIDKeyPair<T> > &pending);
+
+	/**
+	 * Remove the last key of a leaf while bulk loading and put its posting list, kept in the leaf,
+	 * in front of the pairs still to be loaded
+	 */
+	template <class T>
+	void giveBackLast(PostingLeafNode<T> *leafNode, std::deque<RIDKeyPair<T> > &pending);
+
+	/**
+	 * Remove the last entry of a leaf while bulk loading and put it, with its included attributes,
+	 * in front of the entries still to be loaded
+	 */
+	template <class T>
+	void giveBackLast(CoveringLeafNode<T> *leafNode, std::deque<CoveredEntry<T> > &pending);
+	
+	/**
+	 * Slot to split a full node at. An entry appended to the rightmost node of a level, past all its keys, leaves
+	 * the node filled to IndexOptions::fillFactor, or all but one entry for a fill factor of 1, so that ascending
+	 * keys do not leave every node half empty. Any other split, or one with IndexOptions::appendSplits off, is even.
+	 * @param node full node, leaf or non-leaf
+	 * @param atEnd true if the entry that does not fit goes after all keys of node
+	 * @return first entry moved to the new leaf, or key pushed up from a non-leaf node
+	 */
+	template <class Node>
+	int chooseSplit(const Node *node,bool atEnd) const;
+
+	/**
+	 * Split a leaf node into two when node is full and an insert is attempted
+	 * @param leafNode leaf node to split
+	 * @param pageNo page number of leafNode, the new leaf links back to it
+	 * @param splitIndex index to split at
+	 * @param newLeafNode returns the new right leaf, left pinned for the caller
+	 * @param fences separators bounding the leaf, and the two leaves after it
+	 * @return page number of the new leaf and the separator to copy up into the parent
+	 */
+	template <class T, class Leaf>
+	PageKeyPair<T> splitLeaf(Leaf *leafNode,PageId pageNo,int splitIndex,Leaf *&newLeafNode,const KeyFences<T> &fences);
+
+	/**
+	 * Point the left link of a leaf at another page, latching the leaf for the change. Only called by the holder
+	 * of structureLatch, other writers latch a single leaf at a time, so waiting for it cannot deadlock.
+	 * @param pageNo leaf to change, nothing is done for Page::INVALID_NUMBER
+	 * @param leftPageNo new left sibling
+	 */
+	template <class Leaf>
+	void linkLeft(PageId pageNo,PageId leftPageNo);
+	
+	/**
+	 * Split a non leaf (internal) node when pushup operation resulting from a
+	 * split from a lower level results in overflow in the non leaf node
+	 * @param nonLeafNode non leaf node to split
+	 * @param splitIndex index of the key pushed up, keys after it move to the new node
+	 * @param newNonLeafNode returns the new right node, left pinned for the caller
+	 * @return page number of the new node and the key to push up into the parent
+	 */
+	template <class T, class Inner>
+	PageKeyPair<T> splitNonLeaf(Inner *nonLeafNode,int splitIndex,Inner *&newNonLeafNode);
+
+	/**
+	 * Build the tree bottom-up from the sorted (key, rid) pairs of the relation
+	 * @param relationName name of the relation to index
+	 */
+	template <class T, class Leaf, class Inner>
+	void bulkLoad(const std::string &relationName);
+
+	/**
+	 * Append a child to the rightmost node of a non-leaf level during bulk loading, starting a new
+	 * node, and adding it to the level above, when that node is filled up
+	 * @param levels non-leaf levels built so far, levels[0] is the level above the leaves
+	 * @param level level to append to
+	 * @param child page number of the child and the smallest key under it
+	 * @param leftmostPageNo first node of the level below, used if the level has to be created
+	 * @param closedCount entries below the child before this one, which is complete now
+	 */
+	template <class T, class Inner>
+	void bulkAddChild(std::vector<BulkLevel<Inner> > &levels,std::size_t level,PageKeyPair<T> child,PageId leftmostPageNo,std::uint32_t closedCount);
+
+	/**
+	 * Write sorted record ids to a new chain of overflow pages
+	 * @param values PostingCodec values of the record ids
+	 * @param n number of values, at least one
+	 * @return page number of the first page
+	 */
+	PageId writeOverflow(const std::uint64_t *values,int n);
+
+	/**
+	 * Add a record id to a posting list kept in overflow pages, splitting the page it goes to if it is full
+	 * @param firstPageNo first page of the list
+	 * @param value PostingCodec value of the record id
+	 */
+	void insertIntoOverflow(PageId firstPageNo,std::uint64_t value);
+
+	/**
+	 * Remove a record id from a posting list kept in overflow pages, freeing the page if it is emptied
+	 * @param firstPageNo first page of the list, returns the new first page, Page::INVALID_NUMBER once the list is empty
+	 * @param value PostingCodec value of the record id
+	 * @return false if the list does not hold the record id
+	 */
+	bool removeFromOverflow(PageId &firstPageNo,std::uint64_t value);
+
+	/**
+	 * Allocate a new root above the current root after the current root has split, latching rootLatch to publish it
+	 * @param pushUp page number of the node split off the current root and its separator key
+	 * @param level level of the new root, 1 if the old root was a leaf, 0 otherwise
+	 * @param leftCount entries below the current root
+	 * @param rightCount entries below the node split off it
+	 */
+	template <class T, class Inner>
+	void growRoot(PageKeyPair<T> pushUp,int level,std::uint32_t leftCount,std::uint32_t rightCount);
+
+	/**
+	 * Write metaInfo back to the meta page, done whenever the root changes. The caller holds metaLatch
+	 */
+	void writeMetaPage();
+
+	/**
+	 * Allocate a page for a new node, from the free list if it has any, returned pinned and uninitialized
+	 * @param pageNo page number of the node returned in this
+	 * @param page the page returned in this
+	 */
+	void allocNode(PageId &pageNo, Page *&page);
+
+	/**
+	 * Put the page of a node that is no longer part of the tree on the free list
+	 * @param pageNo page number of the node
+	 * @param page the node, pinned, unpinned here
+	 * @param latched true if the node is latched, it is released after it is cleared
+	 */
+	void freeNode(PageId pageNo, Page *page, bool latched = false);
+
+	/**
+	 * Unlatch and unpin a node
+	 * @param dirty true if the node was changed
+	 */
+	void releaseNode(PageId pageNo, Page *page, bool dirty);
+
+	/**
+	 * Release the nodes of a descent path that a split did not reach, see latchForInsert
+	 * @param path path recorded by the descent, its nodes pinned, and latched if the index is counted
+	 * @param depth number of entries of path still held
+	 * @param dirty true if their subtree counts were changed
+	 */
+	template <class Inner>
+	void releasePath(PathEntry *path,int depth,bool dirty = false);
+};
+
+/**
+ * @brief Record ids matched by a scan, returned by BTreeIndex::range() to be used in a range-based for loop.
+ * Finishing the loop is not an error, no exception is thrown at the end of the range or for an empty one.
+ * The scan runs on a cursor owned by the range.
+*/
+class BTreeRange {
+ public:
+  /**
+   * Input iterator over the record ids, advancing it fetches the next one from the index.
+   */
+	class iterator {
+	 public:
+		iterator()
+			: range(NULL)
+		{
+		}
+
+		const RecordId &operator*() const
+		{
+			return rid;
+		}
+
+		iterator &operator++()
+		{
+			if (!range->cursor.next(rid))
+			{
+				range = NULL;
+			}
+			return *this;
+		}
+
+		bool operator==(const iterator &other) const
+		{
+			return range == other.range;
+		}
+
+		bool operator!=(const iterator &other) const
+		{
+			return range != other.range;
+		}
+
+	 private:
+		friend class BTreeRange;
+
+	  /**
+	   * Range iterated over, NULL once the scan is completed, which is also the end iterator.
+	   */
+		BTreeRange *range;
+
+	  /**
+	   * Record id the iterator is on.
+	   */
+		RecordId rid;
+	};
+
+	BTreeRange(BTreeRange &&other);
+
+  /**
+   * Iterator on the first record id. A range can only be iterated over once.
+   */
+	iterator begin();
+
+	iterator end()
+	{
+		return iterator();
+	}
+
+ private:
+	friend class BTreeIndex;
+
+	explicit BTreeRange(BTreeIndex *index);
+	BTreeRange(const BTreeRange &);
+	BTreeRange &operator=(const BTreeRange &);
+
+  /**
+   * Cursor the scan runs on.
+   */
+	BTreeCursor cursor;
+};
 
-	/**
-	 * Recursive method to insert a key and record
-	 * @param pageId page number to insert into
-	 * @param key key of entry
-	 * @param rid record id of entry
-	 * @param newPageNo new page number
-	 */
-	PageId insertHelper(PageId pageId,int key,RecordId rid,PageId newPageNo);
-};
 }
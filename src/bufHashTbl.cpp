@@ -17,10 +17,9 @@ namespace badgerdb {
 
 int BufHashTbl::hash(const File* file, const PageId pageNo)
 {
-  int tmp, value;
-  tmp = (long)file;  // cast of pointer to the file object to an integer
-  value = (tmp + pageNo) % HTSIZE;
-  return value;
+  // unsigned, so the bucket is never negative whatever the address of the file object
+  std::size_t tmp = (std::size_t)file;  // cast of pointer to the file object to an integer
+  return (int)((tmp + pageNo) % HTSIZE);
 }
 
 BufHashTbl::BufHashTbl(int htSize)
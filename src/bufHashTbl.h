@@ -40,7 +40,7 @@ struct hashBucket {
 /**
 * @brief Hash table class to keep track of pages in the buffer pool
 *
-* @warning This class is not threadsafe.
+* @warning This class is not threadsafe. BufMgr guards each bucket with the latch stripe its hash value maps to.
 */
 class BufHashTbl
 {
@@ -54,6 +54,7 @@ class BufHashTbl
 	 */
   hashBucket**  ht;
 
+ public:
 	/**
 	 * returns hash value between 0 and HTSIZE-1 computed using file and pageNo
 	 *
@@ -63,7 +64,6 @@ class BufHashTbl
 	 */
   int	 hash(const File* file, const PageId pageNo);
 
- public:
 	/**
    * Constructor of BufHashTbl class
 	 */
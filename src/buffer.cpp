@@ -5,8 +5,12 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <cstdint>
 #include <memory>
+#include <new>
 #include <iostream>
+#include <thread>
+#include <vector>
 #include "buffer.h"
 #include "exceptions/buffer_exceeded_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
@@ -30,12 +34,23 @@ BufMgr::BufMgr(std::uint32_t bufs)
   	bufDescTable[i].valid = false;
   }
 
-  bufPool = new Page[bufs];
+  // new only aligns to 16 bytes, the frames are placed on a cache line by hand
+  bufPoolMemory = new char[bufs * sizeof(Page) + FRAME_ALIGNMENT];
+  std::uintptr_t start = reinterpret_cast<std::uintptr_t>(bufPoolMemory);
+  bufPool = reinterpret_cast<Page*>((start + FRAME_ALIGNMENT - 1) & ~(std::uintptr_t)(FRAME_ALIGNMENT - 1));
+  for (FrameId i = 0; i < bufs; i++)
+  {
+  	new (&bufPool[i]) Page();
+  }
 
   int htsize = ((((int) (bufs * 1.2))*2)/2)+1;
   hashTable = new BufHashTbl (htsize);  // allocate the buffer hash table
 
   clockHand = bufs - 1;
+  for (int i = 0; i < LATCH_STRIPES; i++)
+  {
+    stripes[i].writes = 0;
+  }
 }
 
 
@@ -52,69 +67,92 @@ BufMgr::~BufMgr() {
 
 	delete hashTable;
   delete [] bufDescTable;
-  delete [] bufPool;
+  for (std::uint32_t i = 0; i < numBufs; i++)
+  {
+  	bufPool[i].~Page();
+  }
+  delete [] bufPoolMemory;
 }
 
-void BufMgr::allocBuf(FrameId & frame) 
+void BufMgr::allocBuf(FrameId & frame, File* file, const PageId pageNo, const int heldStripe)
 {
   // perform first part of clock algorithm to search for 
   // open buffer frame
-  // Assumes non-concurrent access to buffer manager
-  std::uint32_t numScanned = 0;
-  bool found = 0;
-
-  while (numScanned < 2*numBufs)	//Need to scn twice
+  // A frame in use is only looked at under the stripe of its page. Stripes held by
+  // other threads are passed over, their owners may be waiting for the clock latch
+  while (1)
   {
-    // advance the clock
-    advanceClock();
-    numScanned++;
+    std::unique_lock<std::mutex> clock(clockLatch);
+    std::uint32_t numScanned = 0;
+    bool passedOver = false;
 
-    // if invalid, use frame
-    if (! bufDescTable[clockHand].valid)
+    while (numScanned < 2*numBufs)	//Need to scn twice
     {
-      break;
-    }
+      // advance the clock
+      advanceClock();
+      numScanned++;
+      BufDesc* tmpbuf = &(bufDescTable[clockHand]);
+
+      // if invalid, use frame
+      if (! tmpbuf->valid)
+      {
+        tmpbuf->Set(file, pageNo);
+        frame = clockHand;
+        return;
+      }
+
+      int stripe = stripeOf(tmpbuf->file, tmpbuf->pageNo);
+      std::unique_lock<std::mutex> victim(stripes[stripe].mutex, std::defer_lock);
+      if (stripe != heldStripe && !victim.try_lock())
+      {
+        passedOver = true;
+        continue;
+      }
+
+      // is valid, check referenced bit
+      if (tmpbuf->refbit)
+      {
+        // has been referenced, clear the bit
+        count(bufStats.accesses);
+        tmpbuf->refbit = false;
+        continue;
+      }
 
-    // is valid, check referenced bit
-    if (! bufDescTable[clockHand].refbit)
-    {
       // check to see if someone has it pinned
-      if (bufDescTable[clockHand].pinCnt == 0)
+      if (tmpbuf->pinCnt != 0)
       {
-        // hasn't been referenced and is not pinned, use it
-        // remove previous entry from hash table
-        hashTable->remove(bufDescTable[clockHand].file, bufDescTable[clockHand].pageNo);
-        found = true;
-        break;
+        continue;
       }
+
+      // hasn't been referenced and is not pinned, use it
+      // remove previous entry from hash table
+      hashTable->remove(tmpbuf->file, tmpbuf->pageNo);
+
+      // flush any existing changes to disk if necessary, before a reader
+      // of the page can miss it in the hash table and read it from disk
+      if (tmpbuf->dirty)
+      {
+        count(bufStats.diskwrites);
+        std::lock_guard<std::mutex> io(ioLatch);
+        tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[clockHand]);
+        stripes[stripe].writes++;
+      }
+
+      // the frame belongs to the new page before the clock latch is given up
+      tmpbuf->Set(file, pageNo);
+      frame = clockHand;
+      return;
     }
-    else
+
+    // check for full buffer pool
+    if (!passedOver)
     {
-      // has been referenced, clear the bit
-      bufStats.accesses++;
-      bufDescTable[clockHand].refbit = false;
+      throw BufferExceededException();
     }
+    // frames were held by other threads, let them go on and look again
+    clock.unlock();
+    std::this_thread::yield();
   }
-  
-  // check for full buffer pool
-  if (!found && numScanned >= 2*numBufs)
-  {
-    throw BufferExceededException();
-  }
-  
-  // flush any existing changes to disk if necessary
-  if (bufDescTable[clockHand].dirty)
-  {
-    bufStats.diskwrites++;
-    //status = bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo,
-    bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo, bufPool[clockHand]);
-  }
-
-	//Reset all the BufDesc entry for the frame before returning the frame
-  bufDescTable[clockHand].Clear();
-
-  // return new frame number
-  frame = clockHand;
 } // end allocBuf
 
 	
@@ -123,6 +161,9 @@ void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
   // check to see if it is already in the buffer pool
   // std::cout << "readPage called on file.page " << file << "." << pageNo << endl;
   FrameId frameNo = 0;
+  count(bufStats.accesses);
+  int stripe = stripeOf(file, pageNo);
+  std::lock_guard<std::mutex> guard(stripes[stripe].mutex);
 	try
 	{
   	hashTable->lookup(file, pageNo, frameNo);
@@ -134,16 +175,17 @@ void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
   }
   catch(const HashNotFoundException &e) //not in the buffer pool, must allocate a new page
   {
-    // alloc a new frame
-    allocBuf(frameNo);
-
-    // read the page into the new frame
-    bufStats.diskreads++;
-    //status = file->readPage(pageNo, &bufPool[frameNo]);
-    bufPool[frameNo] = file->readPage(pageNo);
+    // read the page first, a failed read leaves the buffer pool as it was
+    count(bufStats.diskreads);
+    Page read;
+    {
+      std::lock_guard<std::mutex> io(ioLatch);
+      read = file->readPage(pageNo);
+    }
 
-    // set up the entry properly
-    bufDescTable[frameNo].Set(file, pageNo);
+    // alloc a new frame, set up for the page
+    allocBuf(frameNo, file, pageNo, stripe);
+    bufPool[frameNo] = read;
     page = &bufPool[frameNo];
 
     // insert in the hash table
@@ -152,10 +194,78 @@ void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
 }
 
 
+void BufMgr::prefetch(File* file, const PageId* pageNos, const std::size_t numPages)
+{
+  FrameId frameNo = 0;
+  std::vector<PageId> missing;
+  std::vector<std::uint64_t> writes;
+  for (std::size_t i = 0; i < numPages; i++)
+  {
+    StripeLatch &stripe = stripes[stripeOf(file, pageNos[i])];
+    std::lock_guard<std::mutex> guard(stripe.mutex);
+    try
+    {
+      hashTable->lookup(file, pageNos[i], frameNo);
+    }
+    catch(const HashNotFoundException &e)
+    {
+      missing.push_back(pageNos[i]);
+      writes.push_back(stripe.writes);
+    }
+  }
+  if (missing.empty())
+  {
+    return;
+  }
+
+  // one hold of the io latch for all of them, so the reads are not interleaved with other threads'
+  std::vector<Page> read(missing.size());
+  {
+    std::lock_guard<std::mutex> io(ioLatch);
+    for (std::size_t i = 0; i < missing.size(); i++)
+    {
+      count(bufStats.diskreads);
+      read[i] = file->readPage(missing[i]);
+    }
+  }
+
+  for (std::size_t i = 0; i < missing.size(); i++)
+  {
+    int stripe = stripeOf(file, missing[i]);
+    std::lock_guard<std::mutex> guard(stripes[stripe].mutex);
+    try
+    {
+      // another thread read it in the meantime
+      hashTable->lookup(file, missing[i], frameNo);
+      continue;
+    }
+    catch(const HashNotFoundException &e)
+    {
+    }
+    if (stripes[stripe].writes != writes[i])
+    {
+      // the page may have been read, changed and written back since, the copy read here is dropped
+      continue;
+    }
+    try
+    {
+      allocBuf(frameNo, file, missing[i], stripe);
+    }
+    catch(const BufferExceededException &e)
+    {
+      return;
+    }
+    bufPool[frameNo] = read[i];
+    bufDescTable[frameNo].pinCnt = 0;
+    hashTable->insert(file, missing[i], frameNo);
+  }
+}
+
 void BufMgr::unPinPage(File* file, const PageId pageNo, const bool dirty) 
 {
   // lookup in hashtable
   FrameId frameNo = 0;
+  std::lock_guard<std::mutex> guard(stripes[stripeOf(file, pageNo)].mutex);
   hashTable->lookup(file, pageNo, frameNo);
 
   if (dirty == true) bufDescTable[frameNo].dirty = dirty;
@@ -172,16 +282,29 @@ void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page)
 {
   FrameId frameNo;
 
-  // alloc a new frame
-  allocBuf(frameNo);
-
-  // allocate a new page in the file
+  // allocate a new page in the file, its number picks the stripe
 	//std::cerr << "buffer data size:" << bufPool[frameNo].data_.length() << "\n";
-  bufPool[frameNo] = file->allocatePage(pageNo);
-  page = &bufPool[frameNo];
+  Page allocated;
+  {
+    std::lock_guard<std::mutex> io(ioLatch);
+    allocated = file->allocatePage(pageNo);
+  }
 
-  // set up the entry properly
-  bufDescTable[frameNo].Set(file, pageNo);
+  int stripe = stripeOf(file, pageNo);
+  std::lock_guard<std::mutex> guard(stripes[stripe].mutex);
+  try
+  {
+    // alloc a new frame, set up for the page
+    allocBuf(frameNo, file, pageNo, stripe);
+  }
+  catch(const BufferExceededException &e)
+  {
+    std::lock_guard<std::mutex> io(ioLatch);
+    file->deletePage(pageNo);
+    throw;
+  }
+  bufPool[frameNo] = allocated;
+  page = &bufPool[frameNo];
 
   // insert in the hash table
   hashTable->insert(file, pageNo, frameNo);
@@ -189,27 +312,39 @@ void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page)
 
 void BufMgr::flushFile(const File* file) 
 {
-  for (std::uint32_t i = 0; i < numBufs; i++)
-	{
-  	BufDesc* tmpbuf = &(bufDescTable[i]);
-  	if(tmpbuf->file && tmpbuf->valid == true && tmpbuf->file == file)
-		{
-	    if (tmpbuf->pinCnt > 0)
-  			throw PagePinnedException(file->filename(), tmpbuf->pageNo, tmpbuf->frameNo);
-
-	    if (tmpbuf->dirty == true)
-			{
-				//if ((status = tmpbuf->file->writePage(tmpbuf->pageNo, &(bufPool[i]))) != OK)
-				tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
-				tmpbuf->dirty = false;
-    	}
-
-    	hashTable->remove(file,tmpbuf->pageNo);
-    	tmpbuf->Clear();
-  	}
-		else if (tmpbuf->valid == false && tmpbuf->file == file)
-  		throw BadBufferException(tmpbuf->frameNo, tmpbuf->dirty, tmpbuf->valid, tmpbuf->refbit);
+  lockAll();
+  try
+  {
+    for (std::uint32_t i = 0; i < numBufs; i++)
+    {
+      BufDesc* tmpbuf = &(bufDescTable[i]);
+      if(tmpbuf->file && tmpbuf->valid == true && tmpbuf->file == file)
+      {
+        if (tmpbuf->pinCnt > 0)
+          throw PagePinnedException(file->filename(), tmpbuf->pageNo, tmpbuf->frameNo);
+
+        if (tmpbuf->dirty == true)
+        {
+          //if ((status = tmpbuf->file->writePage(tmpbuf->pageNo, &(bufPool[i]))) != OK)
+          std::lock_guard<std::mutex> io(ioLatch);
+          tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
+          tmpbuf->dirty = false;
+          stripes[stripeOf(tmpbuf->file, tmpbuf->pageNo)].writes++;
+        }
+
+        hashTable->remove(file,tmpbuf->pageNo);
+        tmpbuf->Clear();
+      }
+      else if (tmpbuf->valid == false && tmpbuf->file == file)
+        throw BadBufferException(tmpbuf->frameNo, tmpbuf->dirty, tmpbuf->valid, tmpbuf->refbit);
+    }
+  }
+  catch(...)
+  {
+    unlockAll();
+    throw;
   }
+  unlockAll();
 }
 
 void BufMgr::disposePage(File* file, const PageId pageNo)
@@ -217,15 +352,40 @@ void BufMgr::disposePage(File* file, const PageId pageNo)
 	//Deallocate from file altogether
   //See if it is in the buffer pool
   FrameId frameNo = 0;
+  std::lock_guard<std::mutex> guard(stripes[stripeOf(file, pageNo)].mutex);
   hashTable->lookup(file, pageNo, frameNo);
 
 	// clear the page
-	bufDescTable[frameNo].Clear();
+  {
+    std::lock_guard<std::mutex> clock(clockLatch);
+    bufDescTable[frameNo].Clear();
+  }
 
 	hashTable->remove(file, pageNo);
 
   // deallocate it in the file	
+  std::lock_guard<std::mutex> io(ioLatch);
   file->deletePage(pageNo);
+  stripes[stripeOf(file, pageNo)].writes++;
+}
+
+void BufMgr::lockAll()
+{
+  // stripes in order, then the clock latch, like every other path
+  for (int i = 0; i < LATCH_STRIPES; i++)
+  {
+    stripes[i].mutex.lock();
+  }
+  clockLatch.lock();
+}
+
+void BufMgr::unlockAll()
+{
+  clockLatch.unlock();
+  for (int i = LATCH_STRIPES - 1; i >= 0; i--)
+  {
+    stripes[i].mutex.unlock();
+  }
 }
 
 void BufMgr::printSelf(void) 
@@ -233,6 +393,7 @@ void BufMgr::printSelf(void)
   BufDesc* tmpbuf;
 	int validFrames = 0;
   
+  lockAll();
   for (std::uint32_t i = 0; i < numBufs; i++)
 	{
   	tmpbuf = &(bufDescTable[i]);
@@ -242,6 +403,7 @@ void BufMgr::printSelf(void)
   	if (tmpbuf->valid == true)
     	validFrames++;
   }
+  unlockAll();
 
 	std::cout << "Total Number of Valid Frames:" << validFrames << "\n";
 }
@@ -9,7 +9,10 @@
 
 #include "file.h"
 #include "bufHashTbl.h"
+#include "latch.h"
+#include <cstdint>
 #include <iostream>
+#include <mutex>
 
 namespace badgerdb {
 
@@ -61,6 +64,12 @@ class BufDesc {
 	 */
   bool refbit;
 
+	/**
+   * Latch of the page in the frame, for callers that share pages between threads. Only meaningful
+   * while the page is pinned, and left alone by Clear() and Set() so versions keep counting up.
+	 */
+  OptimisticLatch latch;
+
 	/**
    * Initialize buffer frame for a new user
 	 */
@@ -157,10 +166,32 @@ struct BufStats
 
 /**
 * @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file 
+*
+* Safe to call from several threads. The hash table buckets are spread over LATCH_STRIPES mutexes, a page is
+* looked up, pinned and unpinned under the stripe of its bucket only. Taking a frame for a new page holds
+* clockLatch, and all reads and writes of files go through ioLatch. Latches are taken in that order, a stripe
+* that would come after clockLatch is only tried, never waited for.
 */
 class BufMgr 
 {
  private:
+	/**
+   * Number of mutexes the hash table buckets are spread over.
+	 */
+  static const int LATCH_STRIPES = 64;
+
+	/**
+   * Mutex of a stripe, padded to a cache line so threads on neighbouring stripes do not share one.
+   * writes counts the pages of the stripe written to or deleted from their file, under the mutex, so that
+   * a copy read from the file without the mutex can be told apart from one that has gone stale since.
+	 */
+  struct StripeLatch
+  {
+    std::mutex mutex;
+    std::uint64_t writes;
+    char padding[64 - (sizeof(std::mutex) + sizeof(std::uint64_t)) % 64];
+  };
+
 	/**
    * Current position of clockhand in our buffer pool
 	 */
@@ -186,6 +217,52 @@ class BufMgr
 	 */
   BufStats bufStats;
 
+	/**
+   * Memory bufPool was carved from, a little larger so that the frames can start on a cache line.
+	 */
+  char *bufPoolMemory;
+
+	/**
+   * Stripes guarding the hash table and the pin count, dirty and referenced bits of the frames in it.
+	 */
+  StripeLatch stripes[LATCH_STRIPES];
+
+	/**
+   * Held while the clock hand moves and frames change pages.
+	 */
+  std::mutex clockLatch;
+
+	/**
+   * Held around every read and write of a file, File is not threadsafe.
+	 */
+  std::mutex ioLatch;
+
+	/**
+   * Stripe of the hash bucket of a page.
+	 */
+  int stripeOf(const File* file, const PageId pageNo)
+  {
+    return hashTable->hash(file, pageNo) % LATCH_STRIPES;
+  }
+
+	/**
+   * Take every stripe and the clock latch, for walking all frames.
+	 */
+  void lockAll();
+
+	/**
+   * Release what lockAll() took.
+	 */
+  void unlockAll();
+
+	/**
+   * Count an event in the statistics, which threads update side by side.
+	 */
+  static void count(int &statistic)
+  {
+    __atomic_fetch_add(&statistic, 1, __ATOMIC_RELAXED);
+  }
+
 	/**
    * Advance clock to next frame in the buffer pool
 	 */
@@ -195,14 +272,23 @@ class BufMgr
   }
 
 	/**
-	 * Allocate a free frame.  
+	 * Allocate a free frame to a page, which is returned pinned once and not yet in the hash table.
 	 *
 	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
+	 * @param file   	File object of the page
+	 * @param pageNo  Page number of the page
+	 * @param heldStripe	Stripe of the page, held by the caller
 	 * @throws BufferExceededException If no such buffer is found which can be allocated
 	 */
-  void allocBuf(FrameId & frame);
+  void allocBuf(FrameId & frame, File* file, const PageId pageNo, const int heldStripe);
 
  public:
+	/**
+   * Alignment of every frame of bufPool, a cache line, so that node layouts which arrange keys by cache line
+   * find them on line boundaries.
+	 */
+  static const std::size_t FRAME_ALIGNMENT = 64;
+
 	/**
    * Actual buffer pool from which frames are allocated
 	 */
@@ -229,6 +315,17 @@ class BufMgr
 	 */
   void readPage(File* file, const PageId PageNo, Page*& page);
 
+	/**
+	 * Read ahead pages that are about to be read. Pages not in the buffer pool yet are read in one go, in the
+	 * order given, and left in frames unpinned but referenced, so that readPage() finds them. Read-ahead stops
+	 * early, without an error, when no frame is free.
+	 *
+	 * @param file   	File object
+	 * @param pageNos	Page numbers, ascending for the reads to go through the file front to back
+	 * @param numPages	Number of page numbers
+	 */
+  void prefetch(File* file, const PageId* pageNos, const std::size_t numPages);
+
 	/**
 	 * Unpin a page from memory since it is no longer required for it to remain in memory.
 	 *
@@ -274,6 +371,17 @@ class BufMgr
 	 */
   void  printSelf();
 
+	/**
+   * Latch of the frame holding a page, for callers that coordinate threads working on the same pages.
+   * The caller must keep the page pinned while it uses the latch.
+	 *
+	 * @param page  	Page returned by readPage() or allocPage()
+	 */
+  OptimisticLatch & latch(const Page* page)
+  {
+		return bufDescTable[page - bufPool].latch;
+  }
+
 	/**
    * Get buffer pool usage statistics
 	 */
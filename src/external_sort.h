@@ -0,0 +1,268 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <string>
+#include <vector>
+#include "string.h"
+
+#include "types.h"
+#include "page.h"
+#include "file.h"
+
+namespace badgerdb
+{
+
+/**
+ * @brief Sorts a stream of fixed-size records that may not fit in memory.
+ *
+ * Records are collected into an in-memory buffer. Whenever the buffer is full it is sorted
+ * and written out as a run to a temporary BlobFile, bypassing the buffer pool. Once all
+ * records are added, finish() sorts what is left and next() returns the records in order,
+ * merging the runs with a heap when more than one was spilled. The temporary file is removed
+ * when the sorter is destroyed.
+ *
+ * The record type must be copyable with memcpy and ordered by operator<.
+ */
+template <class R>
+class ExternalSorter
+{
+ public:
+  /**
+   * Number of records in one page of a spilled run.
+   */
+	static const int RECORDS_PER_PAGE = Page::SIZE / sizeof(R);
+
+  /**
+   * @param spillFileName	Name of the temporary file runs are spilled to. Created on first spill.
+   * @param bufferRecords	Number of records sorted in memory before a run is spilled.
+   */
+	ExternalSorter(const std::string &spillFileName, std::size_t bufferRecords)
+		: spillFileName(spillFileName), bufferRecords(std::max<std::size_t>(bufferRecords, RECORDS_PER_PAGE)),
+			spillFile(NULL), bufferPos(0)
+	{
+	}
+
+  /**
+   * Removes the temporary file, if any runs were spilled.
+   */
+	~ExternalSorter()
+	{
+		if (spillFile != NULL)
+		{
+			delete spillFile;
+			File::remove(spillFileName);
+		}
+	}
+
+  /**
+   * Add a record. May spill a run to disk.
+   */
+	void add(const R &record)
+	{
+		if (buffer.size() == bufferRecords)
+		{
+			spillRun();
+		}
+		buffer.push_back(record);
+	}
+
+  /**
+   * Done adding records, prepare to return them in order.
+   */
+	void finish()
+	{
+		std::sort(buffer.begin(), buffer.end());
+		bufferPos = 0;
+		if (runs.empty())
+		{
+			return;
+		}
+		// the last run stays in memory and takes part in the merge like the spilled ones
+		for (std::size_t i = 0; i < runs.size(); i++)
+		{
+			HeapEntry entry;
+			entry.run = i;
+			if (readFromRun(runs[i], entry.record))
+			{
+				heap.push(entry);
+			}
+		}
+		HeapEntry entry;
+		entry.run = runs.size();
+		if (bufferPos < buffer.size())
+		{
+			entry.record = buffer[bufferPos++];
+			heap.push(entry);
+		}
+	}
+
+  /**
+   * Returns the next record in sorted order.
+   * @param out	record returned in this
+   * @return false once all records have been returned
+   */
+	bool next(R &out)
+	{
+		if (runs.empty())
+		{
+			if (bufferPos == buffer.size())
+			{
+				return false;
+			}
+			out = buffer[bufferPos++];
+			return true;
+		}
+		if (heap.empty())
+		{
+			return false;
+		}
+		HeapEntry top = heap.top();
+		heap.pop();
+		out = top.record;
+		// refill from the run the record came from
+		if (top.run < runs.size())
+		{
+			if (readFromRun(runs[top.run], top.record))
+			{
+				heap.push(top);
+			}
+		}
+		else if (bufferPos < buffer.size())
+		{
+			top.record = buffer[bufferPos++];
+			heap.push(top);
+		}
+		return true;
+	}
+
+  /**
+   * Number of runs spilled to the temporary file.
+   */
+	std::size_t numSpilledRuns() const
+	{
+		return runs.size();
+	}
+
+ private:
+  /**
+   * A sorted run in the temporary file. Its pages were allocated one after another.
+   */
+	struct Run
+	{
+		PageId nextPageNo;	// next page of the run to read
+		std::size_t remaining;	// records of the run not returned yet
+		int pos;	// next record in page
+		int inPage;	// records in page
+		Page page;	// page of the run currently being merged
+	};
+
+  /**
+   * Head of one run in the merge heap.
+   */
+	struct HeapEntry
+	{
+		R record;
+		std::size_t run;	// index into runs, runs.size() for the in-memory buffer
+		bool operator>(const HeapEntry &rhs) const
+		{
+			return rhs.record < record;
+		}
+	};
+
+  /**
+   * Sort the buffer and append it to the temporary file as a new run.
+   */
+	void spillRun()
+	{
+		if (spillFile == NULL)
+		{
+			spillFile = new BlobFile(spillFileName, true);
+		}
+		std::sort(buffer.begin(), buffer.end());
+		Run run;
+		run.remaining = buffer.size();
+		run.pos = 0;
+		run.inPage = 0;
+		for (std::size_t i = 0; i < buffer.size(); i += RECORDS_PER_PAGE)
+		{
+			std::size_t n = std::min<std::size_t>(RECORDS_PER_PAGE, buffer.size() - i);
+			PageId pageNo;
+			Page page = spillFile->allocatePage(pageNo);
+			memcpy((void*)&page, &buffer[i], n * sizeof(R));
+			spillFile->writePage(pageNo, page);
+			if (i == 0)
+			{
+				run.nextPageNo = pageNo;
+			}
+		}
+		runs.push_back(run);
+		buffer.clear();
+	}
+
+  /**
+   * Read the next record of a spilled run, false if the run is used up.
+   */
+	bool readFromRun(Run &run, R &out)
+	{
+		if (run.remaining == 0)
+		{
+			return false;
+		}
+		if (run.pos == run.inPage)
+		{
+			run.page = spillFile->readPage(run.nextPageNo++);
+			run.pos = 0;
+			run.inPage = (int)std::min<std::size_t>(RECORDS_PER_PAGE, run.remaining);
+		}
+		memcpy(&out, reinterpret_cast<const char*>(&run.page) + run.pos * sizeof(R), sizeof(R));
+		run.pos++;
+		run.remaining--;
+		return true;
+	}
+
+  /**
+   * Name of the temporary file.
+   */
+	std::string spillFileName;
+
+  /**
+   * Capacity of the in-memory buffer, in records.
+   */
+	std::size_t bufferRecords;
+
+  /**
+   * Temporary file holding the spilled runs, NULL until the first spill.
+   */
+	BlobFile *spillFile;
+
+  /**
+   * Records not spilled. After finish() the last, in-memory, run.
+   */
+	std::vector<R> buffer;
+
+  /**
+   * Next record of buffer to return.
+   */
+	std::size_t bufferPos;
+
+  /**
+   * Runs spilled to the temporary file.
+   */
+	std::vector<Run> runs;
+
+  /**
+   * Smallest unreturned record of every run.
+   */
+	std::priority_queue<HeapEntry, std::vector<HeapEntry>, std::greater<HeapEntry> > heap;
+};
+
+}
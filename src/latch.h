@@ -0,0 +1,101 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <thread>
+
+namespace badgerdb
+{
+
+/**
+ * @brief Version word for optimistic lock coupling.
+ *
+ * The low bit is set while a writer holds the latch, the other bits count how often it was taken.
+ * Readers never write to the latch: they note the version, read what it protects and then check
+ * that the version did not move, starting over if it did. Writers take the latch either by waiting
+ * for it or by upgrading a version they read before, which fails if anyone wrote in between.
+ */
+class OptimisticLatch
+{
+ public:
+	OptimisticLatch()
+		: word(0)
+	{
+	}
+
+  /**
+   * Version to check a read against later, waits while a writer holds the latch.
+   */
+	std::uint32_t readVersion() const
+	{
+		std::uint32_t version = __atomic_load_n(&word, __ATOMIC_ACQUIRE);
+		for (int spins = 0; version & 1; spins++)
+		{
+			backoff(spins);
+			version = __atomic_load_n(&word, __ATOMIC_ACQUIRE);
+		}
+		return version;
+	}
+
+  /**
+   * True if nothing was written since readVersion() returned version, so everything read in between is consistent.
+   */
+	bool validate(std::uint32_t version) const
+	{
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		return __atomic_load_n(&word, __ATOMIC_RELAXED) == version;
+	}
+
+  /**
+   * Take the latch if it still has the given version.
+   * @return false, and the latch is not taken, if a writer took it since the version was read
+   */
+	bool tryUpgrade(std::uint32_t version)
+	{
+		return __atomic_compare_exchange_n(&word, &version, version + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+	}
+
+  /**
+   * Take the latch, waiting for the writer holding it.
+   */
+	void lock()
+	{
+		for (int spins = 0; !tryUpgrade(readVersion()); spins++)
+		{
+			backoff(spins);
+		}
+	}
+
+  /**
+   * Release the latch, readers that saw the version before it was taken fail to validate.
+   */
+	void unlock()
+	{
+		__atomic_fetch_add(&word, 1, __ATOMIC_RELEASE);
+	}
+
+ private:
+  /**
+   * Wait a little before trying again, giving up the processor after a few tries.
+   */
+	static void backoff(int spins)
+	{
+		if (spins > 4)
+		{
+			std::this_thread::yield();
+		}
+	}
+
+  /**
+   * Version, odd while latched.
+   */
+	std::uint32_t word;
+};
+
+}
@@ -5,10 +5,21 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <random>
 #include <vector>
+#include <map>
+#include <set>
+#include <fstream>
+#include <thread>
+#include <chrono>
+#include <atomic>
 #include "btree.h"
 #include "page.h"
 #include "filescan.h"
+#include "record_fetcher.h"
 #include "page_iterator.h"
 #include "file_iterator.h"
 #include "exceptions/insufficient_space_exception.h"
@@ -19,6 +30,8 @@
 #include "exceptions/bad_opcodes_exception.h"
 #include "exceptions/scan_not_initialized_exception.h"
 #include "exceptions/end_of_file_exception.h"
+#include "exceptions/bad_index_info_exception.h"
+#include "exceptions/invalid_record_exception.h"
 
 #define checkPassFail(a, b) 																				\
 {																																		\
@@ -65,10 +78,16 @@ BufMgr * bufMgr = new BufMgr(100);
 
 void createRelationForward(int relationSize);
 void createRelationBackward(int relationSize);
-void createRelationRandom(int relationSize);
-void intTests();
+void createRelationRandom(int relationSize, const char *format = "%05d string record");
+void createRelationDuplicates(int relationSize, int numKeys);
+void intTests(const IndexOptions &options = IndexOptions());
 int intScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
-void indexTests();
+void doubleTests(const IndexOptions &options = IndexOptions());
+int doubleScan(BTreeIndex *index, double lowVal, Operator lowOp, double highVal, Operator highOp);
+void stringTests(const IndexOptions &options = IndexOptions());
+int stringScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp, const char *format = "%05d string record");
+int scanRecords(BTreeIndex *index, const void *lowVal, Operator lowOp, const void *highVal, Operator highOp);
+void indexTests(const IndexOptions &options = IndexOptions());
 void testScan();
 void test1();
 void test2();
@@ -76,6 +95,40 @@ void test3();
 void test4();
 void test5();
 void test6();
+void test7();
+void test8();
+void test9();
+void test10();
+void test11();
+void test12();
+void test13();
+void test14();
+void test15();
+void test16();
+void test17();
+void test18();
+void test19();
+void test20();
+void test21();
+void test22();
+void test23();
+void test24();
+void test25();
+void test26();
+void test27();
+void test28();
+int changeEntries(BTreeIndex *index, bool remove, int modulo, int residue, Datatype type = INTEGER);
+int insertBatches(BTreeIndex *index, int modulo, int residue, std::size_t batchSize, Datatype type = INTEGER);
+long fileSize(const std::string &fileName);
+int intRangeCount(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+int intBatchScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp, std::size_t batchSize);
+int coveredScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp, std::size_t batchSize);
+int fetchedScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp, std::size_t batchSize);
+int backwardScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp, std::size_t batchSize);
+int thinnedRun(BTreeIndex *index, int key, bool backward);
+int lookupKeys(BTreeIndex *index, int lowVal, int highVal, Datatype type = INTEGER);
+int intCount(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+int estimateInt(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
 void errorTests();
 void deleteRelation();
 
@@ -90,6 +143,20 @@ int main(int argc, char **argv)
 	catch(const FileNotFoundException &)
 	{
   }
+	// and their indexes, which the tests would open instead of building
+	const int indexOffsets[3] = { offsetof(tuple,i), offsetof(tuple,d), offsetof(tuple,s) };
+	for (int i = 0; i < 3; i++)
+	{
+		std::ostringstream indexName;
+		indexName << relationName << '.' << indexOffsets[i];
+		try
+		{
+			File::remove(indexName.str());
+		}
+		catch(const FileNotFoundException &)
+		{
+		}
+	}
 
 	{
 		// Create a new database file.
@@ -145,6 +212,28 @@ int main(int argc, char **argv)
 	test4();
 	test5();
 	test6();
+	test7();
+	test8();
+	test9();
+	test10();
+	test11();
+	test12();
+	test13();
+	test14();
+	test15();
+	test16();
+	test17();
+	test18();
+	test19();
+	test20();
+	test21();
+	test22();
+	test23();
+	test24();
+	test25();
+	test26();
+	test27();
+	test28();
 
 	delete bufMgr;
 
@@ -215,177 +304,2056 @@ void test6()
 
 }
 
-// -----------------------------------------------------------------------------
-// createRelationForward
-// -----------------------------------------------------------------------------
+void test7()
+{
+	// Build the index by inserting every tuple instead of bulk loading
+	std::cout << "--------------------" << std::endl;
+	std::cout << "createRelationRandom, insertEntry build" << std::endl;
+	createRelationRandom(relationSize);
+	IndexOptions options;
+	options.bulkLoad = false;
+	indexTests(options);
+	deleteRelation();
+}
 
-void createRelationForward(int relationSize)
+void test8()
 {
-	std::vector<RecordId> ridVec;
-  // destroy any old copies of relation file
+	// Bulk load with a sort buffer small enough to spill sorted runs to disk
+	std::cout << "--------------------" << std::endl;
+	std::cout << "createRelationRandom, external sort bulk load" << std::endl;
+	createRelationRandom(10000);
+	IndexOptions options;
+	options.fillFactor = 1.0;
+	options.sortBufferEntries = 1500;
+	indexTests(options);
+	deleteRelation();
+}
+
+void test9()
+{
+	// Reopen the index file left by an earlier BTreeIndex instead of rebuilding it
+	std::cout << "--------------------" << std::endl;
+	std::cout << "Reopen existing index" << std::endl;
+	createRelationForward(relationSize);
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+	}
+	bufMgr->clearBufStats();
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		// opening reads the meta page and nothing else
+		checkPassFail(bufMgr->getBufStats().diskreads, 1)
+		checkPassFail(intScan(&index,25,GT,40,LT), 14)
+		checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+	}
 	try
 	{
-		File::remove(relationName);
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), DOUBLE);
+		std::cout << "BadIndexInfoException Test 1 Failed." << std::endl;
+	}
+	catch(const BadIndexInfoException &e)
+	{
+		std::cout << "BadIndexInfoException Test 1 Passed." << std::endl;
+	}
+	try
+	{
+		File::remove(intIndexName);
 	}
 	catch(const FileNotFoundException &e)
 	{
 	}
+	deleteRelation();
+}
 
-  file1 = new PageFile(relationName, true);
-
-  // initialize all of record1.s to keep purify happy
-  memset(record1.s, ' ', sizeof(record1.s));
-	PageId new_page_number;
-  Page new_page = file1->allocatePage(new_page_number);
-
-  // Insert a bunch of tuples into the relation.
-  for(int i = 0; i < relationSize; i++ )
+void test10()
+{
+	// Batched scans, batches smaller than a leaf and larger than the whole range
+	std::cout << "--------------------" << std::endl;
+	std::cout << "createRelationRandom, batched scans" << std::endl;
+	createRelationRandom(10000);
 	{
-    sprintf(record1.s, "%05d string record", i);
-    record1.i = i;
-    record1.d = (double)i;
-    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
-
-		while(1)
-		{
-			try
-			{
-    		new_page.insertRecord(new_data);
-				break;
-			}
-			catch(const InsufficientSpaceException &e)
-			{
-				file1->writePage(new_page_number, new_page);
-  			new_page = file1->allocatePage(new_page_number);
-			}
-		}
-  }
-	file1->writePage(new_page_number, new_page);
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(intBatchScan(&index,25,GT,40,LT,7), 14)
+		checkPassFail(intBatchScan(&index,20,GTE,35,LTE,7), 16)
+		checkPassFail(intBatchScan(&index,-3,GT,3,LT,1), 3)
+		checkPassFail(intBatchScan(&index,0,GT,1,LT,7), 0)
+		checkPassFail(intBatchScan(&index,3000,GTE,4000,LT,100), 1000)
+		checkPassFail(intBatchScan(&index,3000,GTE,4000,LT,4096), 1000)
+		checkPassFail(intBatchScan(&index,-100,GTE,20000,LTE,4096), 10000)
+		// a batch and scanNext continue from the same position
+		int lowVal = 100;
+		int highVal = 200;
+		RecordId rids[60];
+		RecordId rid;
+		index.startScan(&lowVal, GTE, &highVal, LTE);
+		std::size_t found = index.scanNextBatch(rids, 60);
+		index.scanNext(rid);
+		found++;
+		found += index.scanNextBatch(rids, 60);
+		found += index.scanNextBatch(rids, 60);
+		index.endScan();
+		checkPassFail(found, 101)
+	}
+	try
+	{
+		File::remove(intIndexName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+	deleteRelation();
 }
 
-// -----------------------------------------------------------------------------
-// createRelationBackward
-// -----------------------------------------------------------------------------
-
-void createRelationBackward(int relationSize)
+void test11()
 {
-  // destroy any old copies of relation file
+	// Scans that end without exceptions: range-based for loops and the try* calls
+	std::cout << "--------------------" << std::endl;
+	std::cout << "createRelationForward, range scans" << std::endl;
+	createRelationForward(relationSize);
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(intRangeCount(&index,25,GT,40,LT), 14)
+		checkPassFail(intRangeCount(&index,20,GTE,35,LTE), 16)
+		checkPassFail(intRangeCount(&index,0,GT,1,LT), 0)
+		checkPassFail(intRangeCount(&index,5000,GTE,6000,LT), 0)
+		checkPassFail(intRangeCount(&index,3000,GTE,4000,LT), 1000)
+		int lowVal = 0;
+		int highVal = 1;
+		RecordId rid;
+		checkPassFail(index.tryStartScan(&lowVal, GT, &highVal, LT), false)
+		checkPassFail(index.tryScanNext(rid), false)
+		index.endScan();
+	}
 	try
 	{
-		File::remove(relationName);
+		File::remove(intIndexName);
 	}
 	catch(const FileNotFoundException &e)
 	{
 	}
-  file1 = new PageFile(relationName, true);
-
-  // initialize all of record1.s to keep purify happy
-  memset(record1.s, ' ', sizeof(record1.s));
-	PageId new_page_number;
-  Page new_page = file1->allocatePage(new_page_number);
+	deleteRelation();
 
-  // Insert a bunch of tuples into the relation.
-  for(int i = relationSize - 1; i >= 0; i-- )
+	// the whole index fits in the root leaf
+	std::cout << "createRelationForward, single leaf" << std::endl;
+	createRelationForward(10);
 	{
-    sprintf(record1.s, "%05d string record", i);
-    record1.i = i;
-    record1.d = i;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(intScan(&index,2,GTE,5,LT), 3)
+		checkPassFail(intRangeCount(&index,-5,GT,100,LT), 10)
+	}
+	try
+	{
+		File::remove(intIndexName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+	deleteRelation();
 
-    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
+	// runs of equal keys longer than a leaf, built both ways
+	std::cout << "createRelationDuplicates" << std::endl;
+	createRelationDuplicates(10000, 10);
+	for (int bulk = 0; bulk < 2; bulk++)
+	{
+		IndexOptions options;
+		options.bulkLoad = bulk == 1;
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+			checkPassFail(intRangeCount(&index,4,GT,7,LT), 2000)
+			checkPassFail(intRangeCount(&index,4,GTE,4,LTE), 1000)
+			checkPassFail(intRangeCount(&index,4,GT,5,LT), 0)
+			checkPassFail(intScan(&index,8,GT,9,LTE), 1000)
+			checkPassFail(intBatchScan(&index,0,GTE,2,LT,4096), 2000)
+		}
+		try
+		{
+			File::remove(intIndexName);
+		}
+		catch(const FileNotFoundException &e)
+		{
+		}
+	}
+	deleteRelation();
+}
 
-		while(1)
+void test12()
+{
+	// Several cursors open on one index at once, next to the scan of startScan
+	std::cout << "--------------------" << std::endl;
+	std::cout << "createRelationRandom, concurrent cursors" << std::endl;
+	createRelationRandom(10000);
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		int low1 = 1000, high1 = 3000;
+		int low2 = 2000, high2 = 9999;
+		BTreeCursor cursor1(&index);
+		BTreeCursor cursor2(&index);
+		checkPassFail(cursor1.open(&low1, GTE, &high1, LT), true)
+		checkPassFail(cursor2.open(&low2, GT, &high2, LTE), true)
+		int count1 = 0;
+		int count2 = 0;
+		RecordId rid;
+		bool more1 = true;
+		bool more2 = true;
+		while (more1 || more2)
 		{
-			try
+			if (more1 && (more1 = cursor1.next(rid)))
 			{
-    		new_page.insertRecord(new_data);
-				break;
+				count1++;
 			}
-			catch(const InsufficientSpaceException &e)
+			if (more2 && (more2 = cursor2.next(rid)))
 			{
-				file1->writePage(new_page_number, new_page);
-  			new_page = file1->allocatePage(new_page_number);
+				count2++;
+			}
+			// the index's own scan is not disturbed by the cursors
+			if (count1 == 1000)
+			{
+				checkPassFail(intScan(&index,25,GT,40,LT), 14)
 			}
 		}
-  }
+		checkPassFail(count1, 2000)
+		checkPassFail(count2, 7999)
+
+		// nested loop, one inner cursor reopened for every outer entry
+		int outerLow = 100, outerHigh = 110;
+		BTreeCursor outer(&index);
+		BTreeCursor inner(&index);
+		int pairs = 0;
+		outer.open(&outerLow, GTE, &outerHigh, LT);
+		while (outer.next(rid))
+		{
+			int innerLow = 105;
+			int innerHigh = 120;
+			inner.open(&innerLow, GTE, &innerHigh, LT);
+			RecordId innerRid;
+			while (inner.next(innerRid))
+			{
+				pairs++;
+			}
+		}
+		outer.close();
+		inner.close();
+		checkPassFail(pairs, 10 * 15)
 
-	file1->writePage(new_page_number, new_page);
+		// ranges run on cursors of their own, nesting them works too
+		pairs = 0;
+		for (RecordId r1 : index.range(&outerLow, GTE, &outerHigh, LT))
+		{
+			for (RecordId r2 : index.range(&low1, GTE, &high1, LT))
+			{
+				pairs += r1.page_number != 0 && r2.page_number != 0;
+			}
+		}
+		checkPassFail(pairs, 10 * 2000)
+	}
+	try
+	{
+		File::remove(intIndexName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+	deleteRelation();
 }
 
-// -----------------------------------------------------------------------------
-// createRelationRandom
-// -----------------------------------------------------------------------------
-
-void createRelationRandom(int relationSize)
+void test13()
 {
-  // destroy any old copies of relation file
+	// Deletes that merge and redistribute nodes, and reuse the pages they free
+	std::cout << "--------------------" << std::endl;
+	std::cout << "createRelationRandom, deletes" << std::endl;
+	createRelationRandom(relationSize);
+	{
+		IndexOptions options;
+		options.bulkLoad = false;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		// every other key
+		checkPassFail(changeEntries(&index, true, 2, 0), relationSize / 2)
+		checkPassFail(intScan(&index,25,GT,40,LT), 7)
+		checkPassFail(intScan(&index,20,GTE,35,LTE), 8)
+		checkPassFail(intRangeCount(&index,3000,GTE,4000,LT), 500)
+		checkPassFail(intBatchScan(&index,-1,GT,relationSize,LT,4096), relationSize / 2)
+		// deleting again finds nothing
+		checkPassFail(changeEntries(&index, true, 2, 0), 0)
+		int key = 1;
+		RecordId noRid = {1, 1};
+		checkPassFail(index.deleteEntry(&key, noRid), false)
+		// down to a single leaf, then back
+		checkPassFail(changeEntries(&index, true, 2, 1), relationSize / 2)
+		checkPassFail(intRangeCount(&index,-1,GT,relationSize,LT), 0)
+		checkPassFail(changeEntries(&index, false, 1, 0), relationSize)
+		checkPassFail(intScan(&index,25,GT,40,LT), 14)
+		checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+	}
+	long builtSize = fileSize(intIndexName);
+	for (int round = 0; round < 3; round++)
+	{
+		// churn on the reopened index, freed pages are taken again instead of growing the file
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(changeEntries(&index, true, 3, round), (relationSize - round + 2) / 3)
+		checkPassFail(changeEntries(&index, true, 1, 0), relationSize - (relationSize - round + 2) / 3)
+		checkPassFail(changeEntries(&index, false, 1, 0), relationSize)
+		checkPassFail(intScan(&index,300,GT,400,LT), 99)
+	}
+	checkPassFail((fileSize(intIndexName) <= builtSize), true)
 	try
 	{
-		File::remove(relationName);
+		File::remove(intIndexName);
 	}
 	catch(const FileNotFoundException &e)
 	{
 	}
-  file1 = new PageFile(relationName, true);
-
-  // initialize all of record1.s to keep purify happy
-  memset(record1.s, ' ', sizeof(record1.s));
-	PageId new_page_number;
-  Page new_page = file1->allocatePage(new_page_number);
-
-  // insert records in random order
-
-  std::vector<int> intvec(relationSize);
-  for( int i = 0; i < relationSize; i++ )
-  {
-    intvec[i] = i;
-  }
-
-  long pos;
-  int val;
-	int i = 0;
-  while( i < relationSize )
-  {
-    pos = random() % (relationSize-i);
-    val = intvec[pos];
-    sprintf(record1.s, "%05d string record", val);
-    record1.i = val;
-    record1.d = val;
 
-    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
+	// string leaves emptied down to nothing and filled again
+	deleteRelation();
+	createRelationRandom(20000);
+	{
+		IndexOptions options;
+		options.bulkLoad = false;
+		BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING, options);
+		checkPassFail(changeEntries(&index, true, 4, 1, STRING), 5000)
+		checkPassFail(changeEntries(&index, true, 4, 3, STRING), 5000)
+		checkPassFail(stringScan(&index,3000,GTE,4000,LT), 500)
+		checkPassFail(changeEntries(&index, true, 1, 0, STRING), 10000)
+		checkPassFail(stringScan(&index,0,GTE,19999,LTE), 0)
+		checkPassFail(changeEntries(&index, false, 2, 0, STRING), 10000)
+		checkPassFail(stringScan(&index,3000,GTE,4000,LT), 500)
+		checkPassFail(changeEntries(&index, true, 2, 0, STRING), 10000)
+	}
+	try
+	{
+		File::remove(stringIndexName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
 
-		while(1)
+	// entries among long runs of equal keys, in double and string indexes too
+	deleteRelation();
+	createRelationDuplicates(10000, 10);
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(changeEntries(&index, true, 10, 4), 1000)
+		checkPassFail(intRangeCount(&index,3,GTE,5,LTE), 2000)
+		checkPassFail(intRangeCount(&index,4,GTE,4,LTE), 0)
+	}
+	{
+		BTreeIndex index(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE);
+		double key = 7;
+		int deleted = 0;
+		FileScan scan(relationName, bufMgr);
+		try
 		{
-			try
+			RecordId rid;
+			while(1)
 			{
-    		new_page.insertRecord(new_data);
-				break;
+				scan.scanNext(rid);
+				std::string recordStr = scan.getRecord();
+				const RECORD *record = reinterpret_cast<const RECORD*>(recordStr.data());
+				if (record->d == key)
+				{
+					deleted += index.deleteEntry(&key, rid);
+				}
 			}
-			catch(const InsufficientSpaceException &e)
+		}
+		catch(const EndOfFileException &e)
+		{
+		}
+		checkPassFail(deleted, 1000)
+		checkPassFail(doubleScan(&index,6,GTE,8,LTE), 2000)
+	}
+	{
+		BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+		char key[64];
+		sprintf(key, "%05d string record", 2);
+		int deleted = 0;
+		FileScan scan(relationName, bufMgr);
+		try
+		{
+			RecordId rid;
+			while(1)
 			{
-      	file1->writePage(new_page_number, new_page);
-  			new_page = file1->allocatePage(new_page_number);
+				scan.scanNext(rid);
+				std::string recordStr = scan.getRecord();
+				const RECORD *record = reinterpret_cast<const RECORD*>(recordStr.data());
+				if (record->i == 2)
+				{
+					deleted += index.deleteEntry(key, rid);
+				}
 			}
 		}
-
-		int temp = intvec[relationSize-1-i];
-		intvec[relationSize-1-i] = intvec[pos];
-		intvec[pos] = temp;
-		i++;
-  }
-  
-	file1->writePage(new_page_number, new_page);
-}
-
-// -----------------------------------------------------------------------------
-// indexTests
-// -----------------------------------------------------------------------------
-
-void indexTests()
-{
-  intTests();
+		catch(const EndOfFileException &e)
+		{
+		}
+		checkPassFail(deleted, 1000)
+		checkPassFail(stringScan(&index,1,GTE,3,LTE), 2000)
+	}
 	try
 	{
 		File::remove(intIndexName);
+		File::remove(doubleIndexName);
+		File::remove(stringIndexName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+	deleteRelation();
+}
+
+void test14()
+{
+	// STRING keys sharing a long prefix, which leaves store once
+	const char *longKey = "customers/europe/west/account-%08d/balance";
+	std::cout << "--------------------" << std::endl;
+	std::cout << "createRelationRandom, keys with a long shared prefix" << std::endl;
+	createRelationRandom(20000, longKey);
+	{
+		BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+		checkPassFail(stringScan(&index,25,GT,40,LT,longKey), 14)
+		checkPassFail(stringScan(&index,3000,GTE,4000,LT,longKey), 1000)
+		checkPassFail(stringScan(&index,-1,GT,20000,LT,longKey), 20000)
+	}
+	// keys stored whole would need 20000 / STRINGARRAYLEAFSIZE leaves
+	checkPassFail((fileSize(stringIndexName) < 20000 / STRINGARRAYLEAFSIZE / 2 * (long)Page::SIZE), true)
+	File::remove(stringIndexName);
+	{
+		// inserted one by one, leaf splits lengthen the prefixes
+		IndexOptions options;
+		options.bulkLoad = false;
+		BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING, options);
+		checkPassFail(stringScan(&index,3000,GTE,4000,LT,longKey), 1000)
+		checkPassFail(changeEntries(&index, true, 4, 1, STRING), 5000)
+		checkPassFail(stringScan(&index,3000,GTE,4000,LT,longKey), 750)
+		checkPassFail(changeEntries(&index, false, 4, 1, STRING), 5000)
+		checkPassFail(stringScan(&index,-1,GT,20000,LT,longKey), 20000)
+	}
+	File::remove(stringIndexName);
+	{
+		// nodes start out underfull, so deletes merge and borrow on every level
+		IndexOptions options;
+		options.fillFactor = 0.2;
+		BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING, options);
+		checkPassFail(changeEntries(&index, true, 4, 0, STRING), 5000)
+		checkPassFail(changeEntries(&index, true, 4, 2, STRING), 5000)
+		checkPassFail(stringScan(&index,3000,GTE,4000,LT,longKey), 500)
+		checkPassFail(changeEntries(&index, true, 2, 1, STRING), 10000)
+		checkPassFail(stringScan(&index,-1,GT,20000,LT,longKey), 0)
+		checkPassFail(changeEntries(&index, false, 1, 0, STRING), 20000)
+		checkPassFail(stringScan(&index,3000,GTE,4000,LT,longKey), 1000)
+		checkPassFail(stringScan(&index,-1,GT,20000,LT,longKey), 20000)
+	}
+	File::remove(stringIndexName);
+	deleteRelation();
+
+	// keys that are prefixes of other keys, "1" < "10" < "100" < "11" < "2"
+	std::cout << "createRelationRandom, keys of different lengths" << std::endl;
+	createRelationRandom(20000, "%d");
+	for (int bulkLoad = 0; bulkLoad < 2; bulkLoad++)
+	{
+		IndexOptions options;
+		options.bulkLoad = bulkLoad;
+		BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING, options);
+		// 1, 10-19, 100-199, 1000-1999, 10000-19999
+		checkPassFail(stringScan(&index,1,GTE,2,LT,"%d"), 11111)
+		checkPassFail(stringScan(&index,19,GT,2,LT,"%d"), 1110)
+		checkPassFail(stringScan(&index,5,GTE,5,LTE,"%d"), 1)
+		// the multiples of 10 among them
+		checkPassFail(changeEntries(&index, true, 10, 0, STRING), 2000)
+		checkPassFail(stringScan(&index,1,GTE,2,LT,"%d"), 10000)
+		checkPassFail(changeEntries(&index, false, 10, 0, STRING), 2000)
+		checkPassFail(stringScan(&index,1,GTE,2,LT,"%d"), 11111)
+	}
+	File::remove(stringIndexName);
+	deleteRelation();
+}
+
+void test15()
+{
+	// Leaves that keep each key once, with the record ids of its entries in a posting list
+	std::cout << "--------------------" << std::endl;
+	std::cout << "createRelationRandom, posting lists" << std::endl;
+	createRelationRandom(relationSize);
+	IndexOptions options;
+	options.postingLists = true;
+	indexTests(options);
+	options.bulkLoad = false;
+	indexTests(options);
+	deleteRelation();
+
+	// a few keys whose lists fill overflow pages
+	std::cout << "createRelationDuplicates, posting lists" << std::endl;
+	createRelationDuplicates(50000, 10);
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+	}
+	long arraySize = fileSize(intIndexName);
+	File::remove(intIndexName);
+	for (int bulk = 0; bulk < 2; bulk++)
+	{
+		options.bulkLoad = bulk == 1;
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+			checkPassFail(intRangeCount(&index,4,GT,7,LT), 10000)
+			checkPassFail(intRangeCount(&index,4,GTE,4,LTE), 5000)
+			checkPassFail(intRangeCount(&index,4,GT,5,LT), 0)
+			checkPassFail(intScan(&index,8,GT,9,LTE), 5000)
+			checkPassFail(intBatchScan(&index,0,GTE,2,LT,4096), 10000)
+			checkPassFail(intBatchScan(&index,-1,GT,9,LTE,7), 50000)
+		}
+		checkPassFail((fileSize(intIndexName) * 4 < arraySize), true)
+		try
+		{
+			// the layout is part of the index
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+			std::cout << "BadIndexInfoException Test 2 Failed." << std::endl;
+		}
+		catch(const BadIndexInfoException &e)
+		{
+			std::cout << "BadIndexInfoException Test 2 Passed." << std::endl;
+		}
+		{
+			// whole lists leave and come back a record id at a time
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+			checkPassFail(changeEntries(&index, true, 10, 4), 5000)
+			checkPassFail(intRangeCount(&index,3,GTE,5,LTE), 10000)
+			checkPassFail(changeEntries(&index, true, 10, 4), 0)
+			checkPassFail(changeEntries(&index, false, 10, 4), 5000)
+			checkPassFail(intRangeCount(&index,4,GTE,4,LTE), 5000)
+			checkPassFail(changeEntries(&index, true, 2, 1), 25000)
+			checkPassFail(intBatchScan(&index,-1,GT,9,LTE,4096), 25000)
+		}
+		File::remove(intIndexName);
+	}
+	deleteRelation();
+
+	// record ids that arrive out of order go into the middle of lists and split overflow pages
+	std::cout << "createRelationDuplicates, posting lists out of order" << std::endl;
+	createRelationDuplicates(30000, 2);
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		int key = 1;
+		std::vector<RecordId> rids;
+		for (RecordId rid : index.range(&key, GTE, &key, LTE))
+		{
+			rids.push_back(rid);
+		}
+		checkPassFail((int)rids.size(), 15000)
+		int deleted = 0;
+		for (std::size_t i = 0; i < rids.size(); i += 2)
+		{
+			deleted += index.deleteEntry(&key, rids[i]);
+		}
+		checkPassFail(deleted, 7500)
+		checkPassFail(intRangeCount(&index,1,GTE,1,LTE), 7500)
+		for (std::size_t i = rids.size(); i-- > 0; )
+		{
+			if (i % 2 == 0)
+			{
+				index.insertEntry(&key, rids[i]);
+			}
+		}
+		// lists are kept in record id order
+		std::vector<RecordId> again;
+		for (RecordId rid : index.range(&key, GTE, &key, LTE))
+		{
+			again.push_back(rid);
+		}
+		checkPassFail((again == rids), true)
+		checkPassFail(intRangeCount(&index,0,GTE,1,LTE), 30000)
+	}
+	File::remove(intIndexName);
+	deleteRelation();
+}
+
+void test16()
+{
+	// Point lookups, with every leaf layout and with equal keys spread over several leaves
+	std::cout << "--------------------" << std::endl;
+	std::cout << "createRelationRandom, lookups" << std::endl;
+	createRelationRandom(relationSize);
+	IndexOptions options;
+	for (int layout = 0; layout < 4; layout++)
+	{
+		options.postingLists = layout >= 2;
+		options.bulkLoad = layout % 2 == 0;
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+			checkPassFail(lookupKeys(&index,-100,relationSize+100), relationSize)
+			checkPassFail(changeEntries(&index, true, 2, 0), relationSize / 2)
+			checkPassFail(lookupKeys(&index,-100,relationSize+100), relationSize / 2)
+			checkPassFail(changeEntries(&index, true, 2, 1), relationSize / 2)
+			// every leaf is empty
+			checkPassFail(lookupKeys(&index,-100,relationSize+100), 0)
+		}
+		File::remove(intIndexName);
+		{
+			BTreeIndex index(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE, options);
+			checkPassFail(lookupKeys(&index,-100,relationSize+100,DOUBLE), relationSize)
+			double key = 2.5;
+			checkPassFail(index.contains(&key), false)
+		}
+		File::remove(doubleIndexName);
+		{
+			BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING, options);
+			checkPassFail(lookupKeys(&index,-100,relationSize+100,STRING), relationSize)
+			char key[STRINGSIZE + 1] = "00025 string";
+			checkPassFail(index.contains(key), false)
+		}
+		File::remove(stringIndexName);
+	}
+	deleteRelation();
+
+	// equal keys run over leaf boundaries, lookups go right of the separator they equal
+	std::cout << "createRelationDuplicates, lookups" << std::endl;
+	createRelationDuplicates(20000, 40);
+	for (int layout = 0; layout < 4; layout++)
+	{
+		options.postingLists = layout >= 2;
+		options.bulkLoad = layout % 2 == 0;
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+			checkPassFail(lookupKeys(&index,-10,50), 40)
+			checkPassFail(changeEntries(&index, true, 40, 17), 500)
+			checkPassFail(lookupKeys(&index,-10,50), 39)
+			int key = 17;
+			checkPassFail(index.contains(&key), false)
+			checkPassFail(changeEntries(&index, false, 40, 17), 500)
+			checkPassFail(index.contains(&key), true)
+		}
+		File::remove(intIndexName);
+	}
+	deleteRelation();
+}
+
+void test17()
+{
+	// Entries inserted in sorted batches, into emptied and into half full trees
+	std::cout << "--------------------" << std::endl;
+	std::cout << "createRelationRandom, batch inserts" << std::endl;
+	createRelationRandom(relationSize);
+	IndexOptions options;
+	for (int layout = 0; layout < 4; layout++)
+	{
+		options.postingLists = layout >= 2;
+		options.bulkLoad = layout % 2 == 0;
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+			checkPassFail(changeEntries(&index, true, 1, 0), relationSize)
+			// one batch splits its way up from a single leaf
+			checkPassFail(insertBatches(&index, 1, 0, relationSize), relationSize)
+			checkPassFail(intScan(&index,25,GT,40,LT), 14)
+			checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+			checkPassFail(lookupKeys(&index,-100,relationSize+100), relationSize)
+			checkPassFail(changeEntries(&index, true, 4, 1), relationSize / 4)
+			checkPassFail(insertBatches(&index, 4, 1, 97), relationSize / 4)
+			checkPassFail(intRangeCount(&index,-1,GT,relationSize,LT), relationSize)
+			checkPassFail(intBatchScan(&index,300,GT,400,LT,16), 99)
+		}
+		File::remove(intIndexName);
+		{
+			BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING, options);
+			checkPassFail(changeEntries(&index, true, 2, 0, STRING), relationSize / 2)
+			checkPassFail(insertBatches(&index, 2, 0, 1000, STRING), relationSize / 2)
+			checkPassFail(stringScan(&index,-1,GT,relationSize,LT), relationSize)
+			checkPassFail(lookupKeys(&index,-100,relationSize+100,STRING), relationSize)
+		}
+		File::remove(stringIndexName);
+	}
+	deleteRelation();
+
+	// batches full of equal keys
+	std::cout << "createRelationDuplicates, batch inserts" << std::endl;
+	createRelationDuplicates(20000, 40);
+	for (int layout = 0; layout < 4; layout++)
+	{
+		options.postingLists = layout >= 2;
+		options.bulkLoad = layout % 2 == 0;
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+			checkPassFail(changeEntries(&index, true, 5, 2), 4000)
+			checkPassFail(insertBatches(&index, 5, 2, 300), 4000)
+			checkPassFail(intRangeCount(&index,17,GTE,17,LTE), 500)
+			checkPassFail(intRangeCount(&index,-1,GT,40,LT), 20000)
+			checkPassFail(changeEntries(&index, true, 5, 2), 4000)
+		}
+		File::remove(intIndexName);
+	}
+	deleteRelation();
+}
+
+void test18()
+{
+	// Range counts from the subtree counts kept in non-leaf nodes, while the tree changes
+	std::cout << "--------------------" << std::endl;
+	std::cout << "createRelationRandom, counted" << std::endl;
+	createRelationRandom(relationSize);
+	IndexOptions options;
+	options.counted = true;
+	indexTests(options);
+	for (int layout = 0; layout < 4; layout++)
+	{
+		options.postingLists = layout >= 2;
+		options.bulkLoad = layout % 2 == 0;
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+			checkPassFail(intCount(&index,25,GT,40,LT), 14)
+			checkPassFail(intCount(&index,3000,GTE,4000,LT), 1000)
+			checkPassFail(intCount(&index,-1,GT,relationSize,LT), relationSize)
+			checkPassFail(intCount(&index,996,GT,996,LT), 0)
+			checkPassFail(intCount(&index,relationSize,GTE,relationSize+100,LTE), 0)
+			checkPassFail(changeEntries(&index, true, 3, 0), relationSize / 3 + 1)
+			checkPassFail(intCount(&index,0,GTE,relationSize,LT), intRangeCount(&index,0,GTE,relationSize,LT))
+			checkPassFail(intCount(&index,300,GTE,400,LTE), 67)
+			// emptied leaves merge away and come back from batches
+			checkPassFail(changeEntries(&index, true, 3, 1), relationSize / 3 + 1)
+			checkPassFail(insertBatches(&index, 3, 0, 50), relationSize / 3 + 1)
+			checkPassFail(intCount(&index,-1,GT,relationSize,LT), relationSize - relationSize / 3 - 1)
+			checkPassFail(changeEntries(&index, false, 3, 1), relationSize / 3 + 1)
+			checkPassFail(intCount(&index,25,GT,40,LT), 14)
+			checkPassFail(intCount(&index,-1,GT,relationSize,LT), relationSize)
+		}
+		{
+			// counts are saved with the tree
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+			checkPassFail(intCount(&index,4000,GT,relationSize,LTE), relationSize - 4001)
+		}
+		File::remove(intIndexName);
+		{
+			BTreeIndex index(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE, options);
+			double low = 25.5, high = 40;
+			checkPassFail((int)index.countRange(&low, GT, &high, LTE), 15)
+		}
+		File::remove(doubleIndexName);
+		{
+			BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING, options);
+			char low[STRINGSIZE + 1] = "00025 string record";
+			char high[STRINGSIZE + 1] = "04000 string record";
+			checkPassFail((int)index.countRange(low, GTE, high, LT), 3975)
+			checkPassFail(changeEntries(&index, true, 2, 0, STRING), relationSize / 2)
+			checkPassFail((int)index.countRange(low, GTE, high, LT), 1988)
+		}
+		File::remove(stringIndexName);
+	}
+	try
+	{
+		// counted and uncounted trees have different non-leaf nodes
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		options.counted = false;
+		BTreeIndex other(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		std::cout << "BadIndexInfoException Test 3 Failed." << std::endl;
+	}
+	catch(const BadIndexInfoException &e)
+	{
+		std::cout << "BadIndexInfoException Test 3 Passed." << std::endl;
+	}
+	File::remove(intIndexName);
+	{
+		// without counts the range is scanned
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		checkPassFail(intCount(&index,25,GT,40,LT), 14)
+		checkPassFail(intCount(&index,-1,GT,relationSize,LT), relationSize)
+	}
+	File::remove(intIndexName);
+	deleteRelation();
+
+	// long runs of equal keys, in posting lists that spill into overflow pages
+	std::cout << "createRelationDuplicates, counted" << std::endl;
+	createRelationDuplicates(50000, 10);
+	options.counted = true;
+	for (int layout = 0; layout < 4; layout++)
+	{
+		options.postingLists = layout >= 2;
+		options.bulkLoad = layout % 2 == 0;
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+			checkPassFail(intCount(&index,4,GTE,4,LTE), 5000)
+			checkPassFail(intCount(&index,4,GT,7,LT), 10000)
+			checkPassFail(intCount(&index,-1,GT,9,LTE), 50000)
+			checkPassFail(changeEntries(&index, true, 10, 4), 5000)
+			checkPassFail(intCount(&index,3,GTE,5,LTE), 10000)
+			checkPassFail(changeEntries(&index, true, 2, 1), 25000)
+			checkPassFail(intCount(&index,-1,GT,9,LTE), 20000)
+			checkPassFail(insertBatches(&index, 10, 4, 777), 5000)
+			checkPassFail(intCount(&index,-1,GT,9,LTE), intRangeCount(&index,-1,GT,9,LTE))
+		}
+		File::remove(intIndexName);
+	}
+	deleteRelation();
+}
+
+void test19()
+{
+	// Lookups in two threads while two others delete and insert entries, for every layout
+	std::cout << "--------------------" << std::endl;
+	std::cout << "createRelationRandom, concurrent" << std::endl;
+	createRelationRandom(relationSize);
+	std::vector<RECORD> records;
+	std::vector<RecordId> rids;
+	{
+		FileScan scan(relationName, bufMgr);
+		try
+		{
+			RecordId rid;
+			while(1)
+			{
+				scan.scanNext(rid);
+				std::string recordStr = scan.getRecord();
+				records.push_back(*reinterpret_cast<const RECORD*>(recordStr.data()));
+				rids.push_back(rid);
+			}
+		}
+		catch(const EndOfFileException &e)
+		{
+		}
+	}
+
+	const Datatype types[5] = { INTEGER, INTEGER, INTEGER, STRING, DOUBLE };
+	for (int config = 0; config < 5; config++)
+	{
+		IndexOptions options;
+		options.postingLists = config == 1 || config == 4;
+		options.counted = config == 2 || config == 4;
+		Datatype type = types[config];
+		std::string &indexName = type == INTEGER ? intIndexName : type == DOUBLE ? doubleIndexName : stringIndexName;
+		int offset = type == INTEGER ? offsetof(tuple,i) : type == DOUBLE ? offsetof(tuple,d) : offsetof(tuple,s);
+		{
+			BTreeIndex index(relationName, indexName, bufMgr, offset, type, options);
+			std::atomic<int> failures(0);
+			std::atomic<int> writersLeft(2);
+			auto key = [&](std::size_t j) {
+				return type == INTEGER ? (const void*)&records[j].i
+						: type == DOUBLE ? (const void*)&records[j].d : (const void*)records[j].s;
+			};
+			// keys 1 modulo 4 are deleted and inserted again in batches, keys 3 modulo 4 are deleted
+			auto writer = [&](int residue) {
+				std::vector<std::pair<const void*, RecordId> > batch;
+				for (std::size_t j = 0; j < records.size(); j++)
+				{
+					if (records[j].i % 4 != residue)
+					{
+						continue;
+					}
+					if (!index.deleteEntry(key(j), rids[j]))
+					{
+						failures++;
+					}
+					batch.push_back(std::make_pair(key(j), rids[j]));
+				}
+				for (std::size_t j = 0; residue == 1 && j < batch.size(); j += 50)
+				{
+					index.insertBatch(&batch[j], std::min<std::size_t>(50, batch.size() - j));
+				}
+				writersLeft--;
+			};
+			// even keys are never touched and have to be found whatever the writers are doing
+			auto reader = [&]() {
+				int low = -1, high = relationSize;
+				double lowD = low, highD = high;
+				do
+				{
+					for (std::size_t j = 0; j < records.size(); j++)
+					{
+						RecordId rid;
+						if (records[j].i % 2 == 0 && (!index.lookup(key(j), rid) || !(rid == rids[j])))
+						{
+							failures++;
+						}
+					}
+					if (options.counted)
+					{
+						std::uint64_t count = type == INTEGER ? index.countRange(&low, GT, &high, LT)
+								: index.countRange(&lowD, GT, &highD, LT);
+						if (count < (std::uint64_t)relationSize / 2 || count > (std::uint64_t)relationSize)
+						{
+							failures++;
+						}
+					}
+				}
+				while (writersLeft > 0);
+			};
+			std::thread threads[4] = { std::thread(writer, 1), std::thread(writer, 3), std::thread(reader), std::thread(reader) };
+			for (int t = 0; t < 4; t++)
+			{
+				threads[t].join();
+			}
+			checkPassFail(failures.load(), 0)
+			checkPassFail(lookupKeys(&index, 0, relationSize, type), relationSize - relationSize / 4)
+			int scanned = type == INTEGER ? intScan(&index, -1, GT, relationSize, LT)
+					: type == DOUBLE ? doubleScan(&index, -1, GT, relationSize, LT) : stringScan(&index, 0, GTE, relationSize, LT);
+			checkPassFail(scanned, relationSize - relationSize / 4)
+		}
+		File::remove(indexName);
+	}
+	deleteRelation();
+}
+
+void test20()
+{
+	// Scans in two threads while two others split and merge leaves, for every leaf layout
+	std::cout << "--------------------" << std::endl;
+	std::cout << "createRelationRandom, scans alongside writers" << std::endl;
+	createRelationRandom(relationSize);
+	std::vector<RECORD> records;
+	std::vector<RecordId> rids;
+	// key of each record id of the relation
+	std::map<std::uint64_t, int> keyOf;
+	{
+		FileScan scan(relationName, bufMgr);
+		try
+		{
+			RecordId rid;
+			while(1)
+			{
+				scan.scanNext(rid);
+				std::string recordStr = scan.getRecord();
+				records.push_back(*reinterpret_cast<const RECORD*>(recordStr.data()));
+				rids.push_back(rid);
+				keyOf[((std::uint64_t)rid.page_number << 16) | rid.slot_number] = records.back().i;
+			}
+		}
+		catch(const EndOfFileException &e)
+		{
+		}
+	}
+
+	const Datatype types[4] = { INTEGER, INTEGER, STRING, DOUBLE };
+	for (int config = 0; config < 4; config++)
+	{
+		IndexOptions options;
+		options.postingLists = config == 1;
+		options.counted = config == 3;
+		Datatype type = types[config];
+		std::string &indexName = type == INTEGER ? intIndexName : type == DOUBLE ? doubleIndexName : stringIndexName;
+		int offset = type == INTEGER ? offsetof(tuple,i) : type == DOUBLE ? offsetof(tuple,d) : offsetof(tuple,s);
+		{
+			BTreeIndex index(relationName, indexName, bufMgr, offset, type, options);
+			std::atomic<int> failures(0);
+			std::atomic<int> writersLeft(2);
+			auto key = [&](std::size_t j) {
+				return type == INTEGER ? (const void*)&records[j].i
+						: type == DOUBLE ? (const void*)&records[j].d : (const void*)records[j].s;
+			};
+			// a second entry for every key 1 or 3 modulo 4, and a long list for key 1, inserted and then deleted.
+			// The record ids are made up, they are not in the relation
+			auto writer = [&](int residue) {
+				std::vector<std::pair<const void*, RecordId> > extra;
+				for (std::size_t j = 0; j < records.size(); j++)
+				{
+					RecordId rid;
+					rid.page_number = 100000 + records[j].i;
+					rid.slot_number = 1;
+					rid.padding = 0;
+					if (records[j].i % 4 == residue)
+					{
+						extra.push_back(std::make_pair(key(j), rid));
+					}
+					for (int n = 0; records[j].i == 1 && residue == 1 && n < 600; n++)
+					{
+						rid.slot_number = 2 + n;
+						extra.push_back(std::make_pair(key(j), rid));
+					}
+				}
+				for (std::size_t j = 0; j < extra.size(); j++)
+				{
+					index.insertEntry(extra[j].first, extra[j].second);
+				}
+				for (std::size_t j = 0; j < extra.size(); j++)
+				{
+					if (!index.deleteEntry(extra[j].first, extra[j].second))
+					{
+						failures++;
+					}
+				}
+				writersLeft--;
+			};
+			// entries of the relation with even keys are never touched, a scan returns each of them once and in order
+			auto scanner = [&](bool batched) {
+				int low = -1, high = relationSize;
+				double lowD = low, highD = high;
+				const char *lowS = "0", *highS = "1";
+				do
+				{
+					BTreeCursor cursor(&index);
+					type == INTEGER ? cursor.open(&low, GT, &high, LT)
+							: type == DOUBLE ? cursor.open(&lowD, GT, &highD, LT) : cursor.open(lowS, GTE, highS, LT);
+					int even = 0;
+					int lastKey = -1;
+					RecordId batch[64];
+					std::size_t n;
+					while ((n = batched ? cursor.nextBatch(batch, 64) : cursor.next(batch[0]) ? 1 : 0) > 0)
+					{
+						for (std::size_t k = 0; k < n; k++)
+						{
+							std::map<std::uint64_t, int>::const_iterator found = keyOf.find(((std::uint64_t)batch[k].page_number << 16) | batch[k].slot_number);
+							if (found == keyOf.end() || found->second % 2 != 0)
+							{
+								continue;
+							}
+							if (found->second < lastKey)
+							{
+								failures++;
+							}
+							lastKey = found->second;
+							even++;
+						}
+					}
+					if (even != relationSize / 2)
+					{
+						failures++;
+					}
+				}
+				while (writersLeft > 0);
+			};
+			std::thread threads[4] = { std::thread(writer, 1), std::thread(writer, 3), std::thread(scanner, false), std::thread(scanner, true) };
+			for (int t = 0; t < 4; t++)
+			{
+				threads[t].join();
+			}
+			checkPassFail(failures.load(), 0)
+			int scanned = type == INTEGER ? intScan(&index, -1, GT, relationSize, LT)
+					: type == DOUBLE ? doubleScan(&index, -1, GT, relationSize, LT) : stringScan(&index, 0, GTE, relationSize, LT);
+			checkPassFail(scanned, relationSize)
+		}
+		File::remove(indexName);
+	}
+	deleteRelation();
+}
+
+void test21()
+{
+	// Index-only scans of attributes stored in the leaves next to the keys
+	std::cout << "--------------------" << std::endl;
+	std::cout << "createRelationRandom, included attributes" << std::endl;
+	createRelationRandom(relationSize);
+	IndexOptions options;
+	IncludedColumn d = { offsetof(tuple,d), sizeof(double) };
+	IncludedColumn s = { offsetof(tuple,s), STRINGSIZE };
+	options.include.push_back(d);
+	options.include.push_back(s);
+	for (int layout = 0; layout < 4; layout++)
+	{
+		options.bulkLoad = layout % 2 == 0;
+		options.counted = layout >= 2;
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+			checkPassFail(index.payloadSize(), (int)(sizeof(double) + STRINGSIZE))
+			checkPassFail(coveredScan(&index,25,GT,40,LT,0), 14)
+			checkPassFail(coveredScan(&index,3000,GTE,4000,LT,64), 1000)
+			checkPassFail(coveredScan(&index,-1,GT,relationSize,LT,0), relationSize)
+			// merges, borrows and splits move the attributes along with their keys
+			checkPassFail(changeEntries(&index, true, 3, 1), relationSize / 3 + 1)
+			checkPassFail(coveredScan(&index,-1,GT,relationSize,LT,100), relationSize - relationSize / 3 - 1)
+			checkPassFail(insertBatches(&index, 3, 1, 200), relationSize / 3 + 1)
+			checkPassFail(changeEntries(&index, true, 2, 0), relationSize / 2)
+			checkPassFail(changeEntries(&index, false, 2, 0), relationSize / 2)
+			checkPassFail(coveredScan(&index,-1,GT,relationSize,LT,0), relationSize)
+			checkPassFail(lookupKeys(&index,-100,relationSize+100), relationSize)
+		}
+		{
+			// the attributes are saved with the tree
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+			checkPassFail(coveredScan(&index,4000,GT,relationSize,LTE,7), relationSize - 4001)
+		}
+		File::remove(intIndexName);
+	}
+	{
+		// a STRING index covering the int attribute, scanned with a cursor
+		IndexOptions stringOptions;
+		IncludedColumn i = { offsetof(tuple,i), sizeof(int) };
+		stringOptions.include.push_back(i);
+		BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING, stringOptions);
+		char low[STRINGSIZE + 1] = "00025 string record";
+		char high[STRINGSIZE + 1] = "04000 string record";
+		BTreeCursor cursor(&index);
+		cursor.open(low, GTE, high, LT);
+		RecordId rid;
+		int found = 0;
+		int outOfOrder = 0;
+		int previous = 24;
+		while (cursor.next(rid))
+		{
+			int key;
+			memcpy(&key, cursor.payload(), sizeof(int));
+			outOfOrder += key != previous + 1;
+			previous = key;
+			found++;
+		}
+		checkPassFail(found, 3975)
+		checkPassFail(outOfOrder, 0)
+	}
+	File::remove(stringIndexName);
+	try
+	{
+		// posting lists keep no entry per record to store the attributes with
+		options.postingLists = true;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		std::cout << "BadIndexInfoException Test 4 Failed." << std::endl;
+	}
+	catch(const BadIndexInfoException &e)
+	{
+		std::cout << "BadIndexInfoException Test 4 Passed." << std::endl;
+	}
+	options.postingLists = false;
+	try
+	{
+		// an index has to be opened with the attributes it was built with
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		options.include.pop_back();
+		BTreeIndex other(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		std::cout << "BadIndexInfoException Test 5 Failed." << std::endl;
+	}
+	catch(const BadIndexInfoException &e)
+	{
+		std::cout << "BadIndexInfoException Test 5 Passed." << std::endl;
+	}
+	File::remove(intIndexName);
+	deleteRelation();
+}
+
+void test22()
+{
+	// Records of index scans fetched a batch at a time, pinning each page once per batch
+	std::cout << "--------------------" << std::endl;
+	std::cout << "createRelationRandom, batched record fetches" << std::endl;
+	createRelationRandom(relationSize);
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(fetchedScan(&index,25,GT,40,LT,64), 14)
+		checkPassFail(fetchedScan(&index,996,GTE,3000,LTE,50), 2005)
+		checkPassFail(fetchedScan(&index,-1,GT,relationSize,LT,1), relationSize)
+		checkPassFail(fetchedScan(&index,-1,GT,relationSize,LT,relationSize), relationSize)
+
+		// every record id of the relation, twice, in index order
+		std::vector<RecordId> rids(2 * relationSize);
+		int low = -1;
+		int high = relationSize;
+		index.startScan(&low, GT, &high, LT);
+		checkPassFail((int)index.scanNextBatch(&rids[0], relationSize), relationSize)
+		index.endScan();
+		std::copy(rids.begin(), rids.begin() + relationSize, rids.begin() + relationSize);
+		std::set<PageId> pages;
+		for (int i = 0; i < relationSize; i++)
+		{
+			pages.insert(rids[i].page_number);
+		}
+
+		// a cold batch reads each of its pages once, ahead of pinning them
+		bufMgr->flushFile(file1);
+		bufMgr->clearBufStats();
+		std::vector<RecordView> views(rids.size());
+		RecordFetcher fetcher(bufMgr, file1);
+		fetcher.fetch(&rids[0], rids.size(), &views[0]);
+		checkPassFail((int)fetcher.pinnedPages(), (int)pages.size())
+		checkPassFail(bufMgr->getBufStats().diskreads, (int)pages.size())
+		int wrong = 0;
+		for (std::size_t i = 0; i < rids.size(); i++)
+		{
+			Page *curPage;
+			bufMgr->readPage(file1, rids[i].page_number, curPage);
+			std::string copy = curPage->getRecord(rids[i]);
+			bufMgr->unPinPage(file1, rids[i].page_number, false);
+			wrong += copy != std::string(views[i].data, views[i].length);
+			wrong += views[i].data != views[i % relationSize].data;
+		}
+		checkPassFail(wrong, 0)
+		fetcher.release();
+		checkPassFail((int)fetcher.pinnedPages(), 0)
+
+		// a record that is gone fails the batch and leaves none of its pages pinned
+		Page *curPage;
+		bufMgr->readPage(file1, rids[0].page_number, curPage);
+		curPage->deleteRecord(rids[0]);
+		bufMgr->unPinPage(file1, rids[0].page_number, true);
+		try
+		{
+			fetcher.fetch(&rids[1], relationSize, &views[0]);
+			std::cout << "InvalidRecordException Test 1 Failed." << std::endl;
+		}
+		catch(const InvalidRecordException &e)
+		{
+			std::cout << "InvalidRecordException Test 1 Passed." << std::endl;
+		}
+		checkPassFail((int)fetcher.pinnedPages(), 0)
+		// flushing the relation fails while any of its pages is pinned
+		bufMgr->flushFile(file1);
+	}
+	File::remove(intIndexName);
+	deleteRelation();
+}
+
+void test23()
+{
+	// Scans reading the leaves on their right ahead in the background
+	std::cout << "--------------------" << std::endl;
+	std::cout << "createRelationRandom, leaf read-ahead" << std::endl;
+	createRelationRandom(relationSize);
+	IndexOptions options;
+	for (int readAhead = 0; readAhead <= 8; readAhead += 2)
+	{
+		options.readAhead = readAhead;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		BTreeCursor cursor(&index);
+		int low = 25;
+		int high = 40;
+		RecordId rid;
+		int found = 0;
+		// a scan that stays on its first leaf reads nothing ahead
+		cursor.open(&low, GT, &high, LT);
+		while (cursor.next(rid))
+		{
+			found++;
+		}
+		checkPassFail(found, 14)
+		checkPassFail((int)cursor.leavesReadAhead(), 0)
+		low = -1;
+		high = relationSize;
+		found = 0;
+		cursor.open(&low, GT, &high, LT);
+		while (cursor.next(rid))
+		{
+			found++;
+		}
+		checkPassFail(found, relationSize)
+		// the scan may have got to the end before the thread did, it is only cancelled by close
+		for (int wait = 0; wait < 1000 && readAhead > 0 && cursor.leavesReadAhead() == 0; wait++)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		checkPassFail((cursor.leavesReadAhead() > 0), (readAhead > 0))
+		checkPassFail(intScan(&index,-1,GT,relationSize,LT), relationSize)
+		// closed half way, the read-ahead is given up and leaves no page pinned for the index to find
+		cursor.open(&low, GT, &high, LT);
+		for (int i = 0; i < relationSize / 2; i++)
+		{
+			cursor.next(rid);
+		}
+		BTreeCursor moved(std::move(cursor));
+		checkPassFail(moved.next(rid), true)
+		moved.close();
+		checkPassFail(intScan(&index,1000,GTE,4000,LT), 3000)
+		// two scans side by side take turns in the one read-ahead thread of the index
+		BTreeCursor left(&index);
+		BTreeCursor right(&index);
+		left.open(&low, GT, &high, LT);
+		right.open(&low, GT, &high, LT);
+		found = 0;
+		while (left.next(rid) && right.next(rid))
+		{
+			found++;
+		}
+		checkPassFail(found, relationSize)
+		for (int wait = 0; wait < 1000 && readAhead > 0 && (left.leavesReadAhead() == 0 || right.leavesReadAhead() == 0); wait++)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		checkPassFail((left.leavesReadAhead() > 0 && right.leavesReadAhead() > 0), (readAhead > 0))
+	}
+	{
+		// off unless asked for
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		BTreeCursor cursor(&index);
+		int low = -1;
+		int high = relationSize;
+		RecordId rid;
+		int found = 0;
+		cursor.open(&low, GT, &high, LT);
+		while (cursor.next(rid))
+		{
+			found++;
+		}
+		checkPassFail(found, relationSize)
+		checkPassFail((int)cursor.leavesReadAhead(), 0)
+	}
+	File::remove(intIndexName);
+	try
+	{
+		options.readAhead = -1;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		std::cout << "BadIndexInfoException Test 6 Failed." << std::endl;
+	}
+	catch(const BadIndexInfoException &e)
+	{
+		std::cout << "BadIndexInfoException Test 6 Passed." << std::endl;
+	}
+	deleteRelation();
+}
+
+void test24()
+{
+	// Backward scans from the high bound down, along the left links of the leaves
+	std::cout << "--------------------" << std::endl;
+	std::cout << "createRelationRandom, backward scans" << std::endl;
+	createRelationRandom(relationSize);
+	IndexOptions options;
+	for (int layout = 0; layout < 4; layout++)
+	{
+		options.bulkLoad = layout % 2 == 0;
+		options.counted = layout >= 2;
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+			checkPassFail(backwardScan(&index,25,GT,40,LT,0), 14)
+			checkPassFail(backwardScan(&index,20,GTE,35,LTE,5), 16)
+			checkPassFail(backwardScan(&index,996,GT,4000,LT,0), 3003)
+			checkPassFail(backwardScan(&index,-1,GT,relationSize,LT,300), relationSize)
+			checkPassFail(backwardScan(&index,relationSize,GTE,relationSize+10,LT,0), 0)
+			checkPassFail(backwardScan(&index,-10,GTE,-1,LTE,0), 0)
+			{
+				// the top entries of a long range without reading the rest of it
+				BTreeCursor cursor(&index);
+				int low = -1;
+				int high = 3000;
+				RecordId rids[10];
+				checkPassFail(cursor.openBackward(&low, GT, &high, LT), true)
+				checkPassFail((int)cursor.nextBatch(rids, 10), 10)
+				int wrong = 0;
+				for (int i = 0; i < 10; i++)
+				{
+					Page *curPage;
+					bufMgr->readPage(file1, rids[i].page_number, curPage);
+					RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(rids[i]).data()));
+					bufMgr->unPinPage(file1, rids[i].page_number, false);
+					wrong += myRec.i != 2999 - i;
+				}
+				checkPassFail(wrong, 0)
+			}
+			// merges and splits keep the left links
+			checkPassFail(changeEntries(&index, true, 3, 1), relationSize / 3 + 1)
+			checkPassFail(backwardScan(&index,-1,GT,relationSize,LT,0), relationSize - relationSize / 3 - 1)
+			checkPassFail(insertBatches(&index, 3, 1, 200), relationSize / 3 + 1)
+			checkPassFail(changeEntries(&index, true, 2, 0), relationSize / 2)
+			checkPassFail(backwardScan(&index,-1,GT,relationSize,LT,64), relationSize / 2)
+			checkPassFail(changeEntries(&index, false, 2, 0), relationSize / 2)
+			checkPassFail(backwardScan(&index,-1,GT,relationSize,LT,0), relationSize)
+			checkPassFail(backwardScan(&index,1000,GTE,2000,LTE,7), 1001)
+		}
+		File::remove(intIndexName);
+	}
+	{
+		// included attributes come back with the entries of a backward scan
+		IndexOptions coveringOptions;
+		IncludedColumn d = { offsetof(tuple,d), sizeof(double) };
+		coveringOptions.include.push_back(d);
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, coveringOptions);
+		BTreeCursor cursor(&index);
+		int low = 100;
+		int high = 4000;
+		cursor.openBackward(&low, GTE, &high, LTE);
+		RecordId rid;
+		int found = 0;
+		int outOfOrder = 0;
+		while (cursor.next(rid))
+		{
+			double d;
+			memcpy(&d, cursor.payload(), sizeof(double));
+			outOfOrder += d != high - found;
+			found++;
+		}
+		checkPassFail(found, 3901)
+		checkPassFail(outOfOrder, 0)
+	}
+	File::remove(intIndexName);
+	{
+		// STRING keys
+		BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+		char low[STRINGSIZE + 1] = "00025 string record";
+		char high[STRINGSIZE + 1] = "04000 string record";
+		BTreeCursor cursor(&index);
+		RecordId rids[4096];
+		cursor.openBackward(low, GTE, high, LT);
+		checkPassFail((int)cursor.nextBatch(rids, 4096), 3975)
+	}
+	File::remove(stringIndexName);
+	deleteRelation();
+
+	// runs of equal keys longer than a leaf
+	std::cout << "createRelationDuplicates" << std::endl;
+	createRelationDuplicates(10000, 10);
+	for (int bulk = 0; bulk < 2; bulk++)
+	{
+		options = IndexOptions();
+		options.bulkLoad = bulk == 1;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		checkPassFail(backwardScan(&index,4,GT,7,LT,0), 2000)
+		checkPassFail(backwardScan(&index,4,GTE,4,LTE,100), 1000)
+		checkPassFail(backwardScan(&index,4,GT,5,LT,0), 0)
+		checkPassFail(backwardScan(&index,-1,GT,9,LTE,0), 10000)
+	}
+	File::remove(intIndexName);
+	{
+		// leaves of a run rebalanced under a cursor, which goes on after the entry it returned last
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(thinnedRun(&index,0,false), 1000)
+		checkPassFail(thinnedRun(&index,4,true), 1000)
+	}
+	File::remove(intIndexName);
+	try
+	{
+		options.postingLists = true;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		BTreeCursor cursor(&index);
+		int low = 0;
+		int high = 5;
+		cursor.openBackward(&low, GT, &high, LT);
+		std::cout << "BadIndexInfoException Test 7 Failed." << std::endl;
+	}
+	catch(const BadIndexInfoException &e)
+	{
+		std::cout << "BadIndexInfoException Test 7 Passed." << std::endl;
+	}
+	File::remove(intIndexName);
+	deleteRelation();
+}
+
+void test25()
+{
+	// Non-leaf nodes laid out in cache line blocks with summaries above them
+	std::cout << "--------------------" << std::endl;
+	std::cout << "blocked non-leaf nodes" << std::endl;
+	{
+		// a node searched after every kind of change finds what a search of the sorted keys finds
+		typedef BlockedNonLeafNode<> Node;
+		std::vector<char> pages(3 * Page::SIZE + BufMgr::FRAME_ALIGNMENT);
+		std::uintptr_t start = reinterpret_cast<std::uintptr_t>(pages.data());
+		Node *node = reinterpret_cast<Node*>((start + BufMgr::FRAME_ALIGNMENT - 1) & ~(std::uintptr_t)(BufMgr::FRAME_ALIGNMENT - 1));
+		Node *right = reinterpret_cast<Node*>(reinterpret_cast<char*>(node) + Page::SIZE);
+		node->init(1);
+		std::mt19937 rng(25);
+		std::vector<int> keys;
+		int wrong = 0;
+		auto check = [&](const Node *n, const std::vector<int> &sorted) {
+			for (int probe = -2; probe <= 2 * Node::SIZE + 2; probe++)
+			{
+				int lower = std::lower_bound(sorted.begin(), sorted.end(), probe) - sorted.begin();
+				int upper = std::upper_bound(sorted.begin(), sorted.end(), probe) - sorted.begin();
+				wrong += n->lowerBound(probe) != lower || n->upperBound(probe) != upper;
+			}
+			for (std::size_t i = 0; i < sorted.size(); i++)
+			{
+				wrong += n->key(i) != sorted[i] || n->child(i + 1) != (PageId)n->key(i) + 1;
+			}
+		};
+		// even keys in random order, a few of them twice
+		while ((int)keys.size() < Node::SIZE)
+		{
+			int key = 2 * (int)(rng() % Node::SIZE);
+			int at = node->upperBound(key);
+			node->insert(at, key, key + 1);
+			keys.insert(keys.begin() + at, key);
+			if (keys.size() % 97 == 0)
+			{
+				check(node, keys);
+			}
+		}
+		check(node, keys);
+		checkPassFail(node->hasRoom(0), false)
+		// split, both halves are searched by their own summaries
+		int splitIndex = node->splitIndex();
+		node->moveTail(splitIndex, right);
+		std::vector<int> rightKeys(keys.begin() + splitIndex + 1, keys.end());
+		keys.resize(splitIndex);
+		check(node, keys);
+		check(right, rightKeys);
+		while (!keys.empty())
+		{
+			int at = rng() % keys.size();
+			node->remove(at);
+			keys.erase(keys.begin() + at);
+			if (keys.size() % 31 == 0)
+			{
+				check(node, keys);
+			}
+		}
+		// a key replaced by a smaller one, as a merge of the children below does
+		int replaced = rightKeys.size() / 2;
+		right->setChild(replaced + 1, rightKeys[replaced - 1] + 1);
+		rightKeys[replaced] = rightKeys[replaced - 1];
+		right->replaceKey(replaced, rightKeys[replaced]);
+		check(right, rightKeys);
+		checkPassFail(wrong, 0)
+	}
+
+	// indexes of many non-leaf nodes, sparse enough that inserts and deletes change them
+	std::cout << "createRelationRandom, blocked non-leaf nodes" << std::endl;
+	createRelationRandom(30000);
+	IndexOptions options;
+	options.blockedInnerNodes = true;
+	options.fillFactor = 0.05;
+	for (int layout = 0; layout < 3; layout++)
+	{
+		options.counted = layout == 1;
+		options.bulkLoad = layout != 2;
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+			checkPassFail(intScan(&index,25,GT,40,LT), 14)
+			checkPassFail(intScan(&index,-1,GT,30000,LT), 30000)
+			checkPassFail(lookupKeys(&index, 0, 30000), 30000)
+			checkPassFail(changeEntries(&index, true, 3, 1), 10000)
+			checkPassFail(intScan(&index,-1,GT,30000,LT), 20000)
+			checkPassFail(intCount(&index,1000,GTE,2000,LT), 666)
+			checkPassFail(insertBatches(&index, 3, 1, 100), 10000)
+			checkPassFail(changeEntries(&index, true, 2, 0), 15000)
+			checkPassFail(backwardScan(&index,-1,GT,30000,LT,0), 15000)
+			checkPassFail(changeEntries(&index, false, 2, 0), 15000)
+			checkPassFail(lookupKeys(&index, 0, 30000), 30000)
+		}
+		// the layout is kept in the meta page, the index is reopened with it
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+			checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+		}
+		try
+		{
+			IndexOptions sorted = options;
+			sorted.blockedInnerNodes = false;
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, sorted);
+			std::cout << "BadIndexInfoException Test 8 Failed." << std::endl;
+		}
+		catch(const BadIndexInfoException &e)
+		{
+			std::cout << "BadIndexInfoException Test 8 Passed." << std::endl;
+		}
+		File::remove(intIndexName);
+	}
+	try
+	{
+		BTreeIndex index(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE, options);
+		std::cout << "BadIndexInfoException Test 9 Failed." << std::endl;
+	}
+	catch(const BadIndexInfoException &e)
+	{
+		std::cout << "BadIndexInfoException Test 9 Passed." << std::endl;
+	}
+	deleteRelation();
+}
+
+void test26()
+{
+	// Ascending inserts into indexes that split the rightmost node of a level unevenly
+	std::cout << "--------------------" << std::endl;
+	std::cout << "createRelationForward, append splits" << std::endl;
+	createRelationForward(20000);
+	IndexOptions options;
+	options.bulkLoad = false;
+	long sizes[3];
+	for (int policy = 0; policy < 3; policy++)
+	{
+		// even splits, then the left node filled to 90% and to all but one entry
+		options.appendSplits = policy > 0;
+		options.fillFactor = policy == 2 ? 1.0 : 0.9;
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+			checkPassFail(intScan(&index,-1,GT,20000,LT), 20000)
+			checkPassFail(backwardScan(&index,996,GT,4000,LT,0), 3003)
+			checkPassFail(lookupKeys(&index, 0, 20000), 20000)
+		}
+		sizes[policy] = fileSize(intIndexName);
+		if (policy > 0)
+		{
+			// inserts and deletes all over the full nodes split them evenly
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+			checkPassFail(changeEntries(&index, true, 3, 1), 6667)
+			checkPassFail(insertBatches(&index, 3, 1, 50), 6667)
+			checkPassFail(intScan(&index,-1,GT,20000,LT), 20000)
+		}
+		File::remove(intIndexName);
+	}
+	// roughly half the pages of even splits
+	checkPassFail((sizes[1] * 10 < sizes[0] * 6), true)
+	checkPassFail((sizes[2] <= sizes[1]), true)
+
+	for (int policy = 0; policy < 2; policy++)
+	{
+		options.appendSplits = policy == 1;
+		options.fillFactor = 0.9;
+		{
+			BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING, options);
+			checkPassFail(stringScan(&index,-1,GT,20000,LT), 20000)
+		}
+		sizes[policy] = fileSize(stringIndexName);
+		File::remove(stringIndexName);
+	}
+	checkPassFail((sizes[1] * 10 < sizes[0] * 6), true)
+	deleteRelation();
+
+	// descending inserts never append, both policies split evenly
+	std::cout << "createRelationBackward, append splits" << std::endl;
+	createRelationBackward(20000);
+	for (int policy = 0; policy < 2; policy++)
+	{
+		options.appendSplits = policy == 1;
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+			checkPassFail(intScan(&index,-1,GT,20000,LT), 20000)
+		}
+		sizes[policy] = fileSize(intIndexName);
+		File::remove(intIndexName);
+	}
+	checkPassFail(sizes[1], sizes[0])
+	deleteRelation();
+}
+
+void test27()
+{
+	// Descents through the top levels of the tree kept pinned in the index
+	std::cout << "--------------------" << std::endl;
+	std::cout << "createRelationRandom, pinned upper levels" << std::endl;
+	createRelationRandom(30000);
+	IndexOptions options;
+	// a root and a level of about 20 nodes below it
+	options.fillFactor = 0.05;
+	const int pinned[3] = { 0, 4, 32 };
+	int accesses[3];
+	int diskreads[3];
+	for (int config = 0; config < 3; config++)
+	{
+		options.pinnedUpperPages = pinned[config];
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+			RecordId rid;
+			int key = 5;
+			checkPassFail(index.lookup(&key, rid), true)
+			// nothing, the root alone as the level below does not fit, the root and the level below
+			checkPassFail((int)std::min<std::size_t>(index.cachedUpperPages(), 2), config)
+			// the leaf of the key stays in the pool, the descents above it read nothing through the buffer manager
+			// once the levels are pinned
+			bufMgr->clearBufStats();
+			for (int i = 0; i < 100; i++)
+			{
+				index.lookup(&key, rid);
+			}
+			accesses[config] = bufMgr->getBufStats().accesses;
+			// a scan of every leaf evicts all pages of the pool that are not pinned
+			checkPassFail(intScan(&index,-1,GT,30000,LT), 30000)
+			bufMgr->clearBufStats();
+			index.lookup(&key, rid);
+			diskreads[config] = bufMgr->getBufStats().diskreads;
+			checkPassFail(lookupKeys(&index, 0, 30000), 30000)
+			// merges free non-leaf nodes and splits add them, descents go on through the pinned levels
+			checkPassFail(changeEntries(&index, true, 4, 1), 7500)
+			checkPassFail(changeEntries(&index, true, 4, 3), 7500)
+			checkPassFail(lookupKeys(&index, 0, 30000), 15000)
+			checkPassFail(insertBatches(&index, 2, 1, 500), 15000)
+			checkPassFail(lookupKeys(&index, 0, 30000), 30000)
+			checkPassFail(backwardScan(&index,-1,GT,30000,LT,0), 30000)
+			checkPassFail((index.cachedUpperPages() <= (std::size_t)pinned[config]), true)
+		}
+		File::remove(intIndexName);
+	}
+	checkPassFail(accesses[2], 100)
+	checkPassFail((accesses[0] > accesses[1] && accesses[1] > accesses[2]), true)
+	checkPassFail(diskreads[2], 1)
+	checkPassFail((diskreads[0] > diskreads[2]), true)
+	try
+	{
+		options.pinnedUpperPages = -1;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		std::cout << "BadIndexInfoException Test 10 Failed." << std::endl;
+	}
+	catch(const BadIndexInfoException &e)
+	{
+		std::cout << "BadIndexInfoException Test 10 Passed." << std::endl;
+	}
+	deleteRelation();
+}
+
+void test28()
+{
+	// Statistics kept in the meta page, and estimates of ranges from them that read no page
+	std::cout << "--------------------" << std::endl;
+	std::cout << "createRelationRandom, index statistics" << std::endl;
+	createRelationRandom(20000);
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		IndexStats stats = index.statistics();
+		checkPassFail(stats.entries, 20000)
+		checkPassFail(stats.distinctKeys, 20000)
+		checkPassFail(stats.buckets, HISTOGRAM_BUCKETS)
+		checkPassFail(stats.height, 2)
+		checkPassFail((stats.leafPages > 0 && stats.innerPages == 1), true)
+		checkPassFail((stats.leafFill > 0.8 && stats.leafFill <= 0.9), true)
+		checkPassFail(stats.changes, 0)
+		// evenly spread keys are estimated to within a few entries of each bucket the range ends in, without
+		// reading a page
+		int exact = intScan(&index,12345,GT,12400,LT);
+		bufMgr->clearBufStats();
+		checkPassFail(estimateInt(&index,-1,GT,20000,LT), 20000)
+		checkPassFail((std::abs(estimateInt(&index,1000,GTE,5000,LTE) - 4001) <= 10), true)
+		checkPassFail((std::abs(estimateInt(&index,12345,GT,12400,LT) - exact) <= 10), true)
+		checkPassFail(estimateInt(&index,500,GTE,500,LTE), 1)
+		checkPassFail(estimateInt(&index,30000,GTE,40000,LTE), 0)
+		int low = 0;
+		int high = 10000;
+		RangeEstimate half = index.estimateRange(&low, GTE, &high, LT);
+		checkPassFail((std::abs(half.selectivity - 0.5) < 0.001 && std::abs(half.leafPages - stats.leafPages / 2.0) < 0.1), true)
+		checkPassFail(bufMgr->getBufStats().accesses, 0)
+
+		// inserts and deletes count in the buckets of their keys, then the statistics are collected again
+		checkPassFail(changeEntries(&index, true, 4, 1), 5000)
+		stats = index.statistics();
+		checkPassFail(stats.entries, 15000)
+		checkPassFail(stats.changes, 5000)
+		checkPassFail((std::abs(estimateInt(&index,0,GTE,10000,LT) - 7500) <= 10), true)
+		checkPassFail(changeEntries(&index, true, 4, 3), 5000)
+		// a worker collects them beside the deletes, once a quarter of the entries changed
+		for (int wait = 0; wait < 10000 && index.statistics().collectedEntries == 20000; wait++)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		stats = index.statistics();
+		checkPassFail(stats.entries, 10000)
+		checkPassFail((stats.changes < 5000 && stats.collectedEntries < 15000), true)
+		// deletes to leaves the worker had passed count again in the next walk, one with nothing beside it is exact
+		index.refreshStats();
+		checkPassFail((std::abs(estimateInt(&index,2000,GTE,6000,LT) - intScan(&index,2000,GTE,6000,LT)) <= 40), true)
+		// keys past the largest one widen the last bucket
+		for (int key = 20000; key < 21000; key++)
+		{
+			RecordId appended;
+			appended.page_number = key;
+			appended.slot_number = 0;
+			appended.padding = 0;
+			index.insertEntry(&key, appended);
+		}
+		int appended = estimateInt(&index,20000,GTE,21000,LT);
+		checkPassFail((appended > 600 && appended <= 1000), true)
+		checkPassFail(index.statistics().entries, 11000)
+	}
+	{
+		// reopened, the statistics come from the meta page
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		IndexStats stats = index.statistics();
+		checkPassFail(stats.entries, 11000)
+		checkPassFail(stats.buckets, HISTOGRAM_BUCKETS)
+		checkPassFail((std::abs(estimateInt(&index,2000,GTE,6000,LT) - 2000) <= 40), true)
+		index.refreshStats();
+		checkPassFail(index.statistics().changes, 0)
+		checkPassFail(index.statistics().distinctKeys, 11000)
+		try
+		{
+			int low = 5;
+			int high = 2;
+			index.estimateRange(&low, GTE, &high, LTE);
+			checkPassFail(false, true)
+		}
+		catch(const BadScanrangeException &e)
+		{
+		}
+		try
+		{
+			int key = 5;
+			index.estimateRange(&key, LT, &key, LTE);
+			checkPassFail(false, true)
+		}
+		catch(const BadOpcodesException &e)
+		{
+		}
+	}
+	File::remove(intIndexName);
+
+	{
+		BTreeIndex index(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE);
+		double low = 1000;
+		double high = 5000;
+		checkPassFail((std::abs(index.estimateRange(&low, GTE, &high, LT).entries - 4000) <= 10), true)
+		checkPassFail((int)(index.estimateRange(&low, GTE, &low, LTE).entries + 0.5), 1)
+	}
+	File::remove(doubleIndexName);
+	{
+		// string bounds are compared by their bytes after the prefix the bucket shares
+		BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+		char low[64];
+		char high[64];
+		sprintf(low, "%05d string record", 1000);
+		sprintf(high, "%05d string record", 5000);
+		double estimate = index.estimateRange(low, GTE, high, LT).entries;
+		checkPassFail((estimate > 3600 && estimate < 4400), true)
+		checkPassFail(stringScan(&index,1000,GTE,5000,LT), 4000)
+	}
+	File::remove(stringIndexName);
+	{
+		// nearly empty nodes make a deeper tree, whose non-leaf levels the walks pass through
+		IndexOptions options;
+		options.fillFactor = 0.05;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		IndexStats stats = index.statistics();
+		checkPassFail(stats.entries, 20000)
+		checkPassFail((stats.height >= 3 && stats.innerPages > 1), true)
+		int height = stats.height;
+		checkPassFail((std::abs(estimateInt(&index,1000,GTE,5000,LTE) - 4001) <= 10), true)
+		// the nodes have room for the inserts, the worker walks the same levels
+		checkPassFail(changeEntries(&index, false, 2, 1), 10000)
+		for (int wait = 0; wait < 10000 && index.statistics().collectedEntries == 20000; wait++)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		stats = index.statistics();
+		checkPassFail((stats.collectedEntries > 20000 && stats.height == height), true)
+		index.refreshStats();
+		stats = index.statistics();
+		checkPassFail(stats.changes, 0)
+		checkPassFail(stats.collectedEntries, 30000)
+		checkPassFail(stats.height, height)
+	}
+	File::remove(intIndexName);
+	deleteRelation();
+
+	// keys repeated many times, each bucket holds whole keys
+	std::cout << "createRelationDuplicates, index statistics" << std::endl;
+	createRelationDuplicates(20000, 100);
+	for (int posting = 0; posting < 2; posting++)
+	{
+		IndexOptions options;
+		options.postingLists = posting == 1;
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+			IndexStats stats = index.statistics();
+			checkPassFail(stats.entries, 20000)
+			checkPassFail(stats.distinctKeys, 100)
+			checkPassFail(estimateInt(&index,42,GTE,42,LTE), 200)
+			checkPassFail(estimateInt(&index,10,GTE,19,LTE), 2000)
+		}
+		File::remove(intIndexName);
+	}
+	deleteRelation();
+}
+
+// -----------------------------------------------------------------------------
+// createRelationForward
+// -----------------------------------------------------------------------------
+
+void createRelationForward(int relationSize)
+{
+	std::vector<RecordId> ridVec;
+  // destroy any old copies of relation file
+	try
+	{
+		File::remove(relationName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+
+  file1 = new PageFile(relationName, true);
+
+  // initialize all of record1.s to keep purify happy
+  memset(record1.s, ' ', sizeof(record1.s));
+	PageId new_page_number;
+  Page new_page = file1->allocatePage(new_page_number);
+
+  // Insert a bunch of tuples into the relation.
+  for(int i = 0; i < relationSize; i++ )
+	{
+    sprintf(record1.s, "%05d string record", i);
+    record1.i = i;
+    record1.d = (double)i;
+    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
+
+		while(1)
+		{
+			try
+			{
+    		new_page.insertRecord(new_data);
+				break;
+			}
+			catch(const InsufficientSpaceException &e)
+			{
+				file1->writePage(new_page_number, new_page);
+  			new_page = file1->allocatePage(new_page_number);
+			}
+		}
+  }
+	file1->writePage(new_page_number, new_page);
+}
+
+// -----------------------------------------------------------------------------
+// createRelationBackward
+// -----------------------------------------------------------------------------
+
+void createRelationBackward(int relationSize)
+{
+  // destroy any old copies of relation file
+	try
+	{
+		File::remove(relationName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+  file1 = new PageFile(relationName, true);
+
+  // initialize all of record1.s to keep purify happy
+  memset(record1.s, ' ', sizeof(record1.s));
+	PageId new_page_number;
+  Page new_page = file1->allocatePage(new_page_number);
+
+  // Insert a bunch of tuples into the relation.
+  for(int i = relationSize - 1; i >= 0; i-- )
+	{
+    sprintf(record1.s, "%05d string record", i);
+    record1.i = i;
+    record1.d = i;
+
+    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
+
+		while(1)
+		{
+			try
+			{
+    		new_page.insertRecord(new_data);
+				break;
+			}
+			catch(const InsufficientSpaceException &e)
+			{
+				file1->writePage(new_page_number, new_page);
+  			new_page = file1->allocatePage(new_page_number);
+			}
+		}
+  }
+
+	file1->writePage(new_page_number, new_page);
+}
+
+// -----------------------------------------------------------------------------
+// createRelationDuplicates
+// -----------------------------------------------------------------------------
+
+void createRelationDuplicates(int relationSize, int numKeys)
+{
+  // destroy any old copies of relation file
+	try
+	{
+		File::remove(relationName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+  file1 = new PageFile(relationName, true);
+
+  // initialize all of record1.s to keep purify happy
+  memset(record1.s, ' ', sizeof(record1.s));
+	PageId new_page_number;
+  Page new_page = file1->allocatePage(new_page_number);
+
+  // tuple i gets key i % numKeys, every key repeats relationSize / numKeys times
+  for(int i = 0; i < relationSize; i++ )
+	{
+    int val = i % numKeys;
+    sprintf(record1.s, "%05d string record", val);
+    record1.i = val;
+    record1.d = val;
+
+    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
+
+		while(1)
+		{
+			try
+			{
+    		new_page.insertRecord(new_data);
+				break;
+			}
+			catch(const InsufficientSpaceException &e)
+			{
+				file1->writePage(new_page_number, new_page);
+  			new_page = file1->allocatePage(new_page_number);
+			}
+		}
+  }
+
+	file1->writePage(new_page_number, new_page);
+}
+
+// -----------------------------------------------------------------------------
+// createRelationRandom
+// -----------------------------------------------------------------------------
+
+void createRelationRandom(int relationSize, const char *format)
+{
+  // destroy any old copies of relation file
+	try
+	{
+		File::remove(relationName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+  file1 = new PageFile(relationName, true);
+
+  // initialize all of record1.s to keep purify happy
+  memset(record1.s, ' ', sizeof(record1.s));
+	PageId new_page_number;
+  Page new_page = file1->allocatePage(new_page_number);
+
+  // insert records in random order
+
+  std::vector<int> intvec(relationSize);
+  for( int i = 0; i < relationSize; i++ )
+  {
+    intvec[i] = i;
+  }
+
+  long pos;
+  int val;
+	int i = 0;
+  while( i < relationSize )
+  {
+    pos = random() % (relationSize-i);
+    val = intvec[pos];
+    sprintf(record1.s, format, val);
+    record1.i = val;
+    record1.d = val;
+
+    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
+
+		while(1)
+		{
+			try
+			{
+    		new_page.insertRecord(new_data);
+				break;
+			}
+			catch(const InsufficientSpaceException &e)
+			{
+      	file1->writePage(new_page_number, new_page);
+  			new_page = file1->allocatePage(new_page_number);
+			}
+		}
+
+		int temp = intvec[relationSize-1-i];
+		intvec[relationSize-1-i] = intvec[pos];
+		intvec[pos] = temp;
+		i++;
+  }
+  
+	file1->writePage(new_page_number, new_page);
+}
+
+// -----------------------------------------------------------------------------
+// indexTests
+// -----------------------------------------------------------------------------
+
+void indexTests(const IndexOptions &options)
+{
+  intTests(options);
+	try
+	{
+		File::remove(intIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+
+  doubleTests(options);
+	try
+	{
+		File::remove(doubleIndexName);
+	}
+  catch(const FileNotFoundException &e)
+  {
+  }
+
+  stringTests(options);
+	try
+	{
+		File::remove(stringIndexName);
 	}
   catch(const FileNotFoundException &e)
   {
@@ -396,10 +2364,10 @@ void indexTests()
 // intTests
 // -----------------------------------------------------------------------------
 
-void intTests()
+void intTests(const IndexOptions &options)
 {
   std::cout << "Create a B+ Tree index on the integer field" << std::endl;
-  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
   
 
 	// run some tests
@@ -414,20 +2382,490 @@ void intTests()
 
 int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
 {
-  RecordId scanRid;
+  std::cout << "Scan for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowVal << "," << highVal;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << std::endl;
+
+	return scanRecords(index, &lowVal, lowOp, &highVal, highOp);
+}
+
+int intBatchScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp, std::size_t batchSize)
+{
+  std::cout << "Batched scan of " << batchSize << " for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowVal << "," << highVal;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << std::endl;
+
+	std::vector<RecordId> rids(batchSize);
+	Page *curPage;
+	int numResults = 0;
+	int outOfRange = 0;
+	try
+	{
+		index->startScan(&lowVal, lowOp, &highVal, highOp);
+	}
+	catch(const NoSuchKeyFoundException &e)
+	{
+		std::cout << "No Key Found satisfying the scan criteria." << std::endl;
+		return 0;
+	}
+	std::size_t n;
+	while((n = index->scanNextBatch(&rids[0], batchSize)) > 0)
+	{
+		// every record returned must be within the bounds
+		for(std::size_t i = 0; i < n; i++)
+		{
+			bufMgr->readPage(file1, rids[i].page_number, curPage);
+			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(rids[i]).data()));
+			bufMgr->unPinPage(file1, rids[i].page_number, false);
+			if((lowOp == GT ? myRec.i <= lowVal : myRec.i < lowVal) || (highOp == LT ? myRec.i >= highVal : myRec.i > highVal))
+			{
+				outOfRange++;
+			}
+		}
+		numResults += n;
+	}
+	index->endScan();
+	std::cout << "Number of results: " << numResults << std::endl;
+	return outOfRange == 0 ? numResults : -1;
+}
+
+int coveredScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp, std::size_t batchSize)
+{
+  std::cout << "Index-only scan for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowVal << "," << highVal;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << std::endl;
+
+	// the index includes d and s, the records are never read. Both have to be those of a key in the range
+	int width = index->payloadSize();
+	std::vector<RecordId> rids(batchSize > 0 ? batchSize : 1);
+	std::vector<char> payloads(rids.size() * width);
+	int numResults = 0;
+	int wrong = 0;
+	if (!index->tryStartScan(&lowVal, lowOp, &highVal, highOp))
+	{
+		index->endScan();
+		return 0;
+	}
+	while (1)
+	{
+		std::size_t n;
+		if (batchSize == 0)
+		{
+			n = index->tryScanNext(rids[0]) ? 1 : 0;
+			if (n > 0)
+			{
+				memcpy(&payloads[0], index->scanPayload(), width);
+			}
+		}
+		else
+		{
+			n = index->scanNextBatch(&rids[0], batchSize, &payloads[0]);
+		}
+		if (n == 0)
+		{
+			break;
+		}
+		for (std::size_t i = 0; i < n; i++)
+		{
+			double d;
+			char s[STRINGSIZE];
+			char expected[STRINGSIZE];
+			memcpy(&d, &payloads[i * width], sizeof(double));
+			memcpy(s, &payloads[i * width + sizeof(double)], STRINGSIZE);
+			sprintf(expected, "%05d string record", (int)d);
+			if ((lowOp == GT ? d <= lowVal : d < lowVal) || (highOp == LT ? d >= highVal : d > highVal) || strcmp(s, expected) != 0)
+			{
+				wrong++;
+			}
+		}
+		numResults += n;
+	}
+	index->endScan();
+	std::cout << "Number of results: " << numResults << std::endl;
+	return wrong == 0 ? numResults : -1;
+}
+
+int intRangeCount(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+  std::cout << "Range scan for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowVal << "," << highVal;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << std::endl;
+
+	Page *curPage;
+	int numResults = 0;
+	for (RecordId rid : index->range(&lowVal, lowOp, &highVal, highOp))
+	{
+		bufMgr->readPage(file1, rid.page_number, curPage);
+		RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(rid).data()));
+		bufMgr->unPinPage(file1, rid.page_number, false);
+		// a record outside the bounds fails the count
+		if((lowOp == GT ? myRec.i <= lowVal : myRec.i < lowVal) || (highOp == LT ? myRec.i >= highVal : myRec.i > highVal))
+		{
+			return -1;
+		}
+		numResults++;
+	}
+	std::cout << "Number of results: " << numResults << std::endl;
+	return numResults;
+}
+
+int intCount(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+  std::cout << "Range count for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowVal << "," << highVal;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << std::endl;
+
+	int numResults = (int)index->countRange(&lowVal, lowOp, &highVal, highOp);
+	std::cout << "Number of results: " << numResults << std::endl;
+	return numResults;
+}
+
+int estimateInt(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+  std::cout << "Estimate for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowVal << "," << highVal;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << std::endl;
+
+	RangeEstimate estimate = index->estimateRange(&lowVal, lowOp, &highVal, highOp);
+	std::cout << "Estimated results: " << estimate.entries << std::endl;
+	return (int)(estimate.entries + 0.5);
+}
+
+int fetchedScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp, std::size_t batchSize)
+{
+  std::cout << "Fetched scan of " << batchSize << " for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowVal << "," << highVal;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << std::endl;
+
+	// the records of a batch are read through the views while their pages are pinned
+	std::vector<RecordId> rids(batchSize);
+	std::vector<RecordView> views(batchSize);
+	RecordFetcher fetcher(bufMgr, file1);
+	int numResults = 0;
+	int wrong = 0;
+	if (!index->tryStartScan(&lowVal, lowOp, &highVal, highOp))
+	{
+		index->endScan();
+		return 0;
+	}
+	std::size_t n;
+	while((n = index->scanNextBatch(&rids[0], batchSize)) > 0)
+	{
+		fetcher.fetch(&rids[0], n, &views[0]);
+		std::set<PageId> pages;
+		for(std::size_t i = 0; i < n; i++)
+		{
+			RECORD myRec;
+			memcpy(&myRec, views[i].data, sizeof(RECORD));
+			if(views[i].length != sizeof(RECORD) || (lowOp == GT ? myRec.i <= lowVal : myRec.i < lowVal)
+					|| (highOp == LT ? myRec.i >= highVal : myRec.i > highVal))
+			{
+				wrong++;
+			}
+			pages.insert(rids[i].page_number);
+		}
+		wrong += fetcher.pinnedPages() != pages.size();
+		numResults += n;
+	}
+	index->endScan();
+	std::cout << "Number of results: " << numResults << std::endl;
+	return wrong == 0 ? numResults : -1;
+}
+
+int thinnedRun(BTreeIndex * index, int key, bool backward)
+{
+  std::cout << "Run of " << key << " thinned while it is scanned" << std::endl;
+
+	// every other entry is deleted once returned, which leaves the leaves of the cursor underfull. Returns the
+	// entries returned, -1 if one came back twice
+	BTreeCursor cursor(index);
+	if (backward)
+	{
+		cursor.openBackward(&key, GTE, &key, LTE);
+	}
+	else
+	{
+		cursor.open(&key, GTE, &key, LTE);
+	}
+	std::set<std::uint64_t> seen;
+	RecordId rid;
+	while (cursor.next(rid))
+	{
+		if (!seen.insert(((std::uint64_t)rid.page_number << 16) | rid.slot_number).second)
+		{
+			return -1;
+		}
+		if (seen.size() % 2 == 0)
+		{
+			index->deleteEntry(&key, rid);
+		}
+	}
+	std::cout << "Number of results: " << seen.size() << std::endl;
+	return (int)seen.size();
+}
+
+int backwardScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp, std::size_t batchSize)
+{
+  std::cout << "Backward scan of " << batchSize << " for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowVal << "," << highVal;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << std::endl;
+
+	// entries one at a time for a batch size of 0. Keys have to be within the bounds and never go up
+	BTreeCursor cursor(index);
+	std::vector<RecordId> rids(batchSize > 0 ? batchSize : 1);
+	int numResults = 0;
+	int wrong = 0;
+	int previous = highVal;
+	cursor.openBackward(&lowVal, lowOp, &highVal, highOp);
+	while (1)
+	{
+		std::size_t n = batchSize > 0 ? cursor.nextBatch(&rids[0], batchSize) : cursor.next(rids[0]) ? 1 : 0;
+		if (n == 0)
+		{
+			break;
+		}
+		for (std::size_t i = 0; i < n; i++)
+		{
+			Page *curPage;
+			bufMgr->readPage(file1, rids[i].page_number, curPage);
+			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(rids[i]).data()));
+			bufMgr->unPinPage(file1, rids[i].page_number, false);
+			if (myRec.i > previous || (lowOp == GT ? myRec.i <= lowVal : myRec.i < lowVal)
+					|| (highOp == LT ? myRec.i >= highVal : myRec.i > highVal))
+			{
+				wrong++;
+			}
+			previous = myRec.i;
+		}
+		numResults += n;
+	}
+	std::cout << "Number of results: " << numResults << std::endl;
+	return wrong == 0 ? numResults : -1;
+}
+
+int lookupKeys(BTreeIndex * index, int lowVal, int highVal, Datatype type)
+{
+  std::cout << "Lookups for [" << lowVal << "," << highVal << ")" << std::endl;
+
+	// count the keys found, a record id that leads to a record with another key fails the count
 	Page *curPage;
+	int numResults = 0;
+	for (int i = lowVal; i < highVal; i++)
+	{
+		double d = i;
+		char s[64];
+		sprintf(s, "%05d string record", i);
+		const void *key = type == INTEGER ? (const void*)&i : type == DOUBLE ? (const void*)&d : (const void*)s;
+		RecordId rid;
+		bool found = index->lookup(key, rid);
+		if (found != index->contains(key))
+		{
+			return -1;
+		}
+		if (!found)
+		{
+			continue;
+		}
+		bufMgr->readPage(file1, rid.page_number, curPage);
+		RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(rid).data()));
+		bufMgr->unPinPage(file1, rid.page_number, false);
+		if (myRec.i != i)
+		{
+			return -1;
+		}
+		numResults++;
+	}
+	std::cout << "Number of results: " << numResults << std::endl;
+	return numResults;
+}
+
+// -----------------------------------------------------------------------------
+// changeEntries
+// -----------------------------------------------------------------------------
+
+int changeEntries(BTreeIndex * index, bool remove, int modulo, int residue, Datatype type)
+{
+	// delete, or insert, the entries of the tuples whose key is residue modulo modulo
+	int changed = 0;
+	FileScan scan(relationName, bufMgr);
+	try
+	{
+		RecordId rid;
+		while(1)
+		{
+			scan.scanNext(rid);
+			std::string recordStr = scan.getRecord();
+			const RECORD *record = reinterpret_cast<const RECORD*>(recordStr.data());
+			if (record->i % modulo != residue)
+			{
+				continue;
+			}
+			const void *key = type == INTEGER ? (const void*)&record->i
+					: type == DOUBLE ? (const void*)&record->d : (const void*)record->s;
+			if (!remove)
+			{
+				index->insertEntry(key, rid, recordStr.data());
+				changed++;
+			}
+			else if (index->deleteEntry(key, rid))
+			{
+				changed++;
+			}
+		}
+	}
+	catch(const EndOfFileException &e)
+	{
+	}
+	std::cout << (remove ? "Deleted " : "Inserted ") << changed << " entries" << std::endl;
+	return changed;
+}
+
+int insertBatches(BTreeIndex * index, int modulo, int residue, std::size_t batchSize, Datatype type)
+{
+	// insert the entries of the tuples whose key is residue modulo modulo, batchSize at a time
+	std::vector<RECORD> records;
+	std::vector<RecordId> rids;
+	FileScan scan(relationName, bufMgr);
+	try
+	{
+		RecordId rid;
+		while(1)
+		{
+			scan.scanNext(rid);
+			std::string recordStr = scan.getRecord();
+			const RECORD *record = reinterpret_cast<const RECORD*>(recordStr.data());
+			if (record->i % modulo == residue)
+			{
+				records.push_back(*record);
+				rids.push_back(rid);
+			}
+		}
+	}
+	catch(const EndOfFileException &e)
+	{
+	}
+	std::vector<std::pair<const void*, RecordId> > batch;
+	std::vector<const char*> batchRecords;
+	for (std::size_t i = 0; i < records.size(); i += batchSize)
+	{
+		batch.clear();
+		batchRecords.clear();
+		for (std::size_t j = i; j < records.size() && j < i + batchSize; j++)
+		{
+			const void *key = type == INTEGER ? (const void*)&records[j].i
+					: type == DOUBLE ? (const void*)&records[j].d : (const void*)records[j].s;
+			batch.push_back(std::make_pair(key, rids[j]));
+			batchRecords.push_back(reinterpret_cast<const char*>(&records[j]));
+		}
+		index->insertBatch(&batch[0], batch.size(), &batchRecords[0]);
+	}
+	std::cout << "Inserted " << records.size() << " entries in batches of " << batchSize << std::endl;
+	return (int)records.size();
+}
+
+long fileSize(const std::string &fileName)
+{
+	std::ifstream in(fileName.c_str(), std::ios::binary | std::ios::ate);
+	return (long)in.tellg();
+}
+
+// -----------------------------------------------------------------------------
+// doubleTests
+// -----------------------------------------------------------------------------
 
+void doubleTests(const IndexOptions &options)
+{
+  std::cout << "Create a B+ Tree index on the double field" << std::endl;
+  BTreeIndex index(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE, options);
+
+	// run some tests
+	checkPassFail(doubleScan(&index,25,GT,40,LT), 14)
+	checkPassFail(doubleScan(&index,20,GTE,35,LTE), 16)
+	checkPassFail(doubleScan(&index,-3,GT,3,LT), 3)
+	checkPassFail(doubleScan(&index,996,GT,1001,LT), 4)
+	checkPassFail(doubleScan(&index,0,GT,1,LT), 0)
+	checkPassFail(doubleScan(&index,300,GT,400,LT), 99)
+	checkPassFail(doubleScan(&index,3000,GTE,4000,LT), 1000)
+	checkPassFail(doubleScan(&index,24.5,GT,27.5,LT), 3)
+}
+
+int doubleScan(BTreeIndex * index, double lowVal, Operator lowOp, double highVal, Operator highOp)
+{
   std::cout << "Scan for ";
   if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
   std::cout << lowVal << "," << highVal;
   if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
   std::cout << std::endl;
 
+	return scanRecords(index, &lowVal, lowOp, &highVal, highOp);
+}
+
+// -----------------------------------------------------------------------------
+// stringTests
+// -----------------------------------------------------------------------------
+
+void stringTests(const IndexOptions &options)
+{
+  std::cout << "Create a B+ Tree index on the string field" << std::endl;
+  BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING, options);
+
+	// run some tests
+	checkPassFail(stringScan(&index,25,GT,40,LT), 14)
+	checkPassFail(stringScan(&index,20,GTE,35,LTE), 16)
+	checkPassFail(stringScan(&index,-3,GT,3,LT), 3)
+	checkPassFail(stringScan(&index,996,GT,1001,LT), 4)
+	checkPassFail(stringScan(&index,0,GT,1,LT), 0)
+	checkPassFail(stringScan(&index,300,GT,400,LT), 99)
+	checkPassFail(stringScan(&index,3000,GTE,4000,LT), 1000)
+}
+
+int stringScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp, const char *format)
+{
+	// bounds are whole attribute values, the same strings the relation was created with
+	char lowValStr[64];
+	char highValStr[64];
+	sprintf(lowValStr, format, lowVal);
+	sprintf(highValStr, format, highVal);
+
+  std::cout << "Scan for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowValStr << "," << highValStr;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << std::endl;
+
+	return scanRecords(index, lowValStr, lowOp, highValStr, highOp);
+}
+
+// -----------------------------------------------------------------------------
+// scanRecords
+// -----------------------------------------------------------------------------
+
+int scanRecords(BTreeIndex * index, const void *lowVal, Operator lowOp, const void *highVal, Operator highOp)
+{
+  RecordId scanRid;
+	Page *curPage;
+
   int numResults = 0;
 	
 	try
 	{
-  	index->startScan(&lowVal, lowOp, &highVal, highOp);
+  	index->startScan(lowVal, lowOp, highVal, highOp);
 	}
 	catch(const NoSuchKeyFoundException &e)
 	{
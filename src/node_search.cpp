@@ -0,0 +1,177 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "node_search.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NODE_SEARCH_X86
+#endif
+
+namespace badgerdb
+{
+namespace NodeSearch
+{
+
+namespace
+{
+
+/**
+ * Binary search narrows the range down to this many keys, the rest is counted in one
+ * compare-and-popcount pass. 32 ints are two cache lines and four AVX2 compares.
+ */
+const int SEARCH_WINDOW = 32;
+
+typedef int (*CountFn)(const int *keys, int n, int key);
+
+struct Kernel
+{
+	CountFn countLess;
+	CountFn countLessEq;
+	const char *name;
+};
+
+int countLessScalar(const int *keys, int n, int key)
+{
+	int count = 0;
+	for (int i = 0; i < n; i++)
+		count += keys[i] < key;
+	return count;
+}
+
+int countLessEqScalar(const int *keys, int n, int key)
+{
+	int count = 0;
+	for (int i = 0; i < n; i++)
+		count += keys[i] <= key;
+	return count;
+}
+
+#ifdef NODE_SEARCH_X86
+
+__attribute__((target("avx2")))
+int countLessAvx2(const int *keys, int n, int key)
+{
+	const __m256i needle = _mm256_set1_epi32(key);
+	int count = 0;
+	int i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256i block = _mm256_loadu_si256((const __m256i*)(keys + i));
+		__m256i less = _mm256_cmpgt_epi32(needle, block);
+		count += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(less)));
+	}
+	return count + countLessScalar(keys + i, n - i, key);
+}
+
+__attribute__((target("avx2")))
+int countLessEqAvx2(const int *keys, int n, int key)
+{
+	const __m256i needle = _mm256_set1_epi32(key);
+	int count = 0;
+	int i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256i block = _mm256_loadu_si256((const __m256i*)(keys + i));
+		__m256i greater = _mm256_cmpgt_epi32(block, needle);
+		count += 8 - __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(greater)));
+	}
+	return count + countLessEqScalar(keys + i, n - i, key);
+}
+
+__attribute__((target("sse4.1")))
+int countLessSse4(const int *keys, int n, int key)
+{
+	const __m128i needle = _mm_set1_epi32(key);
+	int count = 0;
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128i block = _mm_loadu_si128((const __m128i*)(keys + i));
+		__m128i less = _mm_cmpgt_epi32(needle, block);
+		count += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(less)));
+	}
+	return count + countLessScalar(keys + i, n - i, key);
+}
+
+__attribute__((target("sse4.1")))
+int countLessEqSse4(const int *keys, int n, int key)
+{
+	const __m128i needle = _mm_set1_epi32(key);
+	int count = 0;
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128i block = _mm_loadu_si128((const __m128i*)(keys + i));
+		__m128i greater = _mm_cmpgt_epi32(block, needle);
+		count += 4 - __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(greater)));
+	}
+	return count + countLessEqScalar(keys + i, n - i, key);
+}
+
+#endif
+
+Kernel selectKernel()
+{
+	Kernel kernel = { countLessScalar, countLessEqScalar, "scalar" };
+#ifdef NODE_SEARCH_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+	{
+		kernel.countLess = countLessAvx2;
+		kernel.countLessEq = countLessEqAvx2;
+		kernel.name = "avx2";
+	}
+	else if (__builtin_cpu_supports("sse4.1"))
+	{
+		kernel.countLess = countLessSse4;
+		kernel.countLessEq = countLessEqSse4;
+		kernel.name = "sse4.1";
+	}
+#endif
+	return kernel;
+}
+
+// picked once, before main() runs
+const Kernel kernel = selectKernel();
+
+}
+
+int lowerBound(const int *keys, int n, int key)
+{
+	const int *base = keys;
+	// branch-free halving until the remaining window fits the counting kernel
+	while (n > SEARCH_WINDOW)
+	{
+		int half = n / 2;
+		bool right = base[half - 1] < key;
+		base += right ? half : 0;
+		n = right ? n - half : half;
+	}
+	return (int)(base - keys) + kernel.countLess(base, n, key);
+}
+
+int upperBound(const int *keys, int n, int key)
+{
+	const int *base = keys;
+	while (n > SEARCH_WINDOW)
+	{
+		int half = n / 2;
+		bool right = base[half - 1] <= key;
+		base += right ? half : 0;
+		n = right ? n - half : half;
+	}
+	return (int)(base - keys) + kernel.countLessEq(base, n, key);
+}
+
+const char* kernelName()
+{
+	return kernel.name;
+}
+
+}
+}
@@ -0,0 +1,83 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+namespace badgerdb
+{
+
+/**
+ * @brief In-node key search kernels used by the B+ tree.
+ *
+ * Every search works on the first n entries of a sorted key array and returns a slot
+ * position, so the same call serves descents (child index) and inserts (insert position).
+ * The implementation for int keys is picked once at program startup from the instruction sets
+ * the CPU reports: AVX2, then SSE4.1, then a portable branch-free binary search. Other key
+ * types use the templated binary search, overload resolution prefers the int kernels.
+ */
+namespace NodeSearch
+{
+
+/**
+ * Returns the number of keys in keys[0..n) that are strictly less than key,
+ * i.e. the position of the first key >= key.
+ * @param keys	sorted key array
+ * @param n			number of valid keys in the array
+ * @param key		key searched for
+ */
+int lowerBound(const int *keys, int n, int key);
+
+/**
+ * Returns the number of keys in keys[0..n) that are less than or equal to key,
+ * i.e. the position of the first key > key.
+ * @param keys	sorted key array
+ * @param n			number of valid keys in the array
+ * @param key		key searched for
+ */
+int upperBound(const int *keys, int n, int key);
+
+/**
+ * lowerBound() for key types without a SIMD kernel, a branch-free binary search ordered by operator<.
+ */
+template <class T>
+int lowerBound(const T *keys, int n, const T &key)
+{
+	const T *base = keys;
+	while (n > 1)
+	{
+		int half = n / 2;
+		bool right = base[half - 1] < key;
+		base += right ? half : 0;
+		n = right ? n - half : half;
+	}
+	return (int)(base - keys) + (n == 1 && *base < key);
+}
+
+/**
+ * upperBound() for key types without a SIMD kernel, a branch-free binary search ordered by operator<.
+ */
+template <class T>
+int upperBound(const T *keys, int n, const T &key)
+{
+	const T *base = keys;
+	while (n > 1)
+	{
+		int half = n / 2;
+		bool right = !(key < base[half - 1]);
+		base += right ? half : 0;
+		n = right ? n - half : half;
+	}
+	return (int)(base - keys) + (n == 1 && !(key < *base));
+}
+
+/**
+ * Returns the name of the kernel selected at startup ("avx2", "sse4.1" or "scalar").
+ */
+const char* kernelName();
+
+}
+}
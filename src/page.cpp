@@ -51,6 +51,14 @@ std::string Page::getRecord(const RecordId& record_id) const {
 	return retStr;
 }
 
+const char* Page::getRecordData(const RecordId& record_id,
+                                std::size_t& length) const {
+  validateRecordId(record_id);
+  const PageSlot& slot = getSlot(record_id.slot_number);
+  length = slot.item_length;
+  return data_ + slot.item_offset;
+}
+
 void Page::updateRecord(const RecordId& record_id,
                         const std::string& record_data) {
   validateRecordId(record_id);
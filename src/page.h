@@ -151,6 +151,18 @@ class Page {
    */
   std::string getRecord(const RecordId& record_id) const;
 
+  /**
+   * Returns the bytes of the record with the given ID where they are stored on
+   * the page, without copying them.  They stay valid until the page is changed,
+   * or unpinned if it is in the buffer pool.
+   *
+   * @param record_id  ID of the record to return.
+   * @param length     Length of the record, returned in this.
+   * @return  Pointer to the first byte of the record.
+   */
+  const char* getRecordData(const RecordId& record_id,
+                            std::size_t& length) const;
+
   /**
    * Updates the record with the given ID, replacing its data with a new
    * version.  This is equivalent to deleting the old record and inserting a
@@ -0,0 +1,142 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "read_ahead.h"
+
+namespace badgerdb
+{
+
+ReadAhead::ReadAhead(BufMgr *bufMgr, File *file)
+	: bufMgr(bufMgr), file(file), readingFor(0), stopping(false), lastOwner(0)
+{
+}
+
+ReadAhead::~ReadAhead()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		chains.clear();
+	}
+	wake.notify_one();
+	if (worker.joinable())
+	{
+		worker.join();
+	}
+}
+
+std::uint64_t ReadAhead::newOwner()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return ++lastOwner;
+}
+
+bool ReadAhead::request(std::uint64_t owner, PageId first, int count, NextPageFn nextPage)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (count <= 0 || first == Page::INVALID_NUMBER || readingFor == owner)
+		{
+			return false;
+		}
+		for (std::size_t i = 0; i < chains.size(); i++)
+		{
+			if (chains[i].owner == owner)
+			{
+				return false;
+			}
+		}
+		Chain chain;
+		chain.owner = owner;
+		chain.nextPageNo = first;
+		chain.remaining = count;
+		chain.nextPage = nextPage;
+		chains.push_back(chain);
+		if (!worker.joinable())
+		{
+			worker = std::thread(&ReadAhead::run, this);
+		}
+	}
+	wake.notify_one();
+	return true;
+}
+
+void ReadAhead::cancel(std::uint64_t owner)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	for (std::size_t i = 0; i < chains.size(); i++)
+	{
+		if (chains[i].owner == owner)
+		{
+			chains.erase(chains.begin() + i);
+			break;
+		}
+	}
+	if (readingFor == owner)
+	{
+		// the thread holds the chain, it drops it once the page is read
+		cancelled.insert(owner);
+	}
+	done.wait(lock, [this, owner]() { return readingFor != owner; });
+}
+
+void ReadAhead::forget(std::uint64_t owner)
+{
+	cancel(owner);
+	std::lock_guard<std::mutex> lock(mutex);
+	numRead.erase(owner);
+}
+
+std::uint64_t ReadAhead::pagesRead(std::uint64_t owner)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::map<std::uint64_t, std::uint64_t>::const_iterator it = numRead.find(owner);
+	return it == numRead.end() ? 0 : it->second;
+}
+
+void ReadAhead::run()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (1)
+	{
+		wake.wait(lock, [this]() { return stopping || !chains.empty(); });
+		if (stopping)
+		{
+			return;
+		}
+		Chain chain = chains.front();
+		chains.pop_front();
+		readingFor = chain.owner;
+		lock.unlock();
+		PageId next = Page::INVALID_NUMBER;
+		try
+		{
+			Page *page;
+			bufMgr->readPage(file, chain.nextPageNo, page);
+			next = chain.nextPage(bufMgr, page);
+			bufMgr->unPinPage(file, chain.nextPageNo, false);
+		}
+		catch(...)
+		{
+			// the page is gone or the pool is full, the reader will find out for itself
+		}
+		lock.lock();
+		readingFor = 0;
+		numRead[chain.owner]++;
+		// the chain waits its turn behind the others, unless it was cancelled meanwhile
+		bool dropped = cancelled.erase(chain.owner) > 0;
+		chain.nextPageNo = next;
+		chain.remaining--;
+		if (!dropped && next != Page::INVALID_NUMBER && chain.remaining > 0)
+		{
+			chains.push_back(chain);
+		}
+		done.notify_all();
+	}
+}
+
+}
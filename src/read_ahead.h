@@ -0,0 +1,167 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <set>
+#include <mutex>
+#include <thread>
+#include "types.h"
+#include "page.h"
+#include "file.h"
+#include "buffer.h"
+
+namespace badgerdb
+{
+
+/**
+ * @brief Reads chains of pages into the buffer pool from a thread of its own, ahead of the threads that will need them.
+ *
+ * One ReadAhead serves every scan of a file. Each scan asks for its chain under an owner number of its own, and the
+ * chains wait in a queue, the thread reading a page of the chain at the front and moving the chain to the back
+ * while it has pages left, so that scans side by side take turns. Each page of a chain names the next one, so the
+ * pages of a chain are read one after another: pinned, asked for the next page number and unpinned again, leaving
+ * them in the pool for readPage() to find. The thread is started by the first request and waits for more until
+ * the ReadAhead is destroyed. Read-ahead is only a hint, a page that cannot be read, or a pool without a free
+ * frame, ends the chain without an error.
+ */
+class ReadAhead
+{
+ public:
+  /**
+   * Page number of the page after a pinned page of the chain, Page::INVALID_NUMBER if there is none or the page
+   * could not be read consistently.
+   */
+	typedef PageId (*NextPageFn)(BufMgr *bufMgr, Page *page);
+
+  /**
+   * @param bufMgr	Buffer manager the pages are read into
+   * @param file		File the pages are in
+   */
+	ReadAhead(BufMgr *bufMgr, File *file);
+
+  /**
+   * Drops every chain and stops the thread.
+   */
+	~ReadAhead();
+
+  /**
+   * A new owner number for the requests of one scan, never 0.
+   */
+	std::uint64_t newOwner();
+
+  /**
+   * Read a chain in the background, unless the last chain of the owner is still being read.
+   * @param owner		Owner number of the scan
+   * @param first		First page of the chain
+   * @param count		Number of pages of the chain to read
+   * @param nextPage	Link from a page to the next one of the chain
+   * @return false if the owner has a chain queued and nothing was requested
+   */
+	bool request(std::uint64_t owner, PageId first, int count, NextPageFn nextPage);
+
+  /**
+   * Give up what is left of the chain of the owner. Returns once the thread holds no pin for it any more.
+   */
+	void cancel(std::uint64_t owner);
+
+  /**
+   * cancel() and forget the pages read for the owner, which makes no more requests.
+   */
+	void forget(std::uint64_t owner);
+
+  /**
+   * Number of pages read ahead for the owner, including pages that were in the pool already.
+   */
+	std::uint64_t pagesRead(std::uint64_t owner);
+
+ private:
+	ReadAhead(const ReadAhead &);
+	ReadAhead &operator=(const ReadAhead &);
+
+  /**
+   * The pages of one request left to read.
+   */
+	struct Chain
+	{
+		std::uint64_t owner;
+		PageId nextPageNo;	// next page of the chain
+		int remaining;	// pages left to read
+		NextPageFn nextPage;
+	};
+
+  /**
+   * Body of the thread, reads chains until the ReadAhead is destroyed.
+   */
+	void run();
+
+  /**
+   * Buffer manager the pages are read into.
+   */
+	BufMgr *bufMgr;
+
+  /**
+   * File the pages are in.
+   */
+	File *file;
+
+  /**
+   * Guards the members below, not held while a page is read.
+   */
+	std::mutex mutex;
+
+  /**
+   * Signalled when there is a chain to read or the thread has to stop.
+   */
+	std::condition_variable wake;
+
+  /**
+   * Signalled when the thread finished a page.
+   */
+	std::condition_variable done;
+
+  /**
+   * Chains waiting for the thread, at most one per owner.
+   */
+	std::deque<Chain> chains;
+
+  /**
+   * Owner of the page the thread is reading, with the mutex released, 0 if none.
+   */
+	std::uint64_t readingFor;
+
+  /**
+   * Owners whose chain was cancelled while the thread was reading a page of it.
+   */
+	std::set<std::uint64_t> cancelled;
+
+  /**
+   * Set by the destructor to stop the thread.
+   */
+	bool stopping;
+
+  /**
+   * Last owner number handed out.
+   */
+	std::uint64_t lastOwner;
+
+  /**
+   * Pages read so far for each owner that has not been forgotten.
+   */
+	std::map<std::uint64_t, std::uint64_t> numRead;
+
+  /**
+   * The thread, started by the first request.
+   */
+	std::thread worker;
+};
+
+}
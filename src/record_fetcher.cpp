@@ -0,0 +1,79 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include "record_fetcher.h"
+
+namespace badgerdb
+{
+
+RecordFetcher::RecordFetcher(BufMgr *bufMgr, File *file)
+	: bufMgr(bufMgr), file(file)
+{
+}
+
+RecordFetcher::~RecordFetcher()
+{
+	release();
+}
+
+void RecordFetcher::release()
+{
+	for (std::size_t i = 0; i < pinned.size(); i++)
+	{
+		bufMgr->unPinPage(file, pinned[i], false);
+	}
+	pinned.clear();
+}
+
+void RecordFetcher::fetch(const RecordId *rids, std::size_t count, RecordView *out)
+{
+	release();
+	order.resize(count);
+	for (std::size_t i = 0; i < count; i++)
+	{
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [rids](std::size_t a, std::size_t b) {
+		return rids[a].page_number != rids[b].page_number ? rids[a].page_number < rids[b].page_number
+				: rids[a].slot_number < rids[b].slot_number;
+	});
+
+	// the distinct pages, read ahead in one pass before they are pinned one by one
+	std::vector<PageId> pages;
+	for (std::size_t i = 0; i < count; i++)
+	{
+		PageId pageNo = rids[order[i]].page_number;
+		if (pages.empty() || pages.back() != pageNo)
+		{
+			pages.push_back(pageNo);
+		}
+	}
+	bufMgr->prefetch(file, pages.data(), pages.size());
+
+	try
+	{
+		Page *page = NULL;
+		for (std::size_t i = 0; i < count; i++)
+		{
+			const RecordId &rid = rids[order[i]];
+			if (pinned.empty() || pinned.back() != rid.page_number)
+			{
+				bufMgr->readPage(file, rid.page_number, page);
+				pinned.push_back(rid.page_number);
+			}
+			out[order[i]].data = page->getRecordData(rid, out[order[i]].length);
+		}
+	}
+	catch(...)
+	{
+		release();
+		throw;
+	}
+}
+
+}
@@ -0,0 +1,104 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "types.h"
+#include "page.h"
+#include "file.h"
+#include "buffer.h"
+
+namespace badgerdb
+{
+
+/**
+ * @brief A record where it is stored on its page in the buffer pool.
+ */
+struct RecordView
+{
+	/**
+	 * First byte of the record.
+	 */
+	const char* data;
+
+	/**
+	 * Length of the record in bytes.
+	 */
+	std::size_t length;
+};
+
+/**
+ * @brief Fetches the records of a batch of record ids, such as one returned by BTreeIndex::scanNextBatch().
+ *
+ * The record ids are put in page order and the pages they are on are read ahead together, so records scattered
+ * over the relation are read front to back instead of in index order. Every page is then pinned once for all
+ * of its records, however many there are, and the records are handed back as views into the pinned pages.
+ * The views stay valid until the next fetch() or release(), which unpin the pages. A batch may not be on more
+ * pages than the buffer pool has frames to spare.
+ */
+class RecordFetcher
+{
+ public:
+  /**
+   * @param bufMgr	Buffer manager the pages are pinned in
+   * @param file		Relation the record ids are of
+   */
+	RecordFetcher(BufMgr *bufMgr, File *file);
+
+  /**
+   * Unpins the pages of the last batch.
+   */
+	~RecordFetcher();
+
+  /**
+   * Fetch the records of a batch, releasing the previous one.
+   * @param rids	Record ids, in any order, may repeat
+   * @param count	Number of record ids
+   * @param out		The record of rids[i] is returned in out[i]
+   * @throws InvalidPageException If a record id is on a page the relation does not have
+   * @throws InvalidRecordException If a record id is not that of a record in the relation. No page stays pinned.
+   */
+	void fetch(const RecordId *rids, std::size_t count, RecordView *out);
+
+  /**
+   * Unpin the pages of the last batch, its views are no longer valid.
+   */
+	void release();
+
+  /**
+   * Number of pages the last batch is on, each pinned once.
+   */
+	std::size_t pinnedPages() const
+	{
+		return pinned.size();
+	}
+
+ private:
+  /**
+   * Buffer manager the pages are pinned in.
+   */
+	BufMgr *bufMgr;
+
+  /**
+   * Relation the records are fetched from.
+   */
+	File *file;
+
+  /**
+   * Pages of the last batch, ascending, pinned.
+   */
+	std::vector<PageId> pinned;
+
+  /**
+   * Positions of the record ids of a batch, in page order.
+   */
+	std::vector<std::size_t> order;
+};
+
+}
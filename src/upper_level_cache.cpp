@@ -0,0 +1,65 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include "upper_level_cache.h"
+
+namespace badgerdb
+{
+
+UpperLevelCache::UpperLevelCache(BufMgr *bufMgr, File *file, std::size_t capacity)
+	: bufMgr(bufMgr), file(file), entries(capacity, Entry(PageId(Page::INVALID_NUMBER), (Page*)NULL)), count(0)
+{
+}
+
+UpperLevelCache::~UpperLevelCache()
+{
+	clear();
+}
+
+Page* UpperLevelCache::find(PageId pageNo) const
+{
+	// read while the set may be replaced, a torn read finds a wrong frame or none and fails to validate
+	std::size_t n = std::min(count, entries.size());
+	const Entry *base = entries.data();
+	while (n > 1)
+	{
+		std::size_t half = n / 2;
+		bool right = base[half - 1].first < pageNo;
+		base += right ? half : 0;
+		n = right ? n - half : half;
+	}
+	return n == 1 && base->first == pageNo ? base->second : NULL;
+}
+
+void UpperLevelCache::replace(std::vector<Entry> &pages)
+{
+	std::sort(pages.begin(), pages.end());
+	std::vector<Entry> dropped(entries.begin(), entries.begin() + count);
+	std::size_t n = std::min(pages.size(), entries.size());
+	latch.lock();
+	std::copy(pages.begin(), pages.begin() + n, entries.begin());
+	count = n;
+	latch.unlock();
+	// readers that found a dropped page fail to validate from here on, its frame can go
+	for (std::size_t i = 0; i < dropped.size(); i++)
+	{
+		bufMgr->unPinPage(file, dropped[i].first, false);
+	}
+	for (std::size_t i = n; i < pages.size(); i++)
+	{
+		bufMgr->unPinPage(file, pages[i].first, false);
+	}
+}
+
+void UpperLevelCache::clear()
+{
+	std::vector<Entry> none;
+	replace(none);
+}
+
+}
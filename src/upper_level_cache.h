@@ -0,0 +1,130 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "types.h"
+#include "page.h"
+#include "file.h"
+#include "buffer.h"
+#include "latch.h"
+
+namespace badgerdb
+{
+
+/**
+ * @brief Pages of a file kept pinned in the buffer pool and found by page number without going through the
+ * buffer manager, for the few pages every operation on an index passes.
+ *
+ * The pages are held in a small array sorted by page number, allocated once, so a lookup is a binary search
+ * over a few cache lines and takes no lock. A pinned page stays in its frame, so a page found here is the page
+ * as the buffer manager has it. The set of pages is swapped as a whole under an OptimisticLatch and the pages
+ * that drop out are unpinned afterwards: a reader that used a page from the cache has to validate the version
+ * it read before the lookup before it trusts what it read from the page, the frame may hold another page by now.
+ */
+class UpperLevelCache
+{
+ public:
+  /**
+   * A cached page and its frame.
+   */
+	typedef std::pair<PageId, Page*> Entry;
+
+  /**
+   * @param bufMgr		Buffer manager the pages are pinned in
+   * @param file			File the pages are in
+   * @param capacity	Most pages the cache holds
+   */
+	UpperLevelCache(BufMgr *bufMgr, File *file, std::size_t capacity);
+
+  /**
+   * Unpins the cached pages.
+   */
+	~UpperLevelCache();
+
+  /**
+   * Frame of a cached page, NULL if the page is not cached. Lock-free, see readVersion.
+   */
+	Page* find(PageId pageNo) const;
+
+  /**
+   * Version of the set of pages, to validate reads from a page returned by find against.
+   */
+	std::uint32_t readVersion() const
+	{
+		return latch.readVersion();
+	}
+
+  /**
+   * True if no page was dropped from the cache since readVersion returned version.
+   */
+	bool validate(std::uint32_t version) const
+	{
+		return latch.validate(version);
+	}
+
+  /**
+   * Make pages the cached set. Each page has to be pinned once by the caller, the pin passes to the cache and
+   * is released when the page drops out again. Pages beyond the capacity are unpinned right away.
+   */
+	void replace(std::vector<Entry> &pages);
+
+  /**
+   * Drop and unpin all pages.
+   */
+	void clear();
+
+  /**
+   * Most pages the cache holds.
+   */
+	std::size_t capacity() const
+	{
+		return entries.size();
+	}
+
+  /**
+   * Number of cached pages.
+   */
+	std::size_t size() const
+	{
+		return count;
+	}
+
+ private:
+	UpperLevelCache(const UpperLevelCache &);
+	UpperLevelCache &operator=(const UpperLevelCache &);
+
+  /**
+   * Buffer manager the pages are pinned in.
+   */
+	BufMgr *bufMgr;
+
+  /**
+   * File the pages are in.
+   */
+	File *file;
+
+  /**
+   * Taken while the set of pages changes.
+   */
+	OptimisticLatch latch;
+
+  /**
+   * Cached pages sorted by page number, the first count are in use. Never reallocated.
+   */
+	std::vector<Entry> entries;
+
+  /**
+   * Number of cached pages.
+   */
+	std::size_t count;
+};
+
+}